@@ -77,6 +77,37 @@ extern "C" {
 	/* Trigger INACTIVITY_INTERRUPT if no activity is detected for <INACTIVITY_PERIOD> seconds */
 	#define INACTIVITY_PERIOD							11
 
+	/*--- FIFO streaming configuration ---*/
+	/* Output data rate while streaming. Each FIFO entry costs ~1ms on the 100kHz I2C1 bus, rates
+	   above 400Hz require the bus to run in fast mode */
+#if !defined(ADXL_STREAM_OUTPUT_DATA_RATE)
+	#define ADXL_STREAM_OUTPUT_DATA_RATE				MSK_REG_BW_RATE_400HZ
+#endif
+
+	/* Number of FIFO entries (1 to 31) that raise the WATERMARK interrupt on INT1 */
+#if !defined(ADXL_STREAM_WATERMARK)
+	#define ADXL_STREAM_WATERMARK						16
+#endif
+
+	/* Number of timestamped samples held by the stream ring buffer (power of 2) */
+#if !defined(ADXL_STREAM_BUFFER_SIZE)
+	#define ADXL_STREAM_BUFFER_SIZE						64
+#endif
+
+	/* Motion detection while streaming (ac-coupled, so gravity does not count). The flags are
+	   polled on each drain and mapped to INT2, which is not wired, to keep INT1 for the watermark */
+	#define ADXL_STREAM_ACTIVITY_MG						125.0f
+	#define ADXL_STREAM_INACTIVITY_MG					62.5f
+	#define ADXL_STREAM_INACTIVITY_S					1
+
+	/* Crash detection while streaming. The single tap engine flags a short shock on the x or y axis
+	   (collision), the free fall engine a car that left the ground. Both are mapped to INT1 with the
+	   watermark, so they wake the calculations task up without polling */
+	#define ADXL_STREAM_IMPACT_MG						3000.0f
+	#define ADXL_STREAM_IMPACT_DURATION_US				10000
+	#define ADXL_STREAM_FREEFALL_MG						437.5f
+	#define ADXL_STREAM_FREEFALL_MS						100
+
 
 /*-------------------------  BEGIN ADXL343 REGISTERS  ------------------------*/
 /***
@@ -194,6 +225,20 @@ extern "C" {
 #define REG_TIME_FF_BASE					((uint8_t)0x29)
 #define REG_TAP_AXES_BASE					((uint8_t)0x2A)
 #define REG_ACT_TAP_STATUS_BASE				((uint8_t)0x2B)
+
+	/**
+	 * @type Read/Write (R/W)
+	 * @desc Axes taking part in tap detection (TAP_AXES)
+	 *
+	 * Scale factors: THRESH_TAP and THRESH_FF are 62.5mg/LSB, DUR is 625us/LSB, TIME_FF is 5ms/LSB
+	 */
+	#define MSK_TAP_AXES_TAP_Z_EN					((uint8_t)0x01)
+	#define MSK_TAP_AXES_TAP_Y_EN					((uint8_t)0x02)
+	#define MSK_TAP_AXES_TAP_X_EN					((uint8_t)0x04)
+	#define MSK_TAP_AXES_SUPPRESS					((uint8_t)0x08)
+
+	/* --- End of TAP_AXES definition --- */
+
 #define REG_BW_RATE_BASE					((uint8_t)0x2C)
 
 	/**
@@ -521,10 +566,40 @@ extern "C" {
 	#define MSK_FIFO_CTL_BUFFER_STREAM			((uint8_t)0x02 << BITPOS_FIFO_CTL_FIFOMODE)
 	#define MSK_FIFO_CTL_BUFFER_TRIGGER			((uint8_t)0x03 << BITPOS_FIFO_CTL_FIFOMODE)
 	
+	#define MSK_FIFO_CTL_SAMPLES				((uint8_t)0x1F)
+	#define MSK_FIFO_CTL_TRIGGER				((uint8_t)0x20)
+
 	/* --- End of FIFO_CTL definition --- */
 
 #define REG_FIFO_STATUS_BASE				((uint8_t)0x39)
 
+	/**
+	 * @type Read only (R)
+	 * @desc FIFO status
+	 *
+	 * bitfields:
+	 *			FIFO_STATUS[5:0] = Entries
+	 *						These bits report how many data values are stored in FIFO.
+	 *						Access to collect the data from FIFO is provided through the
+	 *						DATAX, DATAY, and DATAZ registers. FIFO reads must be done in
+	 *						burst or multiple-byte mode because each FIFO level is cleared
+	 *						after any read (single- or multiple-byte) of FIFO. FIFO stores
+	 *						a maximum of 32 entries.
+	 *
+	 *			FIFO_STATUS[7] = FIFO_TRIG
+	 *						A 1 in the FIFO_TRIG bit corresponds to a trigger event
+	 *						occurring, and a 0 means that a FIFO trigger event has not
+	 *						occurred.
+	 */
+
+	/* bit masks */
+	#define MSK_FIFO_STATUS_ENTRIES				((uint8_t)0x3F)
+	#define MSK_FIFO_STATUS_FIFO_TRIG			((uint8_t)0x80)
+
+	#define ADXL_FIFO_DEPTH						32
+
+	/* --- End of FIFO_STATUS definition --- */
+
 
 /* Exported types ------------------------------------------------------------*/
 /* Boolean typedef for ADXL343 register bitfields */
@@ -646,6 +721,41 @@ typedef struct
 } AccelerometerIrqStatus;
 
 
+/**
+ * @brief	Raw acceleration sample drained from the FIFO. The timestamp is rebuilt from the
+ * 			time of the watermark interrupts and the measured sample period.
+ */
+typedef struct
+{
+	uint32_t Timestamp_us;		/* Sampling time in microseconds (wraps around) */
+	uint16_t RawX;
+	uint16_t RawY;
+	uint16_t RawZ;
+
+} AccelerometerSample;
+
+
+/**
+ * @brief	Statistics of the FIFO streaming mode
+ */
+typedef struct
+{
+	uint32_t SamplePeriod_us;	/* Period between two samples at the configured output data rate */
+	uint32_t Drains;			/* Number of FIFO drains (I2C FIFO_STATUS reads) */
+	uint32_t Samples;			/* Number of samples drained from the FIFO */
+	uint32_t FifoFull;			/* Drains that found 32 entries, older samples may have been overwritten */
+	uint32_t Dropped;			/* Samples lost because the ring buffer was full */
+	uint32_t Anchors;			/* Watermark edges used to timestamp the samples */
+	uint32_t PeriodRejected;	/* Period measurements too far from the nominal one, ignored */
+	uint32_t MeasuredPeriod_q8;	/* Sample period measured between watermark edges, us in Q24.8 */
+	uint32_t InactivityEvents;	/* INACTIVITY flags seen, the device is still */
+	uint32_t ActivityEvents;	/* ACTIVITY flags seen, the device moves again */
+	uint32_t ImpactEvents;		/* SINGLE_TAP flags seen, shock above ADXL_STREAM_IMPACT_MG */
+	uint32_t FreeFallEvents;	/* FREE_FALL flags seen */
+
+} AccelerometerStreamStats;
+
+
 
 /* Exported macro ------------------------------------------------------------*/
 	/* Call to clear irq flags without irq flag identification */
@@ -654,6 +764,13 @@ typedef struct
 	/* Sets 32-level buffer mode to Bypass mode */
 	#define __RESET_MEMORY_BUFFER_MODE()		(ADXL343_ConfigureFIFOMode(Buffer_Bypass))
 
+	/* Sample period in microseconds of a BW_RATE output data rate code (0x0F = 3200Hz, halved per step) */
+	#define ADXL_ODR_PERIOD_US(code)			((625UL << (0x0F - ((code) & 0x0F))) / 2)
+
+
+/* Exported variables --------------------------------------------------------*/
+	extern AccelerometerStreamStats xStreamStats;
+
 
 /* Exported functions prototypes ---------------------------------------------*/
 	/*--- Power related functions ---*/
@@ -673,6 +790,8 @@ typedef struct
 	void Accelerometer_SetInterrupt(AccelerometerIrq xIrqPos, AccelerometerBitState xState);
 	void Accelerometer_ResetInterrupt(void);
 	void Accelerometer_MapInterrupt(AccelerometerIrq xIrqPos, AcceleromterIrqPin xIrqPin);
+	void Accelerometer_ConfigureImpactDetection(float cImpactmg, uint32_t cDuration_us, float cFreeFallmg,
+												uint16_t cFreeFall_ms);
 	uint8_t Accelerometer_ReturnIrqFlags(void);
 	void Accelerometer_CheckInterruptFlags(AccelerometerIrqStatus *xIrqStatus);
 
@@ -683,10 +802,22 @@ typedef struct
 	void ADXL343_SPI3WireMode(AccelerometerBitState xState);
 	void ADXL343_ConfigureFIFOMode(AccelerometerBufferStates xBufferMode);
 	void ADXL_ConfigureAccelerationRange(AccelerometerRange xRange);
+	void ADXL343_CommitConfig(void);
 	int32_t ADXL_TwosComplement_13bits(uint16_t value);
 	uint8_t ADXL_TwosComplement_8bits(int8_t input);
 	void ADXL_ReadAcceleration(float *AccelerationX, float *AccelerationY, float *AccelerationZ);
 	void ADXL_ConfigureOffsets(void);
+	float ADXL_ConvertRawAcceleration(uint16_t RawAccel);
+
+	/*--- FIFO streaming ---*/
+	void ADXL343_ConfigureFIFOSamples(uint8_t cSamples);
+	uint8_t ADXL343_ReadFIFOEntries(void);
+	void ADXL343_StartStream(uint8_t cOutputDataRate_Hz, uint8_t cWatermark);
+	void ADXL_StreamMarkWatermark(uint32_t Timestamp_us);
+	uint8_t ADXL_StreamDrain(uint32_t Now_us);
+	uint8_t ADXL_StreamRead(AccelerometerSample *pSample);
+	uint8_t ADXL_StreamInactive(void);
+	uint8_t ADXL_StreamTakeEvents(void);
 
 
 	/*--- Initialization ---*/
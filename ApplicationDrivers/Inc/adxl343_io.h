@@ -36,6 +36,17 @@ extern "C" {
 		A_SET = !A_RESET
 	} AccelerometerFunctionalState;
 
+	/*--- I2C1 traffic of the ADXL343 ---*/
+	typedef struct
+	{
+		uint32_t Transactions;			/* I2C transactions started (retries not counted) */
+		uint32_t ShadowReads;			/* Register reads served by the shadow, no transaction */
+		uint32_t StagedWrites;			/* Register changes staged for the next flush */
+		uint32_t Bursts;				/* Multi-byte writes made by the flushes */
+		uint32_t BurstBytes;			/* Registers written by these bursts */
+
+	} AccelerometerBusStats;
+
 
 /* Exported constants --------------------------------------------------------*/
 
@@ -43,6 +54,10 @@ extern "C" {
 /* Exported macro ------------------------------------------------------------*/
 
 
+/* Exported variables --------------------------------------------------------*/
+extern AccelerometerBusStats xAccelBusStats;
+
+
 /* Private defines -----------------------------------------------------------*/
 
 	/**
@@ -100,10 +115,15 @@ extern "C" {
 
 /* Exported functions prototypes ---------------------------------------------*/
 void AccelerometerBus_Init(void);
+void __io_accelerometer_i2cEngineInit(void);
+void __io_accelerometer_i2cCpltCallback(ErrorStatus xStatus);
 // void __io_accelerometer_i2cWrite(uint8_t* pTxBuff, uint16_t cTxLen);
 // void __io_accelerometer_i2cRead(uint8_t* pRxBuff, uint16_t cRxLen);
 void __io_accelerometer_i2cWriteRegister(uint8_t cRegAddress, uint8_t pData, uint8_t nRetransmissions);
 uint8_t __io_accelerometer_i2cReadRegister(uint8_t cRegAddress, uint8_t nRetransmissions);
+uint8_t __io_accelerometer_ShadowRead(uint8_t cRegAddress, uint8_t nRetransmissions);
+void __io_accelerometer_ShadowStage(uint8_t cRegAddress, uint8_t cData, uint8_t nRetransmissions);
+ErrorStatus __io_accelerometer_ShadowFlush(uint8_t nRetransmissions);
 void __ADXL_READMULTIBYTE_FIFO(uint16_t *DataX, uint16_t *DataY, uint16_t *DataZ);
 
 
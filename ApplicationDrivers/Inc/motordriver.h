@@ -52,9 +52,41 @@ typedef enum
 	SPEED_CAR_OFF		= ((uint8_t)0x00)
 } E_Speed_Car;
 
+/* Outputs driven on the motor shield, kept as a shadow of what is latched/loaded in HW */
+typedef struct
+{
+	uint8_t ShiftRegister;					/* Direction byte latched in the shift register */
+	uint16_t WheelCCR[MOTWHEEL_COUNT];		/* PWM compare value of each wheel (E_MotorWheel_Idx) */
+
+} MotorOutputs;
+
+/* Statistics of Motor_ApplyWheelChanges() calls */
+typedef struct
+{
+	uint32_t Committed;						/* Calls that changed at least one output */
+	uint32_t Suppressed;					/* Calls skipped, HW already held the staged outputs */
+	uint32_t ShiftRegisterWrites;			/* Committed calls that had to shift a byte out */
+
+} MotorCommitStats;
+
+/* Statistics of the brake deadlines, lateness is measured from the deadline given to the watchdog */
+typedef struct
+{
+	uint32_t Arms;							/* Motor_ArmBrakeWatchdog() calls */
+	uint32_t TaskBrakes;					/* Deadlines met by the task braking in time */
+	uint32_t WatchdogBrakes;				/* Deadlines missed by the task, braked by TIM9 */
+	uint32_t TaskLastLateness_us;
+	uint32_t TaskMaxLateness_us;
+	uint32_t WatchdogLastLateness_us;
+	uint32_t WatchdogMaxLateness_us;
+
+} MotorBrakeStats;
+
 
 /* Exported variables ----------------------------------------------------------------------------*/
 extern __IO uint8_t g_ShiftRegisterByteToSet;
+extern MotorCommitStats xMotorCommitStats;
+extern MotorBrakeStats xMotorBrakeStats;
 
 
 /* Exported defines ------------------------------------------------------------------------------*/
@@ -64,6 +96,9 @@ extern __IO uint8_t g_ShiftRegisterByteToSet;
 	#define SPEED_CAR_NORMAL_PERCENTAGE					80
 	#define SPEED_CAR_SLOW_PERCENTAGE					65
 
+	/*--- Time given to the task to brake on a deadline before the watchdog does ---*/
+	#define MOTOR_BRAKE_GUARD_MS						((uint32_t)5)
+
 
 /* Exported constants ----------------------------------------------------------------------------*/
 
@@ -75,12 +110,21 @@ extern __IO uint8_t g_ShiftRegisterByteToSet;
 	/*--- Basic/general motor functions ---*/
 	void Motor_Init(void);
 	void Motor_ApplyWheelChanges(void);
+	void Motor_GetOutputs(MotorOutputs *pOutputs);
+	uint8_t Motor_TryGetOutputs(MotorOutputs *pOutputs);
+	void Motor_ArmBrakeWatchdog(uint32_t Timeout_ms);
+	void Motor_DisarmBrakeWatchdog(void);
+	void Motor_BrakeWatchdogExpired(void);
 
 	/*--- Motor Direction related functions ---*/
 	void Motor_ConfigWheelDirection(E_MotorWheel_Pos MotorWheel, E_Dir_SingleWheel WheelDirection);
 	void Car_ConfigDirection(E_Dir_Car CarDirection);
+	void Car_ConfigVector(int8_t Throttle, int8_t Steer);
 
 	/*--- Motor Speed related functions ---*/
+	void Motor_ConfigWheelSpeed(E_MotorWheel_Pos MotorWheel, uint8_t Percentage);
+	void Motor_ConfigAllWheelSpeed(uint8_t Percentage);
+	void Motor_ApplyWheelSpeeds(const uint8_t pPercentage[MOTWHEEL_COUNT]);
 	void Car_ConfigSpeed(E_Speed_Car CarSpeed);
 
 	/*--- Misc. functions ---*/
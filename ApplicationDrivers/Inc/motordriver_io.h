@@ -52,6 +52,16 @@ typedef enum
 	MOTWHEEL_REARTIRES		= ((uint8_t)0x66)
 } E_MotorWheel_Pos;
 
+/* Index of each motor wheel in arrays holding one value per wheel (PWM compare values) */
+typedef enum
+{
+	MOTWHEEL_IDX_REARLEFT	= 0,
+	MOTWHEEL_IDX_REARRIGHT,
+	MOTWHEEL_IDX_FRONTRIGHT,
+	MOTWHEEL_IDX_FRONTLEFT,
+	MOTWHEEL_COUNT
+} E_MotorWheel_Idx;
+
 
 /* Exported variables ----------------------------------------------------------------------------*/
 extern __IO uint8_t g_RecentShiftRegisterByte;
@@ -62,12 +72,26 @@ extern __IO uint8_t g_RecentShiftRegisterByte;
 	#define WHEEL_SPEED_DEFAULT_PERCENTAGE				100
 	#define WHEEL_SPEED_DEFAULT_STARTING_PERCENTAGE		0
 
+	/*--- Shift Register Back End ---*/
+	/* TIM_DMA: TIM1 update/CH1 requests drive DMA2 Stream5/Stream1 into GPIO BSRR, no CPU involvement */
+	/* BITBANG: pins toggled from the CPU with delay loops (also used before the scheduler starts) */
+	#define MOTOR_SR_BACKEND_BITBANG			0
+	#define MOTOR_SR_BACKEND_TIM_DMA			1
+#ifndef MOTOR_SR_BACKEND
+	#define MOTOR_SR_BACKEND					MOTOR_SR_BACKEND_TIM_DMA
+#endif
+
 	/*--- Timer PWM Parameters ---*/
 	#define	TIM_PWM_PRESCALER_VALUE				9
 	#define TIM_PWM_PERIOD_VALUE				999
 	#define TIM_PWM_MAX_CCR_VALUE				(TIM_PWM_PERIOD_VALUE + 1)
 	#define MAX_PERCENTAGE						100
 
+	/*--- Brake watchdog (TIM9 one-pulse, 100MHz / (9999 + 1) = 100us per tick) ---*/
+	#define TIM_BRAKE_PRESCALER_VALUE			9999
+	#define TIM_BRAKE_TICKS_PER_MS				10
+	#define TIM_BRAKE_MAX_MS					((uint32_t)(0xFFFF / TIM_BRAKE_TICKS_PER_MS))
+
 	/*--- Shift Register Pins ---*/
 	/* Reference: https://lastminuteengineers.com/74hc595-shift-register-arduino-tutorial/ */
 	#define DIR_LATCH_Pin						GPIO_PIN_6
@@ -142,6 +166,11 @@ void __MOTOR_HWInit(void);
 void __MOTOR_SetShiftRegister(uint8_t cByte);
 void __MOTOR_ConfigureSpeed(E_MotorWheel_Pos MotorWheel, uint8_t Percentage);
 void __MOTOR_ConfigureAllWheelSpeed(uint8_t Percentage);
+uint16_t __MOTOR_PercentageToCCR(uint8_t Percentage);
+void __MOTOR_SetAllWheelCCR(const uint16_t *WheelCCR);
+void __MOTOR_StartBrakeTimer(uint32_t Timeout_ms);
+void __MOTOR_StopBrakeTimer(void);
+void __MOTOR_ZeroAllWheelCCR(void);
 
 
 #ifdef __cplusplus
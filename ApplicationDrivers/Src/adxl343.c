@@ -33,7 +33,7 @@
 /* Uncomment the line below to utilize SWO/SWD printf() outputs */
 // #define USE_VCOM
 
-/* define FREERTOS_INCLUDED to perform accurate sampling of acceleration data */
+/* define FREERTOS_INCLUDED to sleep between acceleration samples instead of busy waiting */
 #define FREERTOS_INCLUDED
 #if defined(FREERTOS_INCLUDED)
 	#include "FreeRTOS.h"
@@ -54,11 +54,44 @@ ActInactControlBits xActInactCtlValues = {
 	INACT_Z_AXIS_EN
 };
 
+/* Statistics of the FIFO streaming mode */
+AccelerometerStreamStats xStreamStats = {0};
+
+/* Ring buffer of drained samples. Filled by ADXL_StreamDrain() and emptied by ADXL_StreamRead(),
+   both indexes only ever increase and are masked on access */
+static AccelerometerSample s_StreamBuffer[ADXL_STREAM_BUFFER_SIZE];
+static volatile uint16_t s_StreamHead = 0;
+static volatile uint16_t s_StreamTail = 0;
+
+/* Sample timestamping. The FIFO reaches its watermark right when the watermark-th entry is sampled,
+   so each INT1 edge dates one sample exactly. Samples are dated from the latest such anchor and
+   the period measured between anchors (the ADXL343 oscillator is not the MCU clock). */
+static volatile uint32_t s_WatermarkTimestamp_us = 0;
+static volatile uint8_t s_WatermarkPending = 0;
+static uint8_t s_StreamWatermark = 1;
+static uint32_t s_StreamIndex = 0;				/* Entries popped from the FIFO since the stream started */
+static uint32_t s_AnchorIndex = 0;
+static uint32_t s_AnchorTimestamp_us = 0;
+static uint8_t s_AnchorValid = 0;
+
+/* Set on INACTIVITY, cleared on ACTIVITY */
+static volatile uint8_t s_StreamInactive = 0;
+
+/* SINGLE_TAP/FREE_FALL flags seen since the last ADXL_StreamTakeEvents() */
+static uint8_t s_StreamEvents = 0;
+
 
 /* Private macro -------------------------------------------------------------*/
+/* Measured periods further than 1/8 (12.5%) from the nominal one are taken as missed edges */
+#define ADXL_PERIOD_TOLERANCE_SHIFT		3
+
+#if ((ADXL_STREAM_BUFFER_SIZE & (ADXL_STREAM_BUFFER_SIZE - 1)) != 0)
+	#error "ADXL_STREAM_BUFFER_SIZE must be a power of 2"
+#endif
 
 
 /* Private function prototypes -----------------------------------------------*/
+static void ADXL_StreamUpdateAnchor(uint8_t cEntries, uint32_t Now_us);
 
 /**
   **************************************************************************************************
@@ -71,11 +104,16 @@ ActInactControlBits xActInactCtlValues = {
  * @note  	Configure device prior to setting the measurement bit high (while
  *        	device is still in STANDBY mode). Clearing the measurement bit
  *        	will place device back in STANDBY mode.
+ * @note	Writes the configuration staged so far, before setting the measurement bit
  */
 void Accelerometer_SetMeasurementMode(AccelerometerBitState xState)
 {
+	/* Configuration staged while in STANDBY mode must reach the device first */
+	if(xState == A_ENABLE)
+		__io_accelerometer_ShadowFlush(NMAX_I2C_RETX);
+
 	/* Read contents of POWER_CTL register before modifying */
-	uint8_t temp = __io_accelerometer_i2cReadRegister(REG_POWER_CTL_BASE, NMAX_I2C_RETX);
+	uint8_t temp = __io_accelerometer_ShadowRead(REG_POWER_CTL_BASE, NMAX_I2C_RETX);
 	
 	if(xState == A_ENABLE)
 	{
@@ -89,7 +127,8 @@ void Accelerometer_SetMeasurementMode(AccelerometerBitState xState)
 	}
 	
 	/* Overwrite/update the POWER_CTL register */
-	__io_accelerometer_i2cWriteRegister(REG_POWER_CTL_BASE, temp, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_POWER_CTL_BASE, temp, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowFlush(NMAX_I2C_RETX);
 }
 
 
@@ -101,7 +140,7 @@ void Accelerometer_SetMeasurementMode(AccelerometerBitState xState)
 void Accelerometer_SetLowPowerMode(AccelerometerBitState xState)
 {
 	/* Read contents of BW_RATE register before modifying */
-	uint8_t temp = __io_accelerometer_i2cReadRegister(REG_BW_RATE_BASE, NMAX_I2C_RETX);
+	uint8_t temp = __io_accelerometer_ShadowRead(REG_BW_RATE_BASE, NMAX_I2C_RETX);
 	
 	if(xState == A_ENABLE)
 	{
@@ -115,7 +154,7 @@ void Accelerometer_SetLowPowerMode(AccelerometerBitState xState)
 	}
 	
 	/* Overwrite/update the BW_RATE register */
-	__io_accelerometer_i2cWriteRegister(REG_BW_RATE_BASE, temp, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_BW_RATE_BASE, temp, NMAX_I2C_RETX);
 	
 }
 
@@ -129,7 +168,7 @@ void Accelerometer_SetLowPowerMode(AccelerometerBitState xState)
 void Accelerometer_SetOutputDataRate(uint8_t cOutputDataRate_Hz)
 {
 	/* Read contents of BW_RATE register before modifying */
-	uint8_t temp = __io_accelerometer_i2cReadRegister(REG_BW_RATE_BASE, NMAX_I2C_RETX);
+	uint8_t temp = __io_accelerometer_ShadowRead(REG_BW_RATE_BASE, NMAX_I2C_RETX);
 	
 	/* Clear/reset Output Data Rate field */
 	temp &= MSK_REG_BW_LOWPOWER;
@@ -138,7 +177,7 @@ void Accelerometer_SetOutputDataRate(uint8_t cOutputDataRate_Hz)
 	temp |= cOutputDataRate_Hz;
 	
 	/* Overwrite/update the BW_RATE register */
-	__io_accelerometer_i2cWriteRegister(REG_BW_RATE_BASE, temp, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_BW_RATE_BASE, temp, NMAX_I2C_RETX);
 }
 
 
@@ -153,7 +192,7 @@ void Accelerometer_EnableAutoSleep(uint8_t cTimeInactivity, float cThreshmg)
 	Accelerometer_WriteInactivityThreshTimeMg(cTimeInactivity, cThreshmg);
 	
 	/* Read contents of POWER_CTL register before modifying */
-	uint8_t temp = __io_accelerometer_i2cReadRegister(REG_POWER_CTL_BASE, NMAX_I2C_RETX);
+	uint8_t temp = __io_accelerometer_ShadowRead(REG_POWER_CTL_BASE, NMAX_I2C_RETX);
 	
 	/* Enable Auto sleep bit */
 	temp |= MSK_POWER_CTL_AUTOSLEEP;
@@ -162,7 +201,7 @@ void Accelerometer_EnableAutoSleep(uint8_t cTimeInactivity, float cThreshmg)
 	temp |= MSK_POWER_CTL_LINK;
 	
 	/* Overwrite/update the POWER_CTL register */
-	__io_accelerometer_i2cWriteRegister(REG_POWER_CTL_BASE, temp, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_POWER_CTL_BASE, temp, NMAX_I2C_RETX);
 }
 
 /**
@@ -179,8 +218,8 @@ void Accelerometer_EnableAutoSleep(uint8_t cTimeInactivity, float cThreshmg)
 void Accelerometer_WriteInactivityThreshTime(uint8_t cTimeInactivity, uint8_t cThreshInactivity)
 {
 	/* Configure inactivity conditions/requirements for inactivity function */
-	__io_accelerometer_i2cWriteRegister(REG_THRESH_INACT_BASE, cThreshInactivity, NMAX_I2C_RETX);
-	__io_accelerometer_i2cWriteRegister(REG_TIME_INACT_BASE, cTimeInactivity, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_THRESH_INACT_BASE, cThreshInactivity, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_TIME_INACT_BASE, cTimeInactivity, NMAX_I2C_RETX);
 }
 
 
@@ -190,7 +229,7 @@ void Accelerometer_WriteInactivityThreshTime(uint8_t cTimeInactivity, uint8_t cT
 void Accelerometer_WriteActivityThreshold(uint8_t cThreshActivity)
 {
 	/* Configure the activity threshold */
-	__io_accelerometer_i2cWriteRegister(REG_THRESH_ACT_BASE, cThreshActivity, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_THRESH_ACT_BASE, cThreshActivity, NMAX_I2C_RETX);
 }
 
 
@@ -282,7 +321,7 @@ void Accelerometer_ConfigureActInactControl(ActInactControlBits xInput)
 		temp |= MSK_ACT_INACT_CTL_INACT_Z_EN;
 	
 	/* Update the ACT_INACT_CTL register with the new configuration */
-	__io_accelerometer_i2cWriteRegister(REG_ACT_INACT_CTL_BASE, temp, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_ACT_INACT_CTL_BASE, temp, NMAX_I2C_RETX);
 }
 
 
@@ -298,7 +337,7 @@ void Accelerometer_ConfigureActInactControl(ActInactControlBits xInput)
 void Accelerometer_LinkActivityInactivity(AccelerometerBitState xState)
 {
 	/* Read POWER_CTL register prior to changing/modifying its value */
-	uint8_t temp = __io_accelerometer_i2cReadRegister(REG_POWER_CTL_BASE, NMAX_I2C_RETX);
+	uint8_t temp = __io_accelerometer_ShadowRead(REG_POWER_CTL_BASE, NMAX_I2C_RETX);
 	
 	if(xState == A_ENABLE)
 	{
@@ -312,7 +351,7 @@ void Accelerometer_LinkActivityInactivity(AccelerometerBitState xState)
 	}
 	
 	/* Update POWER_CTL register */
-	__io_accelerometer_i2cWriteRegister(REG_POWER_CTL_BASE, temp, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_POWER_CTL_BASE, temp, NMAX_I2C_RETX);
 }
 
 
@@ -324,7 +363,7 @@ void Accelerometer_LinkActivityInactivity(AccelerometerBitState xState)
 void Accelerometer_SetInterrupt(AccelerometerIrq xIrqPos, AccelerometerBitState xState)
 {
 	/* Read contents of INT_ENABLE before modifying */
-	uint8_t temp = __io_accelerometer_i2cReadRegister(REG_INT_ENABLE_BASE, NMAX_I2C_RETX);
+	uint8_t temp = __io_accelerometer_ShadowRead(REG_INT_ENABLE_BASE, NMAX_I2C_RETX);
 	
 	if(xState == A_ENABLE)
 	{
@@ -338,7 +377,7 @@ void Accelerometer_SetInterrupt(AccelerometerIrq xIrqPos, AccelerometerBitState
 	}
 	
 	/* Overwrite/update the INT_ENABLE register */
-	__io_accelerometer_i2cWriteRegister(REG_INT_ENABLE_BASE, temp, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_INT_ENABLE_BASE, temp, NMAX_I2C_RETX);
 }
 
 
@@ -348,7 +387,7 @@ void Accelerometer_SetInterrupt(AccelerometerIrq xIrqPos, AccelerometerBitState
 void Accelerometer_ResetInterrupt(void)
 {
 	/* Disable all interrupts by setting 0 on all bitfields of INT_ENABLE register */
-	__io_accelerometer_i2cWriteRegister(REG_INT_ENABLE_BASE, 0x00, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_INT_ENABLE_BASE, 0x00, NMAX_I2C_RETX);
 }
 
 
@@ -358,7 +397,7 @@ void Accelerometer_ResetInterrupt(void)
 void Accelerometer_MapInterrupt(AccelerometerIrq xIrqPos, AcceleromterIrqPin xIrqPin)
 {
 	/* Read contents of INT_MAP before modifying */
-	uint8_t temp = __io_accelerometer_i2cReadRegister(REG_INT_MAP_BASE, NMAX_I2C_RETX);
+	uint8_t temp = __io_accelerometer_ShadowRead(REG_INT_MAP_BASE, NMAX_I2C_RETX);
 	
 	if(xIrqPin == InterruptPin1)
 	{
@@ -372,7 +411,35 @@ void Accelerometer_MapInterrupt(AccelerometerIrq xIrqPos, AcceleromterIrqPin xIr
 	}
 	
 	/* Overwrite/update the INT_MAP register */
-	__io_accelerometer_i2cWriteRegister(REG_INT_MAP_BASE, temp, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_INT_MAP_BASE, temp, NMAX_I2C_RETX);
+}
+
+
+/**
+ * @brief	Configures the single tap and free fall engines to detect shocks and falls
+ * @param	cImpactmg: acceleration above which a shock is flagged, in mg (x and y axes only)
+ * 			cDuration_us: longest time above cImpactmg for a shock, longer events are not flagged
+ * 			cFreeFallmg: acceleration below which all axes must stay to flag a free fall, in mg
+ * 			cFreeFall_ms: time all axes must stay below cFreeFallmg
+ * @note	Only sets the thresholds, map and enable the SINGLE_TAP/FREE_FALL interrupts separately
+ */
+void Accelerometer_ConfigureImpactDetection(float cImpactmg, uint32_t cDuration_us, float cFreeFallmg,
+											uint16_t cFreeFall_ms)
+{
+	uint32_t cDur = cDuration_us / 625;
+	uint32_t cTimeFF = cFreeFall_ms / 5;
+
+	/* Same 62.5mg/LSB conversion as the activity thresholds */
+	__io_accelerometer_ShadowStage(REG_THRESH_TAP_BASE, (cImpactmg >= 15937.5f) ? 0xFF : (cImpactmg <= 0) ? 0x00 :
+								   (uint8_t)(cImpactmg/62.5f), NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_DUR_BASE, (cDur > 0xFF) ? 0xFF : (uint8_t)cDur, NMAX_I2C_RETX);
+
+	/* A collision shows on the horizontal axes, bumps of the road on z are left out */
+	__io_accelerometer_ShadowStage(REG_TAP_AXES_BASE, MSK_TAP_AXES_TAP_X_EN | MSK_TAP_AXES_TAP_Y_EN, NMAX_I2C_RETX);
+
+	__io_accelerometer_ShadowStage(REG_THRESH_FF_BASE, (cFreeFallmg >= 15937.5f) ? 0xFF : (cFreeFallmg <= 0) ? 0x00 :
+								   (uint8_t)(cFreeFallmg/62.5f), NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_TIME_FF_BASE, (cTimeFF > 0xFF) ? 0xFF : (uint8_t)cTimeFF, NMAX_I2C_RETX);
 }
 
 
@@ -426,7 +493,7 @@ void Accelerometer_CheckInterruptFlags(AccelerometerIrqStatus *xIrqStatus)
 void ADXL343_InterruptActiveLow(AccelerometerBitState xState)
 {
 	/* Read DATA_FORMAT register prior to changing its values */
-	uint8_t temp = __io_accelerometer_i2cReadRegister(REG_DATA_FORMAT_BASE, NMAX_I2C_RETX);
+	uint8_t temp = __io_accelerometer_ShadowRead(REG_DATA_FORMAT_BASE, NMAX_I2C_RETX);
 	
 	if(xState == A_ENABLE)
 	{
@@ -439,7 +506,7 @@ void ADXL343_InterruptActiveLow(AccelerometerBitState xState)
 	}
 	
 	/* Update the DATA_FORMAT register */
-	__io_accelerometer_i2cWriteRegister(REG_DATA_FORMAT_BASE, temp, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_DATA_FORMAT_BASE, temp, NMAX_I2C_RETX);
 }
 
 
@@ -456,7 +523,7 @@ void ADXL343_InterruptActiveLow(AccelerometerBitState xState)
 void ADXL343_FullResolutionMode(AccelerometerBitState xState)
 {
 	/* Read DATA_FORMAT register prior to changing its values */
-	uint8_t temp = __io_accelerometer_i2cReadRegister(REG_DATA_FORMAT_BASE, NMAX_I2C_RETX);
+	uint8_t temp = __io_accelerometer_ShadowRead(REG_DATA_FORMAT_BASE, NMAX_I2C_RETX);
 
 	if(xState == A_ENABLE)
 	{
@@ -470,7 +537,7 @@ void ADXL343_FullResolutionMode(AccelerometerBitState xState)
 	}
 	
 	/* Update the DATA_FORMAT register */
-	__io_accelerometer_i2cWriteRegister(REG_DATA_FORMAT_BASE, temp, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_DATA_FORMAT_BASE, temp, NMAX_I2C_RETX);
 }
 
 
@@ -480,7 +547,7 @@ void ADXL343_FullResolutionMode(AccelerometerBitState xState)
 void ADXL343_SPI3WireMode(AccelerometerBitState xState)
 {
 	/* Read DATA_FORMAT register prior to changing its values */
-	uint8_t temp = __io_accelerometer_i2cReadRegister(REG_DATA_FORMAT_BASE, NMAX_I2C_RETX);
+	uint8_t temp = __io_accelerometer_ShadowRead(REG_DATA_FORMAT_BASE, NMAX_I2C_RETX);
 	
 	if(xState == A_ENABLE)
 	{
@@ -493,7 +560,7 @@ void ADXL343_SPI3WireMode(AccelerometerBitState xState)
 	}
 	
 	/* Update the DATA_FORMAT register */
-	__io_accelerometer_i2cWriteRegister(REG_DATA_FORMAT_BASE, temp, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_DATA_FORMAT_BASE, temp, NMAX_I2C_RETX);
 }
 
 
@@ -504,7 +571,7 @@ void ADXL343_SPI3WireMode(AccelerometerBitState xState)
 void ADXL343_ConfigureFIFOMode(AccelerometerBufferStates xBufferMode)
 {
 	/* Read FIFO_CTL register prior to changing/modifying its values */
-	uint8_t temp = __io_accelerometer_i2cReadRegister(REG_FIFO_CTL_BASE, NMAX_I2C_RETX);
+	uint8_t temp = __io_accelerometer_ShadowRead(REG_FIFO_CTL_BASE, NMAX_I2C_RETX);
 	
 	/* Clear FIFO_MODE = FIFO_CTL[7:5] field */
 	temp &= 0x3F;
@@ -527,8 +594,10 @@ void ADXL343_ConfigureFIFOMode(AccelerometerBufferStates xBufferMode)
 		temp |= MSK_FIFO_CTL_BUFFER_TRIGGER;
 	}
 	
-	/* Overwrite/Update FIFO_CTL register with new buffer mode */
-	__io_accelerometer_i2cWriteRegister(REG_FIFO_CTL_BASE, temp, NMAX_I2C_RETX);
+	/* Overwrite/Update FIFO_CTL register with new buffer mode. Written right away, as going
+	   through Bypass mode is what clears the FIFO */
+	__io_accelerometer_ShadowStage(REG_FIFO_CTL_BASE, temp, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowFlush(NMAX_I2C_RETX);
 	
 }
 
@@ -540,13 +609,25 @@ void ADXL343_ConfigureFIFOMode(AccelerometerBufferStates xBufferMode)
 void ADXL_ConfigureAccelerationRange(AccelerometerRange xRange)
 {
 	/* Read DATA_FORMAT register prior to changing its values */
-	uint8_t temp = __io_accelerometer_i2cReadRegister(REG_DATA_FORMAT_BASE, NMAX_I2C_RETX);
+	uint8_t temp = __io_accelerometer_ShadowRead(REG_DATA_FORMAT_BASE, NMAX_I2C_RETX);
 
 	/* Clear the range bitfields and configure the desired range */
 	temp = ((temp & ~(0x03)) | ((uint8_t)xRange));
 
 	/* Overwrite/Update DATA_FORMAT register with new values */
-	__io_accelerometer_i2cWriteRegister(REG_DATA_FORMAT_BASE, temp, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_DATA_FORMAT_BASE, temp, NMAX_I2C_RETX);
+}
+
+
+/**
+ * @brief	Writes the configuration staged by the functions of this driver to the device
+ * @note	Configuration functions only update the register shadow, their changes are written
+ * 			in bursts by this function or by Accelerometer_SetMeasurementMode(). Call it after
+ * 			changing the configuration without going through STANDBY mode.
+ */
+void ADXL343_CommitConfig(void)
+{
+	__io_accelerometer_ShadowFlush(NMAX_I2C_RETX);
 }
 
 
@@ -596,6 +677,23 @@ uint8_t ADXL_TwosComplement_8bits(int8_t input)
 }
 
 
+/**
+ * @brief	Converts a raw 13-bit full resolution value into acceleration in units of m/(s^2) or cm/(s^2)
+ */
+float ADXL_ConvertRawAcceleration(uint16_t RawAccel)
+{
+	/**
+	 * Conversion from raw values to normal interpretation, and that value is multiplied with 3.90625mg/LSB
+	 * resolution, or more accurately, 256LSB/g
+	 */
+#if defined(ACCELERATION_M_SEC_SQUARED)
+	return (3.90625f * (float)(ADXL_TwosComplement_13bits(RawAccel))/1000.0f);
+#elif defined(ACCELERATION_CM_SEC_SQUARED)
+	return (3.90625f * (float)(ADXL_TwosComplement_13bits(RawAccel))/10.0f);
+#endif
+}
+
+
 /**
  * @brief	Returns all axes acceleration in float variable in units of m/(s^2) or cm/(s^2)
  */
@@ -607,19 +705,9 @@ void ADXL_ReadAcceleration(float *AccelerationX, float *AccelerationY, float *Ac
 	/* Read FIFO/DATA registers */
 	__ADXL_READMULTIBYTE_FIFO(&RawAccelX, &RawAccelY, &RawAccelZ);
 
-	/**
-	 * Conversion from raw values to normal interpretation, and that value is multiplied with 3.90625mg/LSB
-	 * resolution, or more accurately, 256LSB/g
-	 */
-#if defined(ACCELERATION_M_SEC_SQUARED)
-	*AccelerationX = (3.90625f * (float)(ADXL_TwosComplement_13bits(RawAccelX))/1000.0f);
-	*AccelerationY = (3.90625f * (float)(ADXL_TwosComplement_13bits(RawAccelY))/1000.0f);
-	*AccelerationZ = (3.90625f * (float)(ADXL_TwosComplement_13bits(RawAccelZ))/1000.0f);
-#elif defined(ACCELERATION_CM_SEC_SQUARED)
-	*AccelerationX = (3.90625f * (float)(ADXL_TwosComplement_13bits(RawAccelX))/10.0f);
-	*AccelerationY = (3.90625f * (float)(ADXL_TwosComplement_13bits(RawAccelY))/10.0f);
-	*AccelerationZ = (3.90625f * (float)(ADXL_TwosComplement_13bits(RawAccelZ))/10.0f);
-#endif
+	*AccelerationX = ADXL_ConvertRawAcceleration(RawAccelX);
+	*AccelerationY = ADXL_ConvertRawAcceleration(RawAccelY);
+	*AccelerationZ = ADXL_ConvertRawAcceleration(RawAccelZ);
 }
 
 
@@ -638,10 +726,6 @@ void ADXL_ConfigureOffsets(void)
 	uint8_t OFSXvalue = 0, OFSYvalue = 0, OFSZvalue = 0;			/* values to be placed into the offset registers */
 
 	/* Collect 10 samples of X, Y, and Z acceleration. Note that resolution is 3.90625mg/LSB at 13-bits */
-#if defined(FREERTOS_INCLUDED)
-	taskENTER_CRITICAL();
-#endif
-
 	/* Iterate NUM_ACCELERATION_OFFSET_SAMPLES number of times */
 	for(volatile uint8_t idx=0; idx<NUM_ACCELERATION_OFFSET_SAMPLES; idx++)
 	{
@@ -651,7 +735,11 @@ void ADXL_ConfigureOffsets(void)
 		AvgSampleY += ADXL_TwosComplement_13bits(InputSampleY);
 		AvgSampleZ += ADXL_TwosComplement_13bits(InputSampleZ);
 
+#if defined(FREERTOS_INCLUDED)
+		vTaskDelay(pdMS_TO_TICKS(25));
+#else
 		HAL_Delay(25);
+#endif
 	}
 
 	/* Final acceleration average, all in 0g base */
@@ -661,10 +749,6 @@ void ADXL_ConfigureOffsets(void)
 
 	/* Can reduce AvgSampleZ with 256 so that DATAZ registers will not account +1g from gravity into results */
 
-#if defined(FREERTOS_INCLUDED)
-	taskEXIT_CRITICAL();
-#endif
-
 	/* Place device is non-measurement mode to write into OFSX, OFSY, and OFSZ registers. Note that
 	 * these registers have a resolution of 15.6mg/LSB at 8-bits.
 	 */
@@ -680,16 +764,290 @@ void ADXL_ConfigureOffsets(void)
 	OFSYvalue = ADXL_TwosComplement_8bits(Y_offset);
 	OFSZvalue = ADXL_TwosComplement_8bits(Z_offset);
 
-	/* Write directly into offset registers */
-	__io_accelerometer_i2cWriteRegister(REG_OFSX_BASE, OFSXvalue, NMAX_I2C_RETX);
-	__io_accelerometer_i2cWriteRegister(REG_OFSY_BASE, OFSYvalue, NMAX_I2C_RETX);
-	__io_accelerometer_i2cWriteRegister(REG_OFSZ_BASE, OFSZvalue, NMAX_I2C_RETX);
+	/* Stage the offset registers, written in one burst before the measurement bit is set below */
+	__io_accelerometer_ShadowStage(REG_OFSX_BASE, OFSXvalue, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_OFSY_BASE, OFSYvalue, NMAX_I2C_RETX);
+	__io_accelerometer_ShadowStage(REG_OFSZ_BASE, OFSZvalue, NMAX_I2C_RETX);
 
 	/* Place device in measurement mode again, all changes will be applied afterwards */
 	Accelerometer_SetMeasurementMode(A_ENABLE);
 }
 
 
+/**
+  **************************************************************************************************
+  * FIFO Streaming																			       *
+  **************************************************************************************************
+  */
+
+/**
+ * @brief	Sets the Samples field of the FIFO_CTL register. In Stream mode, the WATERMARK
+ * 			interrupt is raised once the FIFO holds cSamples entries.
+ */
+void ADXL343_ConfigureFIFOSamples(uint8_t cSamples)
+{
+	/* Read FIFO_CTL register prior to changing/modifying its values */
+	uint8_t temp = __io_accelerometer_ShadowRead(REG_FIFO_CTL_BASE, NMAX_I2C_RETX);
+
+	/* Clear and update the Samples field */
+	temp = (temp & ~MSK_FIFO_CTL_SAMPLES) | (cSamples & MSK_FIFO_CTL_SAMPLES);
+
+	/* Overwrite/Update FIFO_CTL register */
+	__io_accelerometer_ShadowStage(REG_FIFO_CTL_BASE, temp, NMAX_I2C_RETX);
+}
+
+
+/**
+ * @brief	Returns the number of entries currently stored in the FIFO (0 to 32)
+ */
+uint8_t ADXL343_ReadFIFOEntries(void)
+{
+	return (__io_accelerometer_i2cReadRegister(REG_FIFO_STATUS_BASE, NMAX_I2C_RETX) & MSK_FIFO_STATUS_ENTRIES);
+}
+
+
+/**
+ * @brief	Switches the accelerometer to Stream mode with the WATERMARK interrupt mapped to INT1
+ * @param	cOutputDataRate_Hz: one of the MSK_REG_BW_RATE_XXXX_HZ bit masks
+ * 			cWatermark: number of FIFO entries (1 to 31) that raise the interrupt
+ * @note	Call after ADXL343_Init(). INT1 stays high until the FIFO is drained below the
+ * 			watermark, so every interrupt must be followed by ADXL_StreamDrain().
+ */
+void ADXL343_StartStream(uint8_t cOutputDataRate_Hz, uint8_t cWatermark)
+{
+	const ActInactControlBits xStreamActInact =
+	{
+		A_ENABLE, A_ENABLE, A_ENABLE, A_ENABLE,
+		A_ENABLE, A_ENABLE, A_ENABLE, A_ENABLE
+	};
+
+	/* Configure the device while in STANDBY mode */
+	Accelerometer_SetMeasurementMode(A_DISABLE);
+	Accelerometer_ResetInterrupt();
+
+	/* Low power mode is only available up to 400Hz and adds noise */
+	Accelerometer_SetLowPowerMode(A_DISABLE);
+	Accelerometer_SetOutputDataRate(cOutputDataRate_Hz);
+
+	/* Going through Bypass mode clears the FIFO */
+	ADXL343_ConfigureFIFOMode(Buffer_Bypass);
+	ADXL343_ConfigureFIFOSamples(cWatermark);
+	ADXL343_ConfigureFIFOMode(Buffer_Stream);
+
+	/* Start with an empty ring buffer */
+	s_StreamTail = s_StreamHead;
+	xStreamStats.SamplePeriod_us = ADXL_ODR_PERIOD_US(cOutputDataRate_Hz);
+	xStreamStats.MeasuredPeriod_q8 = xStreamStats.SamplePeriod_us << 8;
+
+	/* No sample dated yet */
+	s_StreamWatermark = cWatermark;
+	s_StreamIndex = 0;
+	s_AnchorValid = 0;
+	s_WatermarkPending = 0;
+
+	/* Flag motion and stillness of the car, relative to the acceleration when it started/stopped */
+	Accelerometer_WriteActivityThreshMg(ADXL_STREAM_ACTIVITY_MG);
+	Accelerometer_WriteInactivityThreshTimeMg(ADXL_STREAM_INACTIVITY_S, ADXL_STREAM_INACTIVITY_MG);
+	Accelerometer_ConfigureActInactControl(xStreamActInact);
+	Accelerometer_MapInterrupt(ACTIVITY, InterruptPin2);
+	Accelerometer_MapInterrupt(INACTIVITY, InterruptPin2);
+	Accelerometer_SetInterrupt(ACTIVITY, A_ENABLE);
+	Accelerometer_SetInterrupt(INACTIVITY, A_ENABLE);
+	s_StreamInactive = 0;
+
+	/* Flag shocks and falls on INT1 too, the drain tells them from the watermark */
+	Accelerometer_ConfigureImpactDetection(ADXL_STREAM_IMPACT_MG, ADXL_STREAM_IMPACT_DURATION_US,
+										   ADXL_STREAM_FREEFALL_MG, ADXL_STREAM_FREEFALL_MS);
+	Accelerometer_MapInterrupt(SINGLE_TAP, InterruptPin1);
+	Accelerometer_MapInterrupt(FREE_FALL, InterruptPin1);
+	Accelerometer_SetInterrupt(SINGLE_TAP, A_ENABLE);
+	Accelerometer_SetInterrupt(FREE_FALL, A_ENABLE);
+	s_StreamEvents = 0;
+
+	/* Raise WATERMARK interrupts on INT1 */
+	Accelerometer_MapInterrupt(WATERMARK, InterruptPin1);
+	__CLEAR_ADXL_IRQFLAGS();
+	Accelerometer_SetInterrupt(WATERMARK, A_ENABLE);
+
+	Accelerometer_SetMeasurementMode(A_ENABLE);
+}
+
+
+/**
+ * @brief	Records the time of a WATERMARK interrupt
+ * @param	Timestamp_us: time of the INT1 rising edge, in microseconds
+ * @note	To be called from the INT1 interrupt handler
+ */
+void ADXL_StreamMarkWatermark(uint32_t Timestamp_us)
+{
+	s_WatermarkTimestamp_us = Timestamp_us;
+	s_WatermarkPending = 1;
+}
+
+
+/**
+ * @brief	Dates the entries about to be drained, see ADXL_StreamMarkWatermark()
+ * @param	cEntries: number of entries in the FIFO
+ * 			Now_us: time of the drain, used until the first watermark edge comes
+ */
+static void ADXL_StreamUpdateAnchor(uint8_t cEntries, uint32_t Now_us)
+{
+	uint32_t Index, Timestamp_us;
+
+	if(s_WatermarkPending && (cEntries >= s_StreamWatermark) && (cEntries < ADXL_FIFO_DEPTH))
+	{
+		/* The FIFO head is the entry right after the last one popped, the edge dated the
+		   watermark-th entry from there (unless it overflowed since) */
+		Index = s_StreamIndex + s_StreamWatermark - 1;
+		Timestamp_us = s_WatermarkTimestamp_us;
+		xStreamStats.Anchors++;
+
+		if(s_AnchorValid && (Index != s_AnchorIndex))
+		{
+			uint32_t Nominal_q8 = xStreamStats.SamplePeriod_us << 8;
+			uint32_t Period_q8 = (uint32_t)(((uint64_t)(Timestamp_us - s_AnchorTimestamp_us) << 8) / (Index - s_AnchorIndex));
+			uint32_t Deviation_q8 = (Period_q8 > Nominal_q8) ? (Period_q8 - Nominal_q8) : (Nominal_q8 - Period_q8);
+
+			/* Smooth the edge latency out over 8 measurements */
+			if(Deviation_q8 <= (Nominal_q8 >> ADXL_PERIOD_TOLERANCE_SHIFT))
+				xStreamStats.MeasuredPeriod_q8 += ((int32_t)(Period_q8 - xStreamStats.MeasuredPeriod_q8)) / 8;
+			else
+				xStreamStats.PeriodRejected++;
+		}
+	}
+	else if(!s_AnchorValid && cEntries)
+	{
+		/* No edge yet, the newest entry was sampled just before the drain */
+		Index = s_StreamIndex + cEntries - 1;
+		Timestamp_us = Now_us;
+	}
+	else
+	{
+		s_WatermarkPending = 0;
+		return;
+	}
+
+	s_WatermarkPending = 0;
+	s_AnchorIndex = Index;
+	s_AnchorTimestamp_us = Timestamp_us;
+	s_AnchorValid = 1;
+}
+
+
+/**
+ * @brief	Moves all the entries stored in the FIFO into the stream ring buffer
+ * @param	Now_us: time of the call, in the timebase of ADXL_StreamMarkWatermark()
+ * @note	FIFO_STATUS and INT_SOURCE reads are followed by back-to-back 6-byte reads of the DATA
+ * 			registers, one per entry. Each entry is dated from the latest watermark edge, one measured
+ * 			sample period apart.
+ * @retval	Number of samples drained from the FIFO
+ */
+uint8_t ADXL_StreamDrain(uint32_t Now_us)
+{
+	AccelerometerSample xSample;
+	uint8_t cEntries = ADXL343_ReadFIFOEntries();
+
+	uint8_t cSources = Accelerometer_ReturnIrqFlags();
+
+	xStreamStats.Drains++;
+
+	if(cEntries >= ADXL_FIFO_DEPTH)
+		xStreamStats.FifoFull++;
+
+	/* Both flags may be set if the car started and stopped between two drains, take the latest
+	   state from INACTIVITY only when there was no ACTIVITY */
+	if(cSources & MSK_INT_SOURCE_ACTIVITY)
+	{
+		s_StreamInactive = 0;
+		xStreamStats.ActivityEvents++;
+	}
+	else if(cSources & MSK_INT_SOURCE_INACTIVITY)
+	{
+		s_StreamInactive = 1;
+		xStreamStats.InactivityEvents++;
+	}
+
+	if(cSources & (MSK_INT_SOURCE_SINGLE_TAP | MSK_INT_SOURCE_FREE_FALL))
+	{
+		s_StreamEvents |= cSources & (MSK_INT_SOURCE_SINGLE_TAP | MSK_INT_SOURCE_FREE_FALL);
+
+		if(cSources & MSK_INT_SOURCE_SINGLE_TAP)
+			xStreamStats.ImpactEvents++;
+		if(cSources & MSK_INT_SOURCE_FREE_FALL)
+			xStreamStats.FreeFallEvents++;
+
+		/* The INT1 edge may have come from the event rather than from the watermark */
+		s_WatermarkPending = 0;
+	}
+
+	ADXL_StreamUpdateAnchor(cEntries, Now_us);
+
+	for(uint8_t idx = 0; idx < cEntries; idx++)
+	{
+		int32_t Offset = (int32_t)(s_StreamIndex - s_AnchorIndex);
+
+		/* Each read pops one entry */
+		__ADXL_READMULTIBYTE_FIFO(&xSample.RawX, &xSample.RawY, &xSample.RawZ);
+		xSample.Timestamp_us = s_AnchorTimestamp_us + (uint32_t)(((int64_t)Offset * xStreamStats.MeasuredPeriod_q8) >> 8);
+		s_StreamIndex++;
+
+		if((uint16_t)(s_StreamHead - s_StreamTail) < ADXL_STREAM_BUFFER_SIZE)
+		{
+			s_StreamBuffer[s_StreamHead & (ADXL_STREAM_BUFFER_SIZE - 1)] = xSample;
+			s_StreamHead++;
+		}
+		else
+		{
+			xStreamStats.Dropped++;
+		}
+	}
+
+	xStreamStats.Samples += cEntries;
+
+	return cEntries;
+}
+
+
+/**
+ * @brief	Tells whether the accelerometer saw no motion for ADXL_STREAM_INACTIVITY_S, as of the
+ * 			last ADXL_StreamDrain()
+ */
+uint8_t ADXL_StreamInactive(void)
+{
+	return s_StreamInactive;
+}
+
+
+/**
+ * @brief	Returns and clears the shock/fall events seen by the drains since the last call
+ * @retval	MSK_INT_SOURCE_SINGLE_TAP and/or MSK_INT_SOURCE_FREE_FALL, 0 if none
+ * @note	Called by the task that drains the stream
+ */
+uint8_t ADXL_StreamTakeEvents(void)
+{
+	uint8_t cEvents = s_StreamEvents;
+
+	s_StreamEvents = 0;
+
+	return cEvents;
+}
+
+
+/**
+ * @brief	Pops the oldest sample from the stream ring buffer
+ * @retval	1 if a sample was copied into *pSample, 0 if the buffer is empty
+ */
+uint8_t ADXL_StreamRead(AccelerometerSample *pSample)
+{
+	if(s_StreamTail == s_StreamHead)
+		return 0;
+
+	*pSample = s_StreamBuffer[s_StreamTail & (ADXL_STREAM_BUFFER_SIZE - 1)];
+	s_StreamTail++;
+
+	return 1;
+}
+
 
 /**
   **************************************************************************************************
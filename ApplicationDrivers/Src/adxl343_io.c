@@ -15,15 +15,43 @@
 
 
 /* Private includes ----------------------------------------------------------*/
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
 
 
 /* Private typedef -----------------------------------------------------------*/
+	/*--- Kind of I2C1 transfer run by the transaction engine ---*/
+	typedef enum
+	{
+		I2C_XFER_MEM_READ = 0,
+		I2C_XFER_MEM_WRITE,
+		I2C_XFER_MASTER_TX
+	} I2CTransferType;
+
+	/*--- Completion status of the I2C1 transfer in progress ---*/
+	typedef enum
+	{
+		I2C_XFER_DONE = 0,
+		I2C_XFER_PENDING,
+		I2C_XFER_FAILED
+	} I2CTransferStatus;
 
 
 /* Private define ------------------------------------------------------------*/
 #define N_ERROR_RETX								5				/* Allow up to 5 transmission in addition to the original failed transmission */
 #define TOTALNUM_ADXL_REGISTERS						29				/* 29 registers available for use in the ADXL343 */
 #define FIRST_ADXL_REGISTER_ADDR					((uint8_t)0x1D)
+#define SHADOW_BURST_GAP_MAX						2				/* Clean registers rewritten to merge two dirty runs in one burst */
+
+	/*--- Registers changed by the device itself, never served from the shadow nor written in a burst ---*/
+	#define SHADOW_REG_BIT(addr)					((uint32_t)1 << ((addr) - FIRST_ADXL_REGISTER_ADDR))
+	#define SHADOW_VOLATILE_REGISTERS				(SHADOW_REG_BIT(0x2B) | 		/* ACT_TAP_STATUS */	\
+													 SHADOW_REG_BIT(0x30) | 		/* INT_SOURCE */		\
+													 SHADOW_REG_BIT(0x32) | SHADOW_REG_BIT(0x33) |		\
+													 SHADOW_REG_BIT(0x34) | SHADOW_REG_BIT(0x35) |		\
+													 SHADOW_REG_BIT(0x36) | SHADOW_REG_BIT(0x37) |		\
+													 SHADOW_REG_BIT(0x39))			/* FIFO_STATUS */
 
 	/*--- Possible I2C addresses for the ADXL343 accelerometer ---*/
 	#if defined(ALT_ADDRESS_VDD)
@@ -41,11 +69,29 @@
 #endif
 
 
+/* Exported/Global variables -------------------------------------------------*/
+AccelerometerBusStats xAccelBusStats = {0};
+
+
 /* Private variables ---------------------------------------------------------*/
 static const uint32_t i2cTimeout = 50;
 static const uint16_t cRegisterSize = I2C_MEMADD_SIZE_8BIT;			/* registers' addresses are 8-bits wide */
 static uint16_t cTotalAccelerometerRegisters = TOTALNUM_ADXL_REGISTERS;
 
+/* I2C1 transaction engine state */
+static volatile I2CTransferStatus s_I2CTransferStatus = I2C_XFER_DONE;
+static volatile uint8_t s_I2CWaitBlocking = 0;				/* The caller blocks on s_SemI2CXferCplt */
+static SemaphoreHandle_t s_MutexI2CBus = NULL;				/* Serializes the tasks sharing I2C1 */
+static StaticSemaphore_t s_MutexI2CBusBuffer;
+static SemaphoreHandle_t s_SemI2CXferCplt = NULL;			/* Given by the completion callback */
+static StaticSemaphore_t s_SemI2CXferCpltBuffer;
+
+/* Register shadow, index 0 is THRESH_TAP (0x1D). Holds the last value written or staged for each
+   register; a set bit in s_RegDirty marks a staged value not yet written to the device */
+static uint8_t s_RegShadow[TOTALNUM_ADXL_REGISTERS];
+static uint32_t s_RegDirty = 0;
+static uint8_t s_RegShadowValid = 0;
+
 
 /* Array containing first register to write to and the reset value of
    that first register and all registers onwards in ascending order
@@ -64,10 +110,17 @@ static const uint8_t ResetValues[TOTALNUM_ADXL_REGISTERS + 1] = {
 
 
 /* Private macro -------------------------------------------------------------*/
+/* Registers 0x1D to 0x39 that are configuration (not status/data) registers */
+#define __IS_SHADOWED_REGISTER(addr)				(((addr) >= FIRST_ADXL_REGISTER_ADDR) && \
+													 ((addr) < (FIRST_ADXL_REGISTER_ADDR + TOTALNUM_ADXL_REGISTERS)) && \
+													 !(SHADOW_VOLATILE_REGISTERS & SHADOW_REG_BIT(addr)))
 
 
 /* Private function prototypes -----------------------------------------------*/
 static uint16_t __I2C_AddressLoop(void);
+static void __I2C_RecoverBus(void);
+static ErrorStatus __I2C_TransferAndWait(I2CTransferType xType, uint8_t cRegAddress, uint8_t *pData, uint16_t cLen);
+static ErrorStatus __I2C_Transaction(I2CTransferType xType, uint8_t cRegAddress, uint8_t *pData, uint16_t cLen, uint8_t nRetransmissions);
 
 
 /* Private user code ---------------------------------------------------------*/
@@ -144,54 +197,189 @@ void AccelerometerBus_Init(void)
 
 
 /**
- * @brief Writes data onto the ADXL343's internal register
- * @param      cRegAddress: Address of internal register to write into (8-bit internal address)
- *                   pData: 8-bit data to write
- *        nRetransmissions: Number of retransmissions to perform if a NACK occurs at each try
+ * @brief	Brings I2C1 back to a known state after a transfer timed out
+ * @note	Memory transfers cannot be aborted through the HAL, so the peripheral, its
+ * 			DMA stream and its interrupts are de-initialized and initialized again.
  */
-void __io_accelerometer_i2cWriteRegister(uint8_t cRegAddress, uint8_t pData, uint8_t nRetransmissions)
+static void __I2C_RecoverBus(void)
 {
-	uint8_t pTxBuff[1] = {pData};
+	HAL_I2C_DeInit(&hi2c1);
+	MX_I2C1_Init();
+}
 
-	/* timeout counter variable */
-	volatile uint8_t i2c_current_retx = 0;
-	volatile ErrorStatus i2c_process_status;
 
-	do
+/**
+ * @brief	Starts a single I2C1 transfer and waits for its completion
+ * @note	The transfer runs from the I2C1 event/error interrupts (DMA for multi-byte
+ * 			reads). Once the scheduler is running the calling task is blocked on a binary
+ * 			semaphore given by the completion callback, otherwise the completion flag is polled.
+ * 			The task notifications of the caller (ADXL343 INT1...) are left untouched.
+ * @retval	SUCCESS if the transfer completed, ERROR on NACK, bus error, or timeout
+ */
+static ErrorStatus __I2C_TransferAndWait(I2CTransferType xType, uint8_t cRegAddress, uint8_t *pData, uint16_t cLen)
+{
+	HAL_StatusTypeDef l_status;
+	uint32_t l_TickStart;
+
+	s_I2CTransferStatus = I2C_XFER_PENDING;
+	s_I2CWaitBlocking = ((s_SemI2CXferCplt != NULL) && (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)) ? 1 : 0;
+
+	/* Start the transfer, completion is reported through __io_accelerometer_i2cCpltCallback() */
+	switch(xType)
 	{
-		i2c_process_status = SUCCESS;
+		case I2C_XFER_MEM_READ:
+			if(cLen > 1)
+				l_status = HAL_I2C_Mem_Read_DMA(&hi2c1, ACCELEROMETER_ADDRESS, cRegAddress, cRegisterSize, pData, cLen);
+			else
+				l_status = HAL_I2C_Mem_Read_IT(&hi2c1, ACCELEROMETER_ADDRESS, cRegAddress, cRegisterSize, pData, cLen);
+			break;
+
+		case I2C_XFER_MEM_WRITE:
+			l_status = HAL_I2C_Mem_Write_IT(&hi2c1, ACCELEROMETER_ADDRESS, cRegAddress, cRegisterSize, pData, cLen);
+			break;
+
+		case I2C_XFER_MASTER_TX:
+		default:
+			l_status = HAL_I2C_Master_Transmit_IT(&hi2c1, ACCELEROMETER_ADDRESS, pData, cLen);
+			break;
+	}
 
-		/* i2c single byte write operation */
-		if(HAL_I2C_Mem_Write(&hi2c1, ACCELEROMETER_ADDRESS, cRegAddress, cRegisterSize, (uint8_t*)pTxBuff, 1, i2cTimeout) != HAL_OK)
+	if(l_status != HAL_OK)
+	{
+		/* Bus still BUSY from a previous transfer */
+		s_I2CWaitBlocking = 0;
+		__I2C_RecoverBus();
+		return ERROR;
+	}
+
+	/* Wait for the transfer to complete */
+	l_TickStart = HAL_GetTick();
+
+	while(s_I2CTransferStatus == I2C_XFER_PENDING)
+	{
+		if((HAL_GetTick() - l_TickStart) > i2cTimeout)
 		{
-			Error_Handler();
+			s_I2CWaitBlocking = 0;
+			__I2C_RecoverBus();
+			return ERROR;
 		}
 
-		/* Variable used as a counter */
-		volatile uint32_t errorhandler_counter = 0;
-
-		/* Wait until i2c bus is free/ready */
-		while((HAL_I2C_GetState(&hi2c1) != HAL_I2C_STATE_READY) && (errorhandler_counter <= 15999))
+		if(s_I2CWaitBlocking)
 		{
-			errorhandler_counter++;
+			/* A give left over by a transfer that timed out only costs one more pass */
+			xSemaphoreTake(s_SemI2CXferCplt, pdMS_TO_TICKS(i2cTimeout) + 1);
 		}
+	}
+
+	s_I2CWaitBlocking = 0;
+
+	return (s_I2CTransferStatus == I2C_XFER_DONE) ? SUCCESS : ERROR;
+}
+
+
+/**
+ * @brief	Runs an I2C1 transaction with the ADXL343, retrying on NACK and bus errors
+ * @param	nRetransmissions: Number of retransmissions to perform if a NACK occurs at each try
+ * @note	Must not be called from an interrupt. The bus mutex serializes the tasks
+ * 			sharing the accelerometer; no critical section is needed around the call.
+ */
+static ErrorStatus __I2C_Transaction(I2CTransferType xType, uint8_t cRegAddress, uint8_t *pData, uint16_t cLen, uint8_t nRetransmissions)
+{
+	uint8_t i2c_current_retx = 0;
+	uint8_t i2c_error_retx = 0;
+	ErrorStatus i2c_process_status;
+	uint8_t l_BusLocked = 0;
+
+	assert_param(xPortIsInsideInterrupt() == pdFALSE);
+
+	if((s_MutexI2CBus != NULL) && (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING))
+	{
+		xSemaphoreTake(s_MutexI2CBus, portMAX_DELAY);
+		l_BusLocked = 1;
+	}
+
+	xAccelBusStats.Transactions++;
+
+	while(1)
+	{
+		i2c_process_status = __I2C_TransferAndWait(xType, cRegAddress, pData, cLen);
 
-		/* If I2C is BUSY even after 16000 CPU cycles */
-		if((errorhandler_counter >= 16000) && (HAL_I2C_GetState(&hi2c1) != HAL_I2C_STATE_READY))
+		if(i2c_process_status == SUCCESS)
+			break;
+
+		/* When Acknowledge failure occurs (Slave did not acknowledge it's address)
+		   Master restarts communication up to nRetransmissions */
+		if(HAL_I2C_GetError(&hi2c1) == HAL_I2C_ERROR_AF)
+		{
+			if(++i2c_current_retx > nRetransmissions)
+				break;
+		}
+		else if(++i2c_error_retx > N_ERROR_RETX)
 		{
 			printf("I2C Bus still busy\n");
 			Error_Handler();
 		}
+	}
 
-		/* Counter to ensure repeating transaction only happens up to nRetransmissions */
-		i2c_current_retx++;
+	if(l_BusLocked)
+		xSemaphoreGive(s_MutexI2CBus);
 
-  /* When Acknowledge failure occurs (Slave did not acknowledge it's address)
-     Master restarts communication up to nRetransmissions */
+	return i2c_process_status;
+}
+
+
+/**
+ * @brief	Creates the I2C1 bus mutex shared by all ADXL343 transactions, and the semaphore
+ * 			signalling the end of each transfer
+ * @note	Call once before the scheduler is started
+ */
+void __io_accelerometer_i2cEngineInit(void)
+{
+	if(s_MutexI2CBus == NULL)
+		s_MutexI2CBus = xSemaphoreCreateMutexStatic(&s_MutexI2CBusBuffer);
+
+	if(s_SemI2CXferCplt == NULL)
+		s_SemI2CXferCplt = xSemaphoreCreateBinaryStatic(&s_SemI2CXferCpltBuffer);
+}
+
+
+/**
+ * @brief	Completes the pending I2C1 transfer and wakes up the task waiting for it
+ * @param	xStatus: SUCCESS from the transfer complete callbacks, ERROR from the error callback
+ * @note	To be called from the HAL I2C callbacks (interrupt context)
+ */
+void __io_accelerometer_i2cCpltCallback(ErrorStatus xStatus)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	s_I2CTransferStatus = (xStatus == SUCCESS) ? I2C_XFER_DONE : I2C_XFER_FAILED;
+
+	if(s_I2CWaitBlocking)
+	{
+		xSemaphoreGiveFromISR(s_SemI2CXferCplt, &xHigherPriorityTaskWoken);
+		portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 	}
-	while(((HAL_I2C_GetError(&hi2c1) == HAL_I2C_ERROR_AF) && (i2c_current_retx <= nRetransmissions)) ||\
-		((i2c_process_status == ERROR) && (i2c_current_retx <= N_ERROR_RETX)));
+}
 
+
+/**
+ * @brief Writes data onto the ADXL343's internal register
+ * @param      cRegAddress: Address of internal register to write into (8-bit internal address)
+ *                   pData: 8-bit data to write
+ *        nRetransmissions: Number of retransmissions to perform if a NACK occurs at each try
+ * @note  Write-through, the register shadow is updated as well
+ */
+void __io_accelerometer_i2cWriteRegister(uint8_t cRegAddress, uint8_t pData, uint8_t nRetransmissions)
+{
+	uint8_t pTxBuff[1] = {pData};
+
+	/* i2c single byte write operation */
+	if((__I2C_Transaction(I2C_XFER_MEM_WRITE, cRegAddress, pTxBuff, 1, nRetransmissions) == SUCCESS) &&
+	   __IS_SHADOWED_REGISTER(cRegAddress))
+	{
+		s_RegShadow[cRegAddress - FIRST_ADXL_REGISTER_ADDR] = pData;
+		s_RegDirty &= ~SHADOW_REG_BIT(cRegAddress);
+	}
 }
 
 
@@ -204,48 +392,119 @@ uint8_t __io_accelerometer_i2cReadRegister(uint8_t cRegAddress, uint8_t nRetrans
 {
 	uint8_t pRxBuff[1] = {0x00};
 
-	/* timeout counter variable */
-	volatile uint8_t i2c_current_retx = 0;
-	volatile ErrorStatus i2c_process_status;
+	/* i2c single byte read operation */
+	__I2C_Transaction(I2C_XFER_MEM_READ, cRegAddress, pRxBuff, 1, nRetransmissions);
 
-	do
+	/* Return 8-bit value read from internal register */
+	return pRxBuff[0];
+
+}
+
+
+/**
+ * @brief	Returns the value of a configuration register without an I2C transaction
+ * @param	     cRegAddress: Address of internal register to read from (8-bit internal address)
+ * 			nRetransmissions: Number of retransmissions, if the register has to be read from the device
+ * @note	Status and data registers (INT_SOURCE, FIFO_STATUS, ...), and any register read before
+ * 			the shadow is seeded by __RESET_ADXL343_REGISTERS(), are read from the device.
+ */
+uint8_t __io_accelerometer_ShadowRead(uint8_t cRegAddress, uint8_t nRetransmissions)
+{
+	if(!s_RegShadowValid || !__IS_SHADOWED_REGISTER(cRegAddress))
+		return __io_accelerometer_i2cReadRegister(cRegAddress, nRetransmissions);
+
+	xAccelBusStats.ShadowReads++;
+
+	return s_RegShadow[cRegAddress - FIRST_ADXL_REGISTER_ADDR];
+}
+
+
+/**
+ * @brief	Stages a new value of a configuration register, written by the next
+ * 			__io_accelerometer_ShadowFlush()
+ * @param	     cRegAddress: Address of internal register to write into (8-bit internal address)
+ * 			           cData: 8-bit data to write
+ * 			nRetransmissions: Number of retransmissions, if the register is written right away
+ * @note	A value equal to the shadow is not staged. Registers outside the shadow are written
+ * 			right away.
+ */
+void __io_accelerometer_ShadowStage(uint8_t cRegAddress, uint8_t cData, uint8_t nRetransmissions)
+{
+	if(!s_RegShadowValid || !__IS_SHADOWED_REGISTER(cRegAddress))
 	{
-		i2c_process_status = SUCCESS;
+		__io_accelerometer_i2cWriteRegister(cRegAddress, cData, nRetransmissions);
+		return;
+	}
 
-		/* i2c single byte read operation */
-		if(HAL_I2C_Mem_Read(&hi2c1, ACCELEROMETER_ADDRESS, cRegAddress, cRegisterSize, (uint8_t*)pRxBuff, 1, i2cTimeout) != HAL_OK)
-		{
-			Error_Handler();
-		}
+	if(s_RegShadow[cRegAddress - FIRST_ADXL_REGISTER_ADDR] == cData)
+		return;
+
+	s_RegShadow[cRegAddress - FIRST_ADXL_REGISTER_ADDR] = cData;
+	s_RegDirty |= SHADOW_REG_BIT(cRegAddress);
+	xAccelBusStats.StagedWrites++;
+}
 
-		/* Variable used as a counter */
-		volatile uint32_t errorhandler_counter = 0;
 
-		/* Wait until i2c bus is free/ready */
-		while((HAL_I2C_GetState(&hi2c1) != HAL_I2C_STATE_READY) && (errorhandler_counter <= 15999))
+/**
+ * @brief	Writes every staged register to the device
+ * @param	nRetransmissions: Number of retransmissions to perform if a NACK occurs at each burst
+ * @note	Runs of consecutive staged registers are written with a single multi-byte write (the
+ * 			ADXL343 increments the register address after each byte). Two runs split by up to
+ * 			SHADOW_BURST_GAP_MAX configuration registers are merged, rewriting the registers in
+ * 			between with their shadow value costs less than a second transaction. Registers are
+ * 			written in ascending address order, flush before changing a register whose write
+ * 			order matters (POWER_CTL measure bit, FIFO mode).
+ * @retval	SUCCESS if nothing is left staged, ERROR if a burst was not acknowledged (its registers
+ * 			stay staged)
+ */
+ErrorStatus __io_accelerometer_ShadowFlush(uint8_t nRetransmissions)
+{
+	ErrorStatus l_status = SUCCESS;
+	uint8_t idx = 0;
+
+	while(idx < TOTALNUM_ADXL_REGISTERS)
+	{
+		uint8_t First, Last;
+		uint32_t RunMask;
+
+		if(!(s_RegDirty & ((uint32_t)1 << idx)))
 		{
-			errorhandler_counter++;
+			idx++;
+			continue;
 		}
 
-		/* If I2C is BUSY even after 16000 CPU cycles */
-		if((errorhandler_counter >= 16000) && (HAL_I2C_GetState(&hi2c1) != HAL_I2C_STATE_READY))
+		/* Extend the run over staged registers and short gaps of configuration registers */
+		First = idx;
+		Last = idx;
+
+		for(idx = First + 1; idx < TOTALNUM_ADXL_REGISTERS; idx++)
 		{
-			printf("I2C Bus still busy\n");
-			Error_Handler();
+			if(SHADOW_VOLATILE_REGISTERS & ((uint32_t)1 << idx))
+				break;
+
+			if(s_RegDirty & ((uint32_t)1 << idx))
+				Last = idx;
+			else if((idx - Last) > SHADOW_BURST_GAP_MAX)
+				break;
 		}
 
-		/* Counter to ensure repeating transaction only happens up to nRetransmissions */
-		i2c_current_retx++;
+		idx = Last + 1;
+		RunMask = (((uint32_t)1 << (Last - First + 1)) - 1) << First;
 
-		/* When Acknowledge failure occurs (Slave did not acknowledge it's address)
-       Master restarts communication up to nRetransmissions */
+		if(__I2C_Transaction(I2C_XFER_MEM_WRITE, FIRST_ADXL_REGISTER_ADDR + First, &s_RegShadow[First],
+							 Last - First + 1, nRetransmissions) == SUCCESS)
+		{
+			s_RegDirty &= ~RunMask;
+			xAccelBusStats.Bursts++;
+			xAccelBusStats.BurstBytes += Last - First + 1;
+		}
+		else
+		{
+			l_status = ERROR;
+		}
 	}
-	while(((HAL_I2C_GetError(&hi2c1) == HAL_I2C_ERROR_AF) && (i2c_current_retx <= nRetransmissions)) ||\
-		((i2c_process_status == ERROR) && (i2c_current_retx <= N_ERROR_RETX)));
-
-	/* Return 8-bit value read from internal register */
-	return pRxBuff[0];
 
+	return l_status;
 }
 
 
@@ -258,18 +517,15 @@ void __ADXL_READMULTIBYTE_FIFO(uint16_t *DataX, uint16_t *DataY, uint16_t *DataZ
 {
 	/* Variable declarations */
 	uint8_t pRxBuff[6] = {0x00};		/* Store received bytes in this array/buffer */
-	HAL_StatusTypeDef l_status;			/* Used to check if HAL operations were successful or not */
+	ErrorStatus l_status;				/* Used to check if the I2C transaction was successful or not */
 	uint8_t RxLen = 6;					/* Number of bytes to be received in I2C operation */
 
-	/* Perform I2C Memory Read operation. 0x32 represents address of DATAX0 register. */
-	HAL_I2C_Mem_Read(&hi2c1, ACCELEROMETER_ADDRESS, ((uint8_t)0x32), cRegisterSize, (uint8_t*)pRxBuff, RxLen, i2cTimeout);
+	/* Perform I2C Memory Read operation (DMA). 0x32 represents address of DATAX0 register. */
+	l_status = __I2C_Transaction(I2C_XFER_MEM_READ, ((uint8_t)0x32), pRxBuff, RxLen, 0);
 
-	/* Ensure HAL terminated/executed successfully */
-	assert_param(l_status == HAL_OK);
-
-	/* Wait until I2C bus is ready, and check if an ACK was received or not afterwards */
-	while(HAL_I2C_GetState(&hi2c1) != HAL_I2C_STATE_READY);
-	assert_param(HAL_I2C_GetError(&hi2c1) != HAL_I2C_ERROR_AF);
+	/* Ensure an ACK was received and the transfer completed */
+	assert_param(l_status == SUCCESS);
+	(void)l_status;
 
 	/* Assign passed input arguments the raw acceleration values for each axes */
 	*DataX = (((uint16_t)pRxBuff[1] << 8) | pRxBuff[0]);
@@ -281,44 +537,18 @@ void __ADXL_READMULTIBYTE_FIFO(uint16_t *DataX, uint16_t *DataY, uint16_t *DataZ
 /**
  * @brief Resets all the ADXL343 registers to reset values
  *        Check page 21 of the datasheet for its reset values
+ * @note  Seeds the register shadow, registers are known from here on without reading them
  */
 void __RESET_ADXL343_REGISTERS(void){
 
-	volatile ErrorStatus i2c_process_status;
+	/* Perform multiple byte write to reset all the registers. Repeat transmission until an ACK signal is received */
+	while(__I2C_Transaction(I2C_XFER_MASTER_TX, 0, (uint8_t*)ResetValues, cTotalAccelerometerRegisters + 1, N_ERROR_RETX) != SUCCESS);
 
-	do
-	{
-		i2c_process_status = SUCCESS;
-
-		/* Perform multiple byte write to reset all the registers */
-		HAL_StatusTypeDef l_status;
-		l_status = HAL_I2C_Master_Transmit(&hi2c1, ACCELEROMETER_ADDRESS, (uint8_t*)ResetValues, cTotalAccelerometerRegisters + 1, i2cTimeout);
-
-		if(l_status != HAL_OK)
-		{
-			Error_Handler();
-		}
-
-		/* Will be used for a ~3.5ms counter */
-		volatile uint32_t errorhandler_counter = 0;
-
-		/* Wait for i2c bus to become available */
-		while((HAL_I2C_GetState(&hi2c1) != HAL_I2C_STATE_READY) && (errorhandler_counter <= 55999))
-		{
-			errorhandler_counter++;
-		}
-
-		/* If I2C bus is still BUSY after 56000 CPU cycles */
-		if((errorhandler_counter >= 56000) && (HAL_I2C_GetState(&hi2c1) != HAL_I2C_STATE_READY))
-		{
-			printf("I2C Bus still busy\n");
-			Error_Handler();
-		}
-
-		/* Repeat transmission until an ACK signal is received */
-	}
-	while((HAL_I2C_GetError(&hi2c1) == HAL_I2C_ERROR_AF)||(i2c_process_status == ERROR));
+	for(uint8_t idx = 0; idx < TOTALNUM_ADXL_REGISTERS; idx++)
+		s_RegShadow[idx] = ResetValues[idx + 1];
 
+	s_RegDirty = 0;
+	s_RegShadowValid = 1;
 }
 
 /********************************* END OF FILE *********************************/
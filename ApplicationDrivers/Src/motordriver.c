@@ -10,6 +10,10 @@
 
 
 /* Includes --------------------------------------------------------------------------------------*/
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
 #include "motordriver.h"
 
 
@@ -27,6 +31,8 @@
 
 /* Exported/Global variables ---------------------------------------------------------------------*/
 __IO uint8_t g_ShiftRegisterByteToSet = 0x00;		/* Variable will be used to set shift register */
+MotorCommitStats xMotorCommitStats = {0};			/* Committed/suppressed output updates */
+MotorBrakeStats xMotorBrakeStats = {0};				/* Brake deadlines met by the task or by TIM9 */
 
 
 /* External variables ----------------------------------------------------------------------------*/
@@ -34,9 +40,19 @@ __IO uint8_t g_ShiftRegisterByteToSet = 0x00;		/* Variable will be used to set s
 
 /* Private variables -----------------------------------------------------------------------------*/
 static __IO E_Speed_Car s_CarSpeed = SPEED_CAR_OFF;	/* Variable will store configured speed */
+static uint16_t s_WheelCCRToSet[MOTWHEEL_COUNT];	/* PWM compare values applied on next commit */
+static MotorOutputs s_MotorOutputs;					/* Shadow of the outputs latched/loaded in HW */
+static uint8_t s_MotorOutputsValid = 0;				/* Cleared until the shadow matches the HW */
+static SemaphoreHandle_t s_MutexMotor = NULL;		/* Serializes staging and commit between tasks */
+static StaticSemaphore_t s_MutexMotorBuffer;
+static __IO uint8_t s_BrakeLatched = 0;				/* Set by the watchdog, duty cycles held at 0% */
+static __IO uint8_t s_BrakeArmed = 0;
+static __IO uint32_t s_BrakeDeadlineCycles = 0;		/* DWT cycle count of the armed deadline */
+static const uint16_t s_WheelCCRBraked[MOTWHEEL_COUNT] = {0};
 
 
 /* Private function prototypes -------------------------------------------------------------------*/
+static void __Motor_CommitOutputs(void);
 
 
 /* Private user code -----------------------------------------------------------------------------*/
@@ -47,18 +63,196 @@ static __IO E_Speed_Car s_CarSpeed = SPEED_CAR_OFF;	/* Variable will store confi
  */
 void Motor_Init(void)
 {
+	s_MutexMotor = xSemaphoreCreateMutexStatic(&s_MutexMotorBuffer);
+
 	/* Initialize hardware layer (motor shield driver) */
 	__MOTOR_HWInit();
+
+	/* Cycle counter timing the brake watchdog deadline */
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+#if ENABLE_SPEED_CONTROL
+	Motor_ConfigAllWheelSpeed(WHEEL_SPEED_DEFAULT_STARTING_PERCENTAGE);
+#else
+	Motor_ConfigAllWheelSpeed(WHEEL_SPEED_DEFAULT_PERCENTAGE);
+#endif
+
+	/* The shift register content is unknown after reset, the first commit writes everything */
+	g_ShiftRegisterByteToSet = 0x00;
+	s_MotorOutputsValid = 0;
+	Motor_ApplyWheelChanges();
 }
 
 /**
- * @brief	Updates shift register with new wheel directions and selections
- * @note	Update g_ShiftRegisterByteToSet value through Motor_ConfigWheelDirection() prior to calling
- * 			this function
+ * @brief	Updates shift register and PWM duty cycles with new wheel directions, selections and speeds
+ * @note	Update g_ShiftRegisterByteToSet value through Motor_ConfigWheelDirection() and the speeds
+ * 			through Motor_ConfigWheelSpeed() prior to calling this function
  */
 void Motor_ApplyWheelChanges(void)
 {
-	__MOTOR_SetShiftRegister(g_ShiftRegisterByteToSet);
+	xSemaphoreTake(s_MutexMotor, portMAX_DELAY);
+	__Motor_CommitOutputs();
+	xSemaphoreGive(s_MutexMotor);
+}
+
+/**
+ * @brief	Writes the staged outputs that differ from the shadow, in one update
+ * @note	Nothing is written when the staged outputs match what the HW already holds, the update
+ * 			is only counted as suppressed. Must be called with s_MutexMotor taken.
+ * 			Once the brake watchdog fired, duty cycles are held at 0% until it is armed again. TIM9 runs
+ * 			above configMAX_SYSCALL_INTERRUPT_PRIORITY, so it is not masked here: the latch is read
+ * 			again once the duty cycles are written, and a brake that landed in between is restored.
+ * 			An expiry after that read zeroes the duty cycles itself, the next commit sees the latch.
+ */
+static void __Motor_CommitOutputs(void)
+{
+	uint8_t ShiftRegisterChanged = (s_MotorOutputs.ShiftRegister != g_ShiftRegisterByteToSet);
+	uint8_t WheelCCRChanged;
+	const uint16_t *pWheelCCR;
+
+	pWheelCCR = s_BrakeLatched ? s_WheelCCRBraked : s_WheelCCRToSet;
+	WheelCCRChanged = (memcmp(s_MotorOutputs.WheelCCR, pWheelCCR, sizeof(s_WheelCCRToSet)) != 0);
+
+	if(s_MotorOutputsValid && !ShiftRegisterChanged && !WheelCCRChanged)
+	{
+		xMotorCommitStats.Suppressed++;
+		return;
+	}
+
+	/* Duty cycles first, so that a direction change is latched with its own speed */
+	if(!s_MotorOutputsValid || WheelCCRChanged)
+	{
+		__MOTOR_SetAllWheelCCR(pWheelCCR);
+
+		/* CCR writes are done before the latch is read again */
+		__DMB();
+		if(s_BrakeLatched && (pWheelCCR != s_WheelCCRBraked))
+		{
+			pWheelCCR = s_WheelCCRBraked;
+			__MOTOR_ZeroAllWheelCCR();
+		}
+
+		memcpy(s_MotorOutputs.WheelCCR, pWheelCCR, sizeof(s_WheelCCRToSet));
+	}
+
+	if(!s_MotorOutputsValid || ShiftRegisterChanged)
+	{
+		s_MotorOutputs.ShiftRegister = g_ShiftRegisterByteToSet;
+		__MOTOR_SetShiftRegister(s_MotorOutputs.ShiftRegister);
+		xMotorCommitStats.ShiftRegisterWrites++;
+	}
+
+	s_MotorOutputsValid = 1;
+	xMotorCommitStats.Committed++;
+}
+
+/**
+ * @brief	Returns the outputs last committed to the motor shield
+ * @param	pOutputs: Copy of the shadow
+ */
+void Motor_GetOutputs(MotorOutputs *pOutputs)
+{
+	xSemaphoreTake(s_MutexMotor, portMAX_DELAY);
+	*pOutputs = s_MotorOutputs;
+	xSemaphoreGive(s_MutexMotor);
+}
+
+/**
+ * @brief	Returns the outputs last committed to the motor shield, without blocking
+ * @param	pOutputs: Copy of the shadow
+ * @retval	1: copied, 0: another task is staging or committing outputs, pOutputs is left as is
+ * @note	For the timer daemon and other contexts that must not wait on s_MutexMotor
+ */
+uint8_t Motor_TryGetOutputs(MotorOutputs *pOutputs)
+{
+	if(xSemaphoreTake(s_MutexMotor, 0) != pdTRUE)
+		return 0;
+
+	*pOutputs = s_MotorOutputs;
+	xSemaphoreGive(s_MutexMotor);
+
+	return 1;
+}
+
+/**
+  **************************************************************************************************
+  * Brake watchdog																			       *
+  **************************************************************************************************
+  */
+
+/**
+ * @brief	Arms the hardware brake for the end of a motion
+ * @param	Timeout_ms: time left before the motion must end
+ * @note	TIM9 fires MOTOR_BRAKE_GUARD_MS after the deadline, so the task normally brakes first
+ * 			and calls Motor_DisarmBrakeWatchdog(). A brake latched by an earlier expiry is released.
+ */
+void Motor_ArmBrakeWatchdog(uint32_t Timeout_ms)
+{
+	__MOTOR_StopBrakeTimer();
+
+	xSemaphoreTake(s_MutexMotor, portMAX_DELAY);
+
+	if(s_BrakeLatched)
+	{
+		/* HW duty cycles are 0%, have the next commit write the staged ones */
+		s_BrakeLatched = 0;
+		s_MotorOutputsValid = 0;
+	}
+
+	xSemaphoreGive(s_MutexMotor);
+
+	s_BrakeDeadlineCycles = DWT->CYCCNT + (Timeout_ms * (SystemCoreClock / 1000));
+	s_BrakeArmed = 1;
+	xMotorBrakeStats.Arms++;
+
+	__MOTOR_StartBrakeTimer(Timeout_ms + MOTOR_BRAKE_GUARD_MS);
+}
+
+/**
+ * @brief	Cancels the hardware brake, to be called once the task braked or preempted the motion
+ * @note	The brake is accounted to the task when the deadline had passed
+ */
+void Motor_DisarmBrakeWatchdog(void)
+{
+	int32_t Lateness;
+
+	__MOTOR_StopBrakeTimer();
+
+	if(!s_BrakeArmed)
+		return;
+
+	s_BrakeArmed = 0;
+	Lateness = (int32_t)(DWT->CYCCNT - s_BrakeDeadlineCycles);
+
+	if(Lateness >= 0)
+	{
+		xMotorBrakeStats.TaskBrakes++;
+		xMotorBrakeStats.TaskLastLateness_us = (uint32_t)Lateness / (SystemCoreClock / 1000000);
+		if(xMotorBrakeStats.TaskLastLateness_us > xMotorBrakeStats.TaskMaxLateness_us)
+			xMotorBrakeStats.TaskMaxLateness_us = xMotorBrakeStats.TaskLastLateness_us;
+	}
+}
+
+/**
+ * @brief	TIM9 update callback, the task missed the deadline
+ * @note	Called from interrupt context, above configMAX_SYSCALL_INTERRUPT_PRIORITY so that no
+ * 			kernel critical section delays it: no FreeRTOS call, the duty cycles are zeroed directly
+ * 			and held there by __Motor_CommitOutputs() until the watchdog is armed again
+ */
+void Motor_BrakeWatchdogExpired(void)
+{
+	__MOTOR_ZeroAllWheelCCR();
+	s_BrakeLatched = 1;
+
+	if(!s_BrakeArmed)
+		return;
+
+	s_BrakeArmed = 0;
+	xMotorBrakeStats.WatchdogBrakes++;
+	xMotorBrakeStats.WatchdogLastLateness_us = (DWT->CYCCNT - s_BrakeDeadlineCycles) / (SystemCoreClock / 1000000);
+	if(xMotorBrakeStats.WatchdogLastLateness_us > xMotorBrakeStats.WatchdogMaxLateness_us)
+		xMotorBrakeStats.WatchdogMaxLateness_us = xMotorBrakeStats.WatchdogLastLateness_us;
 }
 
 /**
@@ -213,21 +407,27 @@ void Car_ConfigDirection(E_Dir_Car CarDirection)
 		/* Notify user that speed needs to be configured prior to moving car's wheels */
 		return;
 	}
-	else if(s_CarSpeed == SPEED_CAR_VERYFAST)
+#endif
+
+	/* Staging and commit are done as one, the motor timeout may brake from another task */
+	xSemaphoreTake(s_MutexMotor, portMAX_DELAY);
+
+#if ENABLE_SPEED_CONTROL
+	if(s_CarSpeed == SPEED_CAR_VERYFAST)
 	{
-		__MOTOR_ConfigureAllWheelSpeed(SPEED_CAR_VERYFAST_PERCENTAGE);
+		Motor_ConfigAllWheelSpeed(SPEED_CAR_VERYFAST_PERCENTAGE);
 	}
 	else if(s_CarSpeed == SPEED_CAR_FAST)
 	{
-		__MOTOR_ConfigureAllWheelSpeed(SPEED_CAR_FAST_PERCENTAGE);
+		Motor_ConfigAllWheelSpeed(SPEED_CAR_FAST_PERCENTAGE);
 	}
 	else if(s_CarSpeed == SPEED_CAR_NORMAL)
 	{
-		__MOTOR_ConfigureAllWheelSpeed(SPEED_CAR_NORMAL_PERCENTAGE);
+		Motor_ConfigAllWheelSpeed(SPEED_CAR_NORMAL_PERCENTAGE);
 	}
 	else if(s_CarSpeed == SPEED_CAR_SLOW)
 	{
-		__MOTOR_ConfigureAllWheelSpeed(SPEED_CAR_SLOW_PERCENTAGE);
+		Motor_ConfigAllWheelSpeed(SPEED_CAR_SLOW_PERCENTAGE);
 	}
 #endif
 
@@ -280,7 +480,51 @@ void Car_ConfigDirection(E_Dir_Car CarDirection)
 	}
 
 	/* Apply Shift Register value changes to immediately apply motor effects */
-	Motor_ApplyWheelChanges();
+	__Motor_CommitOutputs();
+
+	xSemaphoreGive(s_MutexMotor);
+}
+
+/**
+ * @brief	Drives the car from a joystick position, differential (tank) style
+ * @param	Throttle: -100% (full reverse) to 100% (full forward)
+ * 			Steer: -100% (spin left) to 100% (spin right)
+ * @note	Left wheels run at Throttle + Steer and right wheels at Throttle - Steer, clamped to 100%.
+ * 			The sign of each side selects the wheel direction and its magnitude the duty cycle, both
+ * 			written in one commit.
+ */
+void Car_ConfigVector(int8_t Throttle, int8_t Steer)
+{
+	int16_t Side[2];
+	static const E_MotorWheel_Pos SideWheels[2][2] =
+	{
+		{MOTWHEEL_REARLEFT, MOTWHEEL_FRONTLEFT}, {MOTWHEEL_REARRIGHT, MOTWHEEL_FRONTRIGHT}
+	};
+
+	Side[0] = (int16_t)Throttle + Steer;
+	Side[1] = (int16_t)Throttle - Steer;
+
+	xSemaphoreTake(s_MutexMotor, portMAX_DELAY);
+
+	for(uint8_t idx = 0; idx < 2; idx++)
+	{
+		E_Dir_SingleWheel Direction = (Side[idx] > 0) ? DIR_WHEEL_FORWARD :
+									  (Side[idx] < 0) ? DIR_WHEEL_BACKWARD : DIR_WHEEL_OFF;
+		int16_t Percentage = (Side[idx] < 0) ? -Side[idx] : Side[idx];
+
+		if(Percentage > MAX_PERCENTAGE)
+			Percentage = MAX_PERCENTAGE;
+
+		for(uint8_t wheel = 0; wheel < 2; wheel++)
+		{
+			Motor_ConfigWheelDirection(SideWheels[idx][wheel], Direction);
+			Motor_ConfigWheelSpeed(SideWheels[idx][wheel], (uint8_t)Percentage);
+		}
+	}
+
+	__Motor_CommitOutputs();
+
+	xSemaphoreGive(s_MutexMotor);
 }
 
 /**
@@ -289,6 +533,82 @@ void Car_ConfigDirection(E_Dir_Car CarDirection)
   **************************************************************************************************
   */
 
+/**
+ * @brief	Stages the speed of one or two motor wheels, applied by Motor_ApplyWheelChanges()
+ * @param	MotorWheel: The wheel(s) to modify
+ * 			Percentage: Percentage duty cycle (ranging from 0% to 100%)
+ */
+void Motor_ConfigWheelSpeed(E_MotorWheel_Pos MotorWheel, uint8_t Percentage)
+{
+	uint16_t CCRvalue = __MOTOR_PercentageToCCR(Percentage);
+
+	switch(MotorWheel)
+	{
+		case MOTWHEEL_REARLEFT:
+		{
+			s_WheelCCRToSet[MOTWHEEL_IDX_REARLEFT] = CCRvalue;
+			break;
+		}
+		case MOTWHEEL_REARRIGHT:
+		{
+			s_WheelCCRToSet[MOTWHEEL_IDX_REARRIGHT] = CCRvalue;
+			break;
+		}
+		case MOTWHEEL_FRONTRIGHT:
+		{
+			s_WheelCCRToSet[MOTWHEEL_IDX_FRONTRIGHT] = CCRvalue;
+			break;
+		}
+		case MOTWHEEL_FRONTLEFT:
+		{
+			s_WheelCCRToSet[MOTWHEEL_IDX_FRONTLEFT] = CCRvalue;
+			break;
+		}
+		case MOTWHEEL_FRONTTIRES:
+		{
+			s_WheelCCRToSet[MOTWHEEL_IDX_FRONTRIGHT] = CCRvalue;
+			s_WheelCCRToSet[MOTWHEEL_IDX_FRONTLEFT] = CCRvalue;
+			break;
+		}
+		case MOTWHEEL_REARTIRES:
+		{
+			s_WheelCCRToSet[MOTWHEEL_IDX_REARLEFT] = CCRvalue;
+			s_WheelCCRToSet[MOTWHEEL_IDX_REARRIGHT] = CCRvalue;
+			break;
+		}
+	}
+}
+
+/**
+ * @brief	Writes the speed of every motor wheel in one commit
+ * @param	pPercentage: Percentage duty cycle of each wheel, indexed by E_MotorWheel_Idx
+ * @note	Staging and commit run in one s_MutexMotor hold, so that no other task commits half of
+ * 			the new duty cycles or stages its own in between
+ */
+void Motor_ApplyWheelSpeeds(const uint8_t pPercentage[MOTWHEEL_COUNT])
+{
+	xSemaphoreTake(s_MutexMotor, portMAX_DELAY);
+
+	for(uint8_t idx = 0; idx < MOTWHEEL_COUNT; idx++)
+		s_WheelCCRToSet[idx] = __MOTOR_PercentageToCCR(pPercentage[idx]);
+
+	__Motor_CommitOutputs();
+
+	xSemaphoreGive(s_MutexMotor);
+}
+
+/**
+ * @brief	Stages the same speed for all motor wheels, applied by Motor_ApplyWheelChanges()
+ * @param	Percentage: Percentage duty cycle (ranging from 0% to 100%)
+ */
+void Motor_ConfigAllWheelSpeed(uint8_t Percentage)
+{
+	uint16_t CCRvalue = __MOTOR_PercentageToCCR(Percentage);
+
+	for(uint8_t idx = 0; idx < MOTWHEEL_COUNT; idx++)
+		s_WheelCCRToSet[idx] = CCRvalue;
+}
+
 #if ENABLE_SPEED_CONTROL
 
 /**
@@ -12,6 +12,7 @@
 /* Includes --------------------------------------------------------------------------------------*/
 #include "FreeRTOS.h"
 #include "task.h"
+#include "semphr.h"
 #include "motordriver_io.h"
 
 
@@ -22,6 +23,14 @@
 
 
 /* Private define --------------------------------------------------------------------------------*/
+#if (MOTOR_SR_BACKEND == MOTOR_SR_BACKEND_TIM_DMA)
+	/* Two TIM1 periods per bit (SER set-up then CLK rising edge), plus the latch pulse */
+	#define SR_WAVE_SER_LENGTH				((8 * 2) + 3)
+	#define SR_WAVE_CLK_LENGTH				((8 * 2) + 1)
+
+	/* A waveform lasts SR_WAVE_SER_LENGTH x 100us, give up on it well after */
+	#define SR_WAVE_TIMEOUT_MS				10
+#endif
 
 
 /* Private macro ---------------------------------------------------------------------------------*/
@@ -34,9 +43,18 @@ __IO uint8_t g_RecentShiftRegisterByte = 0x00;	/* Variable to keep track of rece
 /* External variables ----------------------------------------------------------------------------*/
 extern TIM_HandleTypeDef htim1;
 extern TIM_HandleTypeDef htim3;
+extern TIM_HandleTypeDef htim9;
+extern DMA_HandleTypeDef hdma_tim1_up;
+extern DMA_HandleTypeDef hdma_tim1_ch1;
 
 
 /* Private variables -----------------------------------------------------------------------------*/
+#if (MOTOR_SR_BACKEND == MOTOR_SR_BACKEND_TIM_DMA)
+static uint32_t s_SRWaveSer[SR_WAVE_SER_LENGTH];	/* DIR_SER/DIR_LATCH BSRR words, written on TIM1 update */
+static uint32_t s_SRWaveClk[SR_WAVE_CLK_LENGTH];	/* DIR_CLK BSRR words, written on TIM1 CH1 compare */
+static SemaphoreHandle_t s_SemSRWaveIdle = NULL;	/* Given once the previous waveform is fully out */
+static StaticSemaphore_t s_SemSRWaveIdleBuffer;
+#endif
 
 
 /* Private function prototypes -------------------------------------------------------------------*/
@@ -46,6 +64,12 @@ static void __MOTOR_ShiftRegister_DelaySetup(void);
 static void __MOTOR_ShiftRegister_DelayHold(void);
 static void __MOTOR_ShiftRegister_Delay(void);
 static void __MOTOR_SetShiftRegisterBit(FlagStatus BitStatus);
+static void __MOTOR_BitBangShiftRegister(uint8_t cByte);
+#if (MOTOR_SR_BACKEND == MOTOR_SR_BACKEND_TIM_DMA)
+static void __MOTOR_WaitShiftRegisterWave(void);
+static void __MOTOR_StartShiftRegisterWave(uint8_t cByte);
+static void __MOTOR_ShiftRegisterWaveCplt(DMA_HandleTypeDef *hdma);
+#endif
 
 
 /* Private user code -----------------------------------------------------------------------------*/
@@ -59,6 +83,17 @@ void __MOTOR_HWInit(void)
 	/* Keep shift register enabled */
 	__MOTOR_EnableShiftRegister();
 
+#if (MOTOR_SR_BACKEND == MOTOR_SR_BACKEND_TIM_DMA)
+	/* DIR_SER and DIR_LATCH share one BSRR, the update DMA stream drives both */
+	assert_param(DIR_SER_GPIO_Port == DIR_LATCH_GPIO_Port);
+
+	s_SemSRWaveIdle = xSemaphoreCreateBinaryStatic(&s_SemSRWaveIdleBuffer);
+	xSemaphoreGive(s_SemSRWaveIdle);
+
+	hdma_tim1_up.XferCpltCallback = __MOTOR_ShiftRegisterWaveCplt;
+	hdma_tim1_up.XferErrorCallback = __MOTOR_ShiftRegisterWaveCplt;
+#endif
+
 #if ENABLE_SPEED_CONTROL
 	/* Configure motor wheel speed to 0 (no movements) prior to enabling PWM */
 	__MOTOR_ConfigureAllWheelSpeed(WHEEL_SPEED_DEFAULT_STARTING_PERCENTAGE);
@@ -186,11 +221,37 @@ static void __MOTOR_SetShiftRegisterBit(FlagStatus BitStatus)
  * 			QF = 0
  * 			QG = 0
  * 			QH = 0
+ *
+ * 			With the TIM_DMA back end the function returns as soon as the transfer is started, the
+ * 			byte is latched about 1.9ms later. A following call waits for that latch first.
  */
 void __MOTOR_SetShiftRegister(uint8_t cByte)
 {
-	/* Variable declarations and assignments */
 	g_RecentShiftRegisterByte = cByte;
+
+#if (MOTOR_SR_BACKEND == MOTOR_SR_BACKEND_TIM_DMA)
+	/* The DMA completion interrupt is masked by the kernel until the scheduler runs */
+	if(xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+	{
+		__MOTOR_WaitShiftRegisterWave();
+		__MOTOR_StartShiftRegisterWave(cByte);
+		return;
+	}
+#endif
+
+	__MOTOR_BitBangShiftRegister(cByte);
+}
+
+/**
+ * @brief	Shifts and latches a byte by toggling the shift register pins from the CPU
+ * @param	cByte: Byte to send (must be 8-bits)
+ * @retval	None
+ * @note	Blocks for about 0.4ms, only used when MOTOR_SR_BACKEND is MOTOR_SR_BACKEND_BITBANG
+ * 			or before the scheduler starts.
+ */
+static void __MOTOR_BitBangShiftRegister(uint8_t cByte)
+{
+	/* Variable declarations and assignments */
 	uint8_t temp = cByte;
 
 #if PRIORITIZE_SR_DATA_TRF
@@ -230,12 +291,105 @@ void __MOTOR_SetShiftRegister(uint8_t cByte)
 
 }
 
+#if (MOTOR_SR_BACKEND == MOTOR_SR_BACKEND_TIM_DMA)
+/**
+ * @brief	Blocks until the previous waveform has been fully output
+ * @note	A waveform which never completes (TIM1 stopped) is aborted after SR_WAVE_TIMEOUT_MS
+ */
+static void __MOTOR_WaitShiftRegisterWave(void)
+{
+	if(xSemaphoreTake(s_SemSRWaveIdle, pdMS_TO_TICKS(SR_WAVE_TIMEOUT_MS)) == pdTRUE)
+		return;
+
+	__HAL_TIM_DISABLE_DMA(&htim1, TIM_DMA_UPDATE | TIM_DMA_CC1);
+	HAL_DMA_Abort(&hdma_tim1_up);
+	HAL_DMA_Abort(&hdma_tim1_ch1);
+}
+
+/**
+ * @brief	Builds the waveform of cByte and hands it to the TIM1 DMA requests, returns immediately
+ * @param	cByte: Byte to send (must be 8-bits)
+ * @retval	None
+ * @note	Each TIM1 period (100us) the update request writes DIR_SER/DIR_LATCH and the CH1 compare
+ * 			request (half period later) writes DIR_CLK:
+ *
+ * 			s_SRWaveSer:	b0	b0	b1	b1	...	b7	b7	LATCH	LATCH	-
+ * 			s_SRWaveClk:	lo	HI	lo	HI	...	lo	HI	lo
+ *
+ * 			Every DIR_CLK rising edge sits 50us after DIR_SER settled and 50us before it changes,
+ * 			whichever of the two requests comes first once enabled. Bits are sent from lowest to
+ * 			highest order, as with the bit-banged transfer.
+ */
+static void __MOTOR_StartShiftRegisterWave(uint8_t cByte)
+{
+	const uint32_t SerSet = (uint32_t)DIR_SER_Pin;
+	const uint32_t SerReset = (uint32_t)DIR_SER_Pin << 16;
+	const uint32_t LatchSet = (uint32_t)DIR_LATCH_Pin;
+	const uint32_t LatchReset = (uint32_t)DIR_LATCH_Pin << 16;
+	const uint32_t ClkSet = (uint32_t)DIR_CLK_Pin;
+	const uint32_t ClkReset = (uint32_t)DIR_CLK_Pin << 16;
+
+	for(uint8_t i=0; i<8; i++)
+	{
+		uint32_t SerWord = ((cByte >> i) & 0x1) ? SerSet : SerReset;
+
+		s_SRWaveSer[2*i] = SerWord;
+		s_SRWaveSer[(2*i) + 1] = SerWord;
+		s_SRWaveClk[2*i] = ClkReset;
+		s_SRWaveClk[(2*i) + 1] = ClkSet;
+	}
+
+	/* Latch pulse once all 8 bits are clocked in */
+	s_SRWaveSer[16] = LatchSet | SerReset;
+	s_SRWaveSer[17] = LatchSet;
+	s_SRWaveSer[18] = LatchReset;
+	s_SRWaveClk[16] = ClkReset;
+
+	HAL_DMA_Start(&hdma_tim1_ch1, (uint32_t)s_SRWaveClk, (uint32_t)&DIR_CLK_GPIO_Port->BSRR, SR_WAVE_CLK_LENGTH);
+	HAL_DMA_Start_IT(&hdma_tim1_up, (uint32_t)s_SRWaveSer, (uint32_t)&DIR_SER_GPIO_Port->BSRR, SR_WAVE_SER_LENGTH);
+
+	/* Both requests enabled with a single write */
+	__HAL_TIM_ENABLE_DMA(&htim1, TIM_DMA_UPDATE | TIM_DMA_CC1);
+}
+
+/**
+ * @brief	DMA2 Stream5 (TIM1 update) transfer complete/error callback, interrupt context
+ * @note	The CH1 stream wrote its last word before the last update, only its flags are cleared
+ */
+static void __MOTOR_ShiftRegisterWaveCplt(DMA_HandleTypeDef *hdma)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	__HAL_TIM_DISABLE_DMA(&htim1, TIM_DMA_UPDATE | TIM_DMA_CC1);
+
+	if(HAL_DMA_PollForTransfer(&hdma_tim1_ch1, HAL_DMA_FULL_TRANSFER, 0) != HAL_OK)
+		HAL_DMA_Abort(&hdma_tim1_ch1);
+
+	xSemaphoreGiveFromISR(s_SemSRWaveIdle, &xHigherPriorityTaskWoken);
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+#endif
+
 /**
   **************************************************************************************************
   * PWM/Velocity related code																       *
   **************************************************************************************************
   */
 
+/**
+ * @brief	Converts a percentage duty cycle to the PWM compare value
+ * @param	Percentage: Percentage duty cycle (ranging from 0% to 100%)
+ * @retval	CCR value (0 to TIM_PWM_MAX_CCR_VALUE)
+ */
+uint16_t __MOTOR_PercentageToCCR(uint8_t Percentage)
+{
+	/* The percentage duty cycle is represented by: ((TIMx->CCRy)/(TIMx_period + 1)) * 100 */
+	if(Percentage >= MAX_PERCENTAGE)
+		return TIM_PWM_MAX_CCR_VALUE;
+
+	return (uint16_t)(Percentage * ((TIM_PWM_PERIOD_VALUE + 1) / MAX_PERCENTAGE));
+}
+
 /**
  * @brief	Configures speed of motor wheel by modifying PWM duty cycle values
  * @param	MotorWheel: The wheel to modify
@@ -244,14 +398,7 @@ void __MOTOR_SetShiftRegister(uint8_t cByte)
  */
 void __MOTOR_ConfigureSpeed(E_MotorWheel_Pos MotorWheel, uint8_t Percentage)
 {
-	/* The percentage duty cycle is represented by: ((TIMx->CCRy)/(TIMx_period + 1)) * 100 */
-	uint16_t CCRvalue = 0;
-
-	/* Determine CCR value */
-	if(Percentage >= MAX_PERCENTAGE)
-		CCRvalue = TIM_PWM_MAX_CCR_VALUE;
-	else
-		CCRvalue = Percentage * 10;
+	uint16_t CCRvalue = __MOTOR_PercentageToCCR(Percentage);
 
 	/* Modify respective CCR register */
 	switch(MotorWheel)
@@ -304,14 +451,7 @@ void __MOTOR_ConfigureSpeed(E_MotorWheel_Pos MotorWheel, uint8_t Percentage)
  */
 void __MOTOR_ConfigureAllWheelSpeed(uint8_t Percentage)
 {
-	/* The percentage duty cycle is represented by: ((TIMx->CCRy)/(TIMx_period + 1)) * 100 */
-	uint16_t CCRvalue = 0;
-
-	/* Determine CCR value */
-	if(Percentage >= MAX_PERCENTAGE)
-		CCRvalue = TIM_PWM_MAX_CCR_VALUE;
-	else
-		CCRvalue = Percentage * 10;
+	uint16_t CCRvalue = __MOTOR_PercentageToCCR(Percentage);
 
 	/* Configure all relevant CCR registers with the same duty cycle value */
 	TIM3->CCR1 = CCRvalue;
@@ -320,5 +460,66 @@ void __MOTOR_ConfigureAllWheelSpeed(uint8_t Percentage)
 	TIM1->CCR3 = CCRvalue;
 }
 
+/**
+ * @brief	Loads the PWM compare value of every wheel at once
+ * @param	WheelCCR: Compare values indexed by MOTWHEEL_IDX_x (MOTWHEEL_COUNT entries)
+ * @retval	None
+ * @note	CCR preload is enabled, the four writes are kept together so that no PWM period
+ * 			starts with only part of them applied on either timer.
+ */
+void __MOTOR_SetAllWheelCCR(const uint16_t *WheelCCR)
+{
+	taskENTER_CRITICAL();
+
+	TIM3->CCR1 = WheelCCR[MOTWHEEL_IDX_REARLEFT];
+	TIM3->CCR2 = WheelCCR[MOTWHEEL_IDX_REARRIGHT];
+	TIM1->CCR2 = WheelCCR[MOTWHEEL_IDX_FRONTRIGHT];
+	TIM1->CCR3 = WheelCCR[MOTWHEEL_IDX_FRONTLEFT];
+
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief	Starts the one-pulse brake timer, its update interrupt fires once after Timeout_ms
+ * @param	Timeout_ms: clamped to [1, TIM_BRAKE_MAX_MS]
+ * @note	A running pulse is restarted from zero
+ */
+void __MOTOR_StartBrakeTimer(uint32_t Timeout_ms)
+{
+	if(Timeout_ms > TIM_BRAKE_MAX_MS)
+		Timeout_ms = TIM_BRAKE_MAX_MS;
+	else if(Timeout_ms == 0)
+		Timeout_ms = 1;
+
+	__HAL_TIM_DISABLE(&htim9);
+	__HAL_TIM_SET_COUNTER(&htim9, 0);
+	__HAL_TIM_SET_AUTORELOAD(&htim9, (Timeout_ms * TIM_BRAKE_TICKS_PER_MS) - 1);
+	__HAL_TIM_CLEAR_IT(&htim9, TIM_IT_UPDATE);
+	__HAL_TIM_ENABLE_IT(&htim9, TIM_IT_UPDATE);
+	__HAL_TIM_ENABLE(&htim9);
+}
+
+/**
+ * @brief	Cancels the pulse of the brake timer, if any
+ */
+void __MOTOR_StopBrakeTimer(void)
+{
+	__HAL_TIM_DISABLE_IT(&htim9, TIM_IT_UPDATE);
+	__HAL_TIM_DISABLE(&htim9);
+	__HAL_TIM_CLEAR_IT(&htim9, TIM_IT_UPDATE);
+}
+
+/**
+ * @brief	Sets every wheel PWM duty cycle to 0%
+ * @note	Register writes only, safe from interrupt context
+ */
+void __MOTOR_ZeroAllWheelCCR(void)
+{
+	TIM3->CCR1 = 0;
+	TIM3->CCR2 = 0;
+	TIM1->CCR2 = 0;
+	TIM1->CCR3 = 0;
+}
+
 /******************************************* END OF FILE *******************************************/
 
@@ -42,8 +42,14 @@ extern "C" {
 #define HCI_READ_PACKET_SIZE      		128
 /*---------- Number of Bytes reserved for HCI Max Payload -----------*/
 #define HCI_MAX_PAYLOAD_SIZE      		128
-/*---------- Number of incoming packets added to the list of packets to read -----------*/
+/*---------- Number of received HCI events buffered in the read ring until processed -----------*/
 #define HCI_READ_PACKET_NUM_MAX      	10
+/*---------- Number of HCI commands waiting for their response at the same time (one completion slot each) -----------*/
+#define HCI_CMD_INFLIGHT_MAX      		2
+/*---------- HCI packet payload is read through SPI1 DMA (1) or polled byte per byte inside the EXTI ISR (0) -----------*/
+#ifndef HCI_TL_SPI_RX_USE_DMA
+#define HCI_TL_SPI_RX_USE_DMA      		1
+#endif
 /*---------- Scan Interval: time interval from when the Controller started its last scan until it begins the subsequent scan (for a number N, Time = N x 0.625 msec) -----------*/
 #define SCAN_P      					16384
 /*---------- Scan Window: amount of time for the duration of the LE scan (for a number N, Time = N x 0.625 msec) -----------*/
@@ -64,10 +70,10 @@ extern "C" {
 #define ADV_INTERV_MIN      			160
 /*---------- Maximum Advertising Interval (for a number N, Time = N x 0.625 msec) -----------*/
 #define ADV_INTERV_MAX      			320
-/*---------- Minimum Connection Event Interval (for a number N, Time = N x 1.25 msec) -----------*/
-#define L2CAP_INTERV_MIN     			9
-/*---------- Maximum Connection Event Interval (for a number N, Time = N x 1.25 msec) -----------*/
-#define L2CAP_INTERV_MAX      			20
+/*---------- Minimum Connection Event Interval while driving (for a number N, Time = N x 1.25 msec) -----------*/
+#define L2CAP_INTERV_MIN     			6
+/*---------- Maximum Connection Event Interval while driving (for a number N, Time = N x 1.25 msec) -----------*/
+#define L2CAP_INTERV_MAX      			12
 /*---------- Timeout Multiplier (for a number N, Time = N x 10 msec) -----------*/
 #define L2CAP_TIMEOUT_MULTIPLIER      	600
 /*---------- HCI Default Timeout -----------*/
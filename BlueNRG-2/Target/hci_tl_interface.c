@@ -35,6 +35,15 @@
 /* Private variables ---------------------------------------------------------*/
 EXTI_HandleTypeDef hexti0;
 
+#if (HCI_TL_SPI_RX_USE_DMA == 1)
+/* Dummy bytes clocked out while the payload is read through DMA */
+static uint8_t hci_rx_dummy_tx[HCI_READ_PACKET_SIZE];
+/* Payload length of the DMA transfer in progress, 0 when the bus is idle */
+static volatile uint16_t hci_rx_dma_len = 0;
+/* Set by HCI_TL_SPI_Send() so that the DMA completion leaves the IRQ line masked */
+static volatile uint8_t hci_tx_in_progress = 0;
+#endif
+
 /* Private function prototypes -----------------------------------------------*/
 static void HCI_TL_SPI_Enable_IRQ(void);
 static void HCI_TL_SPI_Disable_IRQ(void);
@@ -143,8 +152,10 @@ int32_t HCI_TL_SPI_Receive(uint8_t* buffer, uint16_t size)
 {
   uint16_t byte_count;
   uint8_t len = 0;
+#if (HCI_TL_SPI_RX_USE_DMA == 0)
   uint8_t char_00 = 0x00;
   volatile uint8_t read_char;
+#endif
 
   uint8_t header_master[HEADER_SIZE] = {0x0b, 0x00, 0x00, 0x00, 0x00};
   uint8_t header_slave[HEADER_SIZE];
@@ -169,11 +180,22 @@ int32_t HCI_TL_SPI_Receive(uint8_t* buffer, uint16_t size)
       byte_count = size;
     }
 
+#if (HCI_TL_SPI_RX_USE_DMA == 1)
+    /* Payload goes straight into the packet buffer, CS and IRQ line are
+       released by HCI_TL_SPI_RxCpltCallback() */
+    hci_rx_dma_len = byte_count;
+    if (BSP_SPI1_SendRecv_DMA(hci_rx_dummy_tx, buffer, byte_count) == BSP_ERROR_NONE)
+    {
+      return HCI_TL_RX_PENDING;
+    }
+    hci_rx_dma_len = 0;
+#else
     for(len = 0; len < byte_count; len++)
     {
       BSP_SPI1_SendRecv(&char_00, (uint8_t*)&read_char, 1);
       buffer[len] = read_char;
     }
+#endif
   }
 
   /* Release CS line */
@@ -202,8 +224,25 @@ int32_t HCI_TL_SPI_Send(uint8_t* buffer, uint16_t size)
   static uint8_t read_char_buf[MAX_BUFFER_SIZE];
   uint32_t tickstart = HAL_GetTick();
 
+#if (HCI_TL_SPI_RX_USE_DMA == 1)
+  hci_tx_in_progress = 1;
   HCI_TL_SPI_Disable_IRQ();
 
+  /* Let a packet read already started by the EXTI finish on the bus */
+  while(hci_rx_dma_len != 0)
+  {
+    if((HAL_GetTick() - tickstart) > TIMEOUT_DURATION)
+    {
+      hci_tx_in_progress = 0;
+      HCI_TL_SPI_Enable_IRQ();
+      return -3;
+    }
+  }
+  tickstart = HAL_GetTick();
+#else
+  HCI_TL_SPI_Disable_IRQ();
+#endif
+
   do
   {
     uint32_t tickstart_data_available = HAL_GetTick();
@@ -258,6 +297,9 @@ int32_t HCI_TL_SPI_Send(uint8_t* buffer, uint16_t size)
     }
   } while(result < 0);
 
+#if (HCI_TL_SPI_RX_USE_DMA == 1)
+  hci_tx_in_progress = 0;
+#endif
   HCI_TL_SPI_Enable_IRQ();
 
   return result;
@@ -274,6 +316,44 @@ static int32_t IsDataAvailable(void)
   return (HAL_GPIO_ReadPin(HCI_TL_SPI_EXTI_PORT, HCI_TL_SPI_EXTI_PIN) == GPIO_PIN_SET);
 }
 
+#if (HCI_TL_SPI_RX_USE_DMA == 1)
+/**
+ * @brief  Ends the payload read started by HCI_TL_SPI_Receive().
+ * @note   Called from the SPI1 DMA transfer complete or error interrupt.
+ *
+ * @param  status : BSP_ERROR_NONE if the whole payload was received
+ * @retval None
+ */
+void HCI_TL_SPI_RxCpltCallback(int32_t status)
+{
+  uint16_t byte_count = hci_rx_dma_len;
+
+  if (byte_count == 0)
+  {
+    return;
+  }
+
+  /* Release CS line */
+  HAL_GPIO_WritePin(HCI_TL_SPI_CS_PORT, HCI_TL_SPI_CS_PIN, GPIO_PIN_SET);
+
+  hci_rx_dma_len = 0;
+  hci_notify_asynch_evt_cplt((status == BSP_ERROR_NONE) ? byte_count : 0);
+
+  if (hci_tx_in_progress == 0)
+  {
+    HCI_TL_SPI_Enable_IRQ();
+
+    /* IRQ line still high: the BlueNRG-2 has queued another packet and no new edge will come */
+    hci_tl_lowlevel_isr();
+  }
+  else if (IsDataAvailable())
+  {
+    /* Keep the next packet pending until HCI_TL_SPI_Send() unmasks the IRQ line */
+    HAL_EXTI_GenerateSWI(&hexti0);
+  }
+}
+#endif
+
 /***************************** hci_tl_interface main functions *****************************/
 /**
  * @brief  Register hci_tl_interface IO bus services
@@ -329,6 +409,13 @@ void hci_tl_lowlevel_isr(void)
     {
       return;
     }
+#if (HCI_TL_SPI_RX_USE_DMA == 1)
+    if (hci_rx_dma_len != 0)
+    {
+      /* Payload transfer in progress, loop resumes from HCI_TL_SPI_RxCpltCallback() */
+      return;
+    }
+#endif
   }
 
   /* USER CODE BEGIN hci_tl_lowlevel_isr */
@@ -336,4 +423,20 @@ void hci_tl_lowlevel_isr(void)
   /* USER CODE END hci_tl_lowlevel_isr */
 }
 
+/**
+  * @brief Restart the packet reads held off while the HCI read ring was full
+  * @note  Called from task context. The IRQ line stayed high, no new edge will
+  *        come, so the EXTI interrupt is raised by software.
+  *
+  * @param  None
+  * @retval None
+  */
+void hci_tl_lowlevel_resume(void)
+{
+  if (IsDataAvailable())
+  {
+    HAL_EXTI_GenerateSWI(&hexti0);
+  }
+}
+
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
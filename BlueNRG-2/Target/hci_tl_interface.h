@@ -31,6 +31,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "custom_bus.h"
+#include "bluenrg_conf.h"
 
 /* Exported Defines ----------------------------------------------------------*/
 
@@ -57,6 +58,9 @@ int32_t HCI_TL_SPI_DeInit  (void);
 int32_t HCI_TL_SPI_Receive (uint8_t* buffer, uint16_t size);
 int32_t HCI_TL_SPI_Send    (uint8_t* buffer, uint16_t size);
 int32_t HCI_TL_SPI_Reset   (void);
+#if (HCI_TL_SPI_RX_USE_DMA == 1)
+void    HCI_TL_SPI_RxCpltCallback(int32_t status);
+#endif
 
 /**
  * @brief  Register hci_tl_interface IO bus services
@@ -74,6 +78,14 @@ void hci_tl_lowlevel_init(void);
  */
 void hci_tl_lowlevel_isr(void);
 
+/**
+ * @brief Restart the packet reads held off while the HCI read ring was full
+ *
+ * @param  None
+ * @retval None
+ */
+void hci_tl_lowlevel_resume(void);
+
 #ifdef __cplusplus
 }
 #endif
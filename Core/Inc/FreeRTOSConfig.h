@@ -54,6 +54,8 @@
 /* USER CODE BEGIN 0 */
   extern void configureTimerForRunTimeStats(void);
   extern unsigned long getRunTimeCounterValue(void);
+  extern void LowPower_SuppressTicksAndSleep(uint32_t xExpectedIdleTime);
+  #include "car_app_trace.h"
 /* USER CODE END 0 */
 #endif
 #ifndef CMSIS_device_header
@@ -185,6 +187,24 @@ standard names. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+
+/* 1: application tasks, timers, queues and semaphores are allocated statically, see FRTOS_Init_Tasks().
+   The heap is then only left for objects created at run time.
+   0: they are created from the heap_4 pool */
+#define FRTOS_STATIC_ALLOCATION                  1
+
+/* RAM given to the kernel objects of the application and to the heap, in either layout.
+   Checked at build time in car_app_freertos.c, reported after the link by Tools/ram_budget.py */
+#define FRTOS_RAM_KERNEL_BUDGET                  ((size_t)32768)
+
+#if (FRTOS_STATIC_ALLOCATION == 1)
+#undef configTOTAL_HEAP_SIZE
+#define configTOTAL_HEAP_SIZE                    ((size_t)4096)
+#endif
+
+/* The tick is stopped while idle, the core sleeps or enters STOP mode, see car_app_lowpower.c */
+#define configUSE_TICKLESS_IDLE                  1
+#define portSUPPRESS_TICKS_AND_SLEEP(xExpectedIdleTime) LowPower_SuppressTicksAndSleep(xExpectedIdleTime)
 /* USER CODE END Defines */
 
 #endif /* FREERTOS_CONFIG_H */
@@ -23,6 +23,7 @@ extern "C" {
 #include <string.h>
 #include "main.h"
 #include "bluenrg_conf.h"
+#include "bluenrg1_types.h"
 
 
 /* Exported defines ------------------------------------------------------------------------------*/
@@ -33,6 +34,32 @@ extern "C" {
  	#define MAX_DATA_EXCHANGE_BYTES								4
 	#define DATA_EXCHANGE_6_BYTES								6
 
+	/*--- Throughput of the telemetry stream ---*/
+	#define BLE_ATT_MTU_DEFAULT									((uint16_t)23)
+	#define BLE_DLE_TX_OCTETS									((uint16_t)251)		/* Largest LL PDU payload */
+	#define BLE_DLE_TX_TIME										((uint16_t)2120)	/* (251 + 14) x 8us on the 1M PHY */
+
+	/*--- Connection parameter profiles, see BlueNRG_RequestConnProfile() ---*/
+	/* Active: short interval and no slave latency so commands are actuated within 15ms */
+	#define BLE_CONN_ACTIVE_INTERV_MIN							((uint16_t)L2CAP_INTERV_MIN)		/* N x 1.25ms */
+	#define BLE_CONN_ACTIVE_INTERV_MAX							((uint16_t)L2CAP_INTERV_MAX)
+	#define BLE_CONN_ACTIVE_LATENCY								((uint16_t)0)
+
+	/* Idle: the BlueNRG-2 only listens every (latency + 1) x interval, i.e. every 250ms to 500ms */
+	#define BLE_CONN_IDLE_INTERV_MIN							((uint16_t)40)
+	#define BLE_CONN_IDLE_INTERV_MAX							((uint16_t)80)
+	#define BLE_CONN_IDLE_LATENCY								((uint16_t)4)
+
+	/* Supervision timeout of both profiles, N x 10ms */
+	#define BLE_CONN_SUPERV_TIMEOUT								((uint16_t)L2CAP_TIMEOUT_MULTIPLIER)
+
+	/* Time without command and with motors stopped before switching to the idle profile */
+	#define BLE_CONN_IDLE_AFTER_MS								((uint32_t)3000)
+
+	/* Update_Type of aci_gatt_update_char_value_ext() */
+	#define BLE_UPDATE_LOCAL									((uint8_t)0x00)
+	#define BLE_UPDATE_NOTIFICATION								((uint8_t)0x01)
+
 	/*--- BLE Motor Direction Commands ---*/
 	#define BLEMOT_CMD_N							((uint8_t)0x4E)
 	#define BLEMOT_CMD_N_LOWER						((uint8_t)0x6E)
@@ -47,6 +74,77 @@ extern "C" {
 	#define BLEMOT_CMD_R							((uint8_t)0x52)		/* Might be unused since 'SOUTH' is reverse direction */
 	#define BLEMOT_CMD_R_LOWER						((uint8_t)0x72)		/* Might be unused since 'SOUTH' is reverse direction */
 
+   /**
+    * @brief Binary command frames
+	*
+	* A write on the direction characteristic starting with BLE_CMD_FRAME_ID carries up to
+	* BLE_CMD_PER_WRITE_MAX commands of BLE_CMD_RECORD_SIZE bytes each:
+	* 	[0]		Opcode (BLE_CMD_OP_x), optionally OR'd with BLE_CMD_FLAG_PREEMPT
+	* 	[1]		Sequence number, echoed in xBleCmdStats.LastSequence once executed
+	* 	[2]		Speed in cm/s, 0 for SPEED_TARGET_DEFAULT_CM_S
+	* 	[3..4]	Duration in ms (little endian), 0 for BLE_CMD_DURATION_DEFAULT_MS
+	*
+	* Commands run one after the other, each for its duration, and the car brakes once the queue
+	* is empty. A preempting command (and any stop) discards the queued commands and cuts the
+	* running one short. Any other first byte is taken as a single ASCII command (BLEMOT_CMD_x).
+	*/
+	#define BLE_CMD_FRAME_ID						((uint8_t)0xB1)
+	#define BLE_CMD_RECORD_SIZE						5
+	#define BLE_CMD_PER_WRITE_MAX					16
+	#define BLE_CMD_WRITE_MAX						(1 + (BLE_CMD_PER_WRITE_MAX * BLE_CMD_RECORD_SIZE))
+
+	#define BLE_CMD_OP_STOP							((uint8_t)0x00)
+	#define BLE_CMD_OP_FORWARD						((uint8_t)0x01)
+	#define BLE_CMD_OP_RIGHT						((uint8_t)0x02)
+	#define BLE_CMD_OP_BACK							((uint8_t)0x03)
+	#define BLE_CMD_OP_LEFT							((uint8_t)0x04)
+	#define BLE_CMD_OP_MASK							((uint8_t)0x7F)
+	#define BLE_CMD_OP_INVALID						((uint8_t)0xFF)
+	#define BLE_CMD_FLAG_PREEMPT					((uint8_t)0x80)
+
+	#define BLE_CMD_DURATION_DEFAULT_MS				((uint16_t)1000)
+
+	/*--- Commands waiting for Task_ParseBLEMessage ---*/
+	#define BLE_CMD_QUEUE_LENGTH					32
+
+   /**
+    * @brief Joystick frames
+	*
+	* Streamed at 20Hz to 50Hz with write without response on the direction characteristic:
+	* 	[0]		BLE_JOY_FRAME_ID
+	* 	[1]		Sequence number, frames not newer than the last one applied are dropped
+	* 	[2]		Throttle, int8 from -100 (full reverse) to 100 (full forward)
+	* 	[3]		Steer, int8 from -100 (spin left) to 100 (spin right)
+	*
+	* Only the newest frame is kept until applied. The car brakes if no frame came for
+	* BLE_JOY_DEADMAN_MS, and any command frame or ASCII command ends the joystick drive.
+	*/
+	#define BLE_JOY_FRAME_ID						((uint8_t)0xB2)
+	#define BLE_JOY_FRAME_SIZE						4
+	#define BLE_JOY_DEADMAN_MS						((uint32_t)250)
+
+   /**
+	* @brief Hazard warnings
+	*
+	* WRN_CRASH (shock or free fall) and WRN_SPEED (over speed) notify MAX_DATA_EXCHANGE_BYTES bytes:
+	* 	[0]		BLE_HAZARD_x flags of the events since the previous notification
+	* 	[1]		Number of these events, saturates at 255
+	* 	[2..3]	Velocity estimate at the last event in cm/s (little endian)
+	*/
+	#define BLE_HAZARD_IMPACT						((uint8_t)0x01)
+	#define BLE_HAZARD_FREEFALL						((uint8_t)0x02)
+	#define BLE_HAZARD_OVERSPEED					((uint8_t)0x04)
+	#define BLE_HAZARD_CRASH_MASK					(BLE_HAZARD_IMPACT | BLE_HAZARD_FREEFALL)
+
+   /**
+	* @brief Velocity
+	*
+	* RD_VELOCITY holds MAX_DATA_EXCHANGE_BYTES bytes, updated by the telemetry task when the
+	* estimate changes:
+	* 	[0..3]	Velocity estimate in cm/s (little endian)
+	*/
+	#define BLE_VELOCITY_SIZE						MAX_DATA_EXCHANGE_BYTES
+
    /**
     * @brief GAP Roles
 	*
@@ -76,13 +174,14 @@ extern "C" {
 	/* Notification values related to BLE connectivity */
 	#define FRTOS_TASK_NOTIF_BLE_DISCONNECTED				((uint16_t)0x0001)
 	#define FRTOS_TASK_NOTIF_BLE_CONNECTED					((uint16_t)0x0002)
+	#define FRTOS_TASK_NOTIF_BLE_CONN_ACTIVE				((uint16_t)0x0004)
+	#define FRTOS_TASK_NOTIF_BLE_CONN_IDLE					((uint16_t)0x0008)
 
-	/* Notification values related to Motor directions */
-	#define FRTOS_TASK_NOTIF_DIR_NORTH						((uint16_t)0x0001)
-	#define FRTOS_TASK_NOTIF_DIR_EAST						((uint16_t)0x0002)
-	#define FRTOS_TASK_NOTIF_DIR_SOUTH						((uint16_t)0x0004)
-	#define FRTOS_TASK_NOTIF_DIR_WEST						((uint16_t)0x0008)
-	#define FRTOS_TASK_NOTIF_DIR_FORCESTOP					((uint16_t)0x8000)
+	/* Notification values waking Task_ParseBLEMessage */
+	#define FRTOS_TASK_NOTIF_CMD_PREEMPT					((uint16_t)0x0001)		/* Ends the running command */
+	#define FRTOS_TASK_NOTIF_CMD_QUEUED						((uint16_t)0x0002)
+	#define FRTOS_TASK_NOTIF_JOYSTICK						((uint16_t)0x0004)
+	#define FRTOS_TASK_NOTIF_HAZARD							((uint16_t)0x0008)		/* Car braked on a hazard */
 
 
 /* Exported types --------------------------------------------------------------------------------*/
@@ -96,6 +195,94 @@ typedef enum
 
 } BLE_State_t;
 
+/* One motor command, as queued for Task_ParseBLEMessage */
+typedef struct
+{
+	uint8_t Opcode;						/* BLE_CMD_OP_x, with BLE_CMD_FLAG_PREEMPT if set by the client */
+	uint8_t Sequence;
+	uint8_t Speed_cm_s;
+	uint16_t Duration_ms;
+
+} BLE_Command_t;
+
+/* One joystick position, as posted for Task_ParseBLEMessage */
+typedef struct
+{
+	int8_t Throttle;
+	int8_t Steer;
+	uint8_t Sequence;
+	uint32_t RxCycles;					/* DWT cycle count when the frame was written */
+
+} BLE_Joystick_t;
+
+/* Statistics of the joystick drive */
+typedef struct
+{
+	uint32_t Frames;					/* Frames written by the client */
+	uint32_t Applied;					/* Frames that reached the motor outputs */
+	uint32_t Stale;						/* Frames overwritten by a newer one, or out of sequence */
+	uint32_t DeadmanStops;				/* Brakes after BLE_JOY_DEADMAN_MS without frames */
+	uint32_t LastLatency_us;			/* From the write event to the PWM compare registers update */
+	uint32_t MaxLatency_us;
+	uint32_t TotalLatency_us;			/* Average is TotalLatency_us / Applied */
+
+} BleJoystickStats_t;
+
+/* Statistics of the command protocol */
+typedef struct
+{
+	uint32_t Writes;					/* Writes on the direction characteristic */
+	uint32_t Received;					/* Commands parsed and queued */
+	uint32_t Executed;
+	uint32_t Preempted;					/* Preempting commands, queued commands they discarded are not counted */
+	uint32_t Dropped;					/* Commands lost because the queue was full */
+	uint32_t Malformed;					/* Unknown opcodes, truncated records */
+	uint8_t LastSequence;				/* Sequence number of the last command executed */
+
+} BleCmdStats_t;
+
+/* Statistics of the hazard warnings */
+typedef struct
+{
+	uint32_t Posted;					/* Hazards reported by the calculations task */
+	uint32_t Notified;					/* Notifications sent on WRN_CRASH/WRN_SPEED */
+	uint32_t TxPoolFull;				/* Notifications deferred until the BlueNRG-2 freed TX buffers */
+	uint32_t TxErrors;					/* Notifications rejected for any other reason */
+	uint32_t NotConnected;				/* Hazards dropped while no client was connected */
+
+} BleHazardStats_t;
+
+/* Connection parameter profiles */
+typedef enum
+{
+	CONN_PROFILE_ACTIVE			= 0x00,		/* Motors running or commands coming in */
+	CONN_PROFILE_IDLE			= 0x01,		/* Car stopped, low duty cycle */
+	CONN_PROFILE_COUNT,
+	CONN_PROFILE_NONE			= 0xFF,		/* Nothing requested on this connection yet */
+
+} BLE_ConnProfile_t;
+
+/* Command to actuation latency measured under one connection parameter profile */
+typedef struct
+{
+	uint32_t Commands;					/* Commands actuated under this profile */
+	uint32_t LastLatency_us;			/* From the command write event to the motor outputs commit */
+	uint32_t MaxLatency_us;
+	uint32_t TotalLatency_us;			/* Average is TotalLatency_us / Commands */
+	uint32_t AirLatencyBound_us;		/* Worst case wait for the write over the air, (latency + 1) x interval */
+
+} ConnLatencyStats_t;
+
+/* Statistics of the connection parameter manager */
+typedef struct
+{
+	uint32_t UpdateRequests;			/* aci_l2cap_connection_parameter_update_req() sent */
+	uint32_t UpdatesRejected;			/* Rejected by the central or timed out */
+	uint32_t UpdatesApplied;			/* hci_le_connection_update_complete_event() received */
+	ConnLatencyStats_t Profile[CONN_PROFILE_COUNT];
+
+} ConnParamStats_t;
+
 /* Struct to hold BLE connection related data/parameters */
 typedef struct
 {
@@ -105,6 +292,8 @@ typedef struct
 	uint16_t BLE_ConnInterval;			/* Timing parameters of BLE */
 	uint16_t BLE_ConnLatency;			/* Timing parameters of BLE */
 	uint16_t BLE_SupervisionTimeout;	/* Timing parameters of BLE */
+	uint16_t AttMtu;					/* ATT_MTU agreed with the client */
+	uint16_t MaxTxOctets;				/* Largest LL PDU payload sent on the connection */
 	BLE_State_t ConnectionStatus;		/* Connection status, will be used in FSM */
 } ConnectionStatus_t;
 
@@ -112,6 +301,10 @@ typedef struct
 /* Exported variables ----------------------------------------------------------------------------*/
 extern char pText[TEXTSIZE];
 extern ConnectionStatus_t Conn_Details;
+extern ConnParamStats_t xConnParamStats;
+extern BleCmdStats_t xBleCmdStats;
+extern BleJoystickStats_t xBleJoystickStats;
+extern BleHazardStats_t xBleHazardStats;
 
 
 /* Exported constants ----------------------------------------------------------------------------*/
@@ -125,12 +318,24 @@ extern ConnectionStatus_t Conn_Details;
 /*** BLE Stack and System Init ***/
 void BlueNRG_Init(void);
 void BlueNRG_MakeDeviceDiscoverable(void);
+void BlueNRG_NegotiateThroughput(void);
+void BlueNRG_RequestConnProfile(BLE_ConnProfile_t Profile);
+void BlueNRG_RecordActuation(void);
+void BlueNRG_RecordJoystickActuation(const BLE_Joystick_t *pJoystick);
 
 /*** Custom BLE HCI Functions and Events ***/
 void APP_UserEvtRx(void *pData);
 
 /*** User Application Related Routines/Functions ***/
 void BlueNRG_Loop(void);
+uint8_t BlueNRG_TelemetrySubscribed(void);
+uint16_t BlueNRG_TelemetryPayloadMax(void);
+tBleStatus BlueNRG_NotifyTelemetry(uint8_t *pData, uint16_t Length);
+tBleStatus BlueNRG_PublishCpuLoad(uint8_t *pData, uint16_t Length);
+tBleStatus BlueNRG_PublishHealth(uint8_t *pData, uint16_t Length);
+tBleStatus BlueNRG_PublishVelocity(int32_t Velocity_cm_s);
+void BlueNRG_PostHazard(uint8_t Flags, int16_t Velocity_cm_s);
+tBleStatus BlueNRG_NotifyHazards(void);
 
 
 
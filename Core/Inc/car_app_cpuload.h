@@ -0,0 +1,106 @@
+/**
+  **************************************************************************************************
+  * @file           : car_app_cpuload.h
+  * @brief          : Header for car_app_cpuload.c file.
+  *
+  * @author         : Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Define to prevent recursive inclusion ---------------------------------------------------------*/
+#ifndef __CAR_APP_CPULOAD_H
+#define __CAR_APP_CPULOAD_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+/* Exported defines ------------------------------------------------------------------------------*/
+	/*--- Length of one sampling window ---*/
+	#define CPULOAD_WINDOW_MS					((uint32_t)1000)
+
+	/*--- Tasks tracked, including the idle and timer service tasks ---*/
+	#define CPULOAD_MAX_TASKS					12
+
+	/**
+	 * @brief Report layout (little endian), read or notified on the CPU_LOAD characteristic:
+	 *
+	 * 	[0]			Sequence number, wraps at 255
+	 * 	[1]			Number of tasks N
+	 * 	[2..3]		Window length in ms
+	 * 	[4..5]		Busy time in the window (time out of the idle task), permille
+	 * 	[6..7]		Highest busy time since power up, permille
+	 * 	[8..9]		Time in the application interrupts in the window, permille. It is part of the
+	 * 				load of the tasks they preempted, the idle task included
+	 * 	[10..11]	Highest interrupt time since power up, permille
+	 * 	[12..]		N records: task number, priority, load in the window and highest load, both
+	 * 				permille on 16 bits, CPULOAD_NAME_CHARS of the task name
+	 */
+	#define CPULOAD_HEADER_SIZE					12
+	#define CPULOAD_RECORD_SIZE					(6 + CPULOAD_NAME_CHARS)
+	#define CPULOAD_REPORT_MAX					(CPULOAD_HEADER_SIZE + (CPULOAD_MAX_TASKS * CPULOAD_RECORD_SIZE))
+
+	/*--- Characters of the task names in the CPU load and health records, not null terminated ---*/
+	#define CPULOAD_NAME_CHARS					8
+
+
+/* Exported types --------------------------------------------------------------------------------*/
+	/*--- CPU load of one task ---*/
+	typedef struct
+	{
+		uint32_t TaskNumber;			/* FreeRTOS task number, in creation order */
+		uint32_t PrevRunTime;			/* Run time counter of the task at the previous sample */
+		uint16_t Load_permille;			/* Share of the last window spent in the task */
+		uint16_t Peak_permille;			/* Highest Load_permille seen */
+		uint8_t Priority;				/* Current priority */
+		uint8_t Seen;					/* Set while the task is listed by the kernel */
+		char Name[CPULOAD_NAME_CHARS];	/* Short name, see CpuLoad_ShortName() */
+
+	} CpuLoadTask;
+
+	/*--- Statistics of the CPU load sampler ---*/
+	typedef struct
+	{
+		uint32_t Windows;				/* Samples taken */
+		uint32_t LastWindow_us;			/* Length of the last window */
+		uint16_t Busy_permille;			/* Time out of the idle task in the last window */
+		uint16_t PeakBusy_permille;		/* Highest Busy_permille seen */
+		uint16_t Isr_permille;			/* Time in the application interrupts in the last window */
+		uint16_t PeakIsr_permille;		/* Highest Isr_permille seen */
+		uint32_t TableFull;				/* Tasks left out, more than CPULOAD_MAX_TASKS were listed */
+		uint32_t LastCycles;			/* CPU cycles of the last sample */
+
+	} CpuLoadStats;
+
+
+/* Exported variables ----------------------------------------------------------------------------*/
+extern CpuLoadStats xCpuLoadStats;
+
+
+/* Exported Functions Prototypes -----------------------------------------------------------------*/
+void CpuLoad_Update(const TaskStatus_t *pTasks, UBaseType_t Count, uint32_t RunTime);
+uint16_t CpuLoad_BuildReport(uint8_t *pBuffer, uint16_t MaxLength);
+void CpuLoad_ShortName(char *pOut, const char *pName);
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+#endif  /* __CAR_APP_CPULOAD_H */
+
+
+/******************************************* END OF FILE *******************************************/
@@ -25,6 +25,14 @@ extern "C" {
 
 
 /* Exported types --------------------------------------------------------------------------------*/
+	/*--- RAM taken by the kernel objects of the application, resolved at compile time ---*/
+	typedef struct
+	{
+		uint32_t StaticBytes;			/* Static layout: stacks, TCBs, timers and queues in .bss */
+		uint32_t HeapBytes;				/* Heap layout: same objects from heap_4, block headers included */
+		uint32_t HeapSize;				/* configTOTAL_HEAP_SIZE of the selected layout */
+
+	} FRTOS_RamBudget_t;
 
 
 /* Exported variables ----------------------------------------------------------------------------*/
@@ -36,16 +44,32 @@ extern "C" {
 	extern __IO uint32_t g_CountDirForceStop;
 	extern __IO uint32_t g_CarTotalDistanceCovered;
 
+	/*--- RAM budget of the kernel objects, see FRTOS_STATIC_ALLOCATION ---*/
+	extern const FRTOS_RamBudget_t xFrtosRamBudget;
+
 
 /* Exported defines ------------------------------------------------------------------------------*/
 	/*--- Measurement/Calculation Parameters ---*/
 	#define FREQUENCY_MS_CALCULATION			((uint8_t)25)
 	#define FREQUENCY_S_CALCULATION				((float)FREQUENCY_MS_CALCULATION/1000.0f)
 
-	/*--- Task Stack Sizes ---*/
-	#define TASK_STACKSIZE_MIN					(64 * 4)			/* 256 words = 512 bytes */
-	#define TASK_STACKSIZE_DEFAULT				(256 * 4)			/* 1024 words = 2048 bytes */
-	#define TASK_STACKSIZE_MAX					(1024 * 4)			/* 4096 words = 8192 bytes */
+	/*--- Over speed warning, raised above CAR_OVERSPEED_CM_S and re-armed below CAR_OVERSPEED_RELEASE_CM_S ---*/
+	#define CAR_OVERSPEED_CM_S					((int32_t)200)
+	#define CAR_OVERSPEED_RELEASE_CM_S			((int32_t)150)
+
+	/*--- Task Stack Sizes, in words ---*/
+	#define TASK_STACKSIZE_MIN					(64 * 4)			/* 256 words = 1024 bytes */
+	#define TASK_STACKSIZE_DEFAULT				(256 * 4)			/* 1024 words = 4096 bytes */
+	#define TASK_STACKSIZE_MAX					(1024 * 4)			/* 4096 words = 16384 bytes */
+
+	/*--- Stack of each task, to be tuned from the lowest headroom in the health report ---*/
+	#define TASK_STACK_BLE_CONN					TASK_STACKSIZE_DEFAULT
+	#define TASK_STACK_BLE_MSG					TASK_STACKSIZE_DEFAULT
+	#define TASK_STACK_CALCULATIONS				TASK_STACKSIZE_DEFAULT
+	#define TASK_STACK_PB						TASK_STACKSIZE_MIN
+	#define TASK_STACK_MCULED					TASK_STACKSIZE_MIN
+	#define TASK_STACK_BLE_EVENTS				TASK_STACKSIZE_DEFAULT
+	#define TASK_STACK_TELEMETRY				TASK_STACKSIZE_DEFAULT
 
 	/*--- Task Priorities ---*/
 	#define TASK_PRIO_BLE_CONN					osPriorityHigh6
@@ -54,6 +78,7 @@ extern "C" {
 	#define TASK_PRIO_PB						osPriorityAboveNormal7
 	#define TASK_PRIO_MCULED					osPriorityAboveNormal4
 	#define TASK_PRIO_BLE_EVENTS				osPriorityNormal1
+	#define TASK_PRIO_TELEMETRY					osPriorityNormal
 
 
 /* Exported constants ----------------------------------------------------------------------------*/
@@ -0,0 +1,105 @@
+/**
+  **************************************************************************************************
+  * @file           : car_app_health.h
+  * @brief          : Header for car_app_health.c file.
+  *
+  * @author         : Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Define to prevent recursive inclusion ---------------------------------------------------------*/
+#ifndef __CAR_APP_HEALTH_H
+#define __CAR_APP_HEALTH_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdint.h>
+#include "car_app_cpuload.h"
+
+
+/* Exported types --------------------------------------------------------------------------------*/
+	/*--- Statistics of the health monitor, as of the last sample ---*/
+	typedef struct
+	{
+		uint32_t Samples;				/* Health_Sample() calls */
+		uint32_t TableFull;				/* Samples that found more tasks than HEALTH_MAX_TASKS */
+		uint32_t HeapFree;				/* heap_4 free bytes */
+		uint32_t HeapMinEverFree;		/* Lowest HeapFree since power up */
+		uint32_t HeapLargestBlock;		/* Largest allocation that could succeed */
+		uint32_t HeapFreeBlocks;		/* Free blocks the free bytes are split into */
+		uint16_t Fragmentation_permille;/* Share of the free bytes outside the largest block */
+		uint16_t MinStack_words;		/* Lowest stack headroom of all tasks */
+		uint32_t MinStackTask;			/* Task number of the task with MinStack_words */
+		uint32_t HciPending;			/* HCI received packets waiting for the BLE events task */
+		uint32_t HciPeak;				/* Highest HciPending since power up */
+		uint32_t HciStalls;			/* HCI reads held off on a full ring */
+		uint32_t LowStackSamples;		/* Samples with a task below HEALTH_STACK_LOW_WORDS */
+		uint32_t LowHeapSamples;		/* Samples with HeapLargestBlock below HEALTH_HEAP_LOW_BYTES */
+		uint32_t LastCycles;			/* CPU cycles of the last sample */
+
+	} HealthStats;
+
+
+/* Exported variables ----------------------------------------------------------------------------*/
+extern HealthStats xHealthStats;
+
+
+/* Exported defines ------------------------------------------------------------------------------*/
+	/*--- Sampling period, the CPU load window is closed on every sample ---*/
+	#define HEALTH_PERIOD_MS					CPULOAD_WINDOW_MS
+
+	/*--- Tasks listed per sample, including the idle and timer service tasks ---*/
+	#define HEALTH_MAX_TASKS					CPULOAD_MAX_TASKS
+
+	/*--- Warning levels, raised well before a stack overflow or vApplicationMallocFailedHook() ---*/
+	#define HEALTH_STACK_LOW_WORDS				((uint16_t)32)
+	#define HEALTH_HEAP_LOW_BYTES				((uint32_t)2048)
+
+	/*--- Report flags ---*/
+	#define HEALTH_FLAG_STACK_LOW				((uint8_t)0x01)
+	#define HEALTH_FLAG_HEAP_LOW				((uint8_t)0x02)
+	#define HEALTH_FLAG_HCI_STALLED				((uint8_t)0x04)
+
+	/**
+	 * @brief Report layout (little endian), read or notified on the HEALTH characteristic:
+	 *
+	 * 	[0]			Sequence number, wraps at 255
+	 * 	[1]			Number of tasks N
+	 * 	[2]			HEALTH_FLAG_x
+	 * 	[3]			Highest HCI received packet ring occupancy
+	 * 	[4..5]		Heap free bytes
+	 * 	[6..7]		Lowest heap free bytes since power up
+	 * 	[8..9]		Largest free heap block
+	 * 	[10..11]	Heap fragmentation, permille
+	 * 	[12..13]	HCI reads held off on a full ring, saturates at 65535
+	 * 	[14..]		N records: task number, priority, lowest stack headroom in words on 16 bits,
+	 * 				CPULOAD_NAME_CHARS of the task name
+	 */
+	#define HEALTH_HEADER_SIZE					14
+	#define HEALTH_RECORD_SIZE					(4 + CPULOAD_NAME_CHARS)
+	#define HEALTH_REPORT_MAX					(HEALTH_HEADER_SIZE + (HEALTH_MAX_TASKS * HEALTH_RECORD_SIZE))
+
+
+/* Exported Functions Prototypes -----------------------------------------------------------------*/
+void Health_Sample(void);
+uint16_t Health_BuildReport(uint8_t *pBuffer, uint16_t MaxLength);
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+#endif  /* __CAR_APP_HEALTH_H */
+
+
+/******************************************* END OF FILE *******************************************/
@@ -0,0 +1,90 @@
+/**
+  **************************************************************************************************
+  * @file           : car_app_lowpower.h
+  * @brief          : Header for car_app_lowpower.c file.
+  *
+  * @author         : Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Define to prevent recursive inclusion ---------------------------------------------------------*/
+#ifndef __CAR_APP_LOWPOWER_H
+#define __CAR_APP_LOWPOWER_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdint.h>
+
+
+/* Exported types --------------------------------------------------------------------------------*/
+	/*--- Statistics of the tickless idle, times are measured on TIM5 (sleep) or the RTC (stop) ---*/
+	typedef struct
+	{
+		uint32_t SleepEntries;			/* WFI with the tick suppressed */
+		uint32_t StopEntries;			/* STOP mode with the RTC wakeup timer armed */
+		uint64_t SleepTime_us;			/* Time spent in WFI */
+		uint64_t StopTime_us;			/* Time spent in STOP mode, clock restart included */
+		uint32_t Aborted;				/* A task got ready before the core went to sleep */
+		uint32_t StopVetoes;			/* Long enough for STOP mode, but a peripheral was busy */
+		uint32_t TimerWakeups;			/* Woken up by TIM5 or the RTC for the next task timeout */
+		uint32_t EventWakeups;			/* Woken up earlier by an interrupt (BlueNRG, ADXL343...) */
+		uint32_t LostTicks;				/* Ticks dropped because the core woke up too late */
+		uint32_t LsiFrequency_Hz;		/* LSI measured against TIM5, clocks the RTC */
+		int32_t TickDrift_us;			/* Tick count minus TIM5 time, relative to the first sleep */
+		int32_t MaxTickDrift_us;		/* Largest TickDrift_us in absolute value */
+
+	} LowPowerStats;
+
+
+/* Exported variables ----------------------------------------------------------------------------*/
+extern LowPowerStats xLowPowerStats;
+
+
+/* Exported defines ------------------------------------------------------------------------------*/
+	/*--- 1: long idle periods are spent in STOP mode, 0: WFI only ---*/
+#ifndef LOWPOWER_USE_STOP_MODE
+	#define LOWPOWER_USE_STOP_MODE				1
+#endif
+
+	/*--- Shortest idle period worth STOP mode, the regulator and the PLL take a while to restart ---*/
+	#define LOWPOWER_STOP_MIN_TICKS				((uint32_t)20)
+
+	/*--- STOP mode ends this early, so that the clocks are back before the task timeout ---*/
+	#define LOWPOWER_STOP_WAKEUP_MARGIN_US		((uint32_t)500)
+
+	/*--- RTC wakeup timer clock is LSI/16, and PREDIV_S + 1 sub seconds per RTC second at LSI/4 ---*/
+	#define LOWPOWER_RTC_WUT_DIV				16
+	#define LOWPOWER_RTC_PREDIV_A				((uint32_t)3)
+	#define LOWPOWER_RTC_PREDIV_S				((uint32_t)8191)
+
+	/*--- LSI periods timed per calibration: captures x input prescaler ---*/
+	#define LOWPOWER_LSI_CAPTURES				16
+	#define LOWPOWER_LSI_CAPTURE_PSC			8
+
+
+/* Exported Functions Prototypes -----------------------------------------------------------------*/
+void LowPower_Init(void);
+void LowPower_SuppressTicksAndSleep(uint32_t xExpectedIdleTime);
+void LowPower_RtcWakeupIRQHandler(void);
+uint32_t LowPower_WakeCounts(uint32_t ToBoundary, uint32_t xExpectedIdleTime);
+uint32_t LowPower_CompensateTicks(uint32_t SleptCounts, uint32_t ToBoundary, uint32_t xExpectedIdleTime, uint32_t *pRemaining);
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+#endif  /* __CAR_APP_LOWPOWER_H */
+
+
+/******************************************* END OF FILE *******************************************/
@@ -0,0 +1,89 @@
+/**
+  **************************************************************************************************
+  * @file           : car_app_motion.h
+  * @brief          : Header for car_app_motion.c file.
+  *
+  * @author         : Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Define to prevent recursive inclusion ---------------------------------------------------------*/
+#ifndef __CAR_APP_MOTION_H
+#define __CAR_APP_MOTION_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdint.h>
+
+
+/* Exported types --------------------------------------------------------------------------------*/
+	/*--- Signed Q16.16 fixed point value ---*/
+	typedef int32_t q16_t;
+
+	/*--- Dead reckoning state of the car, updated with every acceleration sample ---*/
+	typedef struct
+	{
+		int32_t AccelPrev[3];			/* Previous raw sample (13-bit counts) of axis x, y, z */
+		q16_t AccelNetPrev[3];			/* Previous sample, bias removed and noise gated, in counts */
+		q16_t Bias[3];					/* Running bias estimate in counts (gravity included on z) */
+		q16_t Velocity[3];				/* Velocity of axis x, y, z in cm/s */
+		q16_t VelocityResultant;		/* Magnitude of the x and y velocity in cm/s */
+		int64_t Distance;				/* Distance covered in cm, Q16.16 on 64 bits */
+		uint32_t Dt_us;					/* Last sample period seen, in microseconds */
+		uint32_t Dt_q32;				/* Dt_us in seconds, Q0.32 */
+		uint8_t Primed;					/* Set once a first sample is stored in AccelPrev */
+		uint8_t Stationary;				/* Car known to stand still, see Motion_SetStationary() */
+		uint32_t StationarySamples;		/* Samples integrated as zero velocity updates */
+		uint32_t GatedSamples;			/* Axis samples below the noise gate, integrated as 0 */
+
+	} MotionState;
+
+
+/* Exported defines ------------------------------------------------------------------------------*/
+	/*--- Q16.16 helpers ---*/
+	#define Q16_SHIFT							16
+	#define Q16_ONE								((q16_t)1 << Q16_SHIFT)
+	#define Q16_FROM_INT(x)						((q16_t)((x) * Q16_ONE))
+	#define Q16_TO_INT(x)						((int32_t)((x) >> Q16_SHIFT))
+
+	/* ADXL343 full resolution scale: 3.90625mg/LSB x 980.665cm/(s^2)/g = 3.8307cm/(s^2) per count */
+	#define MOTION_LSB_CM_S2_Q16				((int32_t)251050)
+
+	/* Samples further apart than this are integrated over this period only (Dt_q32 must stay below 1s) */
+	#define MOTION_DT_MAX_US					((uint32_t)500000)
+
+	/* Bias estimate update while stationary, new = old + (sample - old) / 2^MOTION_BIAS_SHIFT */
+	#define MOTION_BIAS_SHIFT					6
+
+	/* Accelerations within this many counts of the bias are sensor noise (~2 LSB rms at 400Hz) */
+	#define MOTION_NOISE_GATE_Q16				Q16_FROM_INT(4)
+
+	/* Time for the car to coast to a stop once no wheel is driven anymore */
+	#define MOTION_ZUPT_SETTLE_US				((uint32_t)500000)
+
+
+/* Exported Functions Prototypes -----------------------------------------------------------------*/
+void Motion_Init(MotionState *pState);
+void Motion_SetStationary(MotionState *pState, uint8_t Stationary);
+void Motion_Integrate(MotionState *pState, int32_t AccelX, int32_t AccelY, int32_t AccelZ, uint32_t Dt_us);
+q16_t Motion_FastMagnitude(q16_t x, q16_t y);
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+#endif  /* __CAR_APP_MOTION_H */
+
+
+/******************************************* END OF FILE *******************************************/
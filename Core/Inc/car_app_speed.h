@@ -0,0 +1,107 @@
+/**
+  **************************************************************************************************
+  * @file           : car_app_speed.h
+  * @brief          : Header for car_app_speed.c file.
+  *
+  * @author         : Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Define to prevent recursive inclusion ---------------------------------------------------------*/
+#ifndef __CAR_APP_SPEED_H
+#define __CAR_APP_SPEED_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdint.h>
+#include "car_app_motion.h"
+#include "motordriver.h"
+
+
+/* Exported types --------------------------------------------------------------------------------*/
+	/*--- Fixed point PID controller, all values in Q16.16 ---*/
+	typedef struct
+	{
+		q16_t Kff;						/* Feedforward gain, duty % per cm/s of setpoint */
+		q16_t Kp;						/* Proportional gain, duty % per cm/s of error */
+		q16_t Ki_dt;					/* Integral gain x loop period, duty % per cm/s of error */
+		q16_t Kd_rate;					/* Derivative gain x loop rate, duty % per cm/s of change */
+		q16_t OutMin;					/* Output clamp, duty % */
+		q16_t OutMax;
+		q16_t Integral;					/* Integral term, duty % */
+		q16_t PrevMeasurement;			/* Derivative is taken on the measurement, not the error */
+		uint8_t Primed;					/* Set once PrevMeasurement holds a measurement */
+
+	} PidController;
+
+	/*--- Statistics of the speed control loop ---*/
+	typedef struct
+	{
+		uint32_t Iterations;			/* Number of Speed_ControlStep() calls */
+		uint32_t Saturations;			/* Wheel outputs clamped to OutMin/OutMax */
+		uint32_t EncoderSamples;		/* Wheel speeds read from Speed_ReadWheelEncoder() */
+		uint32_t FeedforwardSamples;	/* Wheels without an encoder, driven by the feedforward alone */
+		uint32_t LastCycles;			/* CPU cycles of the last PID computation (4 wheels) */
+		uint32_t MaxCycles;				/* Worst case of LastCycles */
+
+	} SpeedControlStats;
+
+
+/* Exported variables ----------------------------------------------------------------------------*/
+extern SpeedControlStats xSpeedStats;
+
+
+/* Exported defines ------------------------------------------------------------------------------*/
+	/*--- Closed loop wheel speed control (0: duty cycles stay as configured by the motor layer).
+		  Only set once the wheel encoders are fitted, see Speed_ReadWheelEncoder() ---*/
+	#define SPEED_CONTROL_CLOSED_LOOP			0
+
+	/*--- Loop rate of Speed_ControlStep(), in Hz ---*/
+	#define SPEED_CONTROL_LOOP_HZ				((uint32_t)20)
+
+	/*--- Wheel speed commanded on direction inputs, in cm/s ---*/
+	#define SPEED_TARGET_DEFAULT_CM_S			((int32_t)40)
+
+	/*--- Wheel speed commanded by a full joystick deflection, in cm/s ---*/
+	#define SPEED_FULL_SCALE_CM_S				((int32_t)150)
+
+	/* Default gains, to be tuned on the car: roughly 100% duty for 150cm/s */
+	#define SPEED_PID_KFF_Q16					((q16_t)43690)		/* 0.667 %/(cm/s) */
+	#define SPEED_PID_KP_Q16					((q16_t)32768)		/* 0.5 %/(cm/s) */
+	#define SPEED_PID_KI_Q16					((q16_t)65536)		/* 1.0 %/(cm/s)/s */
+	#define SPEED_PID_KD_Q16					((q16_t)0)			/* %/(cm/s^2) */
+
+
+/* Exported Functions Prototypes -----------------------------------------------------------------*/
+	/*--- Generic PID ---*/
+	void Pid_Init(PidController *pPid, q16_t Kff, q16_t Kp, q16_t Ki, q16_t Kd, uint32_t LoopRate_Hz,
+				  q16_t OutMin, q16_t OutMax);
+	void Pid_Reset(PidController *pPid);
+	q16_t Pid_Update(PidController *pPid, q16_t Setpoint, q16_t Measurement);
+	q16_t Pid_Feedforward(PidController *pPid, q16_t Setpoint);
+
+	/*--- Car wheel speed control ---*/
+	void Speed_Init(uint32_t LoopRate_Hz);
+	void Speed_SetTarget(E_MotorWheel_Pos MotorWheel, int32_t Speed_cm_s);
+	void Speed_ControlStep(void);
+	uint8_t Speed_ReadWheelEncoder(E_MotorWheel_Idx Wheel, q16_t *pSpeed);
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+#endif  /* __CAR_APP_SPEED_H */
+
+
+/******************************************* END OF FILE *******************************************/
@@ -0,0 +1,97 @@
+/**
+  **************************************************************************************************
+  * @file           : car_app_telemetry.h
+  * @brief          : Header for car_app_telemetry.c file.
+  *
+  * @author         : Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Define to prevent recursive inclusion ---------------------------------------------------------*/
+#ifndef __CAR_APP_TELEMETRY_H
+#define __CAR_APP_TELEMETRY_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdint.h>
+#include "car_app_motion.h"
+
+
+/* Exported types --------------------------------------------------------------------------------*/
+	/*--- One accelerometer sample together with the dead reckoning output right after it ---*/
+	typedef struct
+	{
+		uint32_t Timestamp_us;			/* Sample timestamp, see ADXL_StreamDrain() */
+		int16_t Accel[3];				/* Sign extended 13-bit counts of axis x, y, z */
+		int16_t Velocity_cm_s;			/* Resultant velocity */
+		int32_t Distance_cm;			/* Distance covered */
+
+	} TelemetryRecord;
+
+	/*--- Statistics of the telemetry stream ---*/
+	typedef struct
+	{
+		uint32_t Records;				/* Records pushed by the calculations task */
+		uint32_t Dropped;				/* Records lost because the ring was full */
+		uint32_t Batches;				/* Batches built, i.e. notifications sent or retried */
+		uint32_t Bytes;					/* Payload bytes of the batches built */
+		uint32_t TxPoolFull;			/* Sends deferred until the BlueNRG-2 freed TX buffers */
+		uint32_t TxErrors;				/* Sends rejected for any other reason, batch discarded */
+
+	} TelemetryStats;
+
+
+/* Exported variables ----------------------------------------------------------------------------*/
+extern TelemetryStats xTelemetryStats;
+
+
+/* Exported defines ------------------------------------------------------------------------------*/
+	/**
+	 * @brief Batch layout (little endian), one batch per notification:
+	 *
+	 * 	[0]		Sequence number, wraps at 255. A gap means batches were lost
+	 * 	[1]		Number of records N
+	 * 	[2..5]	Timestamp of the first record in us. Record i was sampled at
+	 * 			Timestamp + i x SamplePeriod
+	 * 	[6..7]	SamplePeriod in us
+	 * 	[8..11]	Distance covered at the last record, in cm
+	 * 	[12..]	N records of 4 x int16: acceleration x, y, z (counts of 3.9mg) and velocity (cm/s)
+	 */
+	#define TELEMETRY_HEADER_SIZE				12
+	#define TELEMETRY_RECORD_SIZE				8
+
+	/*--- Largest batch, an ATT_MTU of 247 fills a single 251 byte data length extended PDU ---*/
+	#define TELEMETRY_PAYLOAD_MAX				((uint16_t)244)
+
+	/*--- Records buffered between the calculations task and the BLE, must be a power of 2 ---*/
+	#define TELEMETRY_RING_SIZE					128
+
+	/*--- Partial batches are sent at least this often, so low data rates still stream ---*/
+	#define TELEMETRY_FLUSH_PERIOD_MS			((uint32_t)100)
+
+
+/* Exported Functions Prototypes -----------------------------------------------------------------*/
+void Telemetry_Init(uint32_t SamplePeriod_us);
+uint8_t Telemetry_Push(uint32_t Timestamp_us, const MotionState *pMotion);
+uint16_t Telemetry_BuildBatch(uint8_t *pBuffer, uint16_t MaxLength);
+void Telemetry_Discard(void);
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+#endif  /* __CAR_APP_TELEMETRY_H */
+
+
+/******************************************* END OF FILE *******************************************/
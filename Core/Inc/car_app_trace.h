@@ -0,0 +1,128 @@
+/**
+  **************************************************************************************************
+  * @file           : car_app_trace.h
+  * @brief          : Header for car_app_trace.c file. Included by FreeRTOSConfig.h, so that the
+  *  				  kernel trace hooks below are compiled into tasks.c.
+  *
+  * @author         : Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Define to prevent recursive inclusion ---------------------------------------------------------*/
+#ifndef __CAR_APP_TRACE_H
+#define __CAR_APP_TRACE_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdint.h>
+
+
+/* Exported defines ------------------------------------------------------------------------------*/
+	/*--- 1: scheduler events are recorded, 0: the hooks compile to nothing ---*/
+	#define TRACE_RECORDER_ENABLE				1
+
+	/*--- Records held until drained, a power of 2. The oldest ones are overwritten ---*/
+	#define TRACE_RING_RECORDS					512
+
+	/*--- ITM stimulus port the records are drained to, port 0 carries printf() ---*/
+	#define TRACE_ITM_PORT						1
+
+	/*--- First word of xTraceBuffer, finds the ring in a RAM dump ---*/
+	#define TRACE_MAGIC							((uint32_t)0x45435254)	/* "TRCE" */
+
+	/*--- Record types ---*/
+	#define TRACE_EV_TASK_IN					((uint8_t)1)	/* Id: task number, Arg: priority */
+	#define TRACE_EV_ISR_ENTER					((uint8_t)2)	/* Arg: exception number */
+	#define TRACE_EV_ISR_EXIT					((uint8_t)3)	/* Arg: exception number */
+	#define TRACE_EV_NOTIFY						((uint8_t)4)	/* Id: task notified, Arg: task number of the sender */
+	#define TRACE_EV_NOTIFY_FROM_ISR			((uint8_t)5)	/* Id: task notified, Arg: exception number */
+	#define TRACE_EV_IDLE_SLEEP					((uint8_t)6)	/* Tickless idle entered */
+	#define TRACE_EV_IDLE_WAKE					((uint8_t)7)	/* Tickless idle left */
+	#define TRACE_EV_TASK_NAME					((uint8_t)8)	/* Id: task number, Arg: 2 characters of its name */
+
+	/*--- Characters of the task name recorded at creation ---*/
+	#define TRACE_TASK_NAME_CHARS				16
+
+
+/* Exported types --------------------------------------------------------------------------------*/
+	/**
+	 * @brief One trace record, drained as is (little endian):
+	 *
+	 * 	[0..3]	TIM5 count, 2us per count, wraps every 143 minutes
+	 * 	[4]		TRACE_EV_x
+	 * 	[5]		Id
+	 * 	[6..7]	Arg
+	 */
+	typedef struct
+	{
+		uint32_t Timestamp;
+		uint8_t Type;
+		uint8_t Id;
+		uint16_t Arg;
+
+	} TraceRecord;
+
+	/*--- Ring of records, dumped whole by a debugger when ITM is not available ---*/
+	typedef struct
+	{
+		uint32_t Magic;					/* TRACE_MAGIC */
+		uint32_t Records;				/* TRACE_RING_RECORDS */
+		volatile uint32_t Head;			/* Records written since power up */
+		volatile uint32_t Tail;			/* Records drained or overwritten since power up */
+		volatile uint32_t Overwritten;	/* Records lost before being drained */
+		uint32_t Drained;				/* Records sent over ITM */
+		TraceRecord Ring[TRACE_RING_RECORDS];
+
+	} TraceBuffer;
+
+
+/* Exported variables ----------------------------------------------------------------------------*/
+extern TraceBuffer xTraceBuffer;
+
+
+/* Exported Functions Prototypes -----------------------------------------------------------------*/
+uint32_t Trace_Record(uint8_t Type, uint8_t Id, uint16_t Arg);
+uint32_t Trace_RecordFromIsr(uint8_t Type, uint8_t Id);
+void Trace_TaskCreated(uint8_t TaskNumber, const char *pName);
+void Trace_Drain(void);
+void Trace_IsrEnter(void);
+void Trace_IsrExit(void);
+uint32_t Trace_IsrTime(void);
+
+
+/* Exported macro --------------------------------------------------------------------------------*/
+#if (TRACE_RECORDER_ENABLE == 1)
+	/*--- Kernel hooks, expanded within tasks.c where pxCurrentTCB and pxTCB are in scope ---*/
+	#define traceTASK_CREATE(pxNewTCB)			Trace_TaskCreated((uint8_t)(pxNewTCB)->uxTCBNumber, (pxNewTCB)->pcTaskName)
+	#define traceTASK_SWITCHED_IN()				Trace_Record(TRACE_EV_TASK_IN, (uint8_t)pxCurrentTCB->uxTCBNumber, (uint16_t)pxCurrentTCB->uxPriority)
+	#define traceTASK_NOTIFY()					Trace_Record(TRACE_EV_NOTIFY, (uint8_t)pxTCB->uxTCBNumber, (uint16_t)pxCurrentTCB->uxTCBNumber)
+	#define traceTASK_NOTIFY_FROM_ISR()			Trace_RecordFromIsr(TRACE_EV_NOTIFY_FROM_ISR, (uint8_t)pxTCB->uxTCBNumber)
+	#define traceTASK_NOTIFY_GIVE_FROM_ISR()	Trace_RecordFromIsr(TRACE_EV_NOTIFY_FROM_ISR, (uint8_t)pxTCB->uxTCBNumber)
+	#define traceLOW_POWER_IDLE_BEGIN()			Trace_Record(TRACE_EV_IDLE_SLEEP, 0, 0)
+	#define traceLOW_POWER_IDLE_END()			Trace_Record(TRACE_EV_IDLE_WAKE, 0, 0)
+#endif
+
+/*--- The kernel has no interrupt hooks, the application handlers call these. The time spent in
+	  them is accounted for the CPU load report, recorder enabled or not ---*/
+#define TRACE_ISR_ENTER()						Trace_IsrEnter()
+#define TRACE_ISR_EXIT()						Trace_IsrExit()
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+#endif  /* __CAR_APP_TRACE_H */
+
+
+/******************************************* END OF FILE *******************************************/
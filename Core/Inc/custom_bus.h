@@ -61,6 +61,12 @@
 #define BUS_SPI1_SCK_GPIO_AF GPIO_AF5_SPI1
 #define BUS_SPI1_SCK_GPIO_CLK_ENABLE() __HAL_RCC_GPIOB_CLK_ENABLE()
 
+#define BUS_SPI1_DMA_CHANNEL DMA_CHANNEL_3
+#define BUS_SPI1_RX_DMA_STREAM DMA2_Stream2
+#define BUS_SPI1_RX_DMA_IRQn DMA2_Stream2_IRQn
+#define BUS_SPI1_TX_DMA_STREAM DMA2_Stream3
+#define BUS_SPI1_TX_DMA_IRQn DMA2_Stream3_IRQn
+
 #ifndef BUS_SPI1_POLL_TIMEOUT
   #define BUS_SPI1_POLL_TIMEOUT                   0x1000U
 #endif
@@ -92,6 +98,8 @@ typedef struct
   */
 
 extern SPI_HandleTypeDef hspi1;
+extern DMA_HandleTypeDef hdma_spi1_rx;
+extern DMA_HandleTypeDef hdma_spi1_tx;
 
 /**
   * @}
@@ -108,6 +116,7 @@ int32_t BSP_SPI1_DeInit(void);
 int32_t BSP_SPI1_Send(uint8_t *pData, uint16_t Length);
 int32_t BSP_SPI1_Recv(uint8_t *pData, uint16_t Length);
 int32_t BSP_SPI1_SendRecv(uint8_t *pTxData, uint8_t *pRxData, uint16_t Length);
+int32_t BSP_SPI1_SendRecv_DMA(uint8_t *pTxData, uint8_t *pRxData, uint16_t Length);
 #if (USE_HAL_SPI_REGISTER_CALLBACKS == 1U)
 int32_t BSP_SPI1_RegisterDefaultMspCallbacks (void);
 int32_t BSP_SPI1_RegisterMspCallbacks (BSP_SPI_Cb_t *Callbacks);
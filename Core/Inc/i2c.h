@@ -32,6 +32,7 @@ extern "C" {
 /* USER CODE END Includes */
 
 extern I2C_HandleTypeDef hi2c1;
+extern DMA_HandleTypeDef hdma_i2c1_rx;
 
 /* USER CODE BEGIN Private defines */
 
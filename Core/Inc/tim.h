@@ -34,9 +34,12 @@ extern TIM_HandleTypeDef htim1;
 extern TIM_HandleTypeDef htim3;
 extern TIM_HandleTypeDef htim5;
 extern TIM_HandleTypeDef htim9;
+extern DMA_HandleTypeDef hdma_tim1_up;
+extern DMA_HandleTypeDef hdma_tim1_ch1;
 
 /* USER CODE BEGIN Private defines */
-
+/* TIM5 free running timebase, 12.5MHz (PCLK1 x 2) / (24 + 1) = 2us per count */
+#define TIMEBASE_US_PER_COUNT		2
 /* USER CODE END Private defines */
 void MX_TIM1_Init(void);
 void MX_TIM3_Init(void);
@@ -47,7 +50,7 @@ void HAL_TIM_MspPostInit(TIM_HandleTypeDef* timHandle);
 
 
 /* USER CODE BEGIN Prototypes */
-
+uint32_t Timebase_GetMicros(void);
 /* USER CODE END Prototypes */
 
 #ifdef __cplusplus
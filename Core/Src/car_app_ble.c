@@ -18,26 +18,49 @@
 #include "bluenrg1_gatt_aci.h"
 #include "bluenrg1_gap_aci.h"
 #include "bluenrg1_hci_le.h"
+#include "bluenrg1_l2cap_aci.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
+#include "queue.h"
 
 
 /* Private includes ------------------------------------------------------------------------------*/
 #include "bluenrg_conf.h"				/* Contains configured Bluetooth Parameters in CubeMX */
 #include "car_app_freertos.h"
+#include "car_app_telemetry.h"
+#include "car_app_cpuload.h"
+#include "car_app_health.h"
 
 
 /* External variables ----------------------------------------------------------------------------*/
 	/*--- FreeRTOS Task Handles that will be notified from this file ---*/
 	extern TaskHandle_t h_TaskBLEConn;
 	extern TaskHandle_t h_TaskBLEMsg;
+	extern TaskHandle_t h_TaskTelemetry;
+
+	/*--- FreeRTOS Queue filled with the commands written by the client ---*/
+	extern QueueHandle_t h_QueueBLECmd;
+
+	/*--- FreeRTOS Queue of length 1 holding the newest joystick position ---*/
+	extern QueueHandle_t h_QueueBLEJoystick;
 
 
 /* Private typedef -------------------------------------------------------------------------------*/
+/* Hazards posted and not notified yet on one warning characteristic */
+typedef struct
+{
+	uint8_t Flags;						/* BLE_HAZARD_x */
+	uint8_t Count;
+	int16_t Velocity_cm_s;
+
+} BLE_HazardRecord_t;
 
 
 /* Private define --------------------------------------------------------------------------------*/
+/* Value bytes carried by one aci_gatt_update_char_value_ext() command: the HCI packet type and
+   command header (4 bytes) and the command parameters (12 bytes) share HCI_MAX_PAYLOAD_SIZE */
+#define BLE_UPDATE_EXT_CHUNK_MAX				(HCI_MAX_PAYLOAD_SIZE - 4 - 12)
 
 
 /* Private variables -----------------------------------------------------------------------------*/
@@ -50,7 +73,7 @@ uint16_t discovery_time 			= 0;
 
 	/*--- Variables that will hold service and characteristic UUIDs ---*/
 	Service_UUID_t suuid_object;
-	Char_UUID_t char_obj_1, char_obj_2, char_obj_3, char_obj_4, char_obj_5;
+	Char_UUID_t char_obj_1, char_obj_2, char_obj_3, char_obj_4, char_obj_5, char_obj_6, char_obj_7, char_obj_8;
 
 	/*--- Handle to services and associated characteristics ---*/
 	static uint16_t hService;
@@ -59,6 +82,9 @@ uint16_t discovery_time 			= 0;
 	static uint16_t hClientRead_Velocity;
 	static uint16_t hClientWrite_Direction;
 	static uint16_t hClientRead_VerifyDirection;
+	static uint16_t hClientNotify_Telemetry;
+	static uint16_t hClientNotify_CpuLoad;
+	static uint16_t hClientNotify_Health;
 
 	/*--- Handle to associated characteristic descriptors ---*/
 	static uint16_t hFirstCharDesc;
@@ -66,9 +92,34 @@ uint16_t discovery_time 			= 0;
 	static uint16_t hThirdCharDesc;
 	static uint16_t hFourthCharDesc;
 	static uint16_t hFifthCharDesc;
+	static uint16_t hSixthCharDesc;
+	static uint16_t hSeventhCharDesc;
+	static uint16_t hEighthCharDesc;
 
 	/*--- Discovery/Connectivity/Connection Details ---*/
 	ConnectionStatus_t Conn_Details;
+	static __IO uint8_t s_TelemetrySubscribed = 0;		/* Client enabled notifications on the telemetry stream */
+	static __IO uint8_t s_CpuLoadSubscribed = 0;		/* Client enabled notifications on the CPU load report */
+	static __IO uint8_t s_HealthSubscribed = 0;			/* Client enabled notifications on the health report */
+
+	/*--- Connection parameter manager ---*/
+	ConnParamStats_t xConnParamStats = {0};
+	static BLE_ConnProfile_t s_ConnProfileRequested = CONN_PROFILE_NONE;
+	static __IO uint32_t s_CommandRxCycles = 0;		/* DWT cycle count when the last command was written */
+	static __IO uint8_t s_CommandPending = 0;
+
+	/*--- Command protocol ---*/
+	BleCmdStats_t xBleCmdStats = {0};
+
+	/*--- Joystick drive ---*/
+	BleJoystickStats_t xBleJoystickStats = {0};
+	static uint8_t s_JoystickLastSequence = 0;
+	static TickType_t s_JoystickLastTick = 0;
+
+	/*--- Hazard warnings, posted by the calculations task and sent by the telemetry task ---*/
+	BleHazardStats_t xBleHazardStats = {0};
+	static BLE_HazardRecord_t s_HazardCrash = {0};
+	static BLE_HazardRecord_t s_HazardOverSpeed = {0};
 
 	/*--- Buffers containing text/char responses to BLE Scanner App ---*/
 	static const uint8_t s_BLEVerifyMessageLength			= 6;
@@ -87,6 +138,14 @@ uint16_t discovery_time 			= 0;
 static void Setup_DeviceAddress(void);
 static void GAP_Peripheral_ConfigService(void);
 static void Server_ResetConnectionStatus(void);
+static uint8_t Server_ParseAsciiCommand(uint8_t Character);
+static uint8_t Server_ParseCommandFrame(const uint8_t *pData, uint16_t Length);
+static void Server_QueueCommand(const BLE_Command_t *pCommand);
+static void Server_PostJoystick(const uint8_t *pData);
+static void Server_RecordHazard(BLE_HazardRecord_t *pRecord, uint8_t Flags, int16_t Velocity_cm_s);
+static tBleStatus Server_NotifyHazard(uint16_t hCharacteristic, BLE_HazardRecord_t *pPending);
+static tBleStatus Server_UpdateLongValue(uint16_t hChar, uint8_t UpdateType, uint8_t *pData, uint16_t Length);
+static tBleStatus Server_PublishReport(uint16_t hChar, uint8_t Subscribed, uint8_t *pData, uint16_t Length);
 
 
 /***************************** BLE Stack and Interface Initialization  **********************************/
@@ -106,6 +165,10 @@ void BlueNRG_Init(void)
 	hci_reset();
 	HAL_Delay(2000);
 
+	/* Cycle counter timing the command to actuation latency */
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
 	/* Configure transmit power to high power at -2dBm */
 	ret = aci_hal_set_tx_power_level(1, 4);
 	assert_param(ret == BLE_STATUS_SUCCESS);
@@ -208,7 +271,7 @@ static void Setup_DeviceAddress(void)
   */
 static void GAP_Peripheral_ConfigService(void)
 {
-	/* 128-bit UUID Declarations for 1 Service and the 5 Characteristics underneath that Service */
+	/* 128-bit UUID Declarations for 1 Service and the 6 Characteristics underneath that Service */
 
 	/* Configure 128-bit Service UUID since Sciton does not have dedicated 16-bit Service
 	   UUID with Bluetooth SIG. Service UUID obtained through UUID generator.
@@ -225,11 +288,18 @@ static void GAP_Peripheral_ConfigService(void)
 	{0x96,0xF7,0x4E,0xBF,0xB3,0x8E,0xB7,0x82,0x36,0x4B,0x7E,0x8B,0x00,0x00,0x00,0x04};
 	const uint8_t char5_uuid[16] =
 	{0x96,0xF7,0x4E,0xBF,0xB3,0x8E,0xB7,0x82,0x36,0x4B,0x7E,0x8B,0x00,0x00,0x00,0x05};
+	const uint8_t char6_uuid[16] =
+	{0x96,0xF7,0x4E,0xBF,0xB3,0x8E,0xB7,0x82,0x36,0x4B,0x7E,0x8B,0x00,0x00,0x00,0x06};
+	const uint8_t char7_uuid[16] =
+	{0x96,0xF7,0x4E,0xBF,0xB3,0x8E,0xB7,0x82,0x36,0x4B,0x7E,0x8B,0x00,0x00,0x00,0x07};
+	const uint8_t char8_uuid[16] =
+	{0x96,0xF7,0x4E,0xBF,0xB3,0x8E,0xB7,0x82,0x36,0x4B,0x7E,0x8B,0x00,0x00,0x00,0x08};
 
 	BLUENRG_memcpy(&suuid_object.Service_UUID_128, service_uuid, 16);
 
-	/* Add the Bluetooth Service based on the configuration above */
-	aci_gatt_add_service(UUID_TYPE_128, &suuid_object, PRIMARY_SERVICE, 20, &hService);
+	/* Add the Bluetooth Service based on the configuration above. Each characteristic takes 2 records,
+	   plus 1 per descriptor (user description, and CCCD of the notify characteristics) */
+	aci_gatt_add_service(UUID_TYPE_128, &suuid_object, PRIMARY_SERVICE, 32, &hService);
 
 	/* Variables that will hold the four characteristics' 128-bit UUID number.
 	   The first characteristic's UUID was generated with a UUID random number generator,
@@ -321,6 +391,60 @@ static void GAP_Peripheral_ConfigService(void)
 	/* Third characteristic's UUID */
 	BLUENRG_memcpy(&char_obj_5.Char_UUID_128, char5_uuid, 16);
 
+	/**
+	  * @brief Sixth Characteristic (Telemetry stream)
+		*
+		* Handle 													: Service handle to associate it with
+		* UUID type													: 128-bits
+		* Maximum length of the characteristic value				: TELEMETRY_PAYLOAD_MAX bytes
+		* Characteristic Properties									: CHAR_PROP_NOTIFY
+		* Security Permissions										: None
+		* GATT event mask flags										: GATT_DONT_NOTIFY_EVENTS
+		* Enc_Key_Size: 0x07 - the minimum encryption key size required to read the characteristic
+		* Variable characteristic value length						: VARIABLE_LENGTH
+		*
+		* This characteristic pushes batches of acceleration, velocity and distance records, see
+		* car_app_telemetry.h for the layout
+		*/
+	/* Sixth characteristic's UUID */
+	BLUENRG_memcpy(&char_obj_6.Char_UUID_128, char6_uuid, 16);
+
+	/**
+	  * @brief Seventh Characteristic (CPU load report)
+		*
+		* Handle 													: Service handle to associate it with
+		* UUID type													: 128-bits
+		* Maximum length of the characteristic value				: CPULOAD_REPORT_MAX bytes
+		* Characteristic Properties									: CHAR_PROP_READ | CHAR_PROP_NOTIFY
+		* Security Permissions										: None
+		* GATT event mask flags										: GATT_DONT_NOTIFY_EVENTS
+		* Enc_Key_Size: 0x07 - the minimum encryption key size required to read the characteristic
+		* Variable characteristic value length						: VARIABLE_LENGTH
+		*
+		* This characteristic holds the CPU load of every task over the last window, see
+		* car_app_cpuload.h for the layout
+		*/
+	/* Seventh characteristic's UUID */
+	BLUENRG_memcpy(&char_obj_7.Char_UUID_128, char7_uuid, 16);
+
+	/**
+	  * @brief Eighth Characteristic (Health report)
+		*
+		* Handle 													: Service handle to associate it with
+		* UUID type													: 128-bits
+		* Maximum length of the characteristic value				: HEALTH_REPORT_MAX bytes
+		* Characteristic Properties									: CHAR_PROP_READ | CHAR_PROP_NOTIFY
+		* Security Permissions										: None
+		* GATT event mask flags										: GATT_DONT_NOTIFY_EVENTS
+		* Enc_Key_Size: 0x07 - the minimum encryption key size required to read the characteristic
+		* Variable characteristic value length						: VARIABLE_LENGTH
+		*
+		* This characteristic holds the stack headroom of every task and the heap and HCI packet
+		* ring occupancy, see car_app_health.h for the layout
+		*/
+	/* Eighth characteristic's UUID */
+	BLUENRG_memcpy(&char_obj_8.Char_UUID_128, char8_uuid, 16);
+
 	/* Configure the four characteristic defined above for the GATT server (peripheral) */\
 	/* Characteristic will be used to notify if car went above speed limit */
 	aci_gatt_add_char(hService, UUID_TYPE_128, &char_obj_1, MAX_DATA_EXCHANGE_BYTES, CHAR_PROP_NOTIFY,
@@ -337,16 +461,32 @@ static void GAP_Peripheral_ConfigService(void)
 											ATTR_PERMISSION_NONE, GATT_DONT_NOTIFY_EVENTS,
 											0x07, CHAR_VALUE_LEN_CONSTANT, &hClientRead_Velocity);
 
-	/* Characteristic will be used to receive input: N(orth), E(ast), S(outh), W(est), or SS (Stop) */
-	aci_gatt_add_char(hService, UUID_TYPE_128, &char_obj_4, MAX_DATA_EXCHANGE_BYTES, CHAR_PROP_WRITE|CHAR_PROP_WRITE_WITHOUT_RESP,
+	/* Characteristic will be used to receive input: N(orth), E(ast), S(outh), W(est), or X (Stop), or binary
+	   command frames (see BLE_CMD_FRAME_ID) */
+	aci_gatt_add_char(hService, UUID_TYPE_128, &char_obj_4, BLE_CMD_WRITE_MAX, CHAR_PROP_WRITE|CHAR_PROP_WRITE_WITHOUT_RESP,
 											ATTR_PERMISSION_NONE, GATT_NOTIFY_ATTRIBUTE_WRITE,
-											0x07, CHAR_VALUE_LEN_CONSTANT, &hClientWrite_Direction);
+											0x07, CHAR_VALUE_LEN_VARIABLE, &hClientWrite_Direction);
 
 	/* Characteristic will be used to read the direction previously set/configured */
 	aci_gatt_add_char(hService, UUID_TYPE_128, &char_obj_5, BLE_DATA_BYTES(6), CHAR_PROP_READ,
 											ATTR_PERMISSION_NONE, GATT_DONT_NOTIFY_EVENTS,
 											0x07, CHAR_VALUE_LEN_CONSTANT, &hClientRead_VerifyDirection);
 
+	/* Characteristic will be used to stream telemetry batches, one per notification */
+	aci_gatt_add_char(hService, UUID_TYPE_128, &char_obj_6, TELEMETRY_PAYLOAD_MAX, CHAR_PROP_NOTIFY,
+											ATTR_PERMISSION_NONE, GATT_DONT_NOTIFY_EVENTS,
+											0x07, CHAR_VALUE_LEN_VARIABLE, &hClientNotify_Telemetry);
+
+	/* Characteristic will be used to read the CPU load report, or have it notified every window */
+	aci_gatt_add_char(hService, UUID_TYPE_128, &char_obj_7, CPULOAD_REPORT_MAX, CHAR_PROP_READ|CHAR_PROP_NOTIFY,
+											ATTR_PERMISSION_NONE, GATT_DONT_NOTIFY_EVENTS,
+											0x07, CHAR_VALUE_LEN_VARIABLE, &hClientNotify_CpuLoad);
+
+	/* Characteristic will be used to read the health report, or have it notified every period */
+	aci_gatt_add_char(hService, UUID_TYPE_128, &char_obj_8, HEALTH_REPORT_MAX, CHAR_PROP_READ|CHAR_PROP_NOTIFY,
+											ATTR_PERMISSION_NONE, GATT_DONT_NOTIFY_EVENTS,
+											0x07, CHAR_VALUE_LEN_VARIABLE, &hClientNotify_Health);
+
 	/* CCCD value */
 	Char_Desc_Uuid_t DescriptorProperty;
 	DescriptorProperty.Char_UUID_16 = CHAR_USER_DESC_UUID;
@@ -356,6 +496,9 @@ static void GAP_Peripheral_ConfigService(void)
 	const char char3name[] = {'R','D','_','V','E','L','O','C','I','T','Y'};
 	const char char4name[] = {'W','R','_','D','I','R','E','C','T','I','O','N'};
 	const char char5name[] = {'R','D','_','D','I','R','E','C','T','I','O','N'};
+	const char char6name[] = {'T','E','L','E','M','E','T','R','Y'};
+	const char char7name[] = {'C','P','U','_','L','O','A','D'};
+	const char char8name[] = {'H','E','A','L','T','H'};
 
 	/* Configure CCCD for the characteristics above (associated with characteristic UUIDs). The CCCD's
      might only be necessary for indicate/notify related events, as the CCCD feature in the GATT server
@@ -377,6 +520,15 @@ static void GAP_Peripheral_ConfigService(void)
 	aci_gatt_add_char_desc(hService, hClientRead_VerifyDirection, UUID_TYPE_16, &DescriptorProperty,
 															30, 11, (uint8_t*)char5name, ATTR_PERMISSION_NONE, ATTR_ACCESS_READ_ONLY,
 															GATT_DONT_NOTIFY_EVENTS, 7, CHAR_VALUE_LEN_CONSTANT, &hFifthCharDesc);
+	aci_gatt_add_char_desc(hService, hClientNotify_Telemetry, UUID_TYPE_16, &DescriptorProperty,
+														30, 9, (uint8_t*)char6name, ATTR_PERMISSION_NONE, ATTR_ACCESS_READ_ONLY,
+														GATT_DONT_NOTIFY_EVENTS, 7, CHAR_VALUE_LEN_CONSTANT, &hSixthCharDesc);
+	aci_gatt_add_char_desc(hService, hClientNotify_CpuLoad, UUID_TYPE_16, &DescriptorProperty,
+														30, 8, (uint8_t*)char7name, ATTR_PERMISSION_NONE, ATTR_ACCESS_READ_ONLY,
+														GATT_DONT_NOTIFY_EVENTS, 7, CHAR_VALUE_LEN_CONSTANT, &hSeventhCharDesc);
+	aci_gatt_add_char_desc(hService, hClientNotify_Health, UUID_TYPE_16, &DescriptorProperty,
+														30, 6, (uint8_t*)char8name, ATTR_PERMISSION_NONE, ATTR_ACCESS_READ_ONLY,
+														GATT_DONT_NOTIFY_EVENTS, 7, CHAR_VALUE_LEN_CONSTANT, &hEighthCharDesc);
 
 	/*
 	Char_Desc_Uuid_t DescriptorProperty;
@@ -406,6 +558,14 @@ static void Server_ResetConnectionStatus(void)
 	Conn_Details.BLE_ConnLatency = 0xFFFF;
 	Conn_Details.BLE_SupervisionTimeout = 0xFFFF;
 
+	/* Until negotiated otherwise, a connection starts with the minimum ATT_MTU and LL PDU size */
+	Conn_Details.AttMtu = BLE_ATT_MTU_DEFAULT;
+	Conn_Details.MaxTxOctets = 27;
+	s_TelemetrySubscribed = 0;
+	s_CpuLoadSubscribed = 0;
+	s_HealthSubscribed = 0;
+	s_ConnProfileRequested = CONN_PROFILE_NONE;
+
 	/* Set status to not connected */
 	Conn_Details.ConnectionStatus = STATE_NOT_CONNECTED;
 
@@ -417,6 +577,10 @@ static void Server_ResetConnectionStatus(void)
 		/* This value becomes pdTRUE if giving the notification caused a task to unblock, and the unblocked task has a
 		   higher priority than the currently running task, in which a context switch should occur */
 		BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+		const BLE_Command_t xStop = {BLE_CMD_OP_STOP, 0, 0, 0};
+
+		/* Stop the car and drop the queued commands before the task running them gets suspended */
+		Server_QueueCommand(&xStop);
 
 		/* Notify task that manages BLE connections that a disconnection just occurred */
 		xTaskNotifyFromISR(h_TaskBLEConn, FRTOS_TASK_NOTIF_BLE_DISCONNECTED, eSetBits, &xHigherPriorityTaskWoken);
@@ -480,6 +644,30 @@ void BlueNRG_MakeDeviceDiscoverable(void)
 	Conn_Details.ConnectionStatus = STATE_AWAITING_CONNECTION;
 }
 
+/**
+  * @brief	Asks for the largest link layer PDUs and ATT_MTU so that one telemetry batch goes out in a
+  *			single PDU per connection event
+  * @note	To be called from task context once connected. The outcome is reported through
+  *			hci_le_data_length_change_event() and aci_att_exchange_mtu_resp_event(), the client may
+  *			settle for less.
+  */
+void BlueNRG_NegotiateThroughput(void)
+{
+	tBleStatus ret;
+
+	ret = hci_le_set_data_length(Conn_Details.connectionhandle, BLE_DLE_TX_OCTETS, BLE_DLE_TX_TIME);
+	if(ret != BLE_STATUS_SUCCESS)
+	{
+		PRINT_DBG("hci_le_set_data_length() failed: 0x%02x\r\n", ret);
+	}
+
+	ret = aci_gatt_exchange_config(Conn_Details.connectionhandle);
+	if(ret != BLE_STATUS_SUCCESS)
+	{
+		PRINT_DBG("aci_gatt_exchange_config() failed: 0x%02x\r\n", ret);
+	}
+}
+
 /********************** BLE HCI related events and event callbacks in Stack *****************************/
 
 /**
@@ -489,47 +677,19 @@ void BlueNRG_MakeDeviceDiscoverable(void)
   */
 void APP_UserEvtRx(void *pData)
 {
-  uint32_t i;
+  hci_event_process process;
+  uint8_t *evt_data;
 
   hci_spi_pckt *hci_pckt = (hci_spi_pckt *)pData;
 
   if(hci_pckt->type == HCI_EVENT_PKT)
   {
-    hci_event_pckt *event_pckt = (hci_event_pckt*)hci_pckt->data;
+    /* Event callbacks are looked up directly by event code, see bluenrg1_events_lut.c */
+    process = hci_events_lut_lookup(hci_pckt->data, &evt_data);
 
-    if(event_pckt->evt == EVT_LE_META_EVENT)
-    {
-      evt_le_meta_event *evt = (void *)event_pckt->data;
-
-      for (i = 0; i < (sizeof(hci_le_meta_events_table)/sizeof(hci_le_meta_events_table_type)); i++)
-      {
-        if (evt->subevent == hci_le_meta_events_table[i].evt_code)
-        {
-          hci_le_meta_events_table[i].process((void *)evt->data);
-        }
-      }
-    }
-    else if(event_pckt->evt == EVT_VENDOR)
+    if(process != NULL)
     {
-      evt_blue_aci *blue_evt = (void*)event_pckt->data;
-
-      for (i = 0; i < (sizeof(hci_vendor_specific_events_table)/sizeof(hci_vendor_specific_events_table_type)); i++)
-      {
-        if (blue_evt->ecode == hci_vendor_specific_events_table[i].evt_code)
-        {
-          hci_vendor_specific_events_table[i].process((void *)blue_evt->data);
-        }
-      }
-    }
-    else
-    {
-      for (i = 0; i < (sizeof(hci_events_table)/sizeof(hci_events_table_type)); i++)
-      {
-        if (event_pckt->evt == hci_events_table[i].evt_code)
-        {
-          hci_events_table[i].process((void *)event_pckt->data);
-        }
-      }
+      process(evt_data);
     }
   }
 }
@@ -633,80 +793,641 @@ void aci_gatt_attribute_modified_event(uint16_t Connection_Handle,
                                        uint16_t Attr_Data_Length,
                                        uint8_t Attr_Data[])
 {
+	/* CCCD of the telemetry stream, right after its value handle */
+	if(Attr_Handle == hClientNotify_Telemetry+2)
+	{
+		s_TelemetrySubscribed = Attr_Data[0] & 0x01;
+
+		/* Let the telemetry task start streaming or drop what it buffered */
+		xTaskNotifyGive(h_TaskTelemetry);
+		return;
+	}
+
+	/* CCCD of the CPU load and health reports, the reports keep their own period */
+	if(Attr_Handle == hClientNotify_CpuLoad+2)
+	{
+		s_CpuLoadSubscribed = Attr_Data[0] & 0x01;
+		return;
+	}
+
+	if(Attr_Handle == hClientNotify_Health+2)
+	{
+		s_HealthSubscribed = Attr_Data[0] & 0x01;
+		return;
+	}
 
 	/* Determine which characteristic was modified by Client (Indicate and Notify characteristics
 	   are modified by Client only if Client acknowledges these features on Server) */
-	if(Attr_Handle == hClientWrite_Direction+1)
+	if((Attr_Handle == hClientWrite_Direction+1) && (Attr_Data[0] == BLE_JOY_FRAME_ID) &&
+	   (Attr_Data_Length == BLE_JOY_FRAME_SIZE))
+	{
+		/* Streamed without response, no acknowledgment either */
+		Server_PostJoystick(&Attr_Data[1]);
+	}
+	else if((Attr_Handle == hClientWrite_Direction+1) && (Attr_Data_Length > 0))
 	{
-		switch(Attr_Data[0])
+		uint8_t LastOpcode;
+
+		/* Start of the command to actuation latency, see BlueNRG_RecordActuation() */
+		s_CommandRxCycles = DWT->CYCCNT;
+		s_CommandPending = 1;
+		xBleCmdStats.Writes++;
+
+		if((Attr_Data[0] == BLE_CMD_FRAME_ID) && (Attr_Data_Length > 1))
+			LastOpcode = Server_ParseCommandFrame(&Attr_Data[1], Attr_Data_Length - 1);
+		else
+			LastOpcode = Server_ParseAsciiCommand(Attr_Data[0]);
+
+		/* Notify ACK to master through fifth characteristic (verify direction), printing the direction
+		   of the last command written or 'WRONG' */
+		switch(LastOpcode & BLE_CMD_OP_MASK)
 		{
-			case BLEMOT_CMD_N:
-			case BLEMOT_CMD_N_LOWER:
-			{
-				/* If input character is 'N' or 'n' representing North or forward */
-				/* Notify ACK to master through fifth characteristic (verify direction) printing 'NORTH'*/
+			case BLE_CMD_OP_FORWARD:
 				aci_gatt_update_char_value(hService, hClientRead_VerifyDirection, 0, s_BLEVerifyMessageLength, s_pTxNorthDirCharBuffer);
-
-				/* Notify appropriate FreeRTOS task that user wishes to move car forward */
-				xTaskNotify(h_TaskBLEMsg, FRTOS_TASK_NOTIF_DIR_NORTH, eSetBits);
 				break;
-			}
-			case BLEMOT_CMD_E:
-			case BLEMOT_CMD_E_LOWER:
-			{
-				/* If input character is 'E' or 'e' representing East or right */
-				/* Notify ACK to master through fifth characteristic (verify direction) printing 'EAST' */
+			case BLE_CMD_OP_RIGHT:
 				aci_gatt_update_char_value(hService, hClientRead_VerifyDirection, 0, s_BLEVerifyMessageLength, s_pTxEastDirCharBuffer);
-
-				/* Notify appropriate FreeRTOS task that user wishes to move car right */
-				xTaskNotify(h_TaskBLEMsg, FRTOS_TASK_NOTIF_DIR_EAST, eSetBits);
 				break;
-			}
-			case BLEMOT_CMD_S:
-			case BLEMOT_CMD_S_LOWER:
-			{
-				/* If input character is 'S' or 's' representing South or backwards */
-				/* Notify ACK to master through fifth characteristic (verify direction) printing 'SOUTH' */
+			case BLE_CMD_OP_BACK:
 				aci_gatt_update_char_value(hService, hClientRead_VerifyDirection, 0, s_BLEVerifyMessageLength, s_pTxSouthDirCharBuffer);
-
-				/* Notify appropriate FreeRTOS task that user wishes to move car backwards */
-				xTaskNotify(h_TaskBLEMsg, FRTOS_TASK_NOTIF_DIR_SOUTH, eSetBits);
 				break;
-			}
-			case BLEMOT_CMD_W:
-			case BLEMOT_CMD_W_LOWER:
-			{
-				/* If input character is 'W' or 'w' representing West or left */
-				/* Notify ACK to master through fifth characteristic (verify direction) printing 'WEST' */
+			case BLE_CMD_OP_LEFT:
 				aci_gatt_update_char_value(hService, hClientRead_VerifyDirection, 0, s_BLEVerifyMessageLength, s_pTxWestDirCharBuffer);
-
-				/* Notify appropriate FreeRTOS task that user wishes to move car left */
-				xTaskNotify(h_TaskBLEMsg, FRTOS_TASK_NOTIF_DIR_WEST, eSetBits);
 				break;
-			}
-			case BLEMOT_CMD_X:
-			case BLEMOT_CMD_X_LOWER:
-			{
-				/* If input character is 'X' or 'x' representing hard brake */
-				/* Notify ACK to master through fifth characteristic (verify direction) printing 'BRAKES' */
+			case BLE_CMD_OP_STOP:
 				aci_gatt_update_char_value(hService, hClientRead_VerifyDirection, 0, s_BLEVerifyMessageLength, s_pTxForceStopMovingCharBuffer);
-
-				/* Notify appropriate FreeRTOS task that user wishes to instantly stop moving the car */
-				xTaskNotify(h_TaskBLEMsg, FRTOS_TASK_NOTIF_DIR_FORCESTOP, eSetBits);
 				break;
-			}
 			default:
-			{
-				/* Print out 'WRONG' on read characteristic upon receiving unregistered command */
 				aci_gatt_update_char_value(hService, hClientRead_VerifyDirection, 0, s_BLEVerifyMessageLength, s_pTxIncorrectMsgCharBuffer);
 				break;
-			}
 		}
-
 	}
 
 } /* end aci_gatt_attribute_modified_event() */
 
+/**
+  * @brief	Maps a single ASCII command ('N', 'E', 'S', 'W', 'X' in any case) to a queued command
+  * @retval	Opcode queued, BLE_CMD_OP_INVALID if the character is not a command
+  * @note	ASCII commands preempt, so the last letter written always wins. Directions run for
+  *			BLE_CMD_DURATION_DEFAULT_MS.
+  */
+static uint8_t Server_ParseAsciiCommand(uint8_t Character)
+{
+	BLE_Command_t xCommand = {BLE_CMD_OP_INVALID, 0, 0, 0};
+
+	switch(Character)
+	{
+		case BLEMOT_CMD_N:
+		case BLEMOT_CMD_N_LOWER:
+			xCommand.Opcode = BLE_CMD_OP_FORWARD;
+			break;
+		case BLEMOT_CMD_E:
+		case BLEMOT_CMD_E_LOWER:
+			xCommand.Opcode = BLE_CMD_OP_RIGHT;
+			break;
+		case BLEMOT_CMD_S:
+		case BLEMOT_CMD_S_LOWER:
+			xCommand.Opcode = BLE_CMD_OP_BACK;
+			break;
+		case BLEMOT_CMD_W:
+		case BLEMOT_CMD_W_LOWER:
+			xCommand.Opcode = BLE_CMD_OP_LEFT;
+			break;
+		case BLEMOT_CMD_X:
+		case BLEMOT_CMD_X_LOWER:
+			xCommand.Opcode = BLE_CMD_OP_STOP;
+			break;
+		default:
+			xBleCmdStats.Malformed++;
+			return BLE_CMD_OP_INVALID;
+	}
+
+	xCommand.Opcode |= BLE_CMD_FLAG_PREEMPT;
+	Server_QueueCommand(&xCommand);
+
+	return xCommand.Opcode;
+}
+
+/**
+  * @brief	Queues every command of a binary frame, see BLE_CMD_FRAME_ID
+  * @param	pData, Length: the records, frame identifier excluded
+  * @retval	Opcode of the last command queued, BLE_CMD_OP_INVALID if none was valid
+  */
+static uint8_t Server_ParseCommandFrame(const uint8_t *pData, uint16_t Length)
+{
+	uint8_t LastOpcode = BLE_CMD_OP_INVALID;
+
+	if(Length % BLE_CMD_RECORD_SIZE)
+		xBleCmdStats.Malformed++;
+
+	for(; Length >= BLE_CMD_RECORD_SIZE; Length -= BLE_CMD_RECORD_SIZE, pData += BLE_CMD_RECORD_SIZE)
+	{
+		BLE_Command_t xCommand;
+
+		xCommand.Opcode = pData[0];
+		xCommand.Sequence = pData[1];
+		xCommand.Speed_cm_s = pData[2];
+		xCommand.Duration_ms = (uint16_t)(pData[3] | (pData[4] << 8));
+
+		if((xCommand.Opcode & BLE_CMD_OP_MASK) > BLE_CMD_OP_LEFT)
+		{
+			xBleCmdStats.Malformed++;
+			continue;
+		}
+
+		Server_QueueCommand(&xCommand);
+		LastOpcode = xCommand.Opcode;
+	}
+
+	return LastOpcode;
+}
+
+/**
+  * @brief	Hands a command over to Task_ParseBLEMessage
+  * @note	A preempting command empties the queue first and wakes the task out of the command it
+  *			is running. The task is notified once the command is in the queue, and runs at a higher
+  *			priority, so it picks the command up before this event returns.
+  */
+static void Server_QueueCommand(const BLE_Command_t *pCommand)
+{
+	uint32_t Notification = FRTOS_TASK_NOTIF_CMD_QUEUED;
+
+	if((pCommand->Opcode & BLE_CMD_FLAG_PREEMPT) || ((pCommand->Opcode & BLE_CMD_OP_MASK) == BLE_CMD_OP_STOP))
+	{
+		xQueueReset(h_QueueBLECmd);
+		Notification |= FRTOS_TASK_NOTIF_CMD_PREEMPT;
+		xBleCmdStats.Preempted++;
+	}
+
+	if(xQueueSendToBack(h_QueueBLECmd, pCommand, 0) == pdPASS)
+		xBleCmdStats.Received++;
+	else
+		xBleCmdStats.Dropped++;
+
+	xTaskNotify(h_TaskBLEMsg, Notification, eSetBits);
+}
+
+/**
+  * @brief	Posts a joystick position for Task_ParseBLEMessage, see BLE_JOY_FRAME_ID
+  * @param	pData: the frame, identifier excluded
+  * @note	Frames reordered or repeated by the client are dropped. A frame coming after the dead-man
+  *			period is always taken, so a client restarting its sequence is not locked out.
+  *			The mailbox only holds the newest position: one the task did not apply yet is overwritten.
+  */
+static void Server_PostJoystick(const uint8_t *pData)
+{
+	BLE_Joystick_t xJoystick;
+	TickType_t Now = xTaskGetTickCount();
+
+	xBleJoystickStats.Frames++;
+
+	if(((int8_t)(pData[0] - s_JoystickLastSequence) <= 0) &&
+	   ((Now - s_JoystickLastTick) < pdMS_TO_TICKS(BLE_JOY_DEADMAN_MS)))
+	{
+		xBleJoystickStats.Stale++;
+		return;
+	}
+
+	s_JoystickLastSequence = pData[0];
+	s_JoystickLastTick = Now;
+
+	xJoystick.Sequence = pData[0];
+	xJoystick.Throttle = (int8_t)pData[1];
+	xJoystick.Steer = (int8_t)pData[2];
+	xJoystick.RxCycles = DWT->CYCCNT;
+
+	if(uxQueueMessagesWaiting(h_QueueBLEJoystick) != 0)
+		xBleJoystickStats.Stale++;
+
+	xQueueOverwrite(h_QueueBLEJoystick, &xJoystick);
+	xTaskNotify(h_TaskBLEMsg, FRTOS_TASK_NOTIF_JOYSTICK, eSetBits);
+}
+
+/*******************************************************************************
+ * Function Name  : aci_att_exchange_mtu_resp_event.
+ * Description    : ATT_MTU agreed with the client, whichever side asked for it.
+ * Input          : See file bluenrg1_events.h
+ * Output         : See file bluenrg1_events.h
+ * Return         : See file bluenrg1_events.h
+ *******************************************************************************/
+void aci_att_exchange_mtu_resp_event(uint16_t Connection_Handle,
+                                     uint16_t Server_RX_MTU)
+{
+	Conn_Details.AttMtu = Server_RX_MTU;
+
+} /* end aci_att_exchange_mtu_resp_event() */
+
+/*******************************************************************************
+ * Function Name  : hci_le_data_length_change_event.
+ * Description    : Link layer PDU sizes in use on the connection.
+ * Input          : See file bluenrg1_events.h
+ * Output         : See file bluenrg1_events.h
+ * Return         : See file bluenrg1_events.h
+ *******************************************************************************/
+void hci_le_data_length_change_event(uint16_t Connection_Handle,
+                                     uint16_t MaxTxOctets,
+                                     uint16_t MaxTxTime,
+                                     uint16_t MaxRxOctets,
+                                     uint16_t MaxRxTime)
+{
+	Conn_Details.MaxTxOctets = MaxTxOctets;
+
+} /* end hci_le_data_length_change_event() */
+
+/*******************************************************************************
+ * Function Name  : aci_gatt_tx_pool_available_event.
+ * Description    : The BlueNRG-2 has TX buffers again after refusing a
+ *                  notification with BLE_STATUS_INSUFFICIENT_RESOURCES.
+ * Input          : See file bluenrg1_events.h
+ * Output         : See file bluenrg1_events.h
+ * Return         : See file bluenrg1_events.h
+ *******************************************************************************/
+void aci_gatt_tx_pool_available_event(uint16_t Connection_Handle,
+                                      uint16_t Available_Buffers)
+{
+	/* Resume the telemetry stream where it stalled */
+	xTaskNotifyGive(h_TaskTelemetry);
+
+} /* end aci_gatt_tx_pool_available_event() */
+
+/*******************************************************************************
+ * Function Name  : hci_le_connection_update_complete_event.
+ * Description    : The central applied new connection parameters.
+ * Input          : See file bluenrg1_events.h
+ * Output         : See file bluenrg1_events.h
+ * Return         : See file bluenrg1_events.h
+ *******************************************************************************/
+void hci_le_connection_update_complete_event(uint8_t Status,
+                                             uint16_t Connection_Handle,
+                                             uint16_t Conn_Interval,
+                                             uint16_t Conn_Latency,
+                                             uint16_t Supervision_Timeout)
+{
+	if(Status != BLE_STATUS_SUCCESS)
+		return;
+
+	Conn_Details.BLE_ConnInterval = Conn_Interval;
+	Conn_Details.BLE_ConnLatency = Conn_Latency;
+	Conn_Details.BLE_SupervisionTimeout = Supervision_Timeout;
+
+	xConnParamStats.UpdatesApplied++;
+
+} /* end hci_le_connection_update_complete_event() */
+
+/*******************************************************************************
+ * Function Name  : aci_l2cap_connection_update_resp_event.
+ * Description    : The central answered a connection parameter update request.
+ * Input          : See file bluenrg1_events.h
+ * Output         : See file bluenrg1_events.h
+ * Return         : See file bluenrg1_events.h
+ *******************************************************************************/
+void aci_l2cap_connection_update_resp_event(uint16_t Connection_Handle,
+                                            uint16_t Result)
+{
+	/* 0x0000: accepted, hci_le_connection_update_complete_event() follows once applied */
+	if(Result != 0x0000)
+	{
+		/* Ask again on the next profile change */
+		s_ConnProfileRequested = CONN_PROFILE_NONE;
+		xConnParamStats.UpdatesRejected++;
+	}
+
+} /* end aci_l2cap_connection_update_resp_event() */
+
+/*******************************************************************************
+ * Function Name  : aci_l2cap_proc_timeout_event.
+ * Description    : The central did not answer a connection parameter update
+ *                  request within 30 seconds.
+ * Input          : See file bluenrg1_events.h
+ * Output         : See file bluenrg1_events.h
+ * Return         : See file bluenrg1_events.h
+ *******************************************************************************/
+void aci_l2cap_proc_timeout_event(uint16_t Connection_Handle,
+                                  uint8_t Data_Length,
+                                  uint8_t Data[])
+{
+	s_ConnProfileRequested = CONN_PROFILE_NONE;
+	xConnParamStats.UpdatesRejected++;
+
+} /* end aci_l2cap_proc_timeout_event() */
+
+/********************** Connection parameter manager ****************************************************/
+
+/**
+  * @brief	Asks the central for the connection parameters of a profile
+  * @param	Profile: CONN_PROFILE_ACTIVE while the car is driven, CONN_PROFILE_IDLE once it stopped
+  * @note	To be called from task context while connected. Nothing is sent if the same profile was
+  *			already requested on this connection. The central has the final say, the parameters in
+  *			use are tracked by hci_le_connection_update_complete_event().
+  */
+void BlueNRG_RequestConnProfile(BLE_ConnProfile_t Profile)
+{
+	tBleStatus ret;
+
+	if((Conn_Details.ConnectionStatus != STATE_CONNECTED) || (Profile == s_ConnProfileRequested))
+		return;
+
+	if(Profile == CONN_PROFILE_ACTIVE)
+	{
+		ret = aci_l2cap_connection_parameter_update_req(Conn_Details.connectionhandle,
+														BLE_CONN_ACTIVE_INTERV_MIN, BLE_CONN_ACTIVE_INTERV_MAX,
+														BLE_CONN_ACTIVE_LATENCY, BLE_CONN_SUPERV_TIMEOUT);
+	}
+	else
+	{
+		ret = aci_l2cap_connection_parameter_update_req(Conn_Details.connectionhandle,
+														BLE_CONN_IDLE_INTERV_MIN, BLE_CONN_IDLE_INTERV_MAX,
+														BLE_CONN_IDLE_LATENCY, BLE_CONN_SUPERV_TIMEOUT);
+	}
+
+	if(ret == BLE_STATUS_SUCCESS)
+	{
+		s_ConnProfileRequested = Profile;
+		xConnParamStats.UpdateRequests++;
+	}
+	else
+	{
+		PRINT_DBG("aci_l2cap_connection_parameter_update_req() failed: 0x%02x\r\n", ret);
+	}
+}
+
+/**
+  * @brief	Closes the latency measurement of the last command written by the client
+  * @note	To be called once the command reached the motor outputs. The latency is accounted to the
+  *			profile matching the connection interval in use when the command came in.
+  */
+void BlueNRG_RecordActuation(void)
+{
+	ConnLatencyStats_t *pStats;
+	uint32_t Latency_us;
+
+	if(!s_CommandPending)
+		return;
+
+	s_CommandPending = 0;
+	Latency_us = (DWT->CYCCNT - s_CommandRxCycles) / (SystemCoreClock / 1000000);
+
+	pStats = &xConnParamStats.Profile[(Conn_Details.BLE_ConnInterval <= BLE_CONN_ACTIVE_INTERV_MAX) ?
+									  CONN_PROFILE_ACTIVE : CONN_PROFILE_IDLE];
+
+	pStats->Commands++;
+	pStats->LastLatency_us = Latency_us;
+	pStats->TotalLatency_us += Latency_us;
+	if(Latency_us > pStats->MaxLatency_us)
+		pStats->MaxLatency_us = Latency_us;
+
+	/* Interval is N x 1.25ms */
+	pStats->AirLatencyBound_us = ((uint32_t)Conn_Details.BLE_ConnLatency + 1) * Conn_Details.BLE_ConnInterval * 1250;
+}
+
+/**
+  * @brief	Closes the latency measurement of a joystick position
+  * @param	pJoystick: the position, right after it reached the PWM compare registers
+  */
+void BlueNRG_RecordJoystickActuation(const BLE_Joystick_t *pJoystick)
+{
+	uint32_t Latency_us = (DWT->CYCCNT - pJoystick->RxCycles) / (SystemCoreClock / 1000000);
+
+	xBleJoystickStats.Applied++;
+	xBleJoystickStats.LastLatency_us = Latency_us;
+	xBleJoystickStats.TotalLatency_us += Latency_us;
+	if(Latency_us > xBleJoystickStats.MaxLatency_us)
+		xBleJoystickStats.MaxLatency_us = Latency_us;
+}
+
+/********************** Long characteristic values *******************************************************/
+
+/**
+  * @brief	Writes a characteristic value longer than one HCI command in chunks
+  * @param	hChar: characteristic handle
+  *			UpdateType: BLE_UPDATE_x applied once the whole value is written
+  * @retval	Status of the first chunk that failed, BLE_STATUS_SUCCESS otherwise
+  * @note	Only the last chunk requests the notification
+  */
+static tBleStatus Server_UpdateLongValue(uint16_t hChar, uint8_t UpdateType, uint8_t *pData, uint16_t Length)
+{
+	tBleStatus ret = BLE_STATUS_SUCCESS;
+	uint16_t Offset = 0;
+
+	do
+	{
+		uint16_t Chunk = Length - Offset;
+		uint8_t ChunkUpdateType = UpdateType;
+
+		if(Chunk > BLE_UPDATE_EXT_CHUNK_MAX)
+		{
+			Chunk = BLE_UPDATE_EXT_CHUNK_MAX;
+			ChunkUpdateType = BLE_UPDATE_LOCAL;
+		}
+
+		ret = aci_gatt_update_char_value_ext(Conn_Details.connectionhandle, hService, hChar,
+											 ChunkUpdateType, Length, Offset, (uint8_t)Chunk, &pData[Offset]);
+		Offset += Chunk;
+
+	} while((ret == BLE_STATUS_SUCCESS) && (Offset < Length));
+
+	return ret;
+}
+
+/********************** Telemetry stream *****************************************************************/
+
+/**
+  * @brief	Tells whether a client is connected and listens to the telemetry stream
+  */
+uint8_t BlueNRG_TelemetrySubscribed(void)
+{
+	return (Conn_Details.ConnectionStatus == STATE_CONNECTED) && s_TelemetrySubscribed;
+}
+
+/**
+  * @brief	Largest telemetry batch that fits in one notification on the current connection
+  */
+uint16_t BlueNRG_TelemetryPayloadMax(void)
+{
+	uint16_t Length = Conn_Details.AttMtu - 3;
+
+	return (Length > TELEMETRY_PAYLOAD_MAX) ? TELEMETRY_PAYLOAD_MAX : Length;
+}
+
+/**
+  * @brief	Notifies one telemetry batch to the client
+  * @param	pData: batch built by Telemetry_BuildBatch()
+  *			Length: up to BlueNRG_TelemetryPayloadMax() bytes
+  * @retval	BLE_STATUS_INSUFFICIENT_RESOURCES if the BlueNRG-2 TX buffers are full, in which case the
+  *			same batch must be sent again after aci_gatt_tx_pool_available_event()
+  * @note	A value longer than one HCI command is written in chunks, the notification is only
+  *			requested with the last one
+  */
+tBleStatus BlueNRG_NotifyTelemetry(uint8_t *pData, uint16_t Length)
+{
+	return Server_UpdateLongValue(hClientNotify_Telemetry, BLE_UPDATE_NOTIFICATION, pData, Length);
+}
+
+/********************** CPU load and health reports ******************************************************/
+
+/**
+  * @brief	Updates a read/notify report characteristic
+  * @retval	BLE_STATUS_INSUFFICIENT_RESOURCES if the BlueNRG-2 TX buffers are full, in which case the
+  *			same report must be sent again after aci_gatt_tx_pool_available_event()
+  * @note	The report is notified to a subscribed client, otherwise only the stored value is updated
+  *			so that the client can read it at any time
+  */
+static tBleStatus Server_PublishReport(uint16_t hChar, uint8_t Subscribed, uint8_t *pData, uint16_t Length)
+{
+	uint8_t UpdateType = BLE_UPDATE_LOCAL;
+
+	if((Conn_Details.ConnectionStatus == STATE_CONNECTED) && Subscribed)
+		UpdateType = BLE_UPDATE_NOTIFICATION;
+
+	return Server_UpdateLongValue(hChar, UpdateType, pData, Length);
+}
+
+/**
+  * @brief	Updates the CPU load characteristic with the report of the last window
+  * @param	pData: report built by CpuLoad_BuildReport()
+  *			Length: up to CPULOAD_REPORT_MAX bytes
+  * @retval	See Server_PublishReport()
+  */
+tBleStatus BlueNRG_PublishCpuLoad(uint8_t *pData, uint16_t Length)
+{
+	return Server_PublishReport(hClientNotify_CpuLoad, s_CpuLoadSubscribed, pData, Length);
+}
+
+/**
+  * @brief	Updates the health characteristic with the report of the last sample
+  * @param	pData: report built by Health_BuildReport()
+  *			Length: up to HEALTH_REPORT_MAX bytes
+  * @retval	See Server_PublishReport()
+  */
+tBleStatus BlueNRG_PublishHealth(uint8_t *pData, uint16_t Length)
+{
+	return Server_PublishReport(hClientNotify_Health, s_HealthSubscribed, pData, Length);
+}
+
+/**
+  * @brief	Updates the velocity characteristic, read by the client
+  * @param	Velocity_cm_s: velocity estimate of the calculations task
+  * @retval	BLE_STATUS_INSUFFICIENT_RESOURCES if the BlueNRG-2 TX buffers are full, in which case the
+  *			same value must be sent again after aci_gatt_tx_pool_available_event()
+  */
+tBleStatus BlueNRG_PublishVelocity(int32_t Velocity_cm_s)
+{
+	uint8_t Value[BLE_VELOCITY_SIZE];
+
+	Value[0] = (uint8_t)Velocity_cm_s;
+	Value[1] = (uint8_t)((uint32_t)Velocity_cm_s >> 8);
+	Value[2] = (uint8_t)((uint32_t)Velocity_cm_s >> 16);
+	Value[3] = (uint8_t)((uint32_t)Velocity_cm_s >> 24);
+
+	return aci_gatt_update_char_value(hService, hClientRead_Velocity, 0, BLE_VELOCITY_SIZE, Value);
+}
+
+/********************** Hazard warnings ******************************************************************/
+
+/**
+  * @brief	Adds one hazard to the events pending on a warning characteristic
+  * @note	Called from a critical section
+  */
+static void Server_RecordHazard(BLE_HazardRecord_t *pRecord, uint8_t Flags, int16_t Velocity_cm_s)
+{
+	pRecord->Flags |= Flags;
+	pRecord->Velocity_cm_s = Velocity_cm_s;
+
+	if(pRecord->Count < UINT8_MAX)
+		pRecord->Count++;
+}
+
+/**
+  * @brief	Reports a hazard the car just braked on, notified to the client by the telemetry task
+  * @param	Flags: BLE_HAZARD_x, crash flags go to WRN_CRASH and BLE_HAZARD_OVERSPEED to WRN_SPEED
+  *			Velocity_cm_s: velocity estimate when the hazard was detected
+  * @note	Hazards posted before the previous ones were notified are merged into one notification
+  */
+void BlueNRG_PostHazard(uint8_t Flags, int16_t Velocity_cm_s)
+{
+	taskENTER_CRITICAL();
+
+	if(Flags & BLE_HAZARD_CRASH_MASK)
+		Server_RecordHazard(&s_HazardCrash, Flags & BLE_HAZARD_CRASH_MASK, Velocity_cm_s);
+
+	if(Flags & BLE_HAZARD_OVERSPEED)
+		Server_RecordHazard(&s_HazardOverSpeed, BLE_HAZARD_OVERSPEED, Velocity_cm_s);
+
+	taskEXIT_CRITICAL();
+
+	xBleHazardStats.Posted++;
+	xTaskNotifyGive(h_TaskTelemetry);
+}
+
+/**
+  * @brief	Notifies the hazards pending on one warning characteristic
+  * @retval	BLE_STATUS_INSUFFICIENT_RESOURCES if the BlueNRG-2 TX buffers are full, the hazards stay
+  *			pending in that case
+  */
+static tBleStatus Server_NotifyHazard(uint16_t hCharacteristic, BLE_HazardRecord_t *pPending)
+{
+	BLE_HazardRecord_t xRecord;
+	uint8_t Value[MAX_DATA_EXCHANGE_BYTES];
+	tBleStatus ret = BLE_STATUS_SUCCESS;
+
+	taskENTER_CRITICAL();
+	xRecord = *pPending;
+	taskEXIT_CRITICAL();
+
+	if(xRecord.Count == 0)
+		return BLE_STATUS_SUCCESS;
+
+	if(Conn_Details.ConnectionStatus != STATE_CONNECTED)
+	{
+		xBleHazardStats.NotConnected += xRecord.Count;
+	}
+	else
+	{
+		Value[0] = xRecord.Flags;
+		Value[1] = xRecord.Count;
+		Value[2] = (uint8_t)xRecord.Velocity_cm_s;
+		Value[3] = (uint8_t)((uint16_t)xRecord.Velocity_cm_s >> 8);
+
+		ret = aci_gatt_update_char_value(hService, hCharacteristic, 0, MAX_DATA_EXCHANGE_BYTES, Value);
+
+		if(ret == BLE_STATUS_INSUFFICIENT_RESOURCES)
+		{
+			xBleHazardStats.TxPoolFull++;
+			return ret;
+		}
+
+		if(ret == BLE_STATUS_SUCCESS)
+			xBleHazardStats.Notified++;
+		else
+			xBleHazardStats.TxErrors++;
+	}
+
+	/* Keep the hazards posted while this one was sent */
+	taskENTER_CRITICAL();
+	pPending->Count -= xRecord.Count;
+	if(pPending->Count == 0)
+		pPending->Flags = 0;
+	taskEXIT_CRITICAL();
+
+	return ret;
+}
+
+/**
+  * @brief	Notifies the pending hazards on WRN_CRASH and WRN_SPEED
+  * @retval	BLE_STATUS_INSUFFICIENT_RESOURCES if the BlueNRG-2 TX buffers are full, in which case this
+  *			function must be called again after aci_gatt_tx_pool_available_event()
+  * @note	Called by the telemetry task only, before it sends any telemetry batch
+  */
+tBleStatus BlueNRG_NotifyHazards(void)
+{
+	tBleStatus ret = Server_NotifyHazard(hClientNotify_Crash, &s_HazardCrash);
+
+	if(ret != BLE_STATUS_INSUFFICIENT_RESOURCES)
+		ret = Server_NotifyHazard(hClientNotify_OverSpeed, &s_HazardOverSpeed);
+
+	return ret;
+}
+
 /********************** User Application related functions/events/processes *****************************/
 /********************** Not used in FreeRTOS application ************************************************/
 
@@ -0,0 +1,206 @@
+/**
+  **************************************************************************************************
+  * @file           : car_app_cpuload.c
+  * @brief          : This file contains the CPU load sampler. The FreeRTOS run time counters (TIM5,
+  *  				  see getRunTimeCounterValue()) are taken from the health monitor snapshot once
+  *  				  per window and turned into the share of the window each task ran for. The time
+  *  				  spent in the application interrupts is measured by TRACE_ISR_ENTER/EXIT().
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <string.h>
+#include "main.h"
+#include "car_app_cpuload.h"
+#include "car_app_trace.h"
+#include "tim.h"
+
+
+/* Exported/Global variables ---------------------------------------------------------------------*/
+CpuLoadStats xCpuLoadStats = {0};
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+static CpuLoadTask s_Tasks[CPULOAD_MAX_TASKS];
+static uint8_t s_TaskCount = 0;
+static uint32_t s_PrevRunTime = 0;					/* Run time counter at the previous sample */
+static uint32_t s_PrevIsrTime = 0;					/* Trace_IsrTime() at the previous sample */
+static uint8_t s_Sequence = 0;
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+static inline uint16_t Permille(uint32_t Part, uint32_t Total)
+{
+	uint32_t Value = (uint32_t)(((uint64_t)Part * 1000) / Total);
+
+	return (Value > 1000) ? 1000 : (uint16_t)Value;
+}
+
+static inline uint8_t *Put16(uint8_t *pOut, uint16_t Value)
+{
+	pOut[0] = (uint8_t)Value;
+	pOut[1] = (uint8_t)(Value >> 8);
+
+	return pOut + 2;
+}
+
+
+/**
+ * @brief	Closes the current window and computes the load of every task over it
+ * @param	pTasks, Count: snapshot from uxTaskGetSystemState()
+ * 			RunTime: total run time returned along with the snapshot
+ * @note	Called by the health monitor only, every CPULOAD_WINDOW_MS or so (the window length is
+ * 			measured). The kernel charges the time of an interrupt to the task it preempted, the
+ * 			interrupt time is reported on its own as well. Tasks deleted since the previous sample
+ * 			are dropped from the table.
+ */
+void CpuLoad_Update(const TaskStatus_t *pTasks, UBaseType_t Count, uint32_t RunTime)
+{
+	uint32_t CycleStart = DWT->CYCCNT;
+	uint32_t IsrTime = Trace_IsrTime();
+	uint32_t Elapsed;
+	uint16_t IdleLoad = 0;
+	uint8_t idx, Slot;
+
+	Elapsed = RunTime - s_PrevRunTime;
+
+	if(Elapsed == 0)
+		return;
+
+	for(idx = 0; idx < s_TaskCount; idx++)
+		s_Tasks[idx].Seen = 0;
+
+	for(UBaseType_t n = 0; n < Count; n++)
+	{
+		const TaskStatus_t *pStatus = &pTasks[n];
+		CpuLoadTask *pTask = NULL;
+
+		for(idx = 0; idx < s_TaskCount; idx++)
+		{
+			if(s_Tasks[idx].TaskNumber == pStatus->xTaskNumber)
+			{
+				pTask = &s_Tasks[idx];
+				break;
+			}
+		}
+
+		if((pTask == NULL) && (s_TaskCount >= CPULOAD_MAX_TASKS))
+		{
+			/* Deleted tasks still hold their entries until the end of this sample */
+			xCpuLoadStats.TableFull++;
+			continue;
+		}
+
+		if(pTask == NULL)
+		{
+			/* New task, it ran for its whole counter within this window */
+			pTask = &s_Tasks[s_TaskCount++];
+			pTask->TaskNumber = pStatus->xTaskNumber;
+			pTask->PrevRunTime = 0;
+			pTask->Peak_permille = 0;
+			CpuLoad_ShortName(pTask->Name, pStatus->pcTaskName);
+		}
+
+		pTask->Load_permille = Permille(pStatus->ulRunTimeCounter - pTask->PrevRunTime, Elapsed);
+		pTask->PrevRunTime = pStatus->ulRunTimeCounter;
+		pTask->Priority = (uint8_t)pStatus->uxCurrentPriority;
+		pTask->Seen = 1;
+
+		if(pTask->Load_permille > pTask->Peak_permille)
+			pTask->Peak_permille = pTask->Load_permille;
+
+		/* No application task runs at the idle priority */
+		if(pStatus->uxBasePriority == tskIDLE_PRIORITY)
+			IdleLoad = pTask->Load_permille;
+	}
+
+	/* Drop the tasks that were deleted */
+	for(idx = 0, Slot = 0; idx < s_TaskCount; idx++)
+	{
+		if(s_Tasks[idx].Seen)
+			s_Tasks[Slot++] = s_Tasks[idx];
+	}
+
+	s_TaskCount = Slot;
+	s_PrevRunTime = RunTime;
+
+	xCpuLoadStats.Windows++;
+	xCpuLoadStats.LastWindow_us = Elapsed * TIMEBASE_US_PER_COUNT;
+	xCpuLoadStats.Busy_permille = 1000 - IdleLoad;
+	xCpuLoadStats.Isr_permille = Permille(IsrTime - s_PrevIsrTime, Elapsed);
+	s_PrevIsrTime = IsrTime;
+
+	if(xCpuLoadStats.Busy_permille > xCpuLoadStats.PeakBusy_permille)
+		xCpuLoadStats.PeakBusy_permille = xCpuLoadStats.Busy_permille;
+
+	if(xCpuLoadStats.Isr_permille > xCpuLoadStats.PeakIsr_permille)
+		xCpuLoadStats.PeakIsr_permille = xCpuLoadStats.Isr_permille;
+
+	xCpuLoadStats.LastCycles = DWT->CYCCNT - CycleStart;
+}
+
+
+/**
+ * @brief	Packs the loads of the last window, see car_app_cpuload.h for the layout
+ * @param	pBuffer: destination, at least MaxLength bytes
+ * 			MaxLength: room in pBuffer, records that do not fit are left out
+ * @retval	Length of the report, 0 before the first window
+ */
+uint16_t CpuLoad_BuildReport(uint8_t *pBuffer, uint16_t MaxLength)
+{
+	uint8_t *pOut = pBuffer + CPULOAD_HEADER_SIZE;
+	uint8_t Count = 0;
+
+	if((xCpuLoadStats.Windows == 0) || (MaxLength < CPULOAD_HEADER_SIZE))
+		return 0;
+
+	while((Count < s_TaskCount) && ((pOut - pBuffer) + CPULOAD_RECORD_SIZE <= MaxLength))
+	{
+		const CpuLoadTask *pTask = &s_Tasks[Count];
+
+		*pOut++ = (uint8_t)pTask->TaskNumber;
+		*pOut++ = pTask->Priority;
+		pOut = Put16(pOut, pTask->Load_permille);
+		pOut = Put16(pOut, pTask->Peak_permille);
+		memcpy(pOut, pTask->Name, CPULOAD_NAME_CHARS);
+		pOut += CPULOAD_NAME_CHARS;
+		Count++;
+	}
+
+	pBuffer[0] = s_Sequence++;
+	pBuffer[1] = Count;
+	Put16(&pBuffer[2], (uint16_t)(xCpuLoadStats.LastWindow_us / 1000));
+	Put16(&pBuffer[4], xCpuLoadStats.Busy_permille);
+	Put16(&pBuffer[6], xCpuLoadStats.PeakBusy_permille);
+	Put16(&pBuffer[8], xCpuLoadStats.Isr_permille);
+	Put16(&pBuffer[10], xCpuLoadStats.PeakIsr_permille);
+
+	return (uint16_t)(pOut - pBuffer);
+}
+
+
+/**
+ * @brief	Short name of a task for the CPU load and health records
+ * @param	pOut: CPULOAD_NAME_CHARS characters, padded with '\0'
+ * 			pName: task name, the "TaskN - " prefix of the application tasks is left out
+ */
+void CpuLoad_ShortName(char *pOut, const char *pName)
+{
+	const char *pSeparator = strstr(pName, " - ");
+	uint8_t idx;
+
+	if(pSeparator != NULL)
+		pName = pSeparator + 3;
+
+	for(idx = 0; (idx < CPULOAD_NAME_CHARS) && (pName[idx] != '\0'); idx++)
+		pOut[idx] = pName[idx];
+
+	for(; idx < CPULOAD_NAME_CHARS; idx++)
+		pOut[idx] = '\0';
+}
+
+
+/******************************************* END OF FILE *******************************************/
@@ -11,12 +11,13 @@
 
 
 /* Includes --------------------------------------------------------------------------------------*/
-#include <math.h>
 #include "stm32f4xx_it.h"			/* Including only for FreeRTOS Task Notification Bitmask */
 #include "car_app_freertos.h"
 #include "FreeRTOS.h"
 #include "task.h"
 #include "timers.h"
+#include "semphr.h"
+#include "queue.h"
 #include "hci.h"
 #include "hci_tl.h"
 
@@ -25,19 +26,85 @@
 #include "car_app_ble.h"
 #include "motordriver.h"
 #include "adxl343.h"
+#include "car_app_motion.h"
+#include "car_app_speed.h"
+#include "car_app_telemetry.h"
+#include "car_app_cpuload.h"
+#include "car_app_health.h"
+#include "car_app_trace.h"
+#include "tim.h"
 
 
 /* Private typedef -------------------------------------------------------------------------------*/
+/* One entry of the task table, see FRTOS_Init_Tasks() */
+typedef struct
+{
+	TaskFunction_t Routine;
+	const char *pName;
+	uint32_t StackDepth;						/* In words */
+	UBaseType_t Priority;
+	TaskHandle_t *pHandle;
+#if (FRTOS_STATIC_ALLOCATION == 1)
+	StackType_t *pStack;						/* StackDepth words */
+	StaticTask_t *pTCB;
+#endif
+
+} FRTOS_TaskDef_t;
 
 
 /* Private define --------------------------------------------------------------------------------*/
-/* By default, accelerometer will be polled every 25ms. I2C readings is expected to last 860us. */
-#if !defined(ACCELEROMETER_INTERRUPTS) && !defined(ACCELEROMETER_PERIODIC_MEASUREMENTS)
-	#define ACCELEROMETER_PERIODIC_MEASUREMENTS
+/* By default, accelerometer samples are collected in its FIFO and drained on the INT1 watermark interrupt.
+ * Define ACCELEROMETER_PERIODIC_MEASUREMENTS to poll the accelerometer every 25ms instead.
+ */
+#if !defined(ACCELEROMETER_FIFO_STREAM) && !defined(ACCELEROMETER_PERIODIC_MEASUREMENTS)
+	#define ACCELEROMETER_FIFO_STREAM
 #endif
 
 
+/* Kernel objects created by the FRTOS_Init_x() functions */
+#define FRTOS_TASK_COUNT						7
+#define FRTOS_TIMER_COUNT						3
+#define FRTOS_TASK_STACKS_WORDS					(TASK_STACK_BLE_CONN + TASK_STACK_BLE_MSG + TASK_STACK_PB + \
+												 TASK_STACK_MCULED + TASK_STACK_BLE_EVENTS + \
+												 TASK_STACK_CALCULATIONS + TASK_STACK_TELEMETRY)
+#define FRTOS_QUEUE_CMD_STORAGE					(BLE_CMD_QUEUE_LENGTH * sizeof(BLE_Command_t))
+#define FRTOS_QUEUE_JOYSTICK_STORAGE			(1 * sizeof(BLE_Joystick_t))
+
+
 /* Private macro ---------------------------------------------------------------------------------*/
+/* Value of a macro as a string, for #pragma message */
+#define FRTOS_STR_(x)							#x
+#define FRTOS_STR(x)							FRTOS_STR_(x)
+
+/* heap_4 allocation: 8-byte block header, rounded up to portBYTE_ALIGNMENT */
+#define FRTOS_HEAP_BLOCK(Size)					((((Size) + 8) + portBYTE_ALIGNMENT_MASK) & ~((uint32_t)portBYTE_ALIGNMENT_MASK))
+
+/* Objects of the static layout, all in .bss */
+#define FRTOS_RAM_STATIC_BYTES					((FRTOS_TASK_STACKS_WORDS * sizeof(StackType_t)) + \
+												 (FRTOS_TASK_COUNT * sizeof(StaticTask_t)) + \
+												 (FRTOS_TIMER_COUNT * sizeof(StaticTimer_t)) + \
+												 ((2 + HCI_CMD_WAIT_FLAG_NUM) * sizeof(StaticQueue_t)) + \
+												 FRTOS_QUEUE_CMD_STORAGE + FRTOS_QUEUE_JOYSTICK_STORAGE)
+
+/* Same objects from heap_4: one block per stack and per TCB, one per timer and one per queue
+   (control block and storage together). Stacks are whole multiples of the alignment */
+#define FRTOS_RAM_HEAP_BYTES					((FRTOS_TASK_STACKS_WORDS * sizeof(StackType_t)) + \
+												 (FRTOS_TASK_COUNT * FRTOS_HEAP_BLOCK(0)) + \
+												 (FRTOS_TASK_COUNT * FRTOS_HEAP_BLOCK(sizeof(StaticTask_t))) + \
+												 (FRTOS_TIMER_COUNT * FRTOS_HEAP_BLOCK(sizeof(StaticTimer_t))) + \
+												 (HCI_CMD_WAIT_FLAG_NUM * FRTOS_HEAP_BLOCK(sizeof(StaticQueue_t))) + \
+												 FRTOS_HEAP_BLOCK(sizeof(StaticQueue_t) + FRTOS_QUEUE_CMD_STORAGE) + \
+												 FRTOS_HEAP_BLOCK(sizeof(StaticQueue_t) + FRTOS_QUEUE_JOYSTICK_STORAGE))
+
+#if (FRTOS_STATIC_ALLOCATION == 1)
+	/* Stack and TCB of one task, named after its TASK_STACK_x and TASK_PRIO_x */
+	#define FRTOS_TASK_MEMORY(ID)				static StackType_t s_TaskStack_##ID[TASK_STACK_##ID]; \
+												static StaticTask_t s_TaskTCB_##ID
+	#define FRTOS_TASK(Routine, Name, ID, pHandle)	{ Routine, Name, TASK_STACK_##ID, TASK_PRIO_##ID, pHandle, \
+													  s_TaskStack_##ID, &s_TaskTCB_##ID }
+#else
+	#define FRTOS_TASK(Routine, Name, ID, pHandle)	{ Routine, Name, TASK_STACK_##ID, TASK_PRIO_##ID, pHandle }
+#endif
 
 
 /* Exported/Global variables ---------------------------------------------------------------------*/
@@ -50,17 +117,36 @@
 	__IO uint32_t g_CarTotalDistanceCovered = 0;	/* Total distance covered after power cycles, also
 													   saved in Flash Memory */
 
-	/*--- Variables to record remaining stack size of each tasks ---*/
-	UBaseType_t g_Task0_RSS, g_Task1_RSS, g_Task2_RSS, g_Task3_RSS, g_Task4_RSS, g_Task5_RSS;
+	/*--- RAM budget of the kernel objects, printed after the link by Tools/ram_budget.py ---*/
+	const FRTOS_RamBudget_t xFrtosRamBudget = { FRTOS_RAM_STATIC_BYTES, FRTOS_RAM_HEAP_BYTES, configTOTAL_HEAP_SIZE };
+
+	/* Fail the build rather than the boot when the tasks outgrow the RAM of their layout */
+#if (FRTOS_STATIC_ALLOCATION == 1)
+	#pragma message("FreeRTOS static layout, kernel objects in .bss, configTOTAL_HEAP_SIZE " FRTOS_STR(configTOTAL_HEAP_SIZE))
+	_Static_assert(FRTOS_RAM_STATIC_BYTES + configTOTAL_HEAP_SIZE <= FRTOS_RAM_KERNEL_BUDGET,
+				   "Kernel objects and the heap left do not fit in FRTOS_RAM_KERNEL_BUDGET");
+#else
+	#pragma message("FreeRTOS heap layout, kernel objects from heap_4, configTOTAL_HEAP_SIZE " FRTOS_STR(configTOTAL_HEAP_SIZE))
+	_Static_assert(FRTOS_RAM_HEAP_BYTES <= configTOTAL_HEAP_SIZE, "Kernel objects do not fit in configTOTAL_HEAP_SIZE");
+	_Static_assert(configTOTAL_HEAP_SIZE <= FRTOS_RAM_KERNEL_BUDGET, "configTOTAL_HEAP_SIZE exceeds FRTOS_RAM_KERNEL_BUDGET");
+#endif
 
 
 /* External variables ----------------------------------------------------------------------------*/
 
 
 /* Private variables -----------------------------------------------------------------------------*/
+	/*--- FreeRTOS Semaphore Handles ---*/
+	static SemaphoreHandle_t sh_SemHciCmd[HCI_CMD_WAIT_FLAG_NUM];	/* One per HCI command slot, plus slot/bus free */
+
+	/*--- FreeRTOS Queue Handles ---*/
+	QueueHandle_t h_QueueBLECmd;
+	QueueHandle_t h_QueueBLEJoystick;
+
 	/*--- FreeRTOS Timer Handles ---*/
-	TimerHandle_t h_TimMotorTimeout;
 	TimerHandle_t h_TimUpdateLED;
+	static TimerHandle_t sh_TimSpeedControl;
+	static TimerHandle_t sh_TimConnIdle;
 
 	/*--- FreeRTOS Task Handles ---*/
 	TaskHandle_t h_TaskBLEConn;
@@ -69,17 +155,42 @@
 	static TaskHandle_t sh_TaskMcuLED;
 	static TaskHandle_t sh_TaskBLEEvents;
 	TaskHandle_t h_TaskCarCalculations;
+	TaskHandle_t h_TaskTelemetry;
 	//static TaskHandle_t sh_TaskI2CEvents;
 
+#if (FRTOS_STATIC_ALLOCATION == 1)
+	/*--- Statically allocated kernel objects ---*/
+	static StaticSemaphore_t s_SemHciCmdBuffer[HCI_CMD_WAIT_FLAG_NUM];
+	static StaticTimer_t s_TimUpdateLEDBuffer;
+	static StaticTimer_t s_TimSpeedControlBuffer;
+	static StaticTimer_t s_TimConnIdleBuffer;
+	static StaticQueue_t s_QueueBLECmdBuffer;
+	static StaticQueue_t s_QueueBLEJoystickBuffer;
+	static uint8_t s_QueueBLECmdStorage[FRTOS_QUEUE_CMD_STORAGE];
+	static uint8_t s_QueueBLEJoystickStorage[FRTOS_QUEUE_JOYSTICK_STORAGE];
+
+	FRTOS_TASK_MEMORY(BLE_CONN);
+	FRTOS_TASK_MEMORY(BLE_MSG);
+	FRTOS_TASK_MEMORY(PB);
+	FRTOS_TASK_MEMORY(MCULED);
+	FRTOS_TASK_MEMORY(BLE_EVENTS);
+	FRTOS_TASK_MEMORY(CALCULATIONS);
+	FRTOS_TASK_MEMORY(TELEMETRY);
+#endif
+
 	/*--- Private variables related to Task Car Calculations/Measurements ---*/
-	static __IO float s_CarLocalDistanceCovered = 0;		/* units in cm */
+	static MotionState s_CarMotion;							/* Q16.16 dead reckoning state */
+	static __IO int32_t s_CarLocalDistanceCovered = 0;		/* units in cm */
 	static __IO int32_t s_CarVelocityResultant = 0;			/* units in cm/s, always positive */
 	static __IO int32_t s_CarVelocityX = 0;					/* units in cm/s */
 	static __IO int32_t s_CarVelocityY = 0;					/* units in cm/s */
 	static __IO int32_t s_CarVelocityZ = 0;					/* units in cm/s */
-	static float s_CarAccelerationX = 0;					/* units in cm/(s^2) */
-	static float s_CarAccelerationY = 0;					/* units in cm/(s^2) */
-	static float s_CarAccelerationZ = 0;					/* units in cm/(s^2) */
+	static uint32_t s_CarLastDriven_us = 0;					/* Timestamp of the last sample with a wheel driven */
+	static uint8_t s_CarDriven = 0;							/* Set once a wheel was driven */
+	static uint8_t s_CarOverSpeed = 0;						/* Set while above the over speed warning */
+
+	/*--- Private variables related to the speed loop ---*/
+	static __IO uint8_t s_SpeedLoopParked = 0;				/* Set while the speed loop timer is stopped */
 
 
 /* Private function prototypes -------------------------------------------------------------------*/
@@ -90,11 +201,24 @@
 	static void Task_BlinkLEDIndicator(void *argument);
 	static void Task_ManageBLEEvents(void *argument);
 	static void Task_CarMovementCalculations(void *argument);
+	static void Task_StreamTelemetry(void *argument);
 	static void Task_ManageI2CEvents(void *argument);
 
+	/* Car actuation */
+	static void Car_ExecuteCommand(const BLE_Command_t *pCommand);
+	static void Car_DriveVector(const BLE_Joystick_t *pJoystick);
+	static void Car_WakeSpeedLoop(void);
+
+	/* Car movement calculations */
+	static void Car_ReportHazard(uint8_t Flags);
+	static uint8_t Car_IsStationary(uint32_t Timestamp_us);
+	static void Car_IntegrateAcceleration(uint16_t RawX, uint16_t RawY, uint16_t RawZ, uint32_t Timestamp_us,
+										  uint32_t TimeDiff_us);
+
 	/* FreeRTOS Timer Callback */
-	static void vTimMotorTimeoutCallback(TimerHandle_t xTimer);
 	static void vTimUpdateOledScreenCallback(TimerHandle_t xTimer);
+	static void vTimSpeedControlCallback(TimerHandle_t xTimer);
+	static void vTimConnIdleCallback(TimerHandle_t xTimer);
 
 
 /* Private user code -----------------------------------------------------------------------------*/
@@ -120,9 +244,23 @@ void FRTOS_Init_Mutex(void)
  */
 void FRTOS_Init_Semaphores(void)
 {
+	uint8_t i;
 
+	/* Binary semaphores signalled by the HCI transport layer, see hci_cmd_resp_wait() */
+	for(i = 0; i < HCI_CMD_WAIT_FLAG_NUM; i++)
+	{
+#if (FRTOS_STATIC_ALLOCATION == 1)
+		sh_SemHciCmd[i] = xSemaphoreCreateBinaryStatic(&s_SemHciCmdBuffer[i]);
+#else
+		sh_SemHciCmd[i] = xSemaphoreCreateBinary();
+#endif
 
+		/* Ensure semaphore creation succeeds */
+		assert_param(sh_SemHciCmd[i] != NULL);
+	}
 
+	/* Mutex owning the ADXL343 I2C1 bus */
+	__io_accelerometer_i2cEngineInit();
 }
 
 /**
@@ -130,16 +268,31 @@ void FRTOS_Init_Semaphores(void)
  */
 void FRTOS_Init_SWTimers(void)
 {
-	/* Create a timer that does not reload itself and triggers after 1 second */
-	h_TimMotorTimeout = xTimerCreate("TIM_MotorTimeout",
-										1000/portTICK_PERIOD_MS,
+#if (FRTOS_STATIC_ALLOCATION == 1)
+	/* Create a timer that auto-reloads itself every 300ms */
+	h_TimUpdateLED = xTimerCreateStatic("TIM_UpdateOLEDScreen",
+										300/portTICK_PERIOD_MS,
+										pdTRUE,
+										(void *)0,
+										vTimUpdateOledScreenCallback,
+										&s_TimUpdateLEDBuffer);
+
+	/* Create a timer that auto-reloads itself at the wheel speed loop rate */
+	sh_TimSpeedControl = xTimerCreateStatic("TIM_SpeedControl",
+											pdMS_TO_TICKS(1000 / SPEED_CONTROL_LOOP_HZ),
+											pdTRUE,
+											(void *)0,
+											vTimSpeedControlCallback,
+											&s_TimSpeedControlBuffer);
+
+	/* Create a timer that does not reload itself, restarted by every BLE command */
+	sh_TimConnIdle = xTimerCreateStatic("TIM_ConnIdle",
+										pdMS_TO_TICKS(BLE_CONN_IDLE_AFTER_MS),
 										pdFALSE,
 										(void *)0,
-										vTimMotorTimeoutCallback);
-
-	/* Ensure SW Timer creation succeeds */
-	assert_param(h_TimMotorTimeout != NULL);
-
+										vTimConnIdleCallback,
+										&s_TimConnIdleBuffer);
+#else
 	/* Create a timer that auto-reloads itself every 300ms */
 	h_TimUpdateLED = xTimerCreate("TIM_UpdateOLEDScreen",
 									300/portTICK_PERIOD_MS,
@@ -147,8 +300,25 @@ void FRTOS_Init_SWTimers(void)
 									(void *)0,
 									vTimUpdateOledScreenCallback);
 
+	/* Create a timer that auto-reloads itself at the wheel speed loop rate */
+	sh_TimSpeedControl = xTimerCreate("TIM_SpeedControl",
+										pdMS_TO_TICKS(1000 / SPEED_CONTROL_LOOP_HZ),
+										pdTRUE,
+										(void *)0,
+										vTimSpeedControlCallback);
+
+	/* Create a timer that does not reload itself, restarted by every BLE command */
+	sh_TimConnIdle = xTimerCreate("TIM_ConnIdle",
+									pdMS_TO_TICKS(BLE_CONN_IDLE_AFTER_MS),
+									pdFALSE,
+									(void *)0,
+									vTimConnIdleCallback);
+#endif
+
 	/* Ensure SW Timer creation succeeds */
 	assert_param(h_TimUpdateLED != NULL);
+	assert_param(sh_TimSpeedControl != NULL);
+	assert_param(sh_TimConnIdle != NULL);
 }
 
 /**
@@ -156,95 +326,177 @@ void FRTOS_Init_SWTimers(void)
  */
 void FRTOS_Init_Queues(void)
 {
+#if (FRTOS_STATIC_ALLOCATION == 1)
+	/* Motor commands written by the BLE client, run in order by Task_ParseBLEMessage */
+	h_QueueBLECmd = xQueueCreateStatic(BLE_CMD_QUEUE_LENGTH, sizeof(BLE_Command_t),
+										s_QueueBLECmdStorage, &s_QueueBLECmdBuffer);
+
+	/* Mailbox of the newest joystick position, overwritten by every frame */
+	h_QueueBLEJoystick = xQueueCreateStatic(1, sizeof(BLE_Joystick_t),
+											s_QueueBLEJoystickStorage, &s_QueueBLEJoystickBuffer);
+#else
+	/* Motor commands written by the BLE client, run in order by Task_ParseBLEMessage */
+	h_QueueBLECmd = xQueueCreate(BLE_CMD_QUEUE_LENGTH, sizeof(BLE_Command_t));
+
+	/* Mailbox of the newest joystick position, overwritten by every frame */
+	h_QueueBLEJoystick = xQueueCreate(1, sizeof(BLE_Joystick_t));
+#endif
 
-
-
+	/* Ensure queue creation succeeds */
+	assert_param(h_QueueBLECmd != NULL);
+	assert_param(h_QueueBLEJoystick != NULL);
 }
 
 /**
  * @brief	Initializes all relevant FreeRTOS Tasks
+ * @note	Tasks are created in table order, TaskN is created (N + 1)th and its task number in the trace,
+ * 			CPU load and health reports is N + 1. The idle and timer tasks come after, created by
+ * 			vTaskStartScheduler(). With FRTOS_STATIC_ALLOCATION, no task touches the heap.
  */
 void FRTOS_Init_Tasks(void)
 {
-	BaseType_t TaskCreationStatus;
-
-	/* Create task that will maintain BLE Connection */
-	TaskCreationStatus = xTaskCreate( Task_ManageBLEConnections,
-										"Task0 - BLE Connection",
-										TASK_STACKSIZE_DEFAULT,
-										NULL,
-										TASK_PRIO_BLE_CONN,
-										&h_TaskBLEConn);
-
-	/* Ensure task creation succeeds */
-	assert_param(TaskCreationStatus == pdPASS);
-
-	/* Create task that will parse BLE Message */
-	TaskCreationStatus = xTaskCreate( Task_ParseBLEMessage,
-										"Task1 - BLE Message",
-										TASK_STACKSIZE_DEFAULT,
-										NULL,
-										TASK_PRIO_BLE_MSG,
-										&h_TaskBLEMsg);
-
-	/* Ensure task creation succeeds */
-	assert_param(TaskCreationStatus == pdPASS);
-
-	/* Create task that will process push button interrupts */
-	TaskCreationStatus = xTaskCreate( Task_ProcessPushButtonIRQ,
-										"Task4 - PB",
-										TASK_STACKSIZE_DEFAULT,
-										NULL,
-										TASK_PRIO_PB,
-										&h_TaskPBProcessing);
-
-	/* Ensure task creation succeeds */
-	assert_param(TaskCreationStatus == pdPASS);
-
-	/* Create task that will blink MCU LED periodically */
-	TaskCreationStatus = xTaskCreate( Task_BlinkLEDIndicator,
-										"Task2 - MCULED",
-										TASK_STACKSIZE_MIN,
-										NULL,
-										TASK_PRIO_MCULED,
-										&sh_TaskMcuLED);
-
-	/* Ensure task creation succeeds */
-	assert_param(TaskCreationStatus == pdPASS);
-
-	/* Create task that will continuously check for pending BLE events */
-	TaskCreationStatus = xTaskCreate( Task_ManageBLEEvents,
-										"Task3 - BLE Events",
-										TASK_STACKSIZE_DEFAULT,
-										NULL,
-										TASK_PRIO_BLE_EVENTS,
-										&sh_TaskBLEEvents);
-
-	/* Ensure task creation succeeds */
-	assert_param(TaskCreationStatus == pdPASS);
-
-	/* Create task that will periodically measure acceleration and calculate movement velocity and distance */
-	TaskCreationStatus = xTaskCreate( Task_CarMovementCalculations,
-										"Task4 - MovementCalculations",
-										TASK_STACKSIZE_DEFAULT,
-										NULL,
-										TASK_PRIO_CALCULATIONS,
-										&h_TaskCarCalculations);
-
-	/* Ensure task creation succeeds */
-	assert_param(TaskCreationStatus == pdPASS);
-
-	/*
-	TaskCreationStatus = xTaskCreate( Task_ManageI2CEvents,
-										"Task5 - I2C Events",
-										TASK_STACKSIZE_DEFAULT,
-										NULL,
-										TASK_PRIO_I2C_EVENTS,
-										&sh_TaskI2CEvents);
-
-	assert_param(TaskCreationStatus == pdPASS);
-
-	*/
+	static const FRTOS_TaskDef_t TaskTable[] =
+	{
+		/* Maintains the BLE connection */
+		FRTOS_TASK(Task_ManageBLEConnections,		"Task0 - BLE Connection",	BLE_CONN,		&h_TaskBLEConn),
+
+		/* Parses BLE messages */
+		FRTOS_TASK(Task_ParseBLEMessage,			"Task1 - BLE Message",		BLE_MSG,		&h_TaskBLEMsg),
+
+		/* Blinks the MCU LED periodically */
+		FRTOS_TASK(Task_BlinkLEDIndicator,			"Task2 - MCULED",			MCULED,			&sh_TaskMcuLED),
+
+		/* Processes pending BLE events */
+		FRTOS_TASK(Task_ManageBLEEvents,			"Task3 - BLE Events",		BLE_EVENTS,		&sh_TaskBLEEvents),
+
+		/* Measures acceleration and calculates movement velocity and distance */
+		FRTOS_TASK(Task_CarMovementCalculations,	"Task4 - Movement",			CALCULATIONS,	&h_TaskCarCalculations),
+
+		/* Processes push button interrupts */
+		FRTOS_TASK(Task_ProcessPushButtonIRQ,		"Task5 - PB",				PB,				&h_TaskPBProcessing),
+
+		/* Streams movement telemetry to the connected BLE client */
+		FRTOS_TASK(Task_StreamTelemetry,			"Task6 - Telemetry",		TELEMETRY,		&h_TaskTelemetry),
+
+		/* FRTOS_TASK(Task_ManageI2CEvents,			"Task7 - I2C Events",		I2C_EVENTS,		&sh_TaskI2CEvents), */
+	};
+
+	_Static_assert((sizeof(TaskTable) / sizeof(TaskTable[0])) == FRTOS_TASK_COUNT,
+				   "FRTOS_TASK_COUNT does not match the task table");
+
+	for(uint8_t idx = 0; idx < FRTOS_TASK_COUNT; idx++)
+	{
+		const FRTOS_TaskDef_t *pTask = &TaskTable[idx];
+
+#if (FRTOS_STATIC_ALLOCATION == 1)
+		*pTask->pHandle = xTaskCreateStatic(pTask->Routine, pTask->pName, pTask->StackDepth, NULL,
+											pTask->Priority, pTask->pStack, pTask->pTCB);
+
+		/* Ensure task creation succeeds */
+		assert_param(*pTask->pHandle != NULL);
+#else
+		BaseType_t TaskCreationStatus = xTaskCreate(pTask->Routine, pTask->pName, pTask->StackDepth, NULL,
+													pTask->Priority, pTask->pHandle);
+
+		/* Ensure task creation succeeds */
+		assert_param(TaskCreationStatus == pdPASS);
+#endif
+	}
+}
+
+
+
+/**
+  **************************************************************************************************
+  * HCI Transport Layer Hooks																       *
+  **************************************************************************************************
+  */
+
+/**
+ * @brief	Wakes up Task_ManageBLEEvents each time an HCI event is published on the HCI read packet ring
+ * @note	Called from the BlueNRG-2 EXTI/SPI DMA interrupts, or from the task that issued an HCI
+ * 			command through hci_send_req()
+ */
+void hci_user_evt_notify(void)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	if(sh_TaskBLEEvents == NULL)
+	{
+		return;
+	}
+
+	if(xPortIsInsideInterrupt())
+	{
+		vTaskNotifyGiveFromISR(sh_TaskBLEEvents, &xHigherPriorityTaskWoken);
+
+		/* Force context switch if xHigherPriorityTaskWoken == pdTRUE */
+		portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+	}
+	else
+	{
+		xTaskNotifyGive(sh_TaskBLEEvents);
+	}
+}
+
+
+
+/**
+ * @brief	Blocks the task that issued an HCI command until hci_cmd_resp_release() is called with the
+ * 			same flag, i.e. its response arrived or a command slot/the SPI bus was freed
+ * @note	hci_send_req() re-checks its slot after each wakeup, so a stale release is harmless
+ */
+void hci_cmd_resp_wait(uint32_t flag, uint32_t timeout)
+{
+	if((flag >= HCI_CMD_WAIT_FLAG_NUM) || (sh_SemHciCmd[flag] == NULL) ||
+	   (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING))
+	{
+		return;
+	}
+
+	xSemaphoreTake(sh_SemHciCmd[flag], pdMS_TO_TICKS(timeout) + 1);
+}
+
+/**
+ * @brief	Wakes up the task blocked in hci_cmd_resp_wait() on the given flag
+ * @note	Called from the BlueNRG-2 EXTI/SPI DMA interrupts for command responses, from task
+ * 			context otherwise
+ */
+void hci_cmd_resp_release(uint32_t flag)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	if((flag >= HCI_CMD_WAIT_FLAG_NUM) || (sh_SemHciCmd[flag] == NULL))
+	{
+		return;
+	}
+
+	if(xPortIsInsideInterrupt())
+	{
+		xSemaphoreGiveFromISR(sh_SemHciCmd[flag], &xHigherPriorityTaskWoken);
+
+		/* Force context switch if xHigherPriorityTaskWoken == pdTRUE */
+		portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+	}
+	else
+	{
+		xSemaphoreGive(sh_SemHciCmd[flag]);
+	}
+}
+
+/**
+ * @brief	Tells the HCI transport layer whether hci_send_req() is called from Task_ManageBLEEvents,
+ * 			i.e. from a BLE event callback that blocks the processing of the events
+ * @note	Before the scheduler starts, hci_user_evt_proc() and the commands share the one context
+ */
+uint8_t hci_user_evt_proc_caller(void)
+{
+	if(xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED)
+	{
+		return 1;
+	}
+
+	return (xTaskGetCurrentTaskHandle() == sh_TaskBLEEvents) ? 1 : 0;
 }
 
 
@@ -276,21 +528,36 @@ static void Task_ManageBLEConnections(void *argument)
 		/* Block indefinitely until a notification to this task was obtained/received */
 		NotificationValue = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-		g_Task0_RSS = uxTaskGetStackHighWaterMark(NULL);
-
 		if(NotificationValue & FRTOS_TASK_NOTIF_BLE_CONNECTED)
 		{
 			/* Resume or start the task that parses BLE messages */
 			vTaskResume(h_TaskBLEMsg);
+
+			/* Ask for large PDUs and ATT_MTU, telemetry batches grow as soon as the client agrees */
+			BlueNRG_NegotiateThroughput();
+
+			/* Drop to the idle connection parameters unless a command comes in soon */
+			xTimerStart(sh_TimConnIdle, 0);
 		}
 		else if(NotificationValue & FRTOS_TASK_NOTIF_BLE_DISCONNECTED)
 		{
 			/* Suspend the task that parses BLE messages */
 			vTaskSuspend(h_TaskBLEMsg);
+			xTimerStop(sh_TimConnIdle, 0);
 
 			/* Place BLE module in advertising mode to allow new connections */
 			BlueNRG_MakeDeviceDiscoverable();
 		}
+
+		/* Follow the car activity with the connection parameters */
+		if(NotificationValue & FRTOS_TASK_NOTIF_BLE_CONN_ACTIVE)
+		{
+			BlueNRG_RequestConnProfile(CONN_PROFILE_ACTIVE);
+		}
+		else if(NotificationValue & FRTOS_TASK_NOTIF_BLE_CONN_IDLE)
+		{
+			BlueNRG_RequestConnProfile(CONN_PROFILE_IDLE);
+		}
 	}
 
 	/* Delete tasks automatically if somehow code reached this point */
@@ -300,57 +567,128 @@ static void Task_ManageBLEConnections(void *argument)
 /**
  * @brief	FreeRTOS Task responsible for performing particular sets of actions based on received
  * 			BLE messages/commands on the fourth characteristic
- * @note
+ * @note	Commands are run in the order they were written, see BLE_CMD_FRAME_ID. A joystick frame
+ * 			(see BLE_JOY_FRAME_ID) ends the running command and drives the car until the next
+ * 			command, or until no frame came for BLE_JOY_DEADMAN_MS.
  */
 static void Task_ParseBLEMessage(void *argument)
 {
 	/* Variable declarations */
-	uint32_t NotificationValue = 0;
+	BLE_Command_t xCommand;
+	BLE_Joystick_t xJoystick;
+	uint32_t Notification;
+	TickType_t Now, Timeout;
+	TickType_t CommandEnd = 0, JoystickDeadline = 0;
+	uint8_t CommandRunning = 0, JoystickActive = 0;
 
 	/* Initialize Motor */
 	Motor_Init();
 
+#if SPEED_CONTROL_CLOSED_LOOP
+	/* Wheel duty cycles are driven by the speed loop from now on */
+	Speed_Init(SPEED_CONTROL_LOOP_HZ);
+	xTimerStart(sh_TimSpeedControl, portMAX_DELAY);
+#endif
+
 	while(1)
 	{
-		/* Block indefinitely until a notification to this task was obtained/received */
-		NotificationValue = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		/* Sleep until the client writes, or until the running command or joystick drive times out */
+		Now = xTaskGetTickCount();
+		Timeout = portMAX_DELAY;
 
-		/* Check remaining stack size for this particular task */
-		g_Task1_RSS = uxTaskGetStackHighWaterMark(NULL);
+		if(CommandRunning)
+		{
+			Timeout = ((int32_t)(CommandEnd - Now) > 0) ? (CommandEnd - Now) : 0;
 
-		if(NotificationValue & FRTOS_TASK_NOTIF_DIR_FORCESTOP)
+			/* Wake up before the brake watchdog pulse ends on commands longer than one pulse */
+			if(Timeout > pdMS_TO_TICKS(TIM_BRAKE_MAX_MS / 2))
+				Timeout = pdMS_TO_TICKS(TIM_BRAKE_MAX_MS / 2);
+		}
+		else if(uxQueueMessagesWaiting(h_QueueBLECmd) != 0)
+			Timeout = 0;
+
+		if(JoystickActive)
 		{
-			/* Forcing car to stop moving is top priority */
+			TickType_t Remaining = ((int32_t)(JoystickDeadline - Now) > 0) ? (JoystickDeadline - Now) : 0;
+
+			if(Remaining < Timeout)
+				Timeout = Remaining;
+		}
+
+		Notification = 0;
+		xTaskNotifyWait(0, UINT32_MAX, &Notification, Timeout);
+		Now = xTaskGetTickCount();
+
+		if(Notification & FRTOS_TASK_NOTIF_CMD_PREEMPT)
+			CommandRunning = 0;
+
+		if(Notification & FRTOS_TASK_NOTIF_HAZARD)
+		{
+			/* The calculations task braked already, drop what the client asked for before the hazard */
+			CommandRunning = 0;
+			JoystickActive = 0;
+			xQueueReset(h_QueueBLECmd);
+			xQueueReset(h_QueueBLEJoystick);
+
 			Car_ConfigDirection(DIR_CAR_BRAKES);
-			g_CountDirForceStop++;
+			Motor_DisarmBrakeWatchdog();
 		}
-		else if(NotificationValue & FRTOS_TASK_NOTIF_DIR_NORTH)
+
+		/* The newest joystick position wins over the running command */
+		if(xQueueReceive(h_QueueBLEJoystick, &xJoystick, 0) == pdPASS)
 		{
-			/* Move car in forward direction and begin timer that stops car in 1.5s */
-			Car_ConfigDirection(DIR_CAR_FRONT);
-			xTimerStart(h_TimMotorTimeout, 500/portTICK_PERIOD_MS);
-			g_CountDirForward++;
+			CommandRunning = 0;
+			JoystickActive = 1;
+			JoystickDeadline = Now + pdMS_TO_TICKS(BLE_JOY_DEADMAN_MS);
+
+			Motor_ArmBrakeWatchdog(BLE_JOY_DEADMAN_MS);
+			Car_DriveVector(&xJoystick);
 		}
-		else if(NotificationValue & FRTOS_TASK_NOTIF_DIR_EAST)
+		else if(JoystickActive && ((int32_t)(Now - JoystickDeadline) >= 0))
 		{
-			/* Move car in right direction and begin timer that stops car in 1s */
-			Car_ConfigDirection(DIR_CAR_RIGHT);
-			xTimerStart(h_TimMotorTimeout, 0);
-			g_CountDirRight++;
+			/* Client went silent (out of range, app in background...), stop the car */
+			JoystickActive = 0;
+			Car_ConfigDirection(DIR_CAR_BRAKES);
+			Motor_DisarmBrakeWatchdog();
+			xBleJoystickStats.DeadmanStops++;
 		}
-		else if(NotificationValue & FRTOS_TASK_NOTIF_DIR_SOUTH)
+
+		/* The car brakes at the end of the last command queued */
+		if(CommandRunning && ((int32_t)(Now - CommandEnd) >= 0))
 		{
-			/* Move car in reverse direction and begin timer that stops car in 1.5s */
-			Car_ConfigDirection(DIR_CAR_BACK);
-			xTimerStart(h_TimMotorTimeout, 500/portTICK_PERIOD_MS);
-			g_CountDirBack++;
+			CommandRunning = 0;
+
+			if(uxQueueMessagesWaiting(h_QueueBLECmd) == 0)
+			{
+				Car_ConfigDirection(DIR_CAR_BRAKES);
+				Motor_DisarmBrakeWatchdog();
+			}
 		}
-		else if(NotificationValue & FRTOS_TASK_NOTIF_DIR_WEST)
+		else if(CommandRunning)
 		{
-			/* Move car in left direction and begin timer that stops car in 1s */
-			Car_ConfigDirection(DIR_CAR_LEFT);
-			xTimerStart(h_TimMotorTimeout, 0);
-			g_CountDirLeft++;
+			/* Still running, push the brake watchdog back to the end of the command */
+			Motor_ArmBrakeWatchdog((CommandEnd - Now) * portTICK_PERIOD_MS);
+		}
+
+		if(!CommandRunning && (xQueueReceive(h_QueueBLECmd, &xCommand, 0) == pdPASS))
+		{
+			JoystickActive = 0;
+
+			/* Hold the command for its duration unless a preempting command comes in. TIM9 brakes
+			   the car if this task is held off past the end of the command. */
+			if((xCommand.Opcode & BLE_CMD_OP_MASK) != BLE_CMD_OP_STOP)
+			{
+				uint32_t Duration = xCommand.Duration_ms ? xCommand.Duration_ms : BLE_CMD_DURATION_DEFAULT_MS;
+
+				CommandRunning = 1;
+				CommandEnd = Now + pdMS_TO_TICKS(Duration);
+				Motor_ArmBrakeWatchdog(Duration);
+			}
+
+			Car_ExecuteCommand(&xCommand);
+
+			if(!CommandRunning)
+				Motor_DisarmBrakeWatchdog();
 		}
 	}
 
@@ -358,6 +696,102 @@ static void Task_ParseBLEMessage(void *argument)
 	vTaskDelete(NULL);
 }
 
+/**
+ * @brief	Applies one command written by the client to the motors
+ * @note	Called by Task_ParseBLEMessage only
+ */
+static void Car_ExecuteCommand(const BLE_Command_t *pCommand)
+{
+#if SPEED_CONTROL_CLOSED_LOOP
+	/* Speed to hold, picked up by the next speed loop iteration */
+	Speed_SetTarget(MOTWHEEL_FRONTTIRES, pCommand->Speed_cm_s ? pCommand->Speed_cm_s : SPEED_TARGET_DEFAULT_CM_S);
+	Speed_SetTarget(MOTWHEEL_REARTIRES, pCommand->Speed_cm_s ? pCommand->Speed_cm_s : SPEED_TARGET_DEFAULT_CM_S);
+#else
+	/* Joystick drive may have left the wheels at any duty cycle */
+	Motor_ConfigAllWheelSpeed(WHEEL_SPEED_DEFAULT_PERCENTAGE);
+#endif
+
+	switch(pCommand->Opcode & BLE_CMD_OP_MASK)
+	{
+		case BLE_CMD_OP_FORWARD:
+			Car_ConfigDirection(DIR_CAR_FRONT);
+			g_CountDirForward++;
+			break;
+		case BLE_CMD_OP_RIGHT:
+			Car_ConfigDirection(DIR_CAR_RIGHT);
+			g_CountDirRight++;
+			break;
+		case BLE_CMD_OP_BACK:
+			Car_ConfigDirection(DIR_CAR_BACK);
+			g_CountDirBack++;
+			break;
+		case BLE_CMD_OP_LEFT:
+			Car_ConfigDirection(DIR_CAR_LEFT);
+			g_CountDirLeft++;
+			break;
+		default:
+			/* Forcing car to stop moving is top priority */
+			Car_ConfigDirection(DIR_CAR_BRAKES);
+			g_CountDirForceStop++;
+			break;
+	}
+
+	Car_WakeSpeedLoop();
+
+	/* Motor outputs are committed, close the latency measurement of this command */
+	BlueNRG_RecordActuation();
+	xBleCmdStats.Executed++;
+	xBleCmdStats.LastSequence = pCommand->Sequence;
+
+	/* Keep the low latency connection parameters while commands keep coming */
+	xTimerReset(sh_TimConnIdle, 0);
+	xTaskNotify(h_TaskBLEConn, FRTOS_TASK_NOTIF_BLE_CONN_ACTIVE, eSetBits);
+}
+
+/**
+ * @brief	Applies one joystick position written by the client to the motors
+ * @note	Called by Task_ParseBLEMessage only. With the speed loop, each side tracks its share of
+ * 			SPEED_FULL_SCALE_CM_S and the duty cycles written here only hold until the next iteration.
+ */
+static void Car_DriveVector(const BLE_Joystick_t *pJoystick)
+{
+#if SPEED_CONTROL_CLOSED_LOOP
+	int32_t Left = (int32_t)pJoystick->Throttle + pJoystick->Steer;
+	int32_t Right = (int32_t)pJoystick->Throttle - pJoystick->Steer;
+
+	Left = (Left > MAX_PERCENTAGE) ? MAX_PERCENTAGE : (Left < -MAX_PERCENTAGE) ? -MAX_PERCENTAGE : Left;
+	Right = (Right > MAX_PERCENTAGE) ? MAX_PERCENTAGE : (Right < -MAX_PERCENTAGE) ? -MAX_PERCENTAGE : Right;
+
+	Speed_SetTarget(MOTWHEEL_REARLEFT, (Left * SPEED_FULL_SCALE_CM_S) / MAX_PERCENTAGE);
+	Speed_SetTarget(MOTWHEEL_FRONTLEFT, (Left * SPEED_FULL_SCALE_CM_S) / MAX_PERCENTAGE);
+	Speed_SetTarget(MOTWHEEL_REARRIGHT, (Right * SPEED_FULL_SCALE_CM_S) / MAX_PERCENTAGE);
+	Speed_SetTarget(MOTWHEEL_FRONTRIGHT, (Right * SPEED_FULL_SCALE_CM_S) / MAX_PERCENTAGE);
+#endif
+
+	Car_ConfigVector(pJoystick->Throttle, pJoystick->Steer);
+	Car_WakeSpeedLoop();
+
+	/* Motor outputs are committed, close the latency measurement of this frame */
+	BlueNRG_RecordJoystickActuation(pJoystick);
+
+	/* Keep the low latency connection parameters while the joystick streams */
+	xTimerReset(sh_TimConnIdle, 0);
+	xTaskNotify(h_TaskBLEConn, FRTOS_TASK_NOTIF_BLE_CONN_ACTIVE, eSetBits);
+}
+
+/**
+ * @brief	Restarts the speed loop timer once a wheel is driven again
+ * @note	Called by Task_ParseBLEMessage only, after the wheel directions were set. See
+ * 			vTimSpeedControlCallback() for why the timer is stopped.
+ */
+static void Car_WakeSpeedLoop(void)
+{
+#if SPEED_CONTROL_CLOSED_LOOP
+	if(s_SpeedLoopParked && (xTimerStart(sh_TimSpeedControl, 0) == pdPASS))
+		s_SpeedLoopParked = 0;
+#endif
+}
+
 static void Task_ProcessPushButtonIRQ(void *argument)
 {
 	/* Variable declarations */
@@ -369,9 +803,6 @@ static void Task_ProcessPushButtonIRQ(void *argument)
 		/* Block indefinitely until a notification to this task was obtained/received */
 		NotificationValue = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-		/* Check remaining stack size for this particular task */
-		g_Task4_RSS = uxTaskGetStackHighWaterMark(NULL);
-
 		if(NotificationValue & FRTOS_TASK_NOTIF_PB_PRESSED)
 		{
 			/* Test alternating each wheel to observe sequence */
@@ -385,26 +816,18 @@ static void Task_ProcessPushButtonIRQ(void *argument)
 }
 
 /**
- * @brief	FreeRTOS Task responsible for managing BLE events. hci_user_evt_proc() needs to be called
- * 			continuously to manage BLE connections and incoming/outgoing messages.
+ * @brief	FreeRTOS Task responsible for managing BLE events. hci_user_evt_proc() is called each time
+ * 			the HCI transport layer queues an event, see hci_user_evt_notify().
  * @note
  */
 static void Task_ManageBLEEvents(void *argument)
 {
-	/* Configure periodic BLE updates of 15ms */
-	const TickType_t DelayFrequency = pdMS_TO_TICKS(15);
-	TickType_t LastActiveTime;
-
 	while(1)
 	{
-		/* Check amount of unused stack. If returned value is 0, stack overflow has occurred */
-		g_Task3_RSS = uxTaskGetStackHighWaterMark(NULL);
-
-		/* Perform accurate blocking delay */
-		LastActiveTime = xTaskGetTickCount();
-		vTaskDelayUntil(&LastActiveTime, DelayFrequency);
+		/* Block indefinitely until the HCI transport layer has queued at least one event */
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-		/* Need to continuously call this function to process BLE events and connections */
+		/* Process all BLE events and connections queued so far */
 		hci_user_evt_proc();
 	}
 
@@ -424,9 +847,6 @@ static void Task_BlinkLEDIndicator(void *argument)
 
 	while(1)
 	{
-		/* Check amount of unused stack. If returned value is 0, stack overflow has occurred */
-		g_Task2_RSS = uxTaskGetStackHighWaterMark(NULL);
-
 		/* Perform accurate blocking delay */
 		LastActiveTime = xTaskGetTickCount();
 		vTaskDelayUntil(&LastActiveTime, DelayFrequency);
@@ -439,101 +859,276 @@ static void Task_BlinkLEDIndicator(void *argument)
 	vTaskDelete(NULL);
 }
 
+/**
+ * @brief	FreeRTOS Task responsible for streaming telemetry batches to the BLE client, one batch per
+ * 			notification
+ * @note	Woken up by the calculations task when a full batch is pending, by the BLE layer when the
+ * 			BlueNRG-2 frees TX buffers, and every TELEMETRY_FLUSH_PERIOD_MS to send partial batches.
+ * 			A batch refused for lack of TX buffers is kept and sent again on the next wakeup, so sends
+ * 			are paced by the controller rather than by a fixed rate. Pending hazard warnings are sent
+ * 			first, then the velocity when it changed and the CPU load and health reports once every
+ * 			HEALTH_PERIOD_MS.
+ * 			Being the lowest priority task, it also runs the health monitor (stack headroom of every
+ * 			task, heap and HCI packet ring occupancy), so that no other task pays for it.
+ */
+static void Task_StreamTelemetry(void *argument)
+{
+	static uint8_t Batch[TELEMETRY_PAYLOAD_MAX];
+	static uint8_t CpuLoadReport[CPULOAD_REPORT_MAX];
+	static uint8_t HealthReport[HEALTH_REPORT_MAX];
+	uint16_t BatchLength = 0;
+	uint16_t CpuLoadLength = 0;
+	uint16_t HealthLength = 0;
+	int32_t VelocityPublished = -1;		/* Never an estimate, the first one goes out */
+	int32_t Velocity;
+	TickType_t LastHealthSample = xTaskGetTickCount();
+	tBleStatus ret;
+
+	while(1)
+	{
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(TELEMETRY_FLUSH_PERIOD_MS));
+
+		/* Scheduler trace goes out over ITM, only while a debugger listens */
+		Trace_Drain();
+
+		/* Warnings go out before any telemetry batch, retried once TX buffers are freed */
+		if(BlueNRG_NotifyHazards() == BLE_STATUS_INSUFFICIENT_RESOURCES)
+			continue;
+
+		/* RD_VELOCITY is only written when the estimate changed, the client reads it at any time */
+		Velocity = s_CarVelocityResultant;
+		if(Velocity != VelocityPublished)
+		{
+			if(BlueNRG_PublishVelocity(Velocity) == BLE_STATUS_INSUFFICIENT_RESOURCES)
+				continue;
+
+			VelocityPublished = Velocity;
+		}
+
+		/* Lowest priority task, sampling here does not delay the others. The CPU load window length
+		   is measured by the sampler, so being woken up late only stretches the window */
+		if((xTaskGetTickCount() - LastHealthSample) >= pdMS_TO_TICKS(HEALTH_PERIOD_MS))
+		{
+			LastHealthSample = xTaskGetTickCount();
+			Health_Sample();
+			CpuLoadLength = CpuLoad_BuildReport(CpuLoadReport, CPULOAD_REPORT_MAX);
+			HealthLength = Health_BuildReport(HealthReport, HEALTH_REPORT_MAX);
+		}
+
+		/* Reports are kept and sent again once TX buffers are freed, a newer sample replaces them */
+		if(CpuLoadLength != 0)
+		{
+			if(BlueNRG_PublishCpuLoad(CpuLoadReport, CpuLoadLength) == BLE_STATUS_INSUFFICIENT_RESOURCES)
+				continue;
+
+			CpuLoadLength = 0;
+		}
+
+		if(HealthLength != 0)
+		{
+			if(BlueNRG_PublishHealth(HealthReport, HealthLength) == BLE_STATUS_INSUFFICIENT_RESOURCES)
+				continue;
+
+			HealthLength = 0;
+		}
+
+		if(!BlueNRG_TelemetrySubscribed())
+		{
+			/* Nobody listens, drop the records so that streaming starts with fresh samples */
+			BatchLength = 0;
+			Telemetry_Discard();
+			continue;
+		}
+
+		while(1)
+		{
+			if(BatchLength == 0)
+				BatchLength = Telemetry_BuildBatch(Batch, BlueNRG_TelemetryPayloadMax());
+
+			if(BatchLength == 0)
+				break;
+
+			ret = BlueNRG_NotifyTelemetry(Batch, BatchLength);
+
+			if(ret == BLE_STATUS_INSUFFICIENT_RESOURCES)
+			{
+				/* Retried once aci_gatt_tx_pool_available_event() notifies this task */
+				xTelemetryStats.TxPoolFull++;
+				break;
+			}
+
+			if(ret != BLE_STATUS_SUCCESS)
+				xTelemetryStats.TxErrors++;
+
+			BatchLength = 0;
+		}
+	}
+
+	/* Delete tasks automatically if somehow code reached this point */
+	vTaskDelete(NULL);
+}
+
+/**
+ * @brief	Brakes the car on a hazard and warns the client
+ * @param	Flags: BLE_HAZARD_x
+ * @note	Called by the calculations task. Task_ParseBLEMessage then drops the running command and
+ * 			the commands still queued, and the telemetry task sends the warning.
+ */
+static void Car_ReportHazard(uint8_t Flags)
+{
+	Car_ConfigDirection(DIR_CAR_BRAKES);
+	xTaskNotify(h_TaskBLEMsg, FRTOS_TASK_NOTIF_HAZARD, eSetBits);
+
+	BlueNRG_PostHazard(Flags, (int16_t)s_CarVelocityResultant);
+}
+
+/**
+ * @brief	Tells whether the car stands still, from the actuators and the accelerometer
+ * @param	Timestamp_us: time of the sample about to be integrated
+ * @note	The car is still once no wheel was driven for MOTION_ZUPT_SETTLE_US (time to coast to a
+ * 			stop), or as soon as the ADXL343 flags inactivity with the wheels off
+ */
+static uint8_t Car_IsStationary(uint32_t Timestamp_us)
+{
+	if(g_ShiftRegisterByteToSet != 0)
+	{
+		s_CarDriven = 1;
+		s_CarLastDriven_us = Timestamp_us;
+		return 0;
+	}
+
+	if(ADXL_StreamInactive())
+		return 1;
+
+	return !s_CarDriven || ((Timestamp_us - s_CarLastDriven_us) >= MOTION_ZUPT_SETTLE_US);
+}
+
+/**
+ * @brief	Integrates the latest acceleration sample into velocity and distance covered
+ * @param	RawX, RawY, RawZ: raw 13-bit acceleration values read from the ADXL343
+ * 			Timestamp_us: time of the sample
+ * 			TimeDiff_us: time elapsed since the previous acceleration sample
+ * @note	All the calculations run in fixed point, see car_app_motion.c
+ */
+static void Car_IntegrateAcceleration(uint16_t RawX, uint16_t RawY, uint16_t RawZ, uint32_t Timestamp_us,
+									  uint32_t TimeDiff_us)
+{
+	Motion_SetStationary(&s_CarMotion, Car_IsStationary(Timestamp_us));
+
+	Motion_Integrate(&s_CarMotion, ADXL_TwosComplement_13bits(RawX), ADXL_TwosComplement_13bits(RawY),
+					 ADXL_TwosComplement_13bits(RawZ), TimeDiff_us);
+
+	/* Publish whole cm/s and cm values */
+	s_CarVelocityX = Q16_TO_INT(s_CarMotion.Velocity[0]);
+	s_CarVelocityY = Q16_TO_INT(s_CarMotion.Velocity[1]);
+	s_CarVelocityZ = Q16_TO_INT(s_CarMotion.Velocity[2]);
+	s_CarVelocityResultant = Q16_TO_INT(s_CarMotion.VelocityResultant);
+	s_CarLocalDistanceCovered = (int32_t)(s_CarMotion.Distance >> Q16_SHIFT);
+
+	/* One warning per excursion above the speed limit */
+	if(!s_CarOverSpeed && (s_CarVelocityResultant > CAR_OVERSPEED_CM_S))
+	{
+		s_CarOverSpeed = 1;
+		Car_ReportHazard(BLE_HAZARD_OVERSPEED);
+	}
+	else if(s_CarOverSpeed && (s_CarVelocityResultant < CAR_OVERSPEED_RELEASE_CM_S))
+	{
+		s_CarOverSpeed = 0;
+	}
+}
+
 /**
  * @brief	FreeRTOS Task responsible for measuring velocity and distance covered from retrieved acceleration
  * @note
  */
 static void Task_CarMovementCalculations(void *argument)
 {
-	/* Variable declarations */
-	__IO int32_t CarOldVelocityX = 0;				/* units in cm/s */
-	__IO int32_t CarOldVelocityY = 0;				/* units in cm/s */
-	__IO int32_t CarOldVelocityZ = 0;				/* units in cm/s */
-	TickType_t TimeDiff = 0, TimeNow = 0, TimeBefore = 0;
-	float TimeDiff_seconds = 0;
-
-#if defined(ACCELEROMETER_INTERRUPTS)
-	uint32_t NotificationValue = 0;
+#if defined(ACCELEROMETER_FIFO_STREAM)
+	AccelerometerSample xSample;
+	uint32_t LastTimestamp_us = 0;
+	uint8_t FirstSample = 1;
+	uint8_t Events;
+
+	/* INT1 is edge triggered, drain anyway if no watermark interrupt came after twice the fill time */
+	const TickType_t StreamTimeout = pdMS_TO_TICKS((2 * ADXL_STREAM_WATERMARK *
+									 ADXL_ODR_PERIOD_US(ADXL_STREAM_OUTPUT_DATA_RATE)) / 1000) + 1;
 #elif defined(ACCELEROMETER_PERIODIC_MEASUREMENTS)
+	uint16_t RawAccelX, RawAccelY, RawAccelZ;
+	uint32_t Timestamp_us, LastTimestamp_us = 0;
+	uint8_t FirstSample = 1;
+
 	/* Variables used to perform accurate delays */
 	const TickType_t DelayFrequency = pdMS_TO_TICKS(FREQUENCY_MS_CALCULATION);
 	TickType_t LastActiveTime;
 #endif
 
-	/* Initialize accelerometer */
+	/* Initialize dead reckoning and accelerometer */
+	Motion_Init(&s_CarMotion);
 	ADXL343_Init();
 	ADXL_ConfigureOffsets();
 
-#if defined(ACCELEROMETER_INTERRUPTS)
+#if defined(ACCELEROMETER_FIFO_STREAM)
 
-	/**
-	 * This segment of code needs to be fixed. ADXL343 interrupts not triggering as expected.
-	 */
+	/* Collect samples in the ADXL343 FIFO, INT1 is raised once ADXL_STREAM_WATERMARK samples are stored */
+	ADXL343_StartStream(ADXL_STREAM_OUTPUT_DATA_RATE, ADXL_STREAM_WATERMARK);
+	Telemetry_Init(xStreamStats.SamplePeriod_us);
 
 	while(1)
 	{
-		/* Block indefinitely until a notification to this task was obtained/received */
-		NotificationValue = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		/* Block until the FIFO watermark interrupt notifies this task */
+		xTaskNotifyWait(0, FRTOS_TASK_NOTIF_ADXL343_INT1, NULL, StreamTimeout);
+
+		/* Read all the FIFO entries in one go, this also releases INT1 */
+		ADXL_StreamDrain(Timebase_GetMicros());
 
-		/* Check amount of unused stack. If returned value is 0, stack overflow has occurred */
-		g_Task5_RSS = uxTaskGetStackHighWaterMark(NULL);
+		/* Shocks and falls flagged by the ADXL343 raise INT1 as well */
+		Events = ADXL_StreamTakeEvents();
 
-		/* Request acceleration data from ADXL343 accelerometer */
-		if(NotificationValue & FRTOS_TASK_NOTIF_ADXL343_INT1)
+		if(Events)
+			Car_ReportHazard(((Events & MSK_INT_SOURCE_SINGLE_TAP) ? BLE_HAZARD_IMPACT : 0) |
+							 ((Events & MSK_INT_SOURCE_FREE_FALL) ? BLE_HAZARD_FREEFALL : 0));
+
+		/* Integrate each sample over the time elapsed since the previous one */
+		while(ADXL_StreamRead(&xSample))
 		{
-			/* Read accelerations axis x and y from ADXL343 accelerometer connected through I2C/SMBus */
-			ADXL_ReadAcceleration(&s_CarAccelerationX, &s_CarAccelerationY, &s_CarAccelerationZ);
-			DataReadyCounter++;
+			Car_IntegrateAcceleration(xSample.RawX, xSample.RawY, xSample.RawZ, xSample.Timestamp_us,
+									  FirstSample ? xStreamStats.SamplePeriod_us : (xSample.Timestamp_us - LastTimestamp_us));
 
-			/* Measure velocity, and update old velocity afterwards with new duplicate */
-			s_CarVelocity += (s_CarAcceleration * FREQUENCY_S_CALCULATION);
+			/* Wake the telemetry task once a full batch is waiting */
+			if(Telemetry_Push(xSample.Timestamp_us, &s_CarMotion))
+				xTaskNotifyGive(h_TaskTelemetry);
 
-			/* Measure distance covered/lapsed */
-			s_CarLocalDistanceCovered += (s_CarVelocity * FREQUENCY_S_CALCULATION) + (0.5 * s_CarAcceleration * pow(FREQUENCY_S_CALCULATION,2));
+			LastTimestamp_us = xSample.Timestamp_us;
+			FirstSample = 0;
 		}
 	}
 
 #elif defined(ACCELEROMETER_PERIODIC_MEASUREMENTS)
 
+	Telemetry_Init(FREQUENCY_MS_CALCULATION * 1000);
+
 	while(1)
 	{
-		/* Check amount of unused stack. If returned value is 0, stack overflow has occurred */
-		g_Task5_RSS = uxTaskGetStackHighWaterMark(NULL);
-
 		/* Perform accurate blocking delay */
 		LastActiveTime = xTaskGetTickCount();
 		vTaskDelayUntil(&LastActiveTime, DelayFrequency);
 
-		taskENTER_CRITICAL();
-
-		/* Read accelerations axis x and y from ADXL343 accelerometer connected through I2C/SMBus */
-		ADXL_ReadAcceleration(&s_CarAccelerationX, &s_CarAccelerationY, &s_CarAccelerationZ);
-
-		/* Update deltaT (time difference) parameter */
-		TimeNow = xTaskGetTickCount();
-		TimeDiff = TimeNow - TimeBefore;
-		TimeDiff_seconds = TimeDiff/1000.0f;
-		TimeBefore = TimeNow;
-
-		taskEXIT_CRITICAL();
-
-		/* Calculate velocity in cm/s. Velocity will be negative if movement is in negative direction/orientation.
-		 * round() used to remove noise from acceleration readings.
+		/* Read accelerations axis x and y from ADXL343 accelerometer connected through I2C/SMBus. The task
+		 * sleeps while the transfer runs, no critical section is needed.
 		 */
-		s_CarVelocityX = CarOldVelocityX + (round(s_CarAccelerationX) * FREQUENCY_S_CALCULATION);
-		s_CarVelocityY = CarOldVelocityY + (round(s_CarAccelerationY) * FREQUENCY_S_CALCULATION);
-		s_CarVelocityZ = CarOldVelocityZ + (round(s_CarAccelerationZ) * FREQUENCY_S_CALCULATION);
+		__ADXL_READMULTIBYTE_FIFO(&RawAccelX, &RawAccelY, &RawAccelZ);
 
-		/* Calculate resultant velocity and acceleration considering x and y directions only */
-		s_CarVelocityResultant = sqrt(pow(s_CarVelocityX, 2) + pow(s_CarVelocityY, 2));
+		/* Date the sample once its transfer completed, scheduling jitter goes into the real deltaT */
+		Timestamp_us = Timebase_GetMicros();
 
-		/* Update old velocity values to be used in next iteration/measurement */
-		CarOldVelocityX = s_CarVelocityX;
-		CarOldVelocityY = s_CarVelocityY;
-		CarOldVelocityZ = s_CarVelocityZ;
+		Car_IntegrateAcceleration(RawAccelX, RawAccelY, RawAccelZ, Timestamp_us,
+								  FirstSample ? (FREQUENCY_MS_CALCULATION * 1000) : (Timestamp_us - LastTimestamp_us));
 
-		/* Measure distance covered/lapsed. TimeDiff will be in seconds unit. */
-		s_CarLocalDistanceCovered += (float)s_CarVelocityResultant * FREQUENCY_S_CALCULATION;
+		if(Telemetry_Push(Timestamp_us, &s_CarMotion))
+			xTaskNotifyGive(h_TaskTelemetry);
+
+		LastTimestamp_us = Timestamp_us;
+		FirstSample = 0;
 	}
 
 #endif
@@ -560,14 +1155,41 @@ static void Task_ManageI2CEvents(void *argument)
   */
 
 /**
- * @brief	FreeRTOS Timer that stops the car after 1.5 seconds of movement or 1 second of movement
- * 			depending on movement direction
- * @note
+ * @brief	FreeRTOS Timer that runs the wheel speed loop every 1/SPEED_CONTROL_LOOP_HZ seconds
+ * @note	Only started when SPEED_CONTROL_CLOSED_LOOP is set. With no wheel driven, the step has just
+ * 			applied 0% and reset the loops, so the timer is stopped until Car_WakeSpeedLoop() and the
+ * 			idle task can leave the tick off. The scheduler is suspended so that the stop command is
+ * 			always queued before the start command of a new drive.
  */
-static void vTimMotorTimeoutCallback(TimerHandle_t xTimer)
+static void vTimSpeedControlCallback(TimerHandle_t xTimer)
 {
-	/* Stops car movements */
-	Car_ConfigDirection(DIR_CAR_BRAKES);
+	Speed_ControlStep();
+
+	vTaskSuspendAll();
+
+	if((g_ShiftRegisterByteToSet == 0) && (xTimerStop(xTimer, 0) == pdPASS))
+		s_SpeedLoopParked = 1;
+
+	xTaskResumeAll();
+}
+
+/**
+ * @brief	FreeRTOS Timer that switches the BLE connection to its idle parameters BLE_CONN_IDLE_AFTER_MS
+ * 			after the last command
+ * @note	Restarted instead while a motor is still driven. The timer daemon does not wait on the motor
+ * 			mutex: a task updating the outputs counts as activity and the check is done next period.
+ */
+static void vTimConnIdleCallback(TimerHandle_t xTimer)
+{
+	MotorOutputs Outputs;
+
+	if(!Motor_TryGetOutputs(&Outputs) || (Outputs.ShiftRegister != 0))
+	{
+		xTimerStart(xTimer, 0);
+		return;
+	}
+
+	xTaskNotify(h_TaskBLEConn, FRTOS_TASK_NOTIF_BLE_CONN_IDLE, eSetBits);
 }
 
 /**
@@ -0,0 +1,160 @@
+/**
+  **************************************************************************************************
+  * @file           : car_app_health.c
+  * @brief          : This file contains the health monitor of the car. Every HEALTH_PERIOD_MS, one
+  *  				  snapshot of the tasks gives their lowest stack headroom and feeds the CPU load
+  *  				  sampler, and the heap_4 and HCI packet ring occupancy are recorded.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include "main.h"
+#include "car_app_health.h"
+#include "hci.h"
+#include "hci_tl.h"
+
+
+/* Exported/Global variables ---------------------------------------------------------------------*/
+HealthStats xHealthStats = {0};
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+static TaskStatus_t s_TaskStatus[HEALTH_MAX_TASKS];	/* Too large for the stack of the caller */
+static UBaseType_t s_TaskCount = 0;
+static uint8_t s_Flags = 0;
+static uint8_t s_Sequence = 0;
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+static inline uint8_t *Put16(uint8_t *pOut, uint16_t Value)
+{
+	pOut[0] = (uint8_t)Value;
+	pOut[1] = (uint8_t)(Value >> 8);
+
+	return pOut + 2;
+}
+
+static inline uint16_t Saturate16(uint32_t Value)
+{
+	return (Value > UINT16_MAX) ? UINT16_MAX : (uint16_t)Value;
+}
+
+
+/**
+ * @brief	Takes one snapshot of the tasks, the heap and the HCI packet ring
+ * @note	Called by one low priority task only, every HEALTH_PERIOD_MS. The stack headroom is the
+ * 			kernel high water mark, so it is the lowest seen since the task was created. The walk runs
+ * 			with the scheduler suspended, once per period instead of in every task loop.
+ */
+void Health_Sample(void)
+{
+	uint32_t CycleStart = DWT->CYCCNT;
+	HeapStats_t Heap;
+	tHciReadPoolStats Hci;
+	uint32_t RunTime;
+	uint8_t Flags = 0;
+
+	s_TaskCount = uxTaskGetSystemState(s_TaskStatus, HEALTH_MAX_TASKS, &RunTime);
+
+	if(s_TaskCount == 0)
+	{
+		/* More tasks than entries, the kernel fills nothing */
+		xHealthStats.TableFull++;
+	}
+	else
+	{
+		xHealthStats.MinStack_words = UINT16_MAX;
+
+		for(UBaseType_t n = 0; n < s_TaskCount; n++)
+		{
+			if(s_TaskStatus[n].usStackHighWaterMark < xHealthStats.MinStack_words)
+			{
+				xHealthStats.MinStack_words = s_TaskStatus[n].usStackHighWaterMark;
+				xHealthStats.MinStackTask = s_TaskStatus[n].xTaskNumber;
+			}
+		}
+
+		if(xHealthStats.MinStack_words < HEALTH_STACK_LOW_WORDS)
+		{
+			Flags |= HEALTH_FLAG_STACK_LOW;
+			xHealthStats.LowStackSamples++;
+		}
+
+		CpuLoad_Update(s_TaskStatus, s_TaskCount, RunTime);
+	}
+
+	vPortGetHeapStats(&Heap);
+
+	xHealthStats.HeapFree = Heap.xAvailableHeapSpaceInBytes;
+	xHealthStats.HeapMinEverFree = Heap.xMinimumEverFreeBytesRemaining;
+	xHealthStats.HeapLargestBlock = Heap.xSizeOfLargestFreeBlockInBytes;
+	xHealthStats.HeapFreeBlocks = Heap.xNumberOfFreeBlocks;
+	xHealthStats.Fragmentation_permille = (Heap.xAvailableHeapSpaceInBytes == 0) ? 0 :
+		(uint16_t)(1000 - ((Heap.xSizeOfLargestFreeBlockInBytes * 1000) / Heap.xAvailableHeapSpaceInBytes));
+
+	/* The largest block is what the next allocation can get, whatever the free bytes */
+	if(xHealthStats.HeapLargestBlock < HEALTH_HEAP_LOW_BYTES)
+	{
+		Flags |= HEALTH_FLAG_HEAP_LOW;
+		xHealthStats.LowHeapSamples++;
+	}
+
+	hci_read_pool_stats(&Hci);
+
+	if(Hci.stalls != xHealthStats.HciStalls)
+		Flags |= HEALTH_FLAG_HCI_STALLED;
+
+	xHealthStats.HciPending = Hci.pending;
+	xHealthStats.HciPeak = Hci.peak;
+	xHealthStats.HciStalls = Hci.stalls;
+
+	s_Flags = Flags;
+	xHealthStats.Samples++;
+	xHealthStats.LastCycles = DWT->CYCCNT - CycleStart;
+}
+
+
+/**
+ * @brief	Packs the last sample, see car_app_health.h for the layout
+ * @param	pBuffer: destination, at least MaxLength bytes
+ * 			MaxLength: room in pBuffer, records that do not fit are left out
+ * @retval	Length of the report, 0 before the first sample
+ */
+uint16_t Health_BuildReport(uint8_t *pBuffer, uint16_t MaxLength)
+{
+	uint8_t *pOut = pBuffer + HEALTH_HEADER_SIZE;
+	uint8_t Count = 0;
+
+	if((xHealthStats.Samples == 0) || (MaxLength < HEALTH_HEADER_SIZE))
+		return 0;
+
+	while((Count < s_TaskCount) && ((pOut - pBuffer) + HEALTH_RECORD_SIZE <= MaxLength))
+	{
+		const TaskStatus_t *pTask = &s_TaskStatus[Count];
+
+		*pOut++ = (uint8_t)pTask->xTaskNumber;
+		*pOut++ = (uint8_t)pTask->uxCurrentPriority;
+		pOut = Put16(pOut, (uint16_t)pTask->usStackHighWaterMark);
+		CpuLoad_ShortName((char *)pOut, pTask->pcTaskName);
+		pOut += CPULOAD_NAME_CHARS;
+		Count++;
+	}
+
+	pBuffer[0] = s_Sequence++;
+	pBuffer[1] = Count;
+	pBuffer[2] = s_Flags;
+	pBuffer[3] = (uint8_t)((xHealthStats.HciPeak > UINT8_MAX) ? UINT8_MAX : xHealthStats.HciPeak);
+	Put16(&pBuffer[4], Saturate16(xHealthStats.HeapFree));
+	Put16(&pBuffer[6], Saturate16(xHealthStats.HeapMinEverFree));
+	Put16(&pBuffer[8], Saturate16(xHealthStats.HeapLargestBlock));
+	Put16(&pBuffer[10], xHealthStats.Fragmentation_permille);
+	Put16(&pBuffer[12], Saturate16(xHealthStats.HciStalls));
+
+	return (uint16_t)(pOut - pBuffer);
+}
+
+
+/******************************************* END OF FILE *******************************************/
@@ -0,0 +1,563 @@
+/**
+  **************************************************************************************************
+  * @file           : car_app_lowpower.c
+  * @brief          : This file contains the tickless idle of the car. When every task is blocked,
+  *  				  the idle task stops the 1kHz tick and sleeps (WFI, woken up by TIM5) or enters
+  *  				  STOP mode (woken up by the RTC wakeup timer) until the next task timeout, or
+  *  				  until an interrupt such as the BlueNRG-2 (EXTI0) or ADXL343 (EXTI4) one comes.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "car_app_lowpower.h"
+#include "motordriver.h"
+#include "tim.h"
+
+
+/* Private define --------------------------------------------------------------------------------*/
+#define TIMEBASE_COUNTS_PER_S					((uint32_t)1000000 / TIMEBASE_US_PER_COUNT)
+
+/* Longest tick suppression, within the RTC wakeup timer range (65536 x 16 / LSI) */
+#define LOWPOWER_MAX_IDLE_TICKS					((uint32_t)20000)
+
+/* Shortest SysTick reload when the tick has to be taken right away */
+#define SYSTICK_MIN_RELOAD_CYCLES				((uint32_t)100)
+
+/* RTC time is read modulo one hour, far longer than LOWPOWER_MAX_IDLE_TICKS */
+#define RTC_SUBSECONDS_PER_S					(LOWPOWER_RTC_PREDIV_S + 1)
+#define RTC_SUBSECONDS_PER_HOUR					(3600 * RTC_SUBSECONDS_PER_S)
+
+/* 128 LSI periods take 4ms, give up on a missing clock after 20ms */
+#define LSI_CALIBRATION_TIMEOUT_COUNTS			((uint32_t)20000 / TIMEBASE_US_PER_COUNT)
+
+_Static_assert(((1000000 / configTICK_RATE_HZ) % TIMEBASE_US_PER_COUNT) == 0,
+			   "A tick must be a whole number of TIM5 counts");
+
+
+/* Exported/Global variables ---------------------------------------------------------------------*/
+LowPowerStats xLowPowerStats = {0};
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+static uint32_t s_CyclesPerCount = 0;		/* Core cycles per TIM5 count */
+static uint32_t s_CyclesPerTick = 0;		/* Core cycles per tick, SysTick reload + 1 */
+static uint32_t s_PhaseRef = 0;				/* Tick versus TIM5 phase at the first sleep */
+static uint8_t s_PhaseRefSet = 0;
+
+#if LOWPOWER_USE_STOP_MODE
+static uint32_t s_LsiHz = LSI_VALUE;		/* Measured by LowPower_CalibrateLsi() */
+
+/* Every stream is checked, a transfer in flight would stall in STOP mode */
+static DMA_Stream_TypeDef *const s_DmaStreams[] =
+{
+	DMA1_Stream0, DMA1_Stream1, DMA1_Stream2, DMA1_Stream3,
+	DMA1_Stream4, DMA1_Stream5, DMA1_Stream6, DMA1_Stream7,
+	DMA2_Stream0, DMA2_Stream1, DMA2_Stream2, DMA2_Stream3,
+	DMA2_Stream4, DMA2_Stream5, DMA2_Stream6, DMA2_Stream7
+};
+#endif
+
+
+/* Private function prototypes -------------------------------------------------------------------*/
+static uint32_t LowPower_Sleep(uint32_t Start, uint32_t WakeCounts, uint8_t *pTimerWakeup);
+#if LOWPOWER_USE_STOP_MODE
+static void LowPower_InitRtc(void);
+static void LowPower_CalibrateLsi(void);
+static uint8_t LowPower_StopAllowed(void);
+static uint32_t LowPower_Stop(uint32_t Start, uint32_t WakeCounts, uint8_t *pTimerWakeup);
+#endif
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+/**
+ * @brief	Waits for the next TIM5 count, so that core cycles can be related to TIM5 exactly
+ * @retval	TIM5 count just reached
+ */
+static inline uint32_t Timebase_SyncEdge(void)
+{
+	uint32_t Count = TIM5->CNT;
+
+	while(TIM5->CNT == Count);
+
+	return Count + 1;
+}
+
+#if LOWPOWER_USE_STOP_MODE
+static inline void Rtc_Unlock(void)
+{
+	RTC->WPR = 0xCA;
+	RTC->WPR = 0x53;
+}
+
+static inline void Rtc_Lock(void)
+{
+	RTC->WPR = 0xFF;
+}
+
+static inline void Rtc_ClearWakeupFlag(void)
+{
+	RTC->ISR = ~(RTC_ISR_WUTF | RTC_ISR_INIT) | (RTC->ISR & RTC_ISR_INIT);
+	EXTI->PR = EXTI_PR_PR22;
+}
+
+/**
+ * @brief	Reads the RTC time of day in sub seconds, modulo one hour
+ * @note	Shadow registers are bypassed, the read is repeated if the sub seconds moved meanwhile
+ */
+static uint32_t Rtc_ReadSubSeconds(void)
+{
+	uint32_t SubSeconds, Time, Seconds;
+
+	do
+	{
+		SubSeconds = RTC->SSR;
+		Time = RTC->TR;
+	} while(SubSeconds != RTC->SSR);
+
+	Seconds = ((((Time & RTC_TR_MNT) >> RTC_TR_MNT_Pos) * 10) + ((Time & RTC_TR_MNU) >> RTC_TR_MNU_Pos)) * 60;
+	Seconds += (((Time & RTC_TR_ST) >> RTC_TR_ST_Pos) * 10) + ((Time & RTC_TR_SU) >> RTC_TR_SU_Pos);
+
+	return (Seconds * RTC_SUBSECONDS_PER_S) + (LOWPOWER_RTC_PREDIV_S - SubSeconds);
+}
+#endif
+
+
+/**
+ * @brief	Prepares the tickless idle
+ * @note	Called from main() once TIM5 runs, before the scheduler starts. There is no RTC in the
+ * 			CubeMX project, it is clocked by LSI and programmed here.
+ */
+void LowPower_Init(void)
+{
+	s_CyclesPerCount = SystemCoreClock / TIMEBASE_COUNTS_PER_S;
+	s_CyclesPerTick = SystemCoreClock / configTICK_RATE_HZ;
+
+#if LOWPOWER_USE_STOP_MODE
+	LowPower_InitRtc();
+	LowPower_CalibrateLsi();
+#endif
+
+#if defined(DEBUG)
+	/* Keeps the debugger attached in STOP mode, at the cost of most of the savings */
+	HAL_DBGMCU_EnableDBGStopMode();
+#endif
+}
+
+
+/**
+ * @brief	Stops the tick and sleeps until the next task timeout or the next interrupt
+ * @param	xExpectedIdleTime: ticks until the next task timeout
+ * @note	Called by the idle task through portSUPPRESS_TICKS_AND_SLEEP(), with the scheduler
+ * 			suspended. The time slept is measured on TIM5, which STOP mode moves forward by the time
+ * 			measured on the RTC, and the kernel and HAL ticks are stepped by the whole ticks elapsed.
+ * 			The tick due at the wake up time is left to SysTick, as it unblocks the task that timed out.
+ */
+void LowPower_SuppressTicksAndSleep(uint32_t xExpectedIdleTime)
+{
+	uint32_t Start, End, WakeCounts, Phase;
+	uint32_t ToBoundary, Ticks, Remaining;
+	uint8_t TimerWakeup = 0;
+	uint8_t Stop = 0;
+
+	if(xExpectedIdleTime > LOWPOWER_MAX_IDLE_TICKS)
+		xExpectedIdleTime = LOWPOWER_MAX_IDLE_TICKS;
+
+	/* SysTick is stopped on a TIM5 edge, both are then in step to the core cycle */
+	__disable_irq();
+	__DSB();
+	__ISB();
+
+	Start = Timebase_SyncEdge();
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+	ToBoundary = SysTick->VAL;
+
+	/* A task got ready or the tick interrupt is pending: not the time to sleep */
+	if((eTaskConfirmSleepModeStatus() == eAbortSleep) || (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk))
+	{
+		SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+		xLowPowerStats.Aborted++;
+		__enable_irq();
+		return;
+	}
+
+	WakeCounts = LowPower_WakeCounts(ToBoundary, xExpectedIdleTime);
+
+	HAL_SuspendTick();
+
+#if LOWPOWER_USE_STOP_MODE
+	if(xExpectedIdleTime >= LOWPOWER_STOP_MIN_TICKS)
+	{
+		Stop = LowPower_StopAllowed();
+
+		if(!Stop)
+			xLowPowerStats.StopVetoes++;
+	}
+
+	if(Stop)
+		LowPower_Stop(Start, WakeCounts, &TimerWakeup);
+	else
+#endif
+		LowPower_Sleep(Start, WakeCounts, &TimerWakeup);
+
+	End = Timebase_SyncEdge();
+
+	Ticks = LowPower_CompensateTicks(End - Start, ToBoundary, xExpectedIdleTime, &Remaining);
+
+	/* SysTick finishes the current tick, then goes on with full ticks */
+	SysTick->LOAD = Remaining - 1;
+	SysTick->VAL = 0;
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+	SysTick->LOAD = s_CyclesPerTick - 1;
+
+	vTaskStepTick(Ticks);
+
+	/* TIM2 kept counting in WFI, its pending update would count one millisecond twice */
+	uwTick += Ticks * (1000 / configTICK_RATE_HZ);
+	TIM2->SR = ~TIM_SR_UIF;
+	HAL_ResumeTick();
+
+	if(Stop)
+	{
+		xLowPowerStats.StopEntries++;
+		xLowPowerStats.StopTime_us += (End - Start) * TIMEBASE_US_PER_COUNT;
+	}
+	else
+	{
+		xLowPowerStats.SleepEntries++;
+		xLowPowerStats.SleepTime_us += (End - Start) * TIMEBASE_US_PER_COUNT;
+	}
+
+	if(TimerWakeup)
+		xLowPowerStats.TimerWakeups++;
+	else
+		xLowPowerStats.EventWakeups++;
+
+	/* Tick compensation check: the next tick must stay in phase with TIM5. Lost ticks and
+	   rounding show up here, an exact compensation keeps TickDrift_us within a few us */
+	Phase = ((xTaskGetTickCount() + 1) * (s_CyclesPerTick / s_CyclesPerCount)) - (End + (Remaining / s_CyclesPerCount));
+
+	if(!s_PhaseRefSet)
+	{
+		s_PhaseRef = Phase;
+		s_PhaseRefSet = 1;
+	}
+
+	xLowPowerStats.TickDrift_us = (int32_t)(Phase - s_PhaseRef) * TIMEBASE_US_PER_COUNT;
+
+	if((xLowPowerStats.TickDrift_us > xLowPowerStats.MaxTickDrift_us) || (xLowPowerStats.TickDrift_us < -xLowPowerStats.MaxTickDrift_us))
+		xLowPowerStats.MaxTickDrift_us = (xLowPowerStats.TickDrift_us < 0) ? -xLowPowerStats.TickDrift_us : xLowPowerStats.TickDrift_us;
+
+	__enable_irq();
+}
+
+
+/**
+ * @brief	TIM5 counts from the SysTick stop to the wake up for the next task timeout
+ * @param	ToBoundary: core cycles from the SysTick stop to the next tick boundary (SysTick VAL)
+ * 			xExpectedIdleTime: ticks until the next task timeout, 1 at least
+ * @note	The wake up comes before the tick boundary that ends the idle period, by one TIM5 count
+ * 			for Timebase_SyncEdge() and by the shortest SysTick reload. SysTick then takes the last
+ * 			tick on the boundary itself, a wake up past it would leave the tick out of phase.
+ */
+uint32_t LowPower_WakeCounts(uint32_t ToBoundary, uint32_t xExpectedIdleTime)
+{
+	uint32_t Cycles = ToBoundary + ((xExpectedIdleTime - 1) * s_CyclesPerTick);
+
+	if(Cycles < (SYSTICK_MIN_RELOAD_CYCLES + s_CyclesPerCount))
+		return 0;
+
+	return ((Cycles - SYSTICK_MIN_RELOAD_CYCLES) / s_CyclesPerCount) - 1;
+}
+
+
+/**
+ * @brief	Splits the time slept into whole ticks and the part of a tick left
+ * @param	SleptCounts: TIM5 counts from the SysTick stop to the wake up
+ * 			ToBoundary: core cycles from the SysTick stop to the next tick boundary (SysTick VAL)
+ * 			xExpectedIdleTime: ticks until the next task timeout, 1 at least
+ * 			pRemaining: core cycles SysTick has left to count until the next tick
+ * @retval	Ticks to step the kernel by, xExpectedIdleTime - 1 at most
+ * @note	Unless the wake up came past the task timeout, SleptCounts + *pRemaining ends on a tick
+ * 			boundary, so the tick stays in phase with the one before the sleep. The tick due at the task timeout is left
+ * 			to SysTick, since it unblocks the task that timed out.
+ */
+uint32_t LowPower_CompensateTicks(uint32_t SleptCounts, uint32_t ToBoundary, uint32_t xExpectedIdleTime, uint32_t *pRemaining)
+{
+	uint64_t Elapsed = (uint64_t)SleptCounts * s_CyclesPerCount;
+	uint64_t Over;
+	uint32_t Ticks, Remaining;
+
+	/* Whole ticks elapsed, the first boundary was ToBoundary cycles away */
+	if(Elapsed < ToBoundary)
+	{
+		Ticks = 0;
+		Remaining = ToBoundary - (uint32_t)Elapsed;
+	}
+	else
+	{
+		Over = Elapsed - ToBoundary;
+		Ticks = 1 + (uint32_t)(Over / s_CyclesPerTick);
+		Remaining = s_CyclesPerTick - (uint32_t)(Over % s_CyclesPerTick);
+	}
+
+	if(Ticks >= xExpectedIdleTime)
+	{
+		/* Any tick past the expected one was slept through and is lost */
+		xLowPowerStats.LostTicks += Ticks - xExpectedIdleTime;
+		Ticks = xExpectedIdleTime - 1;
+		Remaining = 0;
+	}
+
+	/* A boundary too close for SysTick is stepped now, unless its tick unblocks the task */
+	if(Remaining < SYSTICK_MIN_RELOAD_CYCLES)
+	{
+		if((Ticks + 1) < xExpectedIdleTime)
+		{
+			Ticks++;
+			Remaining += s_CyclesPerTick;
+		}
+		else
+		{
+			Remaining = SYSTICK_MIN_RELOAD_CYCLES;
+		}
+	}
+
+	*pRemaining = Remaining;
+
+	return Ticks;
+}
+
+
+/**
+ * @brief	RTC wakeup timer interrupt, see RTC_WKUP_IRQHandler()
+ * @note	The flags are normally cleared by LowPower_Stop() before interrupts are enabled again
+ */
+void LowPower_RtcWakeupIRQHandler(void)
+{
+#if LOWPOWER_USE_STOP_MODE
+	Rtc_ClearWakeupFlag();
+#endif
+}
+
+
+/**
+ * @brief	Sleeps in WFI until TIM5 reaches Start + WakeCounts or an interrupt comes
+ * @retval	TIM5 count on exit, *pTimerWakeup is set if the wake up time was reached
+ */
+static uint32_t LowPower_Sleep(uint32_t Start, uint32_t WakeCounts, uint8_t *pTimerWakeup)
+{
+	TIM5->CCR3 = Start + WakeCounts;
+	TIM5->SR = ~TIM_SR_CC3IF;
+	TIM5->DIER |= TIM_DIER_CC3IE;
+
+	/* Compare only matches on equality, a wake up time already passed is not waited for */
+	if((int32_t)(TIM5->CCR3 - TIM5->CNT) > 0)
+	{
+		__DSB();
+		__WFI();
+		__ISB();
+
+		*pTimerWakeup = (TIM5->SR & TIM_SR_CC3IF) ? 1 : 0;
+	}
+	else
+	{
+		*pTimerWakeup = 1;
+	}
+
+	/* Nothing else uses the TIM5 interrupt, its pending request is dropped */
+	TIM5->DIER &= ~TIM_DIER_CC3IE;
+	TIM5->SR = ~TIM_SR_CC3IF;
+	NVIC_ClearPendingIRQ(TIM5_IRQn);
+
+	return TIM5->CNT;
+}
+
+
+#if LOWPOWER_USE_STOP_MODE
+/**
+ * @brief	Clocks the RTC by LSI and prepares its wakeup timer on EXTI line 22
+ * @note	Calendar prescalers give an LSI/4 sub second counter, the RTC second is only nominal.
+ * 			The wakeup timer interrupt is enabled here and armed by LowPower_Stop() only.
+ */
+static void LowPower_InitRtc(void)
+{
+	HAL_PWR_EnableBkUpAccess();
+
+	__HAL_RCC_LSI_ENABLE();
+	while(__HAL_RCC_GET_FLAG(RCC_FLAG_LSIRDY) == RESET);
+
+	/* The RTC clock source can only be changed after a backup domain reset */
+	if(__HAL_RCC_GET_RTC_SOURCE() != RCC_RTCCLKSOURCE_LSI)
+	{
+		__HAL_RCC_BACKUPRESET_FORCE();
+		__HAL_RCC_BACKUPRESET_RELEASE();
+		__HAL_RCC_RTC_CONFIG(RCC_RTCCLKSOURCE_LSI);
+	}
+
+	__HAL_RCC_RTC_ENABLE();
+
+	Rtc_Unlock();
+
+	RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+	while(!(RTC->ISR & RTC_ISR_WUTWF));
+
+	RTC->ISR |= RTC_ISR_INIT;
+	while(!(RTC->ISR & RTC_ISR_INITF));
+
+	/* Prescalers are written in two separate accesses */
+	RTC->PRER = LOWPOWER_RTC_PREDIV_S;
+	RTC->PRER |= LOWPOWER_RTC_PREDIV_A << RTC_PRER_PREDIV_A_Pos;
+	RTC->TR = 0;
+
+	/* Wakeup timer clocked by RTC/16 (WUCKSEL = 0) */
+	RTC->CR = RTC_CR_BYPSHAD;
+	RTC->ISR &= ~RTC_ISR_INIT;
+	RTC->CR |= RTC_CR_WUTIE;
+
+	Rtc_Lock();
+
+	EXTI->IMR |= EXTI_IMR_MR22;
+	EXTI->RTSR |= EXTI_RTSR_TR22;
+
+	HAL_NVIC_SetPriority(RTC_WKUP_IRQn, 7, 0);
+	HAL_NVIC_EnableIRQ(RTC_WKUP_IRQn);
+}
+
+
+/**
+ * @brief	Measures LSI against TIM5, remapped to its channel 4 input
+ * @note	LSI is only specified within 17kHz and 47kHz, the RTC wakeup timer would be off by as
+ * 			much without this
+ */
+static void LowPower_CalibrateLsi(void)
+{
+	uint32_t Start, First = 0, Last = 0;
+	uint8_t Captures = 0;
+
+	TIM5->OR = TIM_TIM5_LSI;
+	TIM5->CCMR2 = (TIM5->CCMR2 & ~(TIM_CCMR2_CC4S | TIM_CCMR2_IC4PSC | TIM_CCMR2_IC4F)) | TIM_CCMR2_CC4S_0 | TIM_CCMR2_IC4PSC;
+	TIM5->CCER |= TIM_CCER_CC4E;
+	TIM5->SR = ~TIM_SR_CC4IF;
+
+	Start = TIM5->CNT;
+
+	while((Captures <= LOWPOWER_LSI_CAPTURES) && ((TIM5->CNT - Start) < LSI_CALIBRATION_TIMEOUT_COUNTS))
+	{
+		if(TIM5->SR & TIM_SR_CC4IF)
+		{
+			/* Reading the capture clears the flag */
+			Last = TIM5->CCR4;
+
+			if(Captures == 0)
+				First = Last;
+
+			Captures++;
+		}
+	}
+
+	TIM5->CCER &= ~TIM_CCER_CC4E;
+	TIM5->CCMR2 &= ~(TIM_CCMR2_CC4S | TIM_CCMR2_IC4PSC);
+	TIM5->OR = 0;
+
+	/* Nominal LSI_VALUE is kept if the clock could not be measured */
+	if((Captures > LOWPOWER_LSI_CAPTURES) && (Last != First))
+		s_LsiHz = (uint32_t)(((uint64_t)LOWPOWER_LSI_CAPTURES * LOWPOWER_LSI_CAPTURE_PSC * TIMEBASE_COUNTS_PER_S) / (Last - First));
+
+	xLowPowerStats.LsiFrequency_Hz = s_LsiHz;
+}
+
+
+/**
+ * @brief	Tells whether the peripherals in use can be stopped with the clocks
+ * @retval	1 if STOP mode can be entered
+ */
+static uint8_t LowPower_StopAllowed(void)
+{
+	/* Wheels driven or brake watchdog armed: the PWM timers and TIM9 would stop */
+	if((g_ShiftRegisterByteToSet != 0) || (TIM9->CR1 & TIM_CR1_CEN))
+		return 0;
+
+	/* ADXL343 or BlueNRG-2 transfer in flight */
+	if((I2C1->SR2 & I2C_SR2_BUSY) || (SPI1->SR & SPI_SR_BSY))
+		return 0;
+
+	for(uint8_t idx = 0; idx < (sizeof(s_DmaStreams) / sizeof(s_DmaStreams[0])); idx++)
+	{
+		if(s_DmaStreams[idx]->CR & DMA_SxCR_EN)
+			return 0;
+	}
+
+	return 1;
+}
+
+
+/**
+ * @brief	Enters STOP mode until the RTC wakeup timer expires or an EXTI line is raised
+ * @param	Start: TIM5 count on entry
+ * 			WakeCounts: TIM5 counts from Start to the wake up time
+ * @retval	TIM5 count on exit, *pTimerWakeup is set if the RTC woke the core up
+ * @note	The wakeup timer expires LOWPOWER_STOP_WAKEUP_MARGIN_US early, the PLL restart takes the
+ * 			rest and the core sleeps in WFI if time is left. TIM5 stops with the clocks and is moved
+ * 			forward by the time measured on the RTC, so that it can keep measuring the time slept.
+ */
+static uint32_t LowPower_Stop(uint32_t Start, uint32_t WakeCounts, uint8_t *pTimerWakeup)
+{
+	uint32_t WakeupTimer, RtcStart, RtcElapsed;
+	uint64_t Duration_us = (uint64_t)WakeCounts * TIMEBASE_US_PER_COUNT;
+
+	Duration_us = (Duration_us > LOWPOWER_STOP_WAKEUP_MARGIN_US) ? (Duration_us - LOWPOWER_STOP_WAKEUP_MARGIN_US) : 0;
+	WakeupTimer = (uint32_t)((Duration_us * (s_LsiHz / LOWPOWER_RTC_WUT_DIV)) / 1000000);
+
+	if(WakeupTimer < 2)
+		return LowPower_Sleep(Start, WakeCounts, pTimerWakeup);
+
+	if(WakeupTimer > (RTC_WUTR_WUT + 1))
+		WakeupTimer = RTC_WUTR_WUT + 1;
+
+	Rtc_Unlock();
+	RTC->CR &= ~RTC_CR_WUTE;
+	while(!(RTC->ISR & RTC_ISR_WUTWF));
+	RTC->WUTR = WakeupTimer - 1;
+	Rtc_ClearWakeupFlag();
+	RTC->CR |= RTC_CR_WUTE;
+	Rtc_Lock();
+
+	RtcStart = Rtc_ReadSubSeconds();
+
+	HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+
+	RtcElapsed = (Rtc_ReadSubSeconds() + RTC_SUBSECONDS_PER_HOUR - RtcStart) % RTC_SUBSECONDS_PER_HOUR;
+
+	/* Woken up on HSI, the PLL and its flash latency settings are kept from SystemClock_Config() */
+	__HAL_RCC_PLL_ENABLE();
+	while(__HAL_RCC_GET_FLAG(RCC_FLAG_PLLRDY) == RESET);
+	__HAL_RCC_SYSCLK_CONFIG(RCC_SYSCLKSOURCE_PLLCLK);
+	while(__HAL_RCC_GET_SYSCLK_SOURCE() != RCC_SYSCLKSOURCE_STATUS_PLLCLK);
+
+	*pTimerWakeup = (RTC->ISR & RTC_ISR_WUTF) ? 1 : 0;
+
+	Rtc_Unlock();
+	RTC->CR &= ~RTC_CR_WUTE;
+	Rtc_ClearWakeupFlag();
+	Rtc_Lock();
+	NVIC_ClearPendingIRQ(RTC_WKUP_IRQn);
+
+	/* One sub second is (PREDIV_A + 1) LSI periods */
+	TIM5->CNT += (uint32_t)(((uint64_t)RtcElapsed * (LOWPOWER_RTC_PREDIV_A + 1) * TIMEBASE_COUNTS_PER_S) / s_LsiHz);
+
+	/* Woken up by the RTC: the margin left is slept in WFI */
+	if(*pTimerWakeup)
+		return LowPower_Sleep(Start, WakeCounts, pTimerWakeup);
+
+	return TIM5->CNT;
+}
+#endif
+
+
+/******************************************* END OF FILE *******************************************/
@@ -0,0 +1,158 @@
+/**
+  **************************************************************************************************
+  * @file           : car_app_motion.c
+  * @brief          : This file contains the dead reckoning of the car. Raw accelerometer counts
+  *  				  are integrated into velocity and distance covered in Q16.16 fixed point,
+  *  				  no floating point or libm call is made per sample.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <string.h>
+#include "car_app_motion.h"
+
+
+/* Private define --------------------------------------------------------------------------------*/
+/* Microseconds to seconds in Q0.32, in Q16.16: 2^32 / 10^6 x 2^16 */
+#define MOTION_US_TO_Q32_Q16					((uint64_t)281474977)
+
+/* Alpha max plus beta min coefficients in Q15 (alpha = 0.96043, beta = 0.39782) */
+#define MAGNITUDE_ALPHA_Q15						((uint32_t)31471)
+#define MAGNITUDE_BETA_Q15						((uint32_t)13036)
+
+
+/* Private macro ---------------------------------------------------------------------------------*/
+/* Rounded (a + b)/2 x dt, with a + b in Q16.16 on 64 bits and dt in seconds Q0.32 */
+#define TRAPEZOID_Q16(sum, dt_q32)				((((int64_t)(sum) * (int64_t)(dt_q32)) + ((int64_t)1 << 32)) >> 33)
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+/**
+ * @brief	Resets the dead reckoning state (car at rest, no distance covered)
+ */
+void Motion_Init(MotionState *pState)
+{
+	memset(pState, 0, sizeof(MotionState));
+}
+
+
+/**
+ * @brief	Tells the dead reckoning whether the car stands still
+ * @param	Stationary: 1 while the car is known not to move (no wheel driven, or no motion seen
+ * 						by the accelerometer), 0 otherwise
+ * @note	While stationary, velocity is held at 0 (zero velocity update) and every sample refines
+ * 			the bias estimate instead of being integrated.
+ */
+void Motion_SetStationary(MotionState *pState, uint8_t Stationary)
+{
+	pState->Stationary = Stationary;
+}
+
+
+/**
+ * @brief	Integrates one acceleration sample into velocity and distance covered
+ * @param	AccelX, AccelY, AccelZ: raw 13-bit counts from ADXL_TwosComplement_13bits()
+ * 			Dt_us: time elapsed since the previous sample in microseconds
+ * @note	Both integrations use the trapezoidal rule. The first sample is integrated as if
+ * 			the previous acceleration was the same, and taken as the first bias estimate (the car
+ * 			is expected to stand still at power up).
+ */
+void Motion_Integrate(MotionState *pState, int32_t AccelX, int32_t AccelY, int32_t AccelZ, uint32_t Dt_us)
+{
+	int32_t Accel[3] = {AccelX, AccelY, AccelZ};
+	q16_t VelocityResultantPrev = pState->VelocityResultant;
+
+	if(!pState->Primed)
+	{
+		memcpy(pState->AccelPrev, Accel, sizeof(Accel));
+		for(uint8_t idx = 0; idx < 3; idx++)
+			pState->Bias[idx] = Q16_FROM_INT(Accel[idx]);
+		pState->Primed = 1;
+	}
+
+	if(pState->Stationary)
+	{
+		/* Zero velocity update: nothing to integrate, learn the bias */
+		for(uint8_t idx = 0; idx < 3; idx++)
+		{
+			pState->Bias[idx] += (Q16_FROM_INT(Accel[idx]) - pState->Bias[idx]) >> MOTION_BIAS_SHIFT;
+			pState->AccelPrev[idx] = Accel[idx];
+			pState->AccelNetPrev[idx] = 0;
+			pState->Velocity[idx] = 0;
+		}
+
+		pState->VelocityResultant = 0;
+		pState->StationarySamples++;
+		return;
+	}
+
+	if(Dt_us > MOTION_DT_MAX_US)
+		Dt_us = MOTION_DT_MAX_US;
+
+	/* Every sample has its own dt, converted with a multiply instead of a division */
+	if(Dt_us != pState->Dt_us)
+	{
+		pState->Dt_us = Dt_us;
+		pState->Dt_q32 = (uint32_t)(((uint64_t)Dt_us * MOTION_US_TO_Q32_Q16) >> 16);
+	}
+
+	/* v += (a_prev + a) / 2 x dt, acceleration minus bias converted from counts to cm/(s^2) in Q16.16 */
+	for(uint8_t idx = 0; idx < 3; idx++)
+	{
+		q16_t AccelNet = Q16_FROM_INT(Accel[idx]) - pState->Bias[idx];
+		int64_t AccelSum;
+
+		if((AccelNet < MOTION_NOISE_GATE_Q16) && (AccelNet > -MOTION_NOISE_GATE_Q16))
+		{
+			AccelNet = 0;
+			pState->GatedSamples++;
+		}
+
+		AccelSum = ((int64_t)pState->AccelNetPrev[idx] + AccelNet) * MOTION_LSB_CM_S2_Q16 >> Q16_SHIFT;
+
+		pState->Velocity[idx] += (q16_t)TRAPEZOID_Q16(AccelSum, pState->Dt_q32);
+		pState->AccelPrev[idx] = Accel[idx];
+		pState->AccelNetPrev[idx] = AccelNet;
+	}
+
+	/* Resultant velocity considering x and y directions only */
+	pState->VelocityResultant = Motion_FastMagnitude(pState->Velocity[0], pState->Velocity[1]);
+
+	/* d += (|v_prev| + |v|) / 2 x dt */
+	pState->Distance += TRAPEZOID_Q16((int64_t)VelocityResultantPrev + pState->VelocityResultant, pState->Dt_q32);
+}
+
+
+/**
+ * @brief	Integer approximation of sqrt(x^2 + y^2)
+ * @note	Alpha max plus beta min gives an estimate within 4%, refined by one Newton-Raphson
+ * 			step (error below 0.25%). Axis aligned vectors are returned exactly without division.
+ */
+q16_t Motion_FastMagnitude(q16_t x, q16_t y)
+{
+	uint32_t AbsX = (x < 0) ? (0U - (uint32_t)x) : (uint32_t)x;
+	uint32_t AbsY = (y < 0) ? (0U - (uint32_t)y) : (uint32_t)y;
+	uint32_t Max = (AbsX > AbsY) ? AbsX : AbsY;
+	uint32_t Min = (AbsX > AbsY) ? AbsY : AbsX;
+	uint64_t Estimate;
+
+	if(Min == 0)
+	{
+		Estimate = Max;
+	}
+	else
+	{
+		Estimate = (((uint64_t)Max * MAGNITUDE_ALPHA_Q15) + ((uint64_t)Min * MAGNITUDE_BETA_Q15)) >> 15;
+
+		/* r = (r + (x^2 + y^2) / r) / 2 */
+		Estimate = (Estimate + ((((uint64_t)Max * Max) + ((uint64_t)Min * Min)) / Estimate)) >> 1;
+	}
+
+	return (Estimate > INT32_MAX) ? INT32_MAX : (q16_t)Estimate;
+}
+
+
+/******************************************* END OF FILE *******************************************/
@@ -0,0 +1,263 @@
+/**
+  **************************************************************************************************
+  * @file           : car_app_speed.c
+  * @brief          : This file contains the closed loop speed control of the car wheels. Each wheel
+  *  				  runs its own fixed point PID and drives its PWM duty cycle through the motor
+  *  				  layer. Feedback comes from the wheel encoders. A wheel without one is driven by
+  *  				  the feedforward term alone: the accelerometer velocity is the speed of the car,
+  *  				  not of a wheel, and its drift would wind the integral up.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include "main.h"
+#include "car_app_speed.h"
+
+
+/* Private define --------------------------------------------------------------------------------*/
+#define SPEED_DUTY_MIN_Q16						Q16_FROM_INT(0)
+#define SPEED_DUTY_MAX_Q16						Q16_FROM_INT(MAX_PERCENTAGE)
+
+
+/* Private macro ---------------------------------------------------------------------------------*/
+#define Q16_MUL(a, b)							((int64_t)(a) * (int64_t)(b) >> Q16_SHIFT)
+
+
+/* Exported/Global variables ---------------------------------------------------------------------*/
+SpeedControlStats xSpeedStats = {0};
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+static PidController s_WheelPid[MOTWHEEL_COUNT];
+static q16_t s_WheelTarget[MOTWHEEL_COUNT];			/* cm/s, magnitude (direction is in the shift register) */
+
+/* Motor layer position and shift register selection bits of each wheel, indexed by E_MotorWheel_Idx */
+static const E_MotorWheel_Pos s_WheelPos[MOTWHEEL_COUNT] =
+{
+	MOTWHEEL_REARLEFT, MOTWHEEL_REARRIGHT, MOTWHEEL_FRONTRIGHT, MOTWHEEL_FRONTLEFT
+};
+static const uint8_t s_WheelSelectionMask[MOTWHEEL_COUNT] =
+{
+	MOT1_SELECTION_BITMASK, MOT2_SELECTION_BITMASK, MOT4_SELECTION_BITMASK, MOT3_SELECTION_BITMASK
+};
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+/**
+  **************************************************************************************************
+  * Generic PID																				       *
+  **************************************************************************************************
+  */
+
+/**
+ * @brief	Initializes a PID controller
+ * @param	Kff, Kp, Ki, Kd: gains in Q16.16 (Ki per second, Kd in seconds)
+ * 			LoopRate_Hz: rate at which Pid_Update() is called, folded into Ki and Kd so that no
+ * 						 division is made per update
+ * 			OutMin, OutMax: output clamp
+ */
+void Pid_Init(PidController *pPid, q16_t Kff, q16_t Kp, q16_t Ki, q16_t Kd, uint32_t LoopRate_Hz,
+			  q16_t OutMin, q16_t OutMax)
+{
+	pPid->Kff = Kff;
+	pPid->Kp = Kp;
+	pPid->Ki_dt = (q16_t)(Ki / (int32_t)LoopRate_Hz);
+	pPid->Kd_rate = (q16_t)(Kd * (int32_t)LoopRate_Hz);
+	pPid->OutMin = OutMin;
+	pPid->OutMax = OutMax;
+
+	Pid_Reset(pPid);
+}
+
+/**
+ * @brief	Clears the integral and derivative history of a PID controller
+ */
+void Pid_Reset(PidController *pPid)
+{
+	pPid->Integral = 0;
+	pPid->PrevMeasurement = 0;
+	pPid->Primed = 0;
+}
+
+/**
+ * @brief	Runs one PID iteration
+ * @param	Setpoint, Measurement: Q16.16, same unit
+ * @retval	Output clamped to [OutMin, OutMax], Q16.16
+ * @note	The integral stops growing while the output is saturated in the direction of the error
+ * 			(anti-windup). The derivative acts on the measurement so setpoint steps do not kick.
+ */
+q16_t Pid_Update(PidController *pPid, q16_t Setpoint, q16_t Measurement)
+{
+	int64_t Error = (int64_t)Setpoint - Measurement;
+	int64_t Integral = pPid->Integral + Q16_MUL(pPid->Ki_dt, Error);
+	int64_t Output;
+
+	if(!pPid->Primed)
+	{
+		pPid->PrevMeasurement = Measurement;
+		pPid->Primed = 1;
+	}
+
+	Output = Q16_MUL(pPid->Kff, Setpoint) + Q16_MUL(pPid->Kp, Error) -
+			 Q16_MUL(pPid->Kd_rate, (int64_t)Measurement - pPid->PrevMeasurement);
+	pPid->PrevMeasurement = Measurement;
+
+	if(((Output + Integral) > pPid->OutMax) && (Error > 0))
+		Integral = pPid->Integral;
+	else if(((Output + Integral) < pPid->OutMin) && (Error < 0))
+		Integral = pPid->Integral;
+
+	if(Integral > pPid->OutMax)
+		Integral = pPid->OutMax;
+	else if(Integral < -(int64_t)pPid->OutMax)
+		Integral = -(int64_t)pPid->OutMax;
+
+	pPid->Integral = (q16_t)Integral;
+	Output += Integral;
+
+	if(Output > pPid->OutMax)
+		return pPid->OutMax;
+	if(Output < pPid->OutMin)
+		return pPid->OutMin;
+
+	return (q16_t)Output;
+}
+
+/**
+ * @brief	Runs one iteration without feedback, the output is the feedforward term only
+ * @param	Setpoint: Q16.16
+ * @retval	Output clamped to [OutMin, OutMax], Q16.16
+ * @note	The history is cleared, so that Pid_Update() starts over once feedback comes back
+ */
+q16_t Pid_Feedforward(PidController *pPid, q16_t Setpoint)
+{
+	int64_t Output = Q16_MUL(pPid->Kff, Setpoint);
+
+	Pid_Reset(pPid);
+
+	if(Output > pPid->OutMax)
+		return pPid->OutMax;
+	if(Output < pPid->OutMin)
+		return pPid->OutMin;
+
+	return (q16_t)Output;
+}
+
+/**
+  **************************************************************************************************
+  * Car wheel speed control																	       *
+  **************************************************************************************************
+  */
+
+/**
+ * @brief	Initializes the PID of every wheel and the cycle counter used to measure the loop cost
+ * @param	LoopRate_Hz: rate at which Speed_ControlStep() will be called
+ */
+void Speed_Init(uint32_t LoopRate_Hz)
+{
+	for(uint8_t idx = 0; idx < MOTWHEEL_COUNT; idx++)
+	{
+		Pid_Init(&s_WheelPid[idx], SPEED_PID_KFF_Q16, SPEED_PID_KP_Q16, SPEED_PID_KI_Q16, SPEED_PID_KD_Q16,
+				 LoopRate_Hz, SPEED_DUTY_MIN_Q16, SPEED_DUTY_MAX_Q16);
+		s_WheelTarget[idx] = Q16_FROM_INT(SPEED_TARGET_DEFAULT_CM_S);
+	}
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * @brief	Sets the speed a wheel tracks while it is selected in the shift register
+ * @param	MotorWheel: The wheel(s) to configure, MOTWHEEL_FRONTTIRES/MOTWHEEL_REARTIRES set both
+ * 			Speed_cm_s: Speed magnitude in cm/s, the direction is given by Car_ConfigDirection()
+ */
+void Speed_SetTarget(E_MotorWheel_Pos MotorWheel, int32_t Speed_cm_s)
+{
+	q16_t Target = Q16_FROM_INT((Speed_cm_s < 0) ? -Speed_cm_s : Speed_cm_s);
+
+	for(uint8_t idx = 0; idx < MOTWHEEL_COUNT; idx++)
+	{
+		if((MotorWheel == s_WheelPos[idx]) ||
+		   ((MotorWheel == MOTWHEEL_FRONTTIRES) && ((idx == MOTWHEEL_IDX_FRONTLEFT) || (idx == MOTWHEEL_IDX_FRONTRIGHT))) ||
+		   ((MotorWheel == MOTWHEEL_REARTIRES) && ((idx == MOTWHEEL_IDX_REARLEFT) || (idx == MOTWHEEL_IDX_REARRIGHT))))
+		{
+			s_WheelTarget[idx] = Target;
+		}
+	}
+}
+
+/**
+ * @brief	Reads the speed of one wheel from its encoder
+ * @param	Wheel: wheel index
+ * 			pSpeed: speed magnitude in cm/s, Q16.16
+ * @retval	1 if the wheel has an encoder, 0 to drive it by the feedforward term alone
+ * @note	The car has no wheel encoders, override this function once they are fitted
+ */
+__weak uint8_t Speed_ReadWheelEncoder(E_MotorWheel_Idx Wheel, q16_t *pSpeed)
+{
+	UNUSED(Wheel);
+	UNUSED(pSpeed);
+
+	return 0;
+}
+
+/**
+ * @brief	Runs one iteration of the speed loop, to be called at the rate given to Speed_Init()
+ * @note	Wheels not selected in the shift register (off) get a 0% duty cycle and their PID is
+ * 			reset, so that a wheel starts from its feedforward duty cycle when selected again.
+ */
+void Speed_ControlStep(void)
+{
+	MotorOutputs Outputs;
+	uint8_t WheelDuty[MOTWHEEL_COUNT];
+	uint32_t CycleStart;
+
+	Motor_GetOutputs(&Outputs);
+
+	CycleStart = DWT->CYCCNT;
+
+	for(uint8_t idx = 0; idx < MOTWHEEL_COUNT; idx++)
+	{
+		q16_t Measurement;
+		q16_t Duty;
+
+		if(!(Outputs.ShiftRegister & s_WheelSelectionMask[idx]) || (s_WheelTarget[idx] == 0))
+		{
+			Pid_Reset(&s_WheelPid[idx]);
+			WheelDuty[idx] = 0;
+			continue;
+		}
+
+		if(Speed_ReadWheelEncoder((E_MotorWheel_Idx)idx, &Measurement))
+		{
+			Duty = Pid_Update(&s_WheelPid[idx], s_WheelTarget[idx], Measurement);
+			xSpeedStats.EncoderSamples++;
+		}
+		else
+		{
+			Duty = Pid_Feedforward(&s_WheelPid[idx], s_WheelTarget[idx]);
+			xSpeedStats.FeedforwardSamples++;
+		}
+
+		if((Duty == s_WheelPid[idx].OutMin) || (Duty == s_WheelPid[idx].OutMax))
+			xSpeedStats.Saturations++;
+
+		/* Round to the closest whole percent */
+		WheelDuty[idx] = (uint8_t)Q16_TO_INT(Duty + (Q16_ONE / 2));
+	}
+
+	xSpeedStats.LastCycles = DWT->CYCCNT - CycleStart;
+	if(xSpeedStats.LastCycles > xSpeedStats.MaxCycles)
+		xSpeedStats.MaxCycles = xSpeedStats.LastCycles;
+
+	/* Staged and committed in one hold of the motor mutex, unchanged duty cycles are suppressed */
+	Motor_ApplyWheelSpeeds(WheelDuty);
+
+	xSpeedStats.Iterations++;
+}
+
+
+/******************************************* END OF FILE *******************************************/
@@ -0,0 +1,197 @@
+/**
+  **************************************************************************************************
+  * @file           : car_app_telemetry.c
+  * @brief          : This file contains the telemetry stream of the car. Every accelerometer sample
+  *  				  is recorded along with the velocity and distance computed from it, and records
+  *  				  are packed in batches sized to fit a single GATT notification.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include "main.h"
+#include "car_app_telemetry.h"
+
+
+/* Private define --------------------------------------------------------------------------------*/
+#define TELEMETRY_RING_MASK						(TELEMETRY_RING_SIZE - 1)
+
+
+/* Private macro ---------------------------------------------------------------------------------*/
+#if ((TELEMETRY_RING_SIZE & (TELEMETRY_RING_SIZE - 1)) != 0)
+	#error "TELEMETRY_RING_SIZE must be a power of 2"
+#endif
+
+
+/* Exported/Global variables ---------------------------------------------------------------------*/
+TelemetryStats xTelemetryStats = {0};
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+/* Single producer (Telemetry_Push) single consumer (Telemetry_BuildBatch) ring. Head is only written
+   by the producer and tail by the consumer, both only ever increase and are masked on access */
+static TelemetryRecord s_Ring[TELEMETRY_RING_SIZE];
+static volatile uint16_t s_RingHead = 0;
+static volatile uint16_t s_RingTail = 0;
+
+static uint32_t s_SamplePeriod_us = 0;
+static volatile uint16_t s_BatchCapacity = 1;		/* Records per batch at the last negotiated MTU */
+static uint8_t s_Sequence = 0;
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+static inline uint8_t *Put16(uint8_t *pOut, uint16_t Value)
+{
+	pOut[0] = (uint8_t)Value;
+	pOut[1] = (uint8_t)(Value >> 8);
+
+	return pOut + 2;
+}
+
+static inline uint8_t *Put32(uint8_t *pOut, uint32_t Value)
+{
+	pOut[0] = (uint8_t)Value;
+	pOut[1] = (uint8_t)(Value >> 8);
+	pOut[2] = (uint8_t)(Value >> 16);
+	pOut[3] = (uint8_t)(Value >> 24);
+
+	return pOut + 4;
+}
+
+
+/**
+ * @brief	Sets the nominal period of the samples to come
+ * @param	SamplePeriod_us: accelerometer output data period in microseconds
+ */
+void Telemetry_Init(uint32_t SamplePeriod_us)
+{
+	s_SamplePeriod_us = SamplePeriod_us;
+}
+
+
+/**
+ * @brief	Records one sample right after it was integrated
+ * @param	Timestamp_us: timestamp of the sample
+ * 			pMotion: dead reckoning state, AccelPrev holds the sample itself
+ * @retval	1 if a full batch is now waiting to be sent, 0 otherwise
+ * @note	Called by the calculations task only. The newest record is dropped when the ring is full.
+ */
+uint8_t Telemetry_Push(uint32_t Timestamp_us, const MotionState *pMotion)
+{
+	uint16_t Head = s_RingHead;
+	uint16_t Pending = (uint16_t)(Head - s_RingTail);
+	TelemetryRecord *pRecord;
+
+	if(Pending >= TELEMETRY_RING_SIZE)
+	{
+		xTelemetryStats.Dropped++;
+		return 1;
+	}
+
+	pRecord = &s_Ring[Head & TELEMETRY_RING_MASK];
+	pRecord->Timestamp_us = Timestamp_us;
+	pRecord->Accel[0] = (int16_t)pMotion->AccelPrev[0];
+	pRecord->Accel[1] = (int16_t)pMotion->AccelPrev[1];
+	pRecord->Accel[2] = (int16_t)pMotion->AccelPrev[2];
+	pRecord->Velocity_cm_s = (int16_t)Q16_TO_INT(pMotion->VelocityResultant);
+	pRecord->Distance_cm = (int32_t)(pMotion->Distance >> Q16_SHIFT);
+
+	/* Publish the record before the index */
+	__DMB();
+	s_RingHead = Head + 1;
+
+	xTelemetryStats.Records++;
+
+	return (((Pending + 1) % s_BatchCapacity) == 0) ? 1 : 0;
+}
+
+
+/**
+ * @brief	Packs the oldest records in one batch, see car_app_telemetry.h for the layout
+ * @param	pBuffer: destination, at least MaxLength bytes
+ * 			MaxLength: largest notification the connection allows (ATT_MTU - 3)
+ * @retval	Length of the batch, 0 if no record is pending
+ * @note	A batch ends early on a timestamp that strays more than half a period from its nominal
+ * 			value, so that every record timestamp can be rebuilt from the header alone.
+ */
+uint16_t Telemetry_BuildBatch(uint8_t *pBuffer, uint16_t MaxLength)
+{
+	uint16_t Tail = s_RingTail;
+	uint16_t Pending = (uint16_t)(s_RingHead - Tail);
+	uint16_t Capacity, Count;
+	const TelemetryRecord *pFirst, *pRecord;
+	uint8_t *pOut;
+
+	if(MaxLength > TELEMETRY_PAYLOAD_MAX)
+		MaxLength = TELEMETRY_PAYLOAD_MAX;
+
+	if(MaxLength < (TELEMETRY_HEADER_SIZE + TELEMETRY_RECORD_SIZE))
+		return 0;
+
+	Capacity = (MaxLength - TELEMETRY_HEADER_SIZE) / TELEMETRY_RECORD_SIZE;
+	s_BatchCapacity = Capacity;
+
+	if(Pending == 0)
+		return 0;
+
+	/* Read the records after the index that published them */
+	__DMB();
+
+	if(Pending > Capacity)
+		Pending = Capacity;
+
+	pFirst = &s_Ring[Tail & TELEMETRY_RING_MASK];
+	pRecord = pFirst;
+	pOut = pBuffer + TELEMETRY_HEADER_SIZE;
+
+	for(Count = 0; Count < Pending; Count++)
+	{
+		pRecord = &s_Ring[(uint16_t)(Tail + Count) & TELEMETRY_RING_MASK];
+
+		if(Count > 0)
+		{
+			int32_t Jitter = (int32_t)(pRecord->Timestamp_us - (pFirst->Timestamp_us + (Count * s_SamplePeriod_us)));
+
+			if((uint32_t)((Jitter < 0) ? -Jitter : Jitter) > (s_SamplePeriod_us / 2))
+				break;
+		}
+
+		pOut = Put16(pOut, (uint16_t)pRecord->Accel[0]);
+		pOut = Put16(pOut, (uint16_t)pRecord->Accel[1]);
+		pOut = Put16(pOut, (uint16_t)pRecord->Accel[2]);
+		pOut = Put16(pOut, (uint16_t)pRecord->Velocity_cm_s);
+	}
+
+	/* Distance of the last record packed */
+	pRecord = &s_Ring[(uint16_t)(Tail + Count - 1) & TELEMETRY_RING_MASK];
+
+	pBuffer[0] = s_Sequence++;
+	pBuffer[1] = (uint8_t)Count;
+	pOut = Put32(&pBuffer[2], pFirst->Timestamp_us);
+	pOut = Put16(pOut, (uint16_t)s_SamplePeriod_us);
+	Put32(pOut, (uint32_t)pRecord->Distance_cm);
+
+	/* Done reading the records, hand their slots back to the producer */
+	__DMB();
+	s_RingTail = Tail + Count;
+
+	xTelemetryStats.Batches++;
+	xTelemetryStats.Bytes += TELEMETRY_HEADER_SIZE + (Count * TELEMETRY_RECORD_SIZE);
+
+	return TELEMETRY_HEADER_SIZE + (Count * TELEMETRY_RECORD_SIZE);
+}
+
+
+/**
+ * @brief	Drops every pending record, used while no client listens to the stream
+ * @note	Called by the consumer only
+ */
+void Telemetry_Discard(void)
+{
+	s_RingTail = s_RingHead;
+}
+
+
+/******************************************* END OF FILE *******************************************/
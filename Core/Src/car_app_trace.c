@@ -0,0 +1,202 @@
+/**
+  **************************************************************************************************
+  * @file           : car_app_trace.c
+  * @brief          : This file contains the scheduler trace recorder. Context switches, task
+  *  				  notifications, tickless idle and the application interrupts are written as
+  *  				  fixed size records with a TIM5 timestamp into a RAM ring, drained over ITM by
+  *  				  the telemetry task. Tools/trace_decode.py turns the stream into a timeline.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include "main.h"
+#include "car_app_trace.h"
+
+
+/* Private define --------------------------------------------------------------------------------*/
+#define TRACE_RING_MASK							(TRACE_RING_RECORDS - 1)
+
+_Static_assert((TRACE_RING_RECORDS & TRACE_RING_MASK) == 0, "TRACE_RING_RECORDS must be a power of 2");
+_Static_assert(sizeof(TraceRecord) == 8, "Trace records are drained as two words");
+
+
+/* Exported/Global variables ---------------------------------------------------------------------*/
+TraceBuffer xTraceBuffer = {.Magic = TRACE_MAGIC, .Records = TRACE_RING_RECORDS};
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+static uint32_t s_IsrNesting = 0;				/* Application interrupts running, nested ones included */
+static uint32_t s_IsrStart = 0;					/* TIM5 count at the entry of the outermost one */
+static volatile uint32_t s_IsrTime = 0;			/* TIM5 counts spent in them since power up, wraps */
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+/**
+ * @brief	Tells whether a debugger listens on the trace ITM port
+ */
+static inline uint8_t Trace_ItmEnabled(void)
+{
+	return ((ITM->TCR & ITM_TCR_ITMENA_Msk) && (ITM->TER & (1UL << TRACE_ITM_PORT))) ? 1 : 0;
+}
+
+
+/**
+ * @brief	Writes one record into the ring, the oldest one is overwritten if it is full
+ * @retval	TIM5 count of the record
+ * @note	Called from the kernel hooks with interrupts masked up to configMAX_SYSCALL_INTERRUPT_PRIORITY,
+ * 			and from interrupts of any priority, so the ring is only updated with all interrupts
+ * 			disabled (a few cycles).
+ */
+uint32_t Trace_Record(uint8_t Type, uint8_t Id, uint16_t Arg)
+{
+	uint32_t Primask = __get_PRIMASK();
+	uint32_t Timestamp;
+	TraceRecord *pRecord;
+
+	__disable_irq();
+
+	if((xTraceBuffer.Head - xTraceBuffer.Tail) >= TRACE_RING_RECORDS)
+	{
+		xTraceBuffer.Tail++;
+		xTraceBuffer.Overwritten++;
+	}
+
+	Timestamp = TIM5->CNT;
+
+	pRecord = &xTraceBuffer.Ring[xTraceBuffer.Head & TRACE_RING_MASK];
+	pRecord->Timestamp = Timestamp;
+	pRecord->Type = Type;
+	pRecord->Id = Id;
+	pRecord->Arg = Arg;
+	xTraceBuffer.Head++;
+
+	__set_PRIMASK(Primask);
+
+	return Timestamp;
+}
+
+
+/**
+ * @brief	Writes one record tagged with the exception number of the running interrupt
+ * @retval	TIM5 count of the record
+ */
+uint32_t Trace_RecordFromIsr(uint8_t Type, uint8_t Id)
+{
+	return Trace_Record(Type, Id, (uint16_t)__get_IPSR());
+}
+
+
+/**
+ * @brief	Entry of an application interrupt, see TRACE_ISR_ENTER()
+ * @note	Only the outermost of nested interrupts starts the count, so that no time is counted
+ * 			twice. The nesting and the start are updated with all interrupts disabled, an interrupt
+ * 			coming in between would take the start of the one exiting.
+ */
+void Trace_IsrEnter(void)
+{
+	uint32_t Primask = __get_PRIMASK();
+	uint32_t Timestamp;
+
+	__disable_irq();
+
+#if (TRACE_RECORDER_ENABLE == 1)
+	Timestamp = Trace_RecordFromIsr(TRACE_EV_ISR_ENTER, 0);
+#else
+	Timestamp = TIM5->CNT;
+#endif
+
+	if(s_IsrNesting++ == 0)
+		s_IsrStart = Timestamp;
+
+	__set_PRIMASK(Primask);
+}
+
+
+/**
+ * @brief	Exit of an application interrupt, see TRACE_ISR_EXIT()
+ */
+void Trace_IsrExit(void)
+{
+	uint32_t Primask = __get_PRIMASK();
+	uint32_t Timestamp;
+
+	__disable_irq();
+
+#if (TRACE_RECORDER_ENABLE == 1)
+	Timestamp = Trace_RecordFromIsr(TRACE_EV_ISR_EXIT, 0);
+#else
+	Timestamp = TIM5->CNT;
+#endif
+
+	if((s_IsrNesting != 0) && (--s_IsrNesting == 0))
+		s_IsrTime += Timestamp - s_IsrStart;
+
+	__set_PRIMASK(Primask);
+}
+
+
+/**
+ * @brief	TIM5 counts spent in the application interrupts since power up, wraps
+ * @note	The SysTick, PendSV and HAL timebase (TIM2) interrupts do not call TRACE_ISR_ENTER()
+ */
+uint32_t Trace_IsrTime(void)
+{
+	return s_IsrTime;
+}
+
+
+/**
+ * @brief	Records the name of a new task, TRACE_TASK_NAME_CHARS at most, 2 characters per record
+ * @note	Names of the tasks created at start up are only drained once, a decoder attached later
+ * 			shows task numbers instead.
+ */
+void Trace_TaskCreated(uint8_t TaskNumber, const char *pName)
+{
+	for(uint8_t idx = 0; (idx < TRACE_TASK_NAME_CHARS) && (pName[idx] != '\0'); idx += 2)
+		Trace_Record(TRACE_EV_TASK_NAME, TaskNumber, (uint16_t)((uint8_t)pName[idx] | ((uint8_t)pName[idx + 1] << 8)));
+}
+
+
+/**
+ * @brief	Sends the records written so far to the ITM trace port
+ * @note	Called by the telemetry task only. Without a debugger, the records stay in the ring
+ * 			(xTraceBuffer can then be dumped whole). Each record is copied with interrupts disabled,
+ * 			the ITM FIFO is waited for with interrupts enabled.
+ */
+void Trace_Drain(void)
+{
+	TraceRecord Record;
+
+	if(!Trace_ItmEnabled())
+		return;
+
+	while(1)
+	{
+		__disable_irq();
+
+		if(xTraceBuffer.Tail == xTraceBuffer.Head)
+		{
+			__enable_irq();
+			break;
+		}
+
+		Record = xTraceBuffer.Ring[xTraceBuffer.Tail & TRACE_RING_MASK];
+		xTraceBuffer.Tail++;
+
+		__enable_irq();
+
+		while(ITM->PORT[TRACE_ITM_PORT].u32 == 0);
+		ITM->PORT[TRACE_ITM_PORT].u32 = Record.Timestamp;
+
+		while(ITM->PORT[TRACE_ITM_PORT].u32 == 0);
+		ITM->PORT[TRACE_ITM_PORT].u32 = (uint32_t)Record.Type | ((uint32_t)Record.Id << 8) | ((uint32_t)Record.Arg << 16);
+
+		xTraceBuffer.Drained++;
+	}
+}
+
+
+/******************************************* END OF FILE *******************************************/
@@ -18,6 +18,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "custom_bus.h"
+#include "main.h"
 
 __weak HAL_StatusTypeDef MX_SPI1_Init(SPI_HandleTypeDef* hspi);
 
@@ -38,6 +39,8 @@ __weak HAL_StatusTypeDef MX_SPI1_Init(SPI_HandleTypeDef* hspi);
   */
 
 SPI_HandleTypeDef hspi1;
+DMA_HandleTypeDef hdma_spi1_rx;
+DMA_HandleTypeDef hdma_spi1_tx;
 /**
   * @}
   */
@@ -197,6 +200,25 @@ int32_t BSP_SPI1_SendRecv(uint8_t *pTxData, uint8_t *pRxData, uint16_t Length)
   return ret;
 }
 
+/**
+  * @brief  Send and Receive data to/from SPI BUS (Full duplex) through DMA
+  * @note   Completion is reported by HAL_SPI_TxRxCpltCallback() or
+  *         HAL_SPI_ErrorCallback() from the SPI1 DMA stream interrupts
+  * @param  pData: Pointer to data buffer to send/receive
+  * @param  Length: Length of data in byte
+  * @retval BSP status
+  */
+int32_t BSP_SPI1_SendRecv_DMA(uint8_t *pTxData, uint8_t *pRxData, uint16_t Length)
+{
+  int32_t ret = BSP_ERROR_NONE;
+
+  if(HAL_SPI_TransmitReceive_DMA(&hspi1, pTxData, pRxData, Length) != HAL_OK)
+  {
+      ret = BSP_ERROR_UNKNOWN_FAILURE;
+  }
+  return ret;
+}
+
 #if (USE_HAL_SPI_REGISTER_CALLBACKS == 1U)
 /**
   * @brief Register Default BSP SPI1 Bus Msp Callbacks
@@ -322,7 +344,51 @@ static void SPI1_MspInit(SPI_HandleTypeDef* spiHandle)
     HAL_GPIO_Init(BUS_SPI1_SCK_GPIO_PORT, &GPIO_InitStruct);
 
   /* USER CODE BEGIN SPI1_MspInit 1 */
-
+    __HAL_RCC_DMA2_CLK_ENABLE();
+
+    /* SPI1 DMA Init */
+    /* SPI1_RX Init (DMA2 Stream0 is taken by ADC1) */
+    hdma_spi1_rx.Instance = BUS_SPI1_RX_DMA_STREAM;
+    hdma_spi1_rx.Init.Channel = BUS_SPI1_DMA_CHANNEL;
+    hdma_spi1_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_spi1_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_spi1_rx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_spi1_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_spi1_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_spi1_rx.Init.Mode = DMA_NORMAL;
+    hdma_spi1_rx.Init.Priority = DMA_PRIORITY_HIGH;
+    hdma_spi1_rx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_spi1_rx) != HAL_OK)
+    {
+      Error_Handler();
+    }
+    __HAL_LINKDMA(spiHandle, hdmarx, hdma_spi1_rx);
+
+    /* SPI1_TX Init */
+    hdma_spi1_tx.Instance = BUS_SPI1_TX_DMA_STREAM;
+    hdma_spi1_tx.Init.Channel = BUS_SPI1_DMA_CHANNEL;
+    hdma_spi1_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_spi1_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_spi1_tx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_spi1_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_spi1_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_spi1_tx.Init.Mode = DMA_NORMAL;
+    hdma_spi1_tx.Init.Priority = DMA_PRIORITY_MEDIUM;
+    hdma_spi1_tx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_spi1_tx) != HAL_OK)
+    {
+      Error_Handler();
+    }
+    __HAL_LINKDMA(spiHandle, hdmatx, hdma_spi1_tx);
+
+    /* Same priority as the BlueNRG EXTI line, so the completion never preempts
+       a header read and may still use FreeRTOS FromISR functions */
+    HAL_NVIC_SetPriority(BUS_SPI1_RX_DMA_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(BUS_SPI1_RX_DMA_IRQn);
+    HAL_NVIC_SetPriority(BUS_SPI1_TX_DMA_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(BUS_SPI1_TX_DMA_IRQn);
+    HAL_NVIC_SetPriority(SPI1_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(SPI1_IRQn);
   /* USER CODE END SPI1_MspInit 1 */
 }
 
@@ -346,7 +412,9 @@ static void SPI1_MspDeInit(SPI_HandleTypeDef* spiHandle)
     HAL_GPIO_DeInit(BUS_SPI1_SCK_GPIO_PORT, BUS_SPI1_SCK_GPIO_PIN);
 
   /* USER CODE BEGIN SPI1_MspDeInit 1 */
-
+    HAL_DMA_DeInit(spiHandle->hdmarx);
+    HAL_DMA_DeInit(spiHandle->hdmatx);
+    HAL_NVIC_DisableIRQ(SPI1_IRQn);
   /* USER CODE END SPI1_MspDeInit 1 */
 }
 
@@ -27,6 +27,7 @@
 
 
 /* Private includes ----------------------------------------------------------*/
+#include "tim.h"
 
 
 /* Private typedef -----------------------------------------------------------*/
@@ -63,14 +64,20 @@ void vApplicationMallocFailedHook(void);
 
 /* USER CODE BEGIN 1 */
 /* Functions needed when configGENERATE_RUN_TIME_STATS is on */
-__weak void configureTimerForRunTimeStats(void)
+/**
+ * @brief	Run time stats share the TIM5 timebase, started by MX_TIM5_Init() before the scheduler
+ * @note	TIM5 is a free running 32-bit counter at 500kHz (2us per count, 500 counts per tick).
+ * 			The kernel subtracts counter values, so the wrap around every 143 minutes is harmless.
+ */
+void configureTimerForRunTimeStats(void)
 {
-
+	if((TIM5->CR1 & TIM_CR1_CEN) == 0)
+		HAL_TIM_Base_Start(&htim5);
 }
 
-__weak unsigned long getRunTimeCounterValue(void)
+unsigned long getRunTimeCounterValue(void)
 {
-return 0;
+	return TIM5->CNT;
 }
 /* USER CODE END 1 */
 
@@ -33,6 +33,7 @@
 /* Private includes ----------------------------------------------------------*/
 #include "car_app_freertos.h"
 #include "car_app_ble.h"
+#include "car_app_lowpower.h"
 
 
 /* Private typedef -----------------------------------------------------------*/
@@ -45,7 +46,6 @@
 
 
 /* External variables --------------------------------------------------------*/
-extern UBaseType_t g_Task0_RSS, g_Task1_RSS, g_Task2_RSS, g_Task3_RSS;
 
 
 /* Private variables ---------------------------------------------------------*/
@@ -91,6 +91,11 @@ int main(void)
   MX_I2C1_Init();
   MX_TIM1_Init();
   MX_TIM3_Init();
+  MX_TIM5_Init();
+  MX_TIM9_Init();
+
+  /* Tickless idle, TIM5 must already run */
+  LowPower_Init();
 
   printf("\tSTM32F411RE Nucleo-64 Board\n");
   printf("\tFreeRTOS-BLE-Car\n\n");
@@ -99,8 +104,10 @@ int main(void)
   osKernelInitialize();  /* Call init function for freertos objects (in freertos.c) */
   MX_FREERTOS_Init();
 
-  /* Initialize FreeRTOS SW Timers */
+  /* Initialize FreeRTOS Semaphores, SW Timers and Queues */
+  FRTOS_Init_Semaphores();
   FRTOS_Init_SWTimers();
+  FRTOS_Init_Queues();
 
   /* Additional FreeRTOS Object Initializations */
   FRTOS_Init_Tasks();
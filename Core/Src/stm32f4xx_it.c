@@ -27,6 +27,11 @@
 
 
 /* Private includes ----------------------------------------------------------*/
+#include "adxl343.h"
+#include "motordriver.h"
+#include "tim.h"
+#include "car_app_lowpower.h"
+#include "car_app_trace.h"
 
 
 /* Private typedef -----------------------------------------------------------*/
@@ -70,6 +75,11 @@
 /* External variables --------------------------------------------------------*/
 	/*--- Microcontroller Peripheral Handles ---*/
 	extern DMA_HandleTypeDef hdma_adc1;
+	extern DMA_HandleTypeDef hdma_i2c1_rx;
+	extern DMA_HandleTypeDef hdma_spi1_rx;
+	extern DMA_HandleTypeDef hdma_spi1_tx;
+	extern DMA_HandleTypeDef hdma_tim1_up;
+	extern SPI_HandleTypeDef hspi1;
 	extern I2C_HandleTypeDef hi2c1;
 	extern TIM_HandleTypeDef htim5;
 	extern TIM_HandleTypeDef htim9;
@@ -261,7 +271,9 @@ void DebugMon_Handler(void)
   */
 void EXTI0_IRQHandler(void)
 {
+  TRACE_ISR_ENTER();
   HAL_EXTI_IRQHandler(&H_EXTI_0);
+  TRACE_ISR_EXIT();
 }
 
 /**
@@ -269,7 +281,9 @@ void EXTI0_IRQHandler(void)
   */
 void EXTI4_IRQHandler(void)
 {
-  HAL_EXTI_IRQHandler(GPIO_PIN_4);
+  TRACE_ISR_ENTER();
+  HAL_GPIO_EXTI_IRQHandler(ACCELEROMETER_INT1_Pin);
+  TRACE_ISR_EXIT();
 }
 
 /**
@@ -277,7 +291,9 @@ void EXTI4_IRQHandler(void)
   */
 void TIM1_BRK_TIM9_IRQHandler(void)
 {
+  TRACE_ISR_ENTER();
   HAL_TIM_IRQHandler(&htim9);
+  TRACE_ISR_EXIT();
 }
 
 /**
@@ -293,7 +309,19 @@ void TIM2_IRQHandler(void)
   */
 void I2C1_EV_IRQHandler(void)
 {
+  TRACE_ISR_ENTER();
   HAL_I2C_EV_IRQHandler(&hi2c1);
+  TRACE_ISR_EXIT();
+}
+
+/**
+  * @brief This function handles I2C1 error interrupt.
+  */
+void I2C1_ER_IRQHandler(void)
+{
+  TRACE_ISR_ENTER();
+  HAL_I2C_ER_IRQHandler(&hi2c1);
+  TRACE_ISR_EXIT();
 }
 
 /**
@@ -301,7 +329,9 @@ void I2C1_EV_IRQHandler(void)
   */
 void EXTI15_10_IRQHandler(void)
 {
+  TRACE_ISR_ENTER();
   HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_13);
+  TRACE_ISR_EXIT();
 }
 
 /**
@@ -312,6 +342,24 @@ void TIM5_IRQHandler(void)
   HAL_TIM_IRQHandler(&htim5);
 }
 
+/**
+  * @brief This function handles RTC wakeup interrupt through EXTI line 22.
+  */
+void RTC_WKUP_IRQHandler(void)
+{
+  LowPower_RtcWakeupIRQHandler();
+}
+
+/**
+  * @brief This function handles DMA1 stream0 global interrupt.
+  */
+void DMA1_Stream0_IRQHandler(void)
+{
+  TRACE_ISR_ENTER();
+  HAL_DMA_IRQHandler(&hdma_i2c1_rx);
+  TRACE_ISR_EXIT();
+}
+
 /**
   * @brief This function handles DMA2 stream0 global interrupt.
   */
@@ -320,6 +368,44 @@ void DMA2_Stream0_IRQHandler(void)
   HAL_DMA_IRQHandler(&hdma_adc1);
 }
 
+/**
+  * @brief This function handles DMA2 stream2 global interrupt.
+  */
+void DMA2_Stream2_IRQHandler(void)
+{
+  TRACE_ISR_ENTER();
+  HAL_DMA_IRQHandler(&hdma_spi1_rx);
+  TRACE_ISR_EXIT();
+}
+
+/**
+  * @brief This function handles DMA2 stream3 global interrupt.
+  */
+void DMA2_Stream3_IRQHandler(void)
+{
+  TRACE_ISR_ENTER();
+  HAL_DMA_IRQHandler(&hdma_spi1_tx);
+  TRACE_ISR_EXIT();
+}
+
+/**
+  * @brief This function handles DMA2 stream5 global interrupt.
+  */
+void DMA2_Stream5_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_tim1_up);
+}
+
+/**
+  * @brief This function handles SPI1 global interrupt.
+  */
+void SPI1_IRQHandler(void)
+{
+  TRACE_ISR_ENTER();
+  HAL_SPI_IRQHandler(&hspi1);
+  TRACE_ISR_EXIT();
+}
+
 /******************************************************************************/
 /* STM32F4xx Peripheral Interrupt Callback Functions		                  */
 /******************************************************************************/
@@ -344,7 +430,8 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 	}
 	else if(htim->Instance == TIM9)
 	{
-
+		/* One-pulse brake watchdog expired */
+		Motor_BrakeWatchdogExpired();
 	}
 }
 
@@ -375,15 +462,96 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
 	{
 		/* This value becomes pdTRUE if giving the notification caused a task to unblock, and the unblocked task has a
 		   higher priority than the currently running task, in which a context switch should occur */
-		// BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+		BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+		/* The FIFO just reached its watermark, i.e. the latest sample was taken right now. Shocks and
+		   falls raise INT1 too, ADXL_StreamDrain() discards the timestamp of such edges */
+		ADXL_StreamMarkWatermark(Timebase_GetMicros());
 
-		/* Notifies task that a new acceleration data is available */
-		// xTaskNotifyFromISR(h_TaskCarCalculations, FRTOS_TASK_NOTIF_ADXL343_INT1, eSetBits, &xHigherPriorityTaskWoken);
+		/* Notifies task that the accelerometer FIFO reached its watermark */
+		if(h_TaskCarCalculations != NULL)
+			xTaskNotifyFromISR(h_TaskCarCalculations, FRTOS_TASK_NOTIF_ADXL343_INT1, eSetBits, &xHigherPriorityTaskWoken);
 
 		/* Force context switch if xHigherPriorityTaskWoken == pdTRUE. This does nothing if xHigherPriorityTaskWoken
 		   is pdFALSE */
-		// portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+		portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+	}
+}
+
+/**
+ * @brief  I2C memory read complete callback
+ * @note   I2C1 transfers are owned by the ADXL343 IO driver
+ * @param  hi2c: I2C handle
+ */
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	if(hi2c->Instance == I2C1)
+	{
+		__io_accelerometer_i2cCpltCallback(SUCCESS);
 	}
 }
 
+/**
+ * @brief  I2C memory write complete callback
+ * @param  hi2c: I2C handle
+ */
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	if(hi2c->Instance == I2C1)
+	{
+		__io_accelerometer_i2cCpltCallback(SUCCESS);
+	}
+}
+
+/**
+ * @brief  I2C master transmit complete callback
+ * @param  hi2c: I2C handle
+ */
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	if(hi2c->Instance == I2C1)
+	{
+		__io_accelerometer_i2cCpltCallback(SUCCESS);
+	}
+}
+
+/**
+ * @brief  I2C error callback (NACK, bus error, arbitration lost, DMA error)
+ * @param  hi2c: I2C handle
+ */
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+	if(hi2c->Instance == I2C1)
+	{
+		__io_accelerometer_i2cCpltCallback(ERROR);
+	}
+}
+
+#if (HCI_TL_SPI_RX_USE_DMA == 1)
+/**
+ * @brief  SPI Tx/Rx transfer complete callback
+ * @note   SPI1 only runs DMA transfers to read the BlueNRG-2 HCI packet payload
+ * @param  hspi: SPI handle
+ */
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+	if(hspi->Instance == SPI1)
+	{
+		HCI_TL_SPI_RxCpltCallback(BSP_ERROR_NONE);
+	}
+}
+
+/**
+ * @brief  SPI error callback
+ * @param  hspi: SPI handle
+ */
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+	if(hspi->Instance == SPI1)
+	{
+		HCI_TL_SPI_RxCpltCallback(BSP_ERROR_UNKNOWN_FAILURE);
+	}
+}
+#endif
+
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
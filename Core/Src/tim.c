@@ -27,6 +27,8 @@ TIM_HandleTypeDef htim1;
 TIM_HandleTypeDef htim3;
 TIM_HandleTypeDef htim5;
 TIM_HandleTypeDef htim9;
+DMA_HandleTypeDef hdma_tim1_up;
+DMA_HandleTypeDef hdma_tim1_ch1;
 
 
 /* TIM1 init function */
@@ -99,6 +101,14 @@ void MX_TIM1_Init(void)
   }
   /* USER CODE BEGIN TIM1_Init 2 */
 
+  /* CH1 has no output, its compare event at half period paces the shift register clock DMA */
+  sConfigOC.OCMode = TIM_OCMODE_TIMING;
+  sConfigOC.Pulse = 500;
+  if (HAL_TIM_OC_ConfigChannel(&htim1, &sConfigOC, TIM_CHANNEL_1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
   /* USER CODE END TIM1_Init 2 */
   HAL_TIM_MspPostInit(&htim1);
 
@@ -178,7 +188,7 @@ void MX_TIM5_Init(void)
 
   /* USER CODE END TIM5_Init 1 */
   htim5.Instance = TIM5;
-  htim5.Init.Prescaler = 0;
+  htim5.Init.Prescaler = 24;
   htim5.Init.CounterMode = TIM_COUNTERMODE_UP;
   htim5.Init.Period = 4294967295;
   htim5.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
@@ -199,6 +209,8 @@ void MX_TIM5_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN TIM5_Init 2 */
+  /* Free running timebase, no interrupt */
+  HAL_TIM_Base_Start(&htim5);
 
   /* USER CODE END TIM5_Init 2 */
 
@@ -218,7 +230,7 @@ void MX_TIM9_Init(void)
 
   /* USER CODE END TIM9_Init 1 */
   htim9.Instance = TIM9;
-  htim9.Init.Prescaler = 0;
+  htim9.Init.Prescaler = 9999;
   htim9.Init.CounterMode = TIM_COUNTERMODE_UP;
   htim9.Init.Period = 65535;
   htim9.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
@@ -233,6 +245,10 @@ void MX_TIM9_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN TIM9_Init 2 */
+  /* One-pulse brake watchdog: the counter stops on its update event, and only overflows raise it
+     (the UG event of the init above must not brake) */
+  htim9.Instance->CR1 |= (TIM_CR1_OPM | TIM_CR1_URS);
+  __HAL_TIM_CLEAR_IT(&htim9, TIM_IT_UPDATE);
 
   /* USER CODE END TIM9_Init 2 */
 
@@ -249,6 +265,47 @@ void HAL_TIM_Base_MspInit(TIM_HandleTypeDef* tim_baseHandle)
 		__HAL_RCC_TIM1_CLK_ENABLE();
 		/* USER CODE BEGIN TIM1_MspInit 1 */
 
+		/* TIM1 DMA Init, both streams write the shift register pins through GPIO BSRR */
+		/* TIM1_UP Init */
+		hdma_tim1_up.Instance = DMA2_Stream5;
+		hdma_tim1_up.Init.Channel = DMA_CHANNEL_6;
+		hdma_tim1_up.Init.Direction = DMA_MEMORY_TO_PERIPH;
+		hdma_tim1_up.Init.PeriphInc = DMA_PINC_DISABLE;
+		hdma_tim1_up.Init.MemInc = DMA_MINC_ENABLE;
+		hdma_tim1_up.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+		hdma_tim1_up.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+		hdma_tim1_up.Init.Mode = DMA_NORMAL;
+		hdma_tim1_up.Init.Priority = DMA_PRIORITY_LOW;
+		hdma_tim1_up.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+		if (HAL_DMA_Init(&hdma_tim1_up) != HAL_OK)
+		{
+			Error_Handler();
+		}
+
+		__HAL_LINKDMA(tim_baseHandle,hdma[TIM_DMA_ID_UPDATE],hdma_tim1_up);
+
+		/* TIM1_CH1 Init */
+		hdma_tim1_ch1.Instance = DMA2_Stream1;
+		hdma_tim1_ch1.Init.Channel = DMA_CHANNEL_6;
+		hdma_tim1_ch1.Init.Direction = DMA_MEMORY_TO_PERIPH;
+		hdma_tim1_ch1.Init.PeriphInc = DMA_PINC_DISABLE;
+		hdma_tim1_ch1.Init.MemInc = DMA_MINC_ENABLE;
+		hdma_tim1_ch1.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+		hdma_tim1_ch1.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+		hdma_tim1_ch1.Init.Mode = DMA_NORMAL;
+		hdma_tim1_ch1.Init.Priority = DMA_PRIORITY_LOW;
+		hdma_tim1_ch1.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+		if (HAL_DMA_Init(&hdma_tim1_ch1) != HAL_OK)
+		{
+			Error_Handler();
+		}
+
+		__HAL_LINKDMA(tim_baseHandle,hdma[TIM_DMA_ID_CC1],hdma_tim1_ch1);
+
+		/* DMA2_Stream5_IRQn interrupt configuration (the CH1 stream always completes first) */
+		HAL_NVIC_SetPriority(DMA2_Stream5_IRQn, 6, 2);
+		HAL_NVIC_EnableIRQ(DMA2_Stream5_IRQn);
+
 		/* USER CODE END TIM1_MspInit 1 */
 	}
 	else if(tim_baseHandle->Instance==TIM3)
@@ -285,8 +342,9 @@ void HAL_TIM_Base_MspInit(TIM_HandleTypeDef* tim_baseHandle)
 		/* TIM9 clock enable */
 		__HAL_RCC_TIM9_CLK_ENABLE();
 
-		/* TIM9 interrupt Init */
-		HAL_NVIC_SetPriority(TIM1_BRK_TIM9_IRQn, 7, 2);
+		/* TIM9 interrupt Init, above configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY: the brake watchdog
+		   makes no FreeRTOS call and must not wait for kernel critical sections */
+		HAL_NVIC_SetPriority(TIM1_BRK_TIM9_IRQn, 2, 0);
 		HAL_NVIC_EnableIRQ(TIM1_BRK_TIM9_IRQn);
 		/* USER CODE BEGIN TIM9_MspInit 1 */
 
@@ -363,6 +421,11 @@ void HAL_TIM_Base_MspDeInit(TIM_HandleTypeDef* tim_baseHandle)
 		__HAL_RCC_TIM1_CLK_DISABLE();
 		/* USER CODE BEGIN TIM1_MspDeInit 1 */
 
+		/* TIM1 DMA DeInit */
+		HAL_DMA_DeInit(tim_baseHandle->hdma[TIM_DMA_ID_UPDATE]);
+		HAL_DMA_DeInit(tim_baseHandle->hdma[TIM_DMA_ID_CC1]);
+		HAL_NVIC_DisableIRQ(DMA2_Stream5_IRQn);
+
 		/* USER CODE END TIM1_MspDeInit 1 */
 	}
 	else if(tim_baseHandle->Instance==TIM3)
@@ -408,6 +471,15 @@ void HAL_TIM_Base_MspDeInit(TIM_HandleTypeDef* tim_baseHandle)
 
 /* USER CODE BEGIN 1 */
 
+/**
+ * @brief	Microseconds elapsed since MX_TIM5_Init(), wraps around every 71 minutes
+ * @note	Safe from interrupt context. Differences stay exact across the wrap.
+ */
+uint32_t Timebase_GetMicros(void)
+{
+	return TIM5->CNT * TIMEBASE_US_PER_COUNT;
+}
+
 /* USER CODE END 1 */
 
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
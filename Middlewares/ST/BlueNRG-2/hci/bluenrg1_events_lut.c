@@ -0,0 +1,190 @@
+/**
+  ******************************************************************************
+  * @file    bluenrg1_events_lut.c
+  * @brief   Direct-indexed lookup tables of the BlueNRG-x event callbacks.
+  *          Same entries as the tables of bluenrg1_events.c, indexed by event
+  *          code so that a received event is dispatched with a single lookup.
+  *          Generated by Tools/gen_events_lut.py from bluenrg1_events.c, run
+  *          it again when bluenrg1_events.c is regenerated, do not edit.
+  ******************************************************************************
+  */
+#include <stdint.h>
+#include "bluenrg1_events.h"
+
+tBleStatus hci_disconnection_complete_event_process(uint8_t *buffer_in);
+tBleStatus hci_encryption_change_event_process(uint8_t *buffer_in);
+tBleStatus hci_read_remote_version_information_complete_event_process(uint8_t *buffer_in);
+tBleStatus hci_hardware_error_event_process(uint8_t *buffer_in);
+tBleStatus hci_number_of_completed_packets_event_process(uint8_t *buffer_in);
+tBleStatus hci_data_buffer_overflow_event_process(uint8_t *buffer_in);
+tBleStatus hci_encryption_key_refresh_complete_event_process(uint8_t *buffer_in);
+tBleStatus hci_le_connection_complete_event_process(uint8_t *buffer_in);
+tBleStatus hci_le_advertising_report_event_process(uint8_t *buffer_in);
+tBleStatus hci_le_connection_update_complete_event_process(uint8_t *buffer_in);
+tBleStatus hci_le_read_remote_used_features_complete_event_process(uint8_t *buffer_in);
+tBleStatus hci_le_long_term_key_request_event_process(uint8_t *buffer_in);
+tBleStatus hci_le_data_length_change_event_process(uint8_t *buffer_in);
+tBleStatus hci_le_read_local_p256_public_key_complete_event_process(uint8_t *buffer_in);
+tBleStatus hci_le_generate_dhkey_complete_event_process(uint8_t *buffer_in);
+tBleStatus hci_le_enhanced_connection_complete_event_process(uint8_t *buffer_in);
+tBleStatus hci_le_direct_advertising_report_event_process(uint8_t *buffer_in);
+tBleStatus aci_blue_initialized_event_process(uint8_t *buffer_in);
+tBleStatus aci_blue_events_lost_event_process(uint8_t *buffer_in);
+tBleStatus aci_blue_crash_info_event_process(uint8_t *buffer_in);
+tBleStatus aci_hal_end_of_radio_activity_event_process(uint8_t *buffer_in);
+tBleStatus aci_hal_scan_req_report_event_process(uint8_t *buffer_in);
+tBleStatus aci_hal_fw_error_event_process(uint8_t *buffer_in);
+tBleStatus aci_gap_limited_discoverable_event_process(uint8_t *buffer_in);
+tBleStatus aci_gap_pairing_complete_event_process(uint8_t *buffer_in);
+tBleStatus aci_gap_pass_key_req_event_process(uint8_t *buffer_in);
+tBleStatus aci_gap_authorization_req_event_process(uint8_t *buffer_in);
+tBleStatus aci_gap_slave_security_initiated_event_process(uint8_t *buffer_in);
+tBleStatus aci_gap_bond_lost_event_process(uint8_t *buffer_in);
+tBleStatus aci_gap_proc_complete_event_process(uint8_t *buffer_in);
+tBleStatus aci_gap_addr_not_resolved_event_process(uint8_t *buffer_in);
+tBleStatus aci_gap_numeric_comparison_value_event_process(uint8_t *buffer_in);
+tBleStatus aci_gap_keypress_notification_event_process(uint8_t *buffer_in);
+tBleStatus aci_l2cap_connection_update_resp_event_process(uint8_t *buffer_in);
+tBleStatus aci_l2cap_proc_timeout_event_process(uint8_t *buffer_in);
+tBleStatus aci_l2cap_connection_update_req_event_process(uint8_t *buffer_in);
+tBleStatus aci_l2cap_command_reject_event_process(uint8_t *buffer_in);
+tBleStatus aci_gatt_attribute_modified_event_process(uint8_t *buffer_in);
+tBleStatus aci_gatt_proc_timeout_event_process(uint8_t *buffer_in);
+tBleStatus aci_att_exchange_mtu_resp_event_process(uint8_t *buffer_in);
+tBleStatus aci_att_find_info_resp_event_process(uint8_t *buffer_in);
+tBleStatus aci_att_find_by_type_value_resp_event_process(uint8_t *buffer_in);
+tBleStatus aci_att_read_by_type_resp_event_process(uint8_t *buffer_in);
+tBleStatus aci_att_read_resp_event_process(uint8_t *buffer_in);
+tBleStatus aci_att_read_blob_resp_event_process(uint8_t *buffer_in);
+tBleStatus aci_att_read_multiple_resp_event_process(uint8_t *buffer_in);
+tBleStatus aci_att_read_by_group_type_resp_event_process(uint8_t *buffer_in);
+tBleStatus aci_att_prepare_write_resp_event_process(uint8_t *buffer_in);
+tBleStatus aci_att_exec_write_resp_event_process(uint8_t *buffer_in);
+tBleStatus aci_gatt_indication_event_process(uint8_t *buffer_in);
+tBleStatus aci_gatt_notification_event_process(uint8_t *buffer_in);
+tBleStatus aci_gatt_proc_complete_event_process(uint8_t *buffer_in);
+tBleStatus aci_gatt_error_resp_event_process(uint8_t *buffer_in);
+tBleStatus aci_gatt_disc_read_char_by_uuid_resp_event_process(uint8_t *buffer_in);
+tBleStatus aci_gatt_write_permit_req_event_process(uint8_t *buffer_in);
+tBleStatus aci_gatt_read_permit_req_event_process(uint8_t *buffer_in);
+tBleStatus aci_gatt_read_multi_permit_req_event_process(uint8_t *buffer_in);
+tBleStatus aci_gatt_tx_pool_available_event_process(uint8_t *buffer_in);
+tBleStatus aci_gatt_server_confirmation_event_process(uint8_t *buffer_in);
+tBleStatus aci_gatt_prepare_write_permit_req_event_process(uint8_t *buffer_in);
+
+const hci_event_process hci_events_lut[HCI_EVENTS_LUT_SIZE] = {
+  [0x0005] = hci_disconnection_complete_event_process,
+  [0x0008] = hci_encryption_change_event_process,
+  [0x000c] = hci_read_remote_version_information_complete_event_process,
+  [0x0010] = hci_hardware_error_event_process,
+  [0x0013] = hci_number_of_completed_packets_event_process,
+  [0x001a] = hci_data_buffer_overflow_event_process,
+  [0x0030] = hci_encryption_key_refresh_complete_event_process
+};
+const hci_event_process hci_le_meta_events_lut[HCI_LE_META_EVENTS_LUT_SIZE] = {
+  [0x0001] = hci_le_connection_complete_event_process,
+  [0x0002] = hci_le_advertising_report_event_process,
+  [0x0003] = hci_le_connection_update_complete_event_process,
+  [0x0004] = hci_le_read_remote_used_features_complete_event_process,
+  [0x0005] = hci_le_long_term_key_request_event_process,
+  [0x0007] = hci_le_data_length_change_event_process,
+  [0x0008] = hci_le_read_local_p256_public_key_complete_event_process,
+  [0x0009] = hci_le_generate_dhkey_complete_event_process,
+  [0x000a] = hci_le_enhanced_connection_complete_event_process,
+  [0x000b] = hci_le_direct_advertising_report_event_process
+};
+const hci_event_process hci_vendor_specific_events_lut[HCI_VENDOR_EVENTS_LUT_GROUPS][HCI_VENDOR_EVENTS_LUT_SIZE] = {
+  [0] = {
+    [0x01] = aci_blue_initialized_event_process,
+    [0x02] = aci_blue_events_lost_event_process,
+    [0x03] = aci_blue_crash_info_event_process,
+    [0x04] = aci_hal_end_of_radio_activity_event_process,
+    [0x05] = aci_hal_scan_req_report_event_process,
+    [0x06] = aci_hal_fw_error_event_process
+  },
+  [1] = {
+    [0x00] = aci_gap_limited_discoverable_event_process,
+    [0x01] = aci_gap_pairing_complete_event_process,
+    [0x02] = aci_gap_pass_key_req_event_process,
+    [0x03] = aci_gap_authorization_req_event_process,
+    [0x04] = aci_gap_slave_security_initiated_event_process,
+    [0x05] = aci_gap_bond_lost_event_process,
+    [0x07] = aci_gap_proc_complete_event_process,
+    [0x08] = aci_gap_addr_not_resolved_event_process,
+    [0x09] = aci_gap_numeric_comparison_value_event_process,
+    [0x0a] = aci_gap_keypress_notification_event_process
+  },
+  [2] = {
+    [0x00] = aci_l2cap_connection_update_resp_event_process,
+    [0x01] = aci_l2cap_proc_timeout_event_process,
+    [0x02] = aci_l2cap_connection_update_req_event_process,
+    [0x0a] = aci_l2cap_command_reject_event_process
+  },
+  [3] = {
+    [0x01] = aci_gatt_attribute_modified_event_process,
+    [0x02] = aci_gatt_proc_timeout_event_process,
+    [0x03] = aci_att_exchange_mtu_resp_event_process,
+    [0x04] = aci_att_find_info_resp_event_process,
+    [0x05] = aci_att_find_by_type_value_resp_event_process,
+    [0x06] = aci_att_read_by_type_resp_event_process,
+    [0x07] = aci_att_read_resp_event_process,
+    [0x08] = aci_att_read_blob_resp_event_process,
+    [0x09] = aci_att_read_multiple_resp_event_process,
+    [0x0a] = aci_att_read_by_group_type_resp_event_process,
+    [0x0c] = aci_att_prepare_write_resp_event_process,
+    [0x0d] = aci_att_exec_write_resp_event_process,
+    [0x0e] = aci_gatt_indication_event_process,
+    [0x0f] = aci_gatt_notification_event_process,
+    [0x10] = aci_gatt_proc_complete_event_process,
+    [0x11] = aci_gatt_error_resp_event_process,
+    [0x12] = aci_gatt_disc_read_char_by_uuid_resp_event_process,
+    [0x13] = aci_gatt_write_permit_req_event_process,
+    [0x14] = aci_gatt_read_permit_req_event_process,
+    [0x15] = aci_gatt_read_multi_permit_req_event_process,
+    [0x16] = aci_gatt_tx_pool_available_event_process,
+    [0x17] = aci_gatt_server_confirmation_event_process,
+    [0x18] = aci_gatt_prepare_write_permit_req_event_process
+  }
+};
+
+/**
+  * @brief  Callback of an HCI event packet, one bounds check and one lookup.
+  *
+  * @param  event_pckt Event packet, from its event code on
+  * @param  evt_data Set to the parameters given to the callback
+  * @retval Callback of the event, NULL if it has none
+  */
+hci_event_process hci_events_lut_lookup(uint8_t *event_pckt, uint8_t **evt_data)
+{
+  hci_event_pckt *evt_pckt = (hci_event_pckt *)event_pckt;
+
+  if (evt_pckt->evt == EVT_LE_META_EVENT)
+  {
+    evt_le_meta_event *evt = (void *)evt_pckt->data;
+
+    if (evt->subevent < HCI_LE_META_EVENTS_LUT_SIZE)
+    {
+      *evt_data = evt->data;
+      return hci_le_meta_events_lut[evt->subevent];
+    }
+  }
+  else if (evt_pckt->evt == EVT_VENDOR)
+  {
+    evt_blue_aci *blue_evt = (void *)evt_pckt->data;
+    uint16_t group = HCI_VENDOR_EVENTS_LUT_GROUP(blue_evt->ecode);
+    uint16_t index = HCI_VENDOR_EVENTS_LUT_INDEX(blue_evt->ecode);
+
+    if ((group < HCI_VENDOR_EVENTS_LUT_GROUPS) && (index < HCI_VENDOR_EVENTS_LUT_SIZE))
+    {
+      *evt_data = blue_evt->data;
+      return hci_vendor_specific_events_lut[group][index];
+    }
+  }
+  else if (evt_pckt->evt < HCI_EVENTS_LUT_SIZE)
+  {
+    *evt_data = evt_pckt->data;
+    return hci_events_lut[evt_pckt->evt];
+  }
+
+  return NULL;
+}
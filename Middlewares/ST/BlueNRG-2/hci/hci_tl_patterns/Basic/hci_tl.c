@@ -60,6 +60,11 @@
   #define HCI_READ_PACKET_NUM_MAX 	   (5)
 #endif
 
+#define HCI_CMD_SLOT_IDLE               0
+#define HCI_CMD_SLOT_PENDING            1
+#define HCI_CMD_SLOT_FAILED             2
+#define HCI_CMD_SLOT_CLAIMED            3
+
 #ifndef MIN
   #define MIN(a,b)      ((a) < (b))? (a) : (b)
 #endif
@@ -67,13 +72,79 @@
   #define MAX(a,b)      ((a) > (b))? (a) : (b)
 #endif
 
-tListNode             hciReadPktPool;
-tListNode             hciReadPktRxQueue;
+/* Completion object of a command waiting for its EVT_CMD_COMPLETE/EVT_CMD_STATUS.
+ * The response is copied into the slot's own buffer, it is owned by the interrupt
+ * while packet is NULL and by the waiting hci_send_req() call otherwise.
+ * A task claims an idle slot with LDREX/STREX (IDLE -> CLAIMED), fills it and only
+ * then publishes it as PENDING, the interrupt ignores the slots not PENDING.
+ * from_user_evt marks a command sent from UserEvtRx(), the event consumer waits in it. */
+typedef struct
+{
+  uint16_t                  opcode;
+  uint32_t                  event;
+  uint8_t                   from_user_evt;
+  tHciDataPacket * volatile packet;
+  volatile uint8_t          state;
+  tHciDataPacket            buffer;
+} tHciCmdSlot;
+
+/* Received user events, single-producer/single-consumer ring over hciReadPacketBuffer.
+ * hciReadPktHead is only written by the BlueNRG interrupt (producer) and
+ * hciReadPktTail only by hci_user_evt_proc() (consumer). Both run freely, the
+ * buffer of a packet is hciReadPacketBuffer[index % HCI_READ_PACKET_NUM_MAX].
+ * Buffers from head to tail + HCI_READ_PACKET_NUM_MAX are free, the next packet
+ * is read in place at head and published by incrementing it. */
 static tHciDataPacket hciReadPacketBuffer[HCI_READ_PACKET_NUM_MAX];
+static volatile uint32_t hciReadPktHead = 0;
+static volatile uint32_t hciReadPktTail = 0;
+/* Read target when the ring is full while a command waits for its response, so the
+ * response is not blocked behind unprocessed events. A user event read there is
+ * parked, not dropped: the producer stalls and hci_user_evt_proc() moves it into the
+ * ring as soon as a buffer is free, the head is handed over with hciReadPktParked.
+ * With no command waiting, a full ring leaves the packet in the BlueNRG-2 (IRQ line
+ * kept high) and hciReadPktStalled asks the consumer to resume the reads.
+ * hciReadPacketCmdResp is only used while an event is parked and a command sent from
+ * UserEvtRx() waits: the consumer cannot make room before its response is read. A
+ * user event read there has nowhere to go and is counted in hciReadPktDropped. */
+static tHciDataPacket hciReadPacketSpare;
+static tHciDataPacket hciReadPacketCmdResp;
+static volatile uint8_t hciReadPktParked = 0;
+static volatile uint32_t hciReadPktDropped = 0;
+static volatile uint8_t hciReadPktStalled = 0;
+static volatile uint32_t hciReadPktStalls = 0;
+static volatile uint32_t hciReadPktPeak = 0;
+static volatile uint8_t hciUserEvtRxBusy = 0;
 static tHciContext    hciContext;
+static tHciDataPacket * volatile hciPendingReadPacket = NULL;
+static tHciCmdSlot    hciCmdSlot[HCI_CMD_INFLIGHT_MAX];
+static volatile uint8_t hciSendBusy = 0;
 
 /************************* Static internal functions **************************/
 
+/**
+  * @brief  Atomically replace a byte if it holds the expected value (LDREXB/STREXB).
+  *
+  * @param  addr Address of the byte
+  * @param  expected Value the byte must hold
+  * @param  desired Value written
+  * @retval 1: byte replaced, 0: byte held another value
+  */
+static uint8_t compare_and_set(volatile uint8_t * addr, uint8_t expected, uint8_t desired)
+{
+  do
+  {
+    if (__LDREXB(addr) != expected)
+    {
+      __CLREX();
+      return 0;
+    }
+  } while (__STREXB(desired, addr) != 0);
+
+  /* Accesses to what the byte guards stay after the claim */
+  __DMB();
+  return 1;
+}
+
 /**
   * @brief  Verify the packet type.
   *
@@ -93,6 +164,205 @@ static int verify_packet(const tHciDataPacket * hciReadPacket)
   return 0;      
 }
 
+/**
+  * @brief  Hand a command response over to the hci_send_req() call waiting for it.
+  *         Called from the BlueNRG interrupt context.
+  *
+  * @param  hciReadPacket The HCI data packet
+  * @retval 1: packet given to a command slot, 0: packet is a user event
+  */
+static int dispatch_cmd_resp(tHciDataPacket * hciReadPacket)
+{
+  hci_event_pckt *event_pckt = (void *)(((hci_spi_pckt *)hciReadPacket->dataBuff)->data);
+  uint8_t *ptr = hciReadPacket->dataBuff + (1 + HCI_EVENT_HDR_SIZE);
+  uint16_t opcode;
+  uint32_t event;
+  uint8_t index;
+  int ret = 0;
+
+  switch (event_pckt->evt)
+  {
+  case EVT_CMD_STATUS:
+    opcode = ((evt_cmd_status *)ptr)->opcode;
+    event = EVT_CMD_STATUS;
+    break;
+
+  case EVT_CMD_COMPLETE:
+    opcode = ((evt_cmd_complete *)ptr)->opcode;
+    event = EVT_CMD_COMPLETE;
+    break;
+
+  case EVT_LE_META_EVENT:
+    opcode = 0;
+    event = ((evt_le_meta_event *)ptr)->subevent;
+    break;
+
+  case EVT_HARDWARE_ERROR:
+    /* Fail every command waiting, the event is still reported to the user */
+    for (index = 0; index < HCI_CMD_INFLIGHT_MAX; index++)
+    {
+      if (hciCmdSlot[index].state == HCI_CMD_SLOT_PENDING)
+      {
+        hciCmdSlot[index].state = HCI_CMD_SLOT_FAILED;
+        hci_cmd_resp_release(index);
+      }
+    }
+    return 0;
+
+  default:
+    return 0;
+  }
+
+  for (index = 0; index < HCI_CMD_INFLIGHT_MAX; index++)
+  {
+    tHciCmdSlot *slot = &hciCmdSlot[index];
+
+    if ((slot->state != HCI_CMD_SLOT_PENDING) || (slot->packet != NULL))
+      continue;
+
+    /* Command responses match on opcode, LE meta events on the awaited subevent */
+    if ((event_pckt->evt != EVT_LE_META_EVENT && slot->opcode == opcode) ||
+        (event_pckt->evt == EVT_LE_META_EVENT && slot->event != 0 && slot->event == event))
+    {
+      BLUENRG_memcpy(slot->buffer.dataBuff, hciReadPacket->dataBuff, hciReadPacket->data_len);
+      slot->buffer.data_len = hciReadPacket->data_len;
+      slot->packet = &slot->buffer;
+      hci_cmd_resp_release(index);
+      ret = 1;
+      break;
+    }
+  }
+
+  return ret;
+}
+
+/**
+  * @brief  Tell whether a command slot still waits for its response.
+  *
+  * @param  from_user_evt 1: only count the commands sent from UserEvtRx()
+  * @retval 1: a response is awaited, 0: otherwise
+  */
+static int cmd_resp_awaited(uint8_t from_user_evt)
+{
+  uint8_t index;
+
+  for (index = 0; index < HCI_CMD_INFLIGHT_MAX; index++)
+  {
+    if ((hciCmdSlot[index].state == HCI_CMD_SLOT_PENDING) && (hciCmdSlot[index].packet == NULL) &&
+        (!from_user_evt || hciCmdSlot[index].from_user_evt))
+      return 1;
+  }
+
+  return 0;
+}
+
+/**
+  * @brief  Buffer the next packet is read into. Called from the BlueNRG
+  *         interrupt context (producer side of the ring).
+  *
+  * @param  None
+  * @retval Head buffer of the ring, the spare buffer when the ring is full and
+  *         a command response is awaited, the command response buffer when the
+  *         spare holds a parked event and UserEvtRx() waits for a response,
+  *         NULL when the read must wait
+  */
+static tHciDataPacket * read_packet_buffer(void)
+{
+  uint32_t head;
+
+  /* The consumer owns the head until the parked event is in the ring */
+  if (hciReadPktParked)
+  {
+    /* The consumer is blocked in its own command, nothing makes room before the response */
+    if (cmd_resp_awaited(1))
+      return &hciReadPacketCmdResp;
+
+    return NULL;
+  }
+
+  __DMB();
+  head = hciReadPktHead;
+
+  if ((head - hciReadPktTail) < HCI_READ_PACKET_NUM_MAX)
+    return &hciReadPacketBuffer[head % HCI_READ_PACKET_NUM_MAX];
+
+  if (cmd_resp_awaited(0))
+    return &hciReadPacketSpare;
+
+  return NULL;
+}
+
+/**
+  * @brief  Move the event parked in the spare buffer to the head of the ring.
+  *         Called by hci_user_evt_proc() once a buffer is free, the producer
+  *         does not touch the head while an event is parked.
+  *
+  * @param  None
+  * @retval None
+  */
+static void publish_parked_packet(void)
+{
+  uint32_t head = hciReadPktHead;
+  tHciDataPacket * hciReadPacket = &hciReadPacketBuffer[head % HCI_READ_PACKET_NUM_MAX];
+
+  BLUENRG_memcpy(hciReadPacket->dataBuff, hciReadPacketSpare.dataBuff, hciReadPacketSpare.data_len);
+  hciReadPacket->data_len = hciReadPacketSpare.data_len;
+
+  __DMB();
+  hciReadPktHead = head + 1;
+
+  if ((hciReadPktHead - hciReadPktTail) > hciReadPktPeak)
+    hciReadPktPeak = hciReadPktHead - hciReadPktTail;
+
+  /* Head and spare buffer go back to the producer */
+  __DMB();
+  hciReadPktParked = 0;
+}
+
+/**
+  * @brief  Publish a received packet to the application, or leave its buffer
+  *         free when it is empty, invalid or a command response.
+  *         Called from the BlueNRG interrupt context.
+  *
+  * @param  hciReadPacket The HCI data packet, from read_packet_buffer()
+  * @param  data_len Number of bytes received
+  * @retval None
+  */
+static void queue_read_packet(tHciDataPacket * hciReadPacket, int32_t data_len)
+{
+  if (data_len <= 0)
+    return;
+
+  hciReadPacket->data_len = data_len;
+  if ((verify_packet(hciReadPacket) != 0) || (dispatch_cmd_resp(hciReadPacket) != 0))
+    return;
+
+  if (hciReadPacket == &hciReadPacketCmdResp)
+  {
+    /* User event read while waiting for a response, ring and spare are both taken */
+    hciReadPktDropped++;
+    return;
+  }
+
+  if (hciReadPacket == &hciReadPacketSpare)
+  {
+    /* User event behind a full ring, kept until hci_user_evt_proc() makes room */
+    __DMB();
+    hciReadPktParked = 1;
+    hci_user_evt_notify();
+    return;
+  }
+
+  /* Packet content must be visible before the consumer sees the new head */
+  __DMB();
+  hciReadPktHead = hciReadPktHead + 1;
+
+  if ((hciReadPktHead - hciReadPktTail) > hciReadPktPeak)
+    hciReadPktPeak = hciReadPktHead - hciReadPktTail;
+
+  hci_user_evt_notify();
+}
+
 /**
   * @brief  Send an HCI command.
   *
@@ -121,64 +391,183 @@ static void send_cmd(uint16_t ogf, uint16_t ocf, uint8_t plen, void *param)
 }
 
 /**
-  * @brief  Remove the tail from a source list and insert it to the head 
-  *         of a destination list.
+  * @brief  Reserve a command slot for the response of the given command.
   *
-  * @param  dest_list
-  * @param  src_list
-  * @retval None
+  * @param  r The HCI request
+  * @param  opcode The packed command opcode
+  * @retval Index of the slot, HCI_CMD_INFLIGHT_MAX if all slots are in use
   */
-static void move_list(tListNode * dest_list, tListNode * src_list)
+static uint8_t cmd_slot_alloc(struct hci_request* r, uint16_t opcode)
 {
-  pListNode tmp_node;
-  
-  while (!list_is_empty(src_list))
+  uint8_t index;
+
+  for (index = 0; index < HCI_CMD_INFLIGHT_MAX; index++)
   {
-    list_remove_tail(src_list, &tmp_node);
-    list_insert_head(dest_list, tmp_node);
+    if (compare_and_set(&hciCmdSlot[index].state, HCI_CMD_SLOT_IDLE, HCI_CMD_SLOT_CLAIMED))
+    {
+      hciCmdSlot[index].opcode = opcode;
+      hciCmdSlot[index].event  = (r->event == EVT_CMD_STATUS) ? 0 : r->event;
+      hciCmdSlot[index].packet = NULL;
+      hciCmdSlot[index].from_user_evt = (hciUserEvtRxBusy && hci_user_evt_proc_caller()) ? 1 : 0;
+
+      /* Visible to the interrupt only once filled */
+      __DMB();
+      hciCmdSlot[index].state  = HCI_CMD_SLOT_PENDING;
+      break;
+    }
   }
+
+  return index;
 }
 
 /**
-  * @brief  Free the HCI event list.
+  * @brief  Release a command slot, a response received too late is discarded.
   *
-  * @param  None
+  * @param  index Index of the slot
   * @retval None
   */
-static void free_event_list(void)
+static void cmd_slot_free(uint8_t index)
 {
-  tHciDataPacket * pckt;
+  hciCmdSlot[index].packet = NULL;
+
+  /* Done with the slot before another task can claim it */
+  __DMB();
+  hciCmdSlot[index].state  = HCI_CMD_SLOT_IDLE;
 
-  while(list_get_size(&hciReadPktPool) < HCI_READ_PACKET_NUM_MAX/2){
-    list_remove_head(&hciReadPktRxQueue, (tListNode **)&pckt);    
-    list_insert_tail(&hciReadPktPool, (tListNode *)pckt);
+  hci_cmd_resp_release(HCI_CMD_WAIT_SLOT_FREE);
+}
+
+/**
+  * @brief  Give the buffer of a command slot back to the interrupt once its
+  *         response has been parsed, so a further response can be received.
+  *
+  * @param  index Index of the slot
+  * @retval None
+  */
+static void cmd_slot_rearm(uint8_t index)
+{
+  hciCmdSlot[index].packet = NULL;
+}
+
+/**
+  * @brief  Send an HCI command, one caller at a time on the IO Bus.
+  *
+  * @param  r The HCI request
+  * @param  tickstart Tick at which the request started
+  * @retval 0: command sent, -1: IO Bus still busy on timeout
+  */
+static int send_cmd_locked(struct hci_request* r, uint32_t tickstart)
+{
+  while (compare_and_set(&hciSendBusy, 0, 1) == 0)
+  {
+    if ((HAL_GetTick() - tickstart) > HCI_DEFAULT_TIMEOUT_MS)
+      return -1;
+
+    hci_cmd_resp_wait(HCI_CMD_WAIT_BUS_FREE, HCI_DEFAULT_TIMEOUT_MS - (HAL_GetTick() - tickstart));
+  }
+
+  send_cmd(r->ogf, r->ocf, r->clen, r->cparam);
+
+  __DMB();
+  hciSendBusy = 0;
+  hci_cmd_resp_release(HCI_CMD_WAIT_BUS_FREE);
+
+  return 0;
+}
+
+/**
+  * @brief  Copy the command response into the request.
+  *
+  * @param  r The HCI request
+  * @param  hciReadPacket The HCI data packet given to the command slot
+  * @retval 0: done, -1: failed, 1: response still expected
+  */
+static int parse_cmd_resp(struct hci_request* r, tHciDataPacket * hciReadPacket)
+{
+  hci_spi_pckt *hci_hdr = (void *)hciReadPacket->dataBuff;
+  hci_event_pckt *event_pckt = (void *)(hci_hdr->data);
+  uint8_t *ptr = hciReadPacket->dataBuff + (1 + HCI_EVENT_HDR_SIZE);
+  uint32_t len = hciReadPacket->data_len - (1 + HCI_EVENT_HDR_SIZE);
+  evt_cmd_status    *cs;
+  evt_le_meta_event *me;
+
+  switch (event_pckt->evt)
+  {
+  case EVT_CMD_STATUS:
+    cs = (void *) ptr;
+
+    if (r->event != EVT_CMD_STATUS) {
+      if (cs->status) {
+        return -1;
+      }
+      return 1;
+    }
+
+    r->rlen = MIN(len, r->rlen);
+    BLUENRG_memcpy(r->rparam, ptr, r->rlen);
+    return 0;
+
+  case EVT_CMD_COMPLETE:
+    ptr += EVT_CMD_COMPLETE_SIZE;
+    len -= EVT_CMD_COMPLETE_SIZE;
+
+    r->rlen = MIN(len, r->rlen);
+    BLUENRG_memcpy(r->rparam, ptr, r->rlen);
+    return 0;
+
+  case EVT_LE_META_EVENT:
+    me = (void *) ptr;
+
+    len -= 1;
+    r->rlen = MIN(len, r->rlen);
+    BLUENRG_memcpy(r->rparam, me->data, r->rlen);
+    return 0;
+
+  default:
+    return 1;
   }
 }
 
 /********************** HCI Transport layer functions *****************************/
 
-void hci_init(void(* UserEvtRx)(void* pData), void* pConf)
+__weak void hci_user_evt_notify(void)
 {
-  uint8_t index;
+  /* Nothing to do by default, hci_user_evt_proc() is polled */
+}
 
+__weak void hci_cmd_resp_wait(uint32_t flag, uint32_t timeout)
+{
+  /* Nothing to do by default, hci_send_req() polls the command slot */
+}
+
+__weak void hci_cmd_resp_release(uint32_t flag)
+{
+}
+
+__weak uint8_t hci_user_evt_proc_caller(void)
+{
+  /* Without an RTOS, a command sent while UserEvtRx() runs comes from UserEvtRx() */
+  return 1;
+}
+
+void hci_init(void(* UserEvtRx)(void* pData), void* pConf)
+{
   if(UserEvtRx != NULL)
   {
     hciContext.UserEvtRx = UserEvtRx;
   }
   
-  /* Initialize list heads of ready and free hci data packet queues */
-  list_init_head(&hciReadPktPool);
-  list_init_head(&hciReadPktRxQueue);
+  /* Every buffer of the ring is free */
+  hciReadPktHead = 0;
+  hciReadPktTail = 0;
+  hciReadPktParked = 0;
+  hciReadPktStalled = 0;
+  hciReadPktStalls = 0;
+  hciReadPktDropped = 0;
 
   /* Initialize TL BLE layer */
   hci_tl_lowlevel_init();
 
-  /* Initialize the queue of free hci data packets */
-  for (index = 0; index < HCI_READ_PACKET_NUM_MAX; index++)
-  {
-    list_insert_tail(&hciReadPktPool, (tListNode *)&hciReadPacketBuffer[index]);
-  } 
-  
   /* Initialize low level driver */
   if (hciContext.io.Init)  hciContext.io.Init(NULL);
   if (hciContext.io.Reset) hciContext.io.Reset();
@@ -196,193 +585,147 @@ void hci_register_io_bus(tHciIO* fops)
 
 int hci_send_req(struct hci_request* r, BOOL async)
 {
-  uint8_t *ptr;
   uint16_t opcode = htobs(cmd_opcode_pack(r->ogf, r->ocf));
-  hci_event_pckt *event_pckt;
-  hci_spi_pckt *hci_hdr;
-
-  tHciDataPacket * hciReadPacket = NULL;
-  tListNode hciTempQueue;
-  
-  list_init_head(&hciTempQueue);
+  tHciDataPacket * hciReadPacket;
+  uint32_t tickstart = HAL_GetTick();
+  uint32_t elapsed;
+  uint8_t slot;
+  int ret = -1;
 
-  free_event_list();
-  
-  send_cmd(r->ogf, r->ocf, r->clen, r->cparam);
-  
   if (async)
   {
-    return 0;
+    return send_cmd_locked(r, tickstart);
   }
-  
-  while (1) 
+
+  /* Reserve the completion object signalled by the BlueNRG interrupt */
+  while ((slot = cmd_slot_alloc(r, opcode)) == HCI_CMD_INFLIGHT_MAX)
   {
-    evt_cmd_complete  *cc;
-    evt_cmd_status    *cs;
-    evt_le_meta_event *me;
-    uint32_t len;
-    
-    uint32_t tickstart = HAL_GetTick();
-      
-    while (1)
+    elapsed = HAL_GetTick() - tickstart;
+    if (elapsed > HCI_DEFAULT_TIMEOUT_MS)
     {
-      if ((HAL_GetTick() - tickstart) > HCI_DEFAULT_TIMEOUT_MS)
-      {
-        goto failed;
-      }
-      
-      if (!list_is_empty(&hciReadPktRxQueue)) 
-      {
-        break;
-      }
+      return -1;
     }
-    
-    /* Extract packet from HCI event queue. */
-    list_remove_head(&hciReadPktRxQueue, (tListNode **)&hciReadPacket);    
-    
-    hci_hdr = (void *)hciReadPacket->dataBuff;
+    hci_cmd_resp_wait(HCI_CMD_WAIT_SLOT_FREE, HCI_DEFAULT_TIMEOUT_MS - elapsed);
+  }
+
+  /* The response can now be read into the spare buffer if the ring is full */
+  if (hciReadPktStalled)
+  {
+    hciReadPktStalled = 0;
+    hci_tl_lowlevel_resume();
+  }
+
+  if (send_cmd_locked(r, tickstart) < 0)
+  {
+    cmd_slot_free(slot);
+    return -1;
+  }
+
+  while (1)
+  {
+    hciReadPacket = hciCmdSlot[slot].packet;
 
-    if (hci_hdr->type == HCI_EVENT_PKT)
+    if (hciReadPacket != NULL)
     {
-      event_pckt = (void *)(hci_hdr->data);
-    
-      ptr = hciReadPacket->dataBuff + (1 + HCI_EVENT_HDR_SIZE);
-      len = hciReadPacket->data_len - (1 + HCI_EVENT_HDR_SIZE);
-    
-      switch (event_pckt->evt) 
-      {      
-      case EVT_CMD_STATUS:
-        cs = (void *) ptr;
-        
-        if (cs->opcode != opcode)
-          goto failed;
-        
-        if (r->event != EVT_CMD_STATUS) {
-          if (cs->status) {
-            goto failed;
-          }
-          break;
-        }
-
-        r->rlen = MIN(len, r->rlen);
-        BLUENRG_memcpy(r->rparam, ptr, r->rlen);
-        goto done;
-      
-      case EVT_CMD_COMPLETE:
-        cc = (void *) ptr;
-      
-        if (cc->opcode != opcode)
-          goto failed;
-      
-        ptr += EVT_CMD_COMPLETE_SIZE;
-        len -= EVT_CMD_COMPLETE_SIZE;
-      
-        r->rlen = MIN(len, r->rlen);
-        BLUENRG_memcpy(r->rparam, ptr, r->rlen);
-        goto done;
-      
-      case EVT_LE_META_EVENT:
-        me = (void *) ptr;
-      
-        if (me->subevent != r->event)
-          break;
-      
-        len -= 1;
-        r->rlen = MIN(len, r->rlen);
-        BLUENRG_memcpy(r->rparam, me->data, r->rlen);
-        goto done;
-      
-      case EVT_HARDWARE_ERROR:            
-        goto failed;
-      
-      default:      
+      ret = parse_cmd_resp(r, hciReadPacket);
+
+      /* The slot buffer can receive the next response */
+      cmd_slot_rearm(slot);
+
+      if (ret <= 0)
         break;
-      }
-    }
-    
-    /* If there are no more packets to be processed, be sure there is at list one
-       packet in the pool to process the expected event.
-       If no free packets are available, discard the processed event and insert it
-       into the pool. */
-    if (list_is_empty(&hciReadPktPool) && list_is_empty(&hciReadPktRxQueue)) {
-      list_insert_tail(&hciReadPktPool, (tListNode *)hciReadPacket);
-      hciReadPacket=NULL;
-    }
-    else {
-      /* Insert the packet in a different queue. These packets will be
-      inserted back in the main queue just before exiting from send_req(), so that
-      these events can be processed by the application.
-    */
-    list_insert_tail(&hciTempQueue, (tListNode *)hciReadPacket);
-      hciReadPacket=NULL;
+
+      ret = -1;
     }
+
+    if (hciCmdSlot[slot].state == HCI_CMD_SLOT_FAILED)
+      break;
+
+    elapsed = HAL_GetTick() - tickstart;
+    if (elapsed > HCI_DEFAULT_TIMEOUT_MS)
+      break;
+
+    /* Block until the response reaches the slot */
+    hci_cmd_resp_wait(slot, HCI_DEFAULT_TIMEOUT_MS - elapsed);
   }
-  
-failed: 
-  if (hciReadPacket!=NULL) {
-    list_insert_head(&hciReadPktPool, (tListNode *)hciReadPacket);
-  }
-  move_list(&hciReadPktRxQueue, &hciTempQueue);
 
-  return -1;
-  
-done:
-  /* Insert the packet back into the pool.*/
-  list_insert_head(&hciReadPktPool, (tListNode *)hciReadPacket); 
-  move_list(&hciReadPktRxQueue, &hciTempQueue);
+  cmd_slot_free(slot);
 
-  return 0;
+  return ret;
 }
 
 void hci_user_evt_proc(void)
 {
-  tHciDataPacket * hciReadPacket = NULL;
-     
+  uint32_t tail = hciReadPktTail;
+
   /* process any pending events read */
-  while (list_is_empty(&hciReadPktRxQueue) == FALSE)
+  while (1)
   {
-    list_remove_head (&hciReadPktRxQueue, (tListNode **)&hciReadPacket);
+    /* An event parked behind the full ring goes in first, so the order is kept */
+    if (hciReadPktParked && ((hciReadPktHead - tail) < HCI_READ_PACKET_NUM_MAX))
+    {
+      __DMB();
+      publish_parked_packet();
+    }
+
+    if (tail == hciReadPktHead)
+      break;
+
+    /* Head is read before the packet content it publishes */
+    __DMB();
 
     if (hciContext.UserEvtRx != NULL)
     {
-      hciContext.UserEvtRx(hciReadPacket->dataBuff);
+      hciUserEvtRxBusy = 1;
+      hciContext.UserEvtRx(hciReadPacketBuffer[tail % HCI_READ_PACKET_NUM_MAX].dataBuff);
+      hciUserEvtRxBusy = 0;
     }
 
-    list_insert_tail(&hciReadPktPool, (tListNode *)hciReadPacket);
+    /* Done with the buffer before it is handed back to the producer */
+    __DMB();
+    tail++;
+    hciReadPktTail = tail;
+  }
+
+  /* The BlueNRG-2 holds packets the ring had no room for, read them again */
+  if (hciReadPktStalled)
+  {
+    hciReadPktStalled = 0;
+    hci_tl_lowlevel_resume();
   }
 }
 
 int32_t hci_notify_asynch_evt(void* pdata)
 {
   tHciDataPacket * hciReadPacket = NULL;
-  uint8_t data_len;
+  int32_t data_len;
   
   int32_t ret = 0;
   
-  if (list_is_empty (&hciReadPktPool) == FALSE)
+  if (hciPendingReadPacket != NULL)
+  {
+    /* A packet read is still in progress */
+    ret = 1;
+  }
+  else if ((hciReadPacket = read_packet_buffer()) == NULL)
+  {
+    /* Back-pressure: the packet stays in the BlueNRG-2 until the ring has room */
+    hciReadPktStalled = 1;
+    hciReadPktStalls++;
+    ret = 1;
+  }
+  else if (hciContext.io.Receive)
   {
-    /* Queuing a packet to read */
-    list_remove_head (&hciReadPktPool, (tListNode **)&hciReadPacket);
-    
-    if (hciContext.io.Receive)
+    /* Read in place at the head of the ring, or into a reserved buffer */
+    hciPendingReadPacket = hciReadPacket;
+    data_len = hciContext.io.Receive(hciReadPacket->dataBuff, HCI_READ_PACKET_SIZE);
+    if (data_len != HCI_TL_RX_PENDING)
     {
-      data_len = hciContext.io.Receive(hciReadPacket->dataBuff, HCI_READ_PACKET_SIZE);
-      if (data_len > 0)
-      {                    
-        hciReadPacket->data_len = data_len;
-        if (verify_packet(hciReadPacket) == 0)
-          list_insert_tail(&hciReadPktRxQueue, (tListNode *)hciReadPacket);
-        else
-          list_insert_head(&hciReadPktPool, (tListNode *)hciReadPacket);          
-      }
-      else 
-      {
-        /* Insert the packet back into the pool*/
-        list_insert_head(&hciReadPktPool, (tListNode *)hciReadPacket);
-      }
+      hciPendingReadPacket = NULL;
+      queue_read_packet(hciReadPacket, data_len);
     }
   }
-  else 
+  else
   {
     ret = 1;
   }
@@ -390,4 +733,26 @@ int32_t hci_notify_asynch_evt(void* pdata)
   
 }
 
+void hci_read_pool_stats(tHciReadPoolStats * stats)
+{
+  uint32_t head = hciReadPktHead;
+
+  stats->size = HCI_READ_PACKET_NUM_MAX;
+  stats->pending = head - hciReadPktTail;
+  stats->peak = hciReadPktPeak;
+  stats->stalls = hciReadPktStalls;
+  stats->dropped = hciReadPktDropped;
+}
+
+void hci_notify_asynch_evt_cplt(int32_t data_len)
+{
+  tHciDataPacket * hciReadPacket = hciPendingReadPacket;
+
+  if (hciReadPacket != NULL)
+  {
+    hciPendingReadPacket = NULL;
+    queue_read_packet(hciReadPacket, data_len);
+  }
+}
+
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
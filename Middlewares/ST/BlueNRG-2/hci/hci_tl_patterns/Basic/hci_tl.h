@@ -21,6 +21,28 @@
 #include "ble_list.h"
 #include "bluenrg_conf.h"
 
+/**
+ * Value returned by the IO Bus Receive function when the packet payload is
+ * still being transferred (DMA). The transfer is completed by calling
+ * hci_notify_asynch_evt_cplt().
+ */
+#define HCI_TL_RX_PENDING         (-1)
+
+/**
+ * Number of HCI commands that may wait for their response at the same time
+ */
+#ifndef HCI_CMD_INFLIGHT_MAX
+  #define HCI_CMD_INFLIGHT_MAX      (1)
+#endif
+
+/**
+ * Flags passed to hci_cmd_resp_wait()/hci_cmd_resp_release(). Values below
+ * HCI_CMD_INFLIGHT_MAX identify the command slot waiting for its response.
+ */
+#define HCI_CMD_WAIT_SLOT_FREE    (HCI_CMD_INFLIGHT_MAX)
+#define HCI_CMD_WAIT_BUS_FREE     (HCI_CMD_INFLIGHT_MAX + 1)
+#define HCI_CMD_WAIT_FLAG_NUM     (HCI_CMD_INFLIGHT_MAX + 2)
+
 /** 
  * @addtogroup LOW_LEVEL_INTERFACE LOW_LEVEL_INTERFACE
  * @{
@@ -63,7 +85,6 @@ struct hci_request {
  */
 typedef struct _tHciDataPacket
 {
-  tListNode currentNode;
   uint8_t dataBuff[HCI_READ_PACKET_SIZE];
   uint8_t data_len;
 } tHciDataPacket;
@@ -71,6 +92,22 @@ typedef struct _tHciDataPacket
  * @}
  */
 
+/**
+ * @brief Occupancy of the received packet ring, see hci_read_pool_stats()
+ * @{
+ */
+typedef struct
+{
+  uint32_t size;    /**< Packets the ring holds */
+  uint32_t pending; /**< Packets waiting for hci_user_evt_proc() */
+  uint32_t peak;    /**< Highest pending count since power up */
+  uint32_t stalls;  /**< Reads held off in the BlueNRG-2 while the ring was full */
+  uint32_t dropped; /**< User events lost while a command response was awaited */
+} tHciReadPoolStats;
+/**
+ * @}
+ */
+
 /**
  * @brief Structure used to manage the BUS IO operations.
  *        All the structure fields will point to functions defined at user level.
@@ -190,6 +227,27 @@ void hci_register_io_bus(tHciIO* fops);
  */
 int32_t hci_notify_asynch_evt(void* pdata);
 
+/**
+ * @brief  Completes a packet read left pending by hci_notify_asynch_evt() when
+ *         the IO Bus Receive function returned HCI_TL_RX_PENDING.
+ *         It must be called from the transfer complete interrupt.
+ *
+ * @param  data_len Number of bytes received, 0 if the transfer failed
+ * @retval None
+ */
+void hci_notify_asynch_evt_cplt(int32_t data_len);
+
+/**
+ * @brief  Called each time an event is queued for hci_user_evt_proc(), either
+ *         from the BlueNRG interrupt or on return from hci_send_req().
+ *         The application may override this weak function to wake up the
+ *         context that processes the user events.
+ *
+ * @param  None
+ * @retval None
+ */
+void hci_user_evt_notify(void);
+
 /**
  * @brief  This function resume the User Event Flow which has been stopped on return 
  *         from UserEvtRx() when the User Event has not been processed.
@@ -201,26 +259,52 @@ void hci_resume_flow(void);
 
 /**
  * @brief  This function is called when an ACI/HCI command is sent and the response 
- *         is waited from the BLE core.
- *         The application shall implement a mechanism to not return from this function 
- *         until the waited event is received.
- *         This is notified to the application with hci_cmd_resp_release().
+ *         is waited from the BLE core, or when a command slot or the IO Bus is
+ *         not available yet.
+ *         The application may implement a mechanism to block the caller until
+ *         hci_cmd_resp_release() is called with the same flag or until the
+ *         timeout expires. The default implementation returns immediately and
+ *         hci_send_req() keeps polling.
  *         It is called from the same context the HCI command has been sent.
  *
- * @param  timeout: Waiting timeout
+ * @param  flag: Command slot index or HCI_CMD_WAIT_SLOT_FREE/HCI_CMD_WAIT_BUS_FREE
+ * @param  timeout: Waiting timeout in ms
  * @retval None
  */
-void hci_cmd_resp_wait(uint32_t timeout);
+void hci_cmd_resp_wait(uint32_t flag, uint32_t timeout);
 
 /**
- * @brief  This function is called when an ACI/HCI command is sent and the response is
- *         received from the BLE core.
+ * @brief  This function is called when an ACI/HCI command response is
+ *         received from the BLE core (BlueNRG interrupt context), or when a
+ *         command slot or the IO Bus is released (task context).
  *
- * @param  flag: Release flag
+ * @param  flag: Release flag, same values as for hci_cmd_resp_wait()
  * @retval None
  */
 void hci_cmd_resp_release(uint32_t flag);
 
+/**
+ * @brief  Tells whether the caller of hci_send_req() is the context that runs
+ *         hci_user_evt_proc(). Only asked while UserEvtRx() runs, so that the
+ *         response to a command sent from an event callback is still read when
+ *         the ring is full (see hci_read_pool_stats(), dropped).
+ *         An RTOS application overrides this weak function, the default
+ *         returns 1 for a single context.
+ *
+ * @param  None
+ * @retval 1: called from the hci_user_evt_proc() context, 0: otherwise
+ */
+uint8_t hci_user_evt_proc_caller(void);
+
+/**
+ * @brief  Reports how full the received packet ring is. Can be called from any
+ *         task, the values are a snapshot.
+ *
+ * @param  stats: Filled with the ring occupancy
+ * @retval None
+ */
+void hci_read_pool_stats(tHciReadPoolStats * stats);
+
 /**
  * @}
  */
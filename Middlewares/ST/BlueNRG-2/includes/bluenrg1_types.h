@@ -37,7 +37,26 @@ typedef struct hci_command_table_type_s {
 extern const hci_events_table_type hci_events_table[7];
 extern const hci_le_meta_events_table_type hci_le_meta_events_table[10];
 extern const hci_vendor_specific_events_table_type hci_vendor_specific_events_table[43];
+
 #include <stdint.h>
+
+/* Direct-indexed copies of the hci_*_events_table above, in bluenrg1_events_lut.c
+   generated by Tools/gen_events_lut.py.
+   Vendor specific event codes are split in 4 groups (HAL, GAP, L2CAP, GATT/ATT)
+   selected by bits [11:10] of the code, bits [9:0] index the group. */
+#define HCI_EVENTS_LUT_SIZE                   0x31
+#define HCI_LE_META_EVENTS_LUT_SIZE           0x0C
+#define HCI_VENDOR_EVENTS_LUT_GROUPS          4
+#define HCI_VENDOR_EVENTS_LUT_SIZE            0x19
+#define HCI_VENDOR_EVENTS_LUT_GROUP(ecode)    ((uint16_t)(ecode) >> 10)
+#define HCI_VENDOR_EVENTS_LUT_INDEX(ecode)    ((uint16_t)(ecode) & 0x03FF)
+
+extern const hci_event_process hci_events_lut[HCI_EVENTS_LUT_SIZE];
+extern const hci_event_process hci_le_meta_events_lut[HCI_LE_META_EVENTS_LUT_SIZE];
+extern const hci_event_process hci_vendor_specific_events_lut[HCI_VENDOR_EVENTS_LUT_GROUPS][HCI_VENDOR_EVENTS_LUT_SIZE];
+
+hci_event_process hci_events_lut_lookup(uint8_t *event_pckt, uint8_t **evt_data);
+
 /** Documentation for C struct Whitelist_Entry_t */
 typedef PACKED(struct) packed_Whitelist_Entry_t_s {
   /** Address type.
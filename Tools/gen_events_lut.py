@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+"""
+Generator of the direct-indexed HCI event tables (bluenrg1_events_lut.c).
+
+The entries are read from the tables ST generates in bluenrg1_events.c, so the
+lookup tables always hold the same callbacks. Run it again each time
+bluenrg1_events.c is regenerated. The table sizes are checked against the
+HCI_*_LUT_* defines of bluenrg1_types.h.
+
+With --check nothing is written: the exit status is non-zero when the file on
+disk differs from the one generated (run by the host tests, Tools/tests).
+
+Usage: gen_events_lut.py [--check] [--events bluenrg1_events.c] [--types bluenrg1_types.h] [-o bluenrg1_events_lut.c]
+"""
+
+import argparse
+import os
+import re
+import sys
+
+ROOT = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+BLE = os.path.join(ROOT, "Middlewares", "ST", "BlueNRG-2")
+EVENTS_C = os.path.join(BLE, "hci", "bluenrg1_events.c")
+TYPES_H = os.path.join(BLE, "includes", "bluenrg1_types.h")
+LUT_C = os.path.join(BLE, "hci", "bluenrg1_events_lut.c")
+
+# Tables of bluenrg1_events.c
+TABLES = ("hci_events_table", "hci_le_meta_events_table", "hci_vendor_specific_events_table")
+
+# Vendor specific codes, keep in line with HCI_VENDOR_EVENTS_LUT_GROUP/INDEX
+VENDOR_GROUP_SHIFT = 10
+VENDOR_INDEX_MASK = 0x03FF
+
+HEADER = """\
+/**
+  ******************************************************************************
+  * @file    bluenrg1_events_lut.c
+  * @brief   Direct-indexed lookup tables of the BlueNRG-x event callbacks.
+  *          Same entries as the tables of bluenrg1_events.c, indexed by event
+  *          code so that a received event is dispatched with a single lookup.
+  *          Generated by Tools/gen_events_lut.py from bluenrg1_events.c, run
+  *          it again when bluenrg1_events.c is regenerated, do not edit.
+  ******************************************************************************
+  */
+#include <stdint.h>
+#include "bluenrg1_events.h"
+
+"""
+
+LOOKUP = """
+/**
+  * @brief  Callback of an HCI event packet, one bounds check and one lookup.
+  *
+  * @param  event_pckt Event packet, from its event code on
+  * @param  evt_data Set to the parameters given to the callback
+  * @retval Callback of the event, NULL if it has none
+  */
+hci_event_process hci_events_lut_lookup(uint8_t *event_pckt, uint8_t **evt_data)
+{
+  hci_event_pckt *evt_pckt = (hci_event_pckt *)event_pckt;
+
+  if (evt_pckt->evt == EVT_LE_META_EVENT)
+  {
+    evt_le_meta_event *evt = (void *)evt_pckt->data;
+
+    if (evt->subevent < HCI_LE_META_EVENTS_LUT_SIZE)
+    {
+      *evt_data = evt->data;
+      return hci_le_meta_events_lut[evt->subevent];
+    }
+  }
+  else if (evt_pckt->evt == EVT_VENDOR)
+  {
+    evt_blue_aci *blue_evt = (void *)evt_pckt->data;
+    uint16_t group = HCI_VENDOR_EVENTS_LUT_GROUP(blue_evt->ecode);
+    uint16_t index = HCI_VENDOR_EVENTS_LUT_INDEX(blue_evt->ecode);
+
+    if ((group < HCI_VENDOR_EVENTS_LUT_GROUPS) && (index < HCI_VENDOR_EVENTS_LUT_SIZE))
+    {
+      *evt_data = blue_evt->data;
+      return hci_vendor_specific_events_lut[group][index];
+    }
+  }
+  else if (evt_pckt->evt < HCI_EVENTS_LUT_SIZE)
+  {
+    *evt_data = evt_pckt->data;
+    return hci_events_lut[evt_pckt->evt];
+  }
+
+  return NULL;
+}
+"""
+
+
+def read_tables(source):
+    """Entries (code, callback) of each table, in the order of bluenrg1_events.c."""
+    tables = {}
+    for name in TABLES:
+        match = re.search(r"\b%s\[(\d+)\]\s*=\s*\{(.*?)\n\};" % name, source, re.S)
+        if match is None:
+            sys.exit("%s not found in bluenrg1_events.c" % name)
+        entries = [(int(code, 16), process)
+                   for code, process in re.findall(r"\{\s*(0x[0-9A-Fa-f]+)\s*,\s*(\w+)\s*\}", match.group(2))]
+        if len(entries) != int(match.group(1)):
+            sys.exit("%s: %d entries read, %s declared" % (name, len(entries), match.group(1)))
+        tables[name] = entries
+    return tables
+
+
+def read_sizes(source):
+    """HCI_*_LUT_* defines of bluenrg1_types.h."""
+    sizes = dict((name, int(value, 0)) for name, value in
+                 re.findall(r"#define\s+(HCI_\w+_LUT_(?:SIZE|GROUPS))\s+(0x[0-9A-Fa-f]+|\d+)", source))
+    for name in ("HCI_EVENTS_LUT_SIZE", "HCI_LE_META_EVENTS_LUT_SIZE",
+                 "HCI_VENDOR_EVENTS_LUT_GROUPS", "HCI_VENDOR_EVENTS_LUT_SIZE"):
+        if name not in sizes:
+            sys.exit("%s not defined in bluenrg1_types.h" % name)
+    return sizes
+
+
+def check_sizes(tables, sizes):
+    """Every code fits its table and the tables are no larger than needed."""
+    vendor = tables["hci_vendor_specific_events_table"]
+    needed = {
+        "HCI_EVENTS_LUT_SIZE": max(code for code, _ in tables["hci_events_table"]) + 1,
+        "HCI_LE_META_EVENTS_LUT_SIZE": max(code for code, _ in tables["hci_le_meta_events_table"]) + 1,
+        "HCI_VENDOR_EVENTS_LUT_GROUPS": max(code >> VENDOR_GROUP_SHIFT for code, _ in vendor) + 1,
+        "HCI_VENDOR_EVENTS_LUT_SIZE": max(code & VENDOR_INDEX_MASK for code, _ in vendor) + 1,
+    }
+    errors = ["%s is 0x%02X, the tables need 0x%02X" % (name, sizes[name], value)
+              for name, value in sorted(needed.items()) if sizes[name] != value]
+    for name, entries in tables.items():
+        codes = [code for code, _ in entries]
+        if len(set(codes)) != len(codes):
+            errors.append("%s has a code twice, the linear search keeps the first one only" % name)
+    return errors
+
+
+def generate(tables):
+    out = [HEADER]
+    for name in TABLES:
+        out += ["tBleStatus %s(uint8_t *buffer_in);\n" % process for _, process in tables[name]]
+    out.append("\n")
+
+    out.append("const hci_event_process hci_events_lut[HCI_EVENTS_LUT_SIZE] = {\n")
+    out.append(",\n".join("  [0x%04x] = %s" % entry for entry in tables["hci_events_table"]))
+    out.append("\n};\n")
+
+    out.append("const hci_event_process hci_le_meta_events_lut[HCI_LE_META_EVENTS_LUT_SIZE] = {\n")
+    out.append(",\n".join("  [0x%04x] = %s" % entry for entry in tables["hci_le_meta_events_table"]))
+    out.append("\n};\n")
+
+    groups = {}
+    for code, process in tables["hci_vendor_specific_events_table"]:
+        groups.setdefault(code >> VENDOR_GROUP_SHIFT, []).append((code & VENDOR_INDEX_MASK, process))
+    out.append("const hci_event_process hci_vendor_specific_events_lut"
+               "[HCI_VENDOR_EVENTS_LUT_GROUPS][HCI_VENDOR_EVENTS_LUT_SIZE] = {\n")
+    out.append(",\n".join("  [%d] = {\n%s\n  }" % (group, ",\n".join("    [0x%02x] = %s" % entry for entry in entries))
+                          for group, entries in sorted(groups.items())))
+    out.append("\n};\n")
+
+    out.append(LOOKUP)
+    return "".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--check", action="store_true", help="compare with the output file instead of writing it")
+    parser.add_argument("--events", default=EVENTS_C, help="bluenrg1_events.c generated by ST")
+    parser.add_argument("--types", default=TYPES_H, help="bluenrg1_types.h holding the table sizes")
+    parser.add_argument("-o", "--output", default=LUT_C, help="bluenrg1_events_lut.c to write")
+    args = parser.parse_args()
+
+    with open(args.events) as handle:
+        tables = read_tables(handle.read())
+    with open(args.types) as handle:
+        errors = check_sizes(tables, read_sizes(handle.read()))
+    if errors:
+        sys.exit("\n".join(errors))
+
+    lut = generate(tables)
+
+    if args.check:
+        with open(args.output) as handle:
+            if handle.read() != lut:
+                sys.exit("%s is not the one generated from %s, run gen_events_lut.py" % (args.output, args.events))
+        print("%d + %d + %d events, lookup tables up to date" % tuple(len(tables[name]) for name in TABLES))
+        return
+
+    with open(args.output, "w") as handle:
+        handle.write(lut)
+    print("%d + %d + %d events written to %s" % (tuple(len(tables[name]) for name in TABLES) + (args.output,)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+"""
+Post-link RAM budget report of the FreeRTOS kernel objects (FRTOS_STATIC_ALLOCATION).
+
+Reads xFrtosRamBudget from the linked firmware, the sizes car_app_freertos.c
+resolved at compile time for the static and the heap layouts, and adds the
+sizes of the objects actually linked: task stacks and TCBs, timers, queues,
+semaphores and the heap_4 pool. The preprocessor cannot evaluate sizeof, so
+these figures only exist once the firmware is built.
+
+The exit status is non-zero when the selected layout does not fit its budget,
+so it can run as the post-build step of the IDE:
+    python3 ../Tools/ram_budget.py ${ProjName}.elf
+
+Usage: ram_budget.py [--budget BYTES] firmware.elf
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+# Keep in line with FRTOS_RamBudget_t (car_app_freertos.h)
+BUDGET_SYMBOL = "xFrtosRamBudget"
+BUDGET_FORMAT = "I"                 # StaticBytes, HeapBytes, HeapSize
+BUDGET_FIELDS = 3
+HEAP_SYMBOL = "ucHeap"              # heap_4 pool, configTOTAL_HEAP_SIZE bytes
+
+# FRTOS_RAM_KERNEL_BUDGET of FreeRTOSConfig.h
+KERNEL_BUDGET = 32768
+
+# Statically allocated kernel objects of car_app_freertos.c
+STATIC_OBJECTS = re.compile(r"^s_(TaskStack_|TaskTCB_|Tim\w+Buffer$|Queue\w+(Buffer|Storage)$|SemHciCmdBuffer$)")
+
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+
+
+class Elf:
+    """Symbols and section contents of an ELF file, 32 or 64 bits."""
+
+    def __init__(self, data):
+        if data[:4] != b"\x7fELF":
+            raise ValueError("not an ELF file")
+        self.data = data
+        self.is64 = data[4] == 2
+        self.endian = "<" if data[5] == 1 else ">"
+        if self.is64:
+            shoff, = struct.unpack_from(self.endian + "Q", data, 0x28)
+            shentsize, shnum = struct.unpack_from(self.endian + "HH", data, 0x3A)
+            section = self.endian + "IIQQQQIIQQ"
+        else:
+            shoff, = struct.unpack_from(self.endian + "I", data, 0x20)
+            shentsize, shnum = struct.unpack_from(self.endian + "HH", data, 0x2E)
+            section = self.endian + "IIIIIIIIII"
+        # name, type, flags, addr, offset, size, link, info, addralign, entsize
+        self.sections = [struct.unpack_from(section, data, shoff + idx * shentsize) for idx in range(shnum)]
+
+    def _string(self, table, offset):
+        start = self.sections[table][4] + offset
+        return self.data[start:self.data.index(b"\0", start)].decode()
+
+    def symbols(self):
+        """(name, value, size, section index) of every symbol, local ones included."""
+        symbol = self.endian + ("IBBHQQ" if self.is64 else "IIIBBH")
+        entsize = struct.calcsize(symbol)
+        for header in self.sections:
+            if header[1] != SHT_SYMTAB:
+                continue
+            for offset in range(header[4], header[4] + header[5], entsize):
+                fields = struct.unpack_from(symbol, self.data, offset)
+                if self.is64:
+                    name, _, _, shndx, value, size = fields
+                else:
+                    name, value, size, _, _, shndx = fields
+                if name:
+                    yield self._string(header[6], name), value, size, shndx
+
+    def read(self, shndx, value, size):
+        """Contents of a symbol, None when it has none in the file (.bss)."""
+        header = self.sections[shndx]
+        if header[1] == SHT_NOBITS:
+            return None
+        start = header[4] + value - header[3]
+        return self.data[start:start + size]
+
+
+def report(elf, budget):
+    """Lines of the report and whether the selected layout fits."""
+    symbols = dict((name, (value, size, shndx)) for name, value, size, shndx in elf.symbols())
+    if BUDGET_SYMBOL not in symbols:
+        raise ValueError("%s not found, not a FreeRTOS_BLE_Car firmware or stripped" % BUDGET_SYMBOL)
+
+    value, size, shndx = symbols[BUDGET_SYMBOL]
+    fmt = elf.endian + BUDGET_FORMAT * BUDGET_FIELDS
+    static_bytes, heap_bytes, heap_size = struct.unpack(fmt, elf.read(shndx, value, struct.calcsize(fmt)))
+
+    linked = sorted((name, size) for name, (_, size, _) in symbols.items() if STATIC_OBJECTS.match(name))
+    linked_bytes = sum(size for _, size in linked)
+    pool = symbols.get(HEAP_SYMBOL, (0, 0, 0))[1]
+    is_static = bool(linked)
+
+    lines = [
+        "Static layout: %6d bytes in .bss + %6d bytes of heap = %6d" % (static_bytes, heap_size, static_bytes + heap_size),
+        "Heap layout:   %6d bytes from heap_4" % heap_bytes,
+        "Selected:      %s layout, configTOTAL_HEAP_SIZE %d, ucHeap %d linked" %
+        ("static" if is_static else "heap", heap_size, pool),
+    ]
+    if is_static:
+        lines += ["  %-28s %6d" % entry for entry in linked]
+        lines.append("  %-28s %6d" % ("total", linked_bytes))
+        if linked_bytes != static_bytes:
+            lines.append("warning: %d bytes linked, %d computed, FRTOS_RAM_STATIC_BYTES is out of date"
+                         % (linked_bytes, static_bytes))
+        used = linked_bytes + pool
+        fits = used <= budget
+    else:
+        used = pool
+        fits = (heap_bytes <= heap_size) and (pool <= budget)
+    lines.append("Budget:        %6d of %d bytes, %d left" % (used, budget, budget - used))
+    return lines, fits
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--budget", type=int, default=KERNEL_BUDGET, help="FRTOS_RAM_KERNEL_BUDGET in bytes")
+    parser.add_argument("elf", help="linked firmware")
+    args = parser.parse_args()
+
+    with open(args.elf, "rb") as handle:
+        data = handle.read()
+    try:
+        lines, fits = report(Elf(data), args.budget)
+    except ValueError as error:
+        sys.exit("%s: %s" % (args.elf, error))
+
+    print("\n".join(lines))
+    if not fits:
+        sys.exit("%s: kernel objects over the RAM budget" % args.elf)
+
+
+if __name__ == "__main__":
+    main()
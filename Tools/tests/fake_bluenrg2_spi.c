@@ -0,0 +1,577 @@
+/**
+  **************************************************************************************************
+  * @file           : fake_bluenrg2_spi.c
+  * @brief          : Host fake of the BlueNRG-2 behind SPI1, its IRQ line on EXTI0 and the SPI1 DMA,
+  *  				  under the unchanged hci_tl_interface.c. The controller speaks the SPI header
+  *  				  protocol of the BlueNRG-2 (0x0B read / 0x0A write, 5 byte header) and keeps its
+  *  				  IRQ line high while it holds a packet or CS is low. A thread plays the EXTI0
+  *  				  interrupt and another the DMA completion interrupt, both serialized on a
+  *  				  "CPU" lock that HAL_NVIC_DisableIRQ() also takes, so a masked interrupt never
+  *  				  runs under the task. Bytes are clocked at the SPI1 rate of the target, and
+  *  				  counted by context: interrupt, task or DMA.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hci_tl_interface.h"
+#include "fake_bluenrg2_spi.h"
+
+
+/* Private define --------------------------------------------------------------------------------*/
+#define FAKE_HEADER_READ						0x0B
+#define FAKE_HEADER_WRITE						0x0A
+#define FAKE_HEADER_READY						0x02
+#define FAKE_WRITE_SPACE						128
+
+
+/* Private typedef -------------------------------------------------------------------------------*/
+typedef enum
+{
+	SPI_PHASE_IDLE = 0,
+	SPI_PHASE_HEADER,
+	SPI_PHASE_READ,
+	SPI_PHASE_WRITE
+
+} FakeSpiPhase;
+
+typedef struct
+{
+	uint8_t Length;
+	uint8_t Data[FAKE_PACKET_SIZE_MAX];
+
+} FakePacket;
+
+typedef struct
+{
+	uint8_t *pTx;
+	uint8_t *pRx;
+	uint16_t Length;
+
+} FakeDmaJob;
+
+
+/* Exported/Global variables ---------------------------------------------------------------------*/
+FakeSpiStats g_FakeSpi;
+FakeCommandHandler g_FakeCommandHandler;
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+/*--- Controller, its FIFO and the SPI slave state ---*/
+static pthread_mutex_t s_Lock = PTHREAD_MUTEX_INITIALIZER;
+static FakePacket s_Fifo[FAKE_FIFO_PACKETS];
+static uint32_t s_FifoHead, s_FifoTail;
+static uint8_t s_CsLow;
+static uint8_t s_LineLevel;
+static FakeSpiPhase s_Phase;
+static uint8_t s_HeaderIdx;
+static uint8_t s_HeaderMaster[FAKE_SPI_HEADER_SIZE];
+static uint8_t s_HeaderSlave[FAKE_SPI_HEADER_SIZE];
+static uint16_t s_ReadIdx, s_ReadLength;
+static uint8_t s_Command[FAKE_WRITE_SPACE + FAKE_SPI_HEADER_SIZE];
+static uint16_t s_CommandLength;
+
+/*--- Interrupt controller: the CPU lock, the EXTI0 pending bit and the NVIC enable ---*/
+static pthread_mutex_t s_Cpu;				/* Recursive, the EXTI callback masks EXTI0 itself */
+static pthread_mutex_t s_Nvic = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_NvicCond = PTHREAD_COND_INITIALIZER;
+static uint8_t s_ExtiPending;
+static uint8_t s_ExtiEnabled;
+static EXTI_HandleTypeDef *s_pExti;
+
+/*--- SPI1 DMA ---*/
+static pthread_mutex_t s_DmaLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_DmaCond = PTHREAD_COND_INITIALIZER;
+static FakeDmaJob s_DmaJob;
+#if (HCI_TL_SPI_RX_USE_DMA == 1)
+static pthread_t s_DmaThread;
+#endif
+
+static volatile uint8_t s_Stop;
+static pthread_t s_ExtiThread;
+static __thread uint8_t s_InIsr;
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+static uint64_t Fake_Now_ns(void)
+{
+	struct timespec Now;
+
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return ((uint64_t)Now.tv_sec * 1000000000ull) + (uint64_t)Now.tv_nsec;
+}
+
+
+/**
+ * @brief	Sets the EXTI0 pending bit, the interrupt runs once the NVIC line is enabled
+ */
+static void Exti_Pend(void)
+{
+	pthread_mutex_lock(&s_Nvic);
+	s_ExtiPending = 1;
+	pthread_cond_signal(&s_NvicCond);
+	pthread_mutex_unlock(&s_Nvic);
+}
+
+
+/**
+ * @brief	Follows the IRQ line after a change of the controller state, a rising edge pends EXTI0.
+ * 			Called with s_Lock held.
+ */
+static void Line_Update(void)
+{
+	uint8_t Level = (s_FifoHead != s_FifoTail) || s_CsLow;
+
+	if(Level && !s_LineLevel)
+		Exti_Pend();
+
+	s_LineLevel = Level;
+}
+
+
+/**
+ * @brief	The packet at the head of the FIFO is gone once the host read some of it
+ */
+static void Fifo_Pop(void)
+{
+	s_FifoTail++;
+	g_FakeSpi.Reads++;
+}
+
+
+static uint8_t Spi_Byte(uint8_t Tx)
+{
+	FakePacket *pHead = &s_Fifo[s_FifoTail % FAKE_FIFO_PACKETS];
+	uint8_t Rx = 0;
+
+	switch(s_Phase)
+	{
+		case SPI_PHASE_HEADER:
+			if(s_HeaderIdx == 0)
+			{
+				s_ReadLength = (s_FifoHead != s_FifoTail) ? pHead->Length : 0;
+				s_HeaderSlave[0] = FAKE_HEADER_READY;
+				s_HeaderSlave[1] = (uint8_t)FAKE_WRITE_SPACE;
+				s_HeaderSlave[2] = 0;
+				s_HeaderSlave[3] = (uint8_t)s_ReadLength;
+				s_HeaderSlave[4] = (uint8_t)(s_ReadLength >> 8);
+			}
+
+			s_HeaderMaster[s_HeaderIdx] = Tx;
+			Rx = s_HeaderSlave[s_HeaderIdx++];
+
+			if(s_HeaderIdx == FAKE_SPI_HEADER_SIZE)
+			{
+				s_ReadIdx = 0;
+				s_CommandLength = 0;
+
+				if(s_HeaderMaster[0] == FAKE_HEADER_WRITE)
+					s_Phase = SPI_PHASE_WRITE;
+				else
+				{
+					s_Phase = SPI_PHASE_READ;
+					if(s_ReadLength == 0)
+						g_FakeSpi.EmptyReads++;
+				}
+			}
+			break;
+
+		case SPI_PHASE_READ:
+			if(s_ReadIdx < s_ReadLength)
+			{
+				Rx = pHead->Data[s_ReadIdx++];
+				if(s_ReadIdx == s_ReadLength)
+					Fifo_Pop();
+			}
+			break;
+
+		case SPI_PHASE_WRITE:
+			if(s_CommandLength < sizeof(s_Command))
+				s_Command[s_CommandLength++] = Tx;
+			break;
+
+		default:
+			/* Clocked with CS high, the controller does not listen */
+			break;
+	}
+
+	return Rx;
+}
+
+
+/**
+ * @brief	Moves Length bytes either way, the byte count goes to the context that clocked them
+ */
+static void Spi_Transfer(uint8_t *pTx, uint8_t *pRx, uint16_t Length, uint64_t *pCounter)
+{
+	pthread_mutex_lock(&s_Lock);
+
+	for(uint16_t idx = 0; idx < Length; idx++)
+		pRx[idx] = Spi_Byte(pTx[idx]);
+
+	*pCounter += Length;
+
+	pthread_mutex_unlock(&s_Lock);
+}
+
+
+/**
+ * @brief	The CPU clocks the bytes out itself, it spins for the time they take on the bus
+ */
+static void Spi_Spin(uint16_t Length)
+{
+	uint64_t End = Fake_Now_ns() + ((uint64_t)Length * FAKE_SPI_BYTE_NS);
+
+	while(Fake_Now_ns() < End);
+}
+
+
+/**
+ * @brief	EXTI0 interrupt, runs the callback registered by hci_tl_lowlevel_init()
+ */
+static void *Thread_Exti(void *pArg)
+{
+	uint8_t Run;
+	uint64_t Start;
+
+	while(1)
+	{
+		pthread_mutex_lock(&s_Nvic);
+		while(!(s_ExtiPending && s_ExtiEnabled) && !s_Stop)
+			pthread_cond_wait(&s_NvicCond, &s_Nvic);
+		pthread_mutex_unlock(&s_Nvic);
+
+		if(s_Stop)
+			break;
+
+		/* Masked meanwhile by the task, in which case the pending bit stays */
+		pthread_mutex_lock(&s_Cpu);
+		pthread_mutex_lock(&s_Nvic);
+		Run = s_ExtiPending && s_ExtiEnabled;
+		if(Run)
+			s_ExtiPending = 0;
+		pthread_mutex_unlock(&s_Nvic);
+
+		if(Run && (s_pExti != NULL) && (s_pExti->PendingCallback != NULL))
+		{
+			s_InIsr = 1;
+			Start = Fake_Now_ns();
+			s_pExti->PendingCallback();
+			g_FakeSpi.IsrTime_ns += Fake_Now_ns() - Start;
+			g_FakeSpi.Interrupts++;
+			s_InIsr = 0;
+		}
+		pthread_mutex_unlock(&s_Cpu);
+	}
+
+	return NULL;
+}
+
+
+#if (HCI_TL_SPI_RX_USE_DMA == 1)
+/**
+ * @brief	SPI1 DMA: the payload takes its bus time, then the completion interrupt runs
+ */
+static void *Thread_Dma(void *pArg)
+{
+	FakeDmaJob Job;
+	struct timespec Wait;
+	uint64_t Start;
+
+	while(1)
+	{
+		pthread_mutex_lock(&s_DmaLock);
+		while((s_DmaJob.Length == 0) && !s_Stop)
+			pthread_cond_wait(&s_DmaCond, &s_DmaLock);
+		Job = s_DmaJob;
+		pthread_mutex_unlock(&s_DmaLock);
+
+		if(s_Stop)
+			break;
+
+		Wait.tv_sec = 0;
+		Wait.tv_nsec = (long)Job.Length * FAKE_SPI_BYTE_NS;
+		nanosleep(&Wait, NULL);
+
+		pthread_mutex_lock(&s_Cpu);
+		Spi_Transfer(Job.pTx, Job.pRx, Job.Length, &g_FakeSpi.DmaBytes);
+
+		/* The stream is free again before the callback, which may start the next packet */
+		pthread_mutex_lock(&s_DmaLock);
+		s_DmaJob.Length = 0;
+		pthread_mutex_unlock(&s_DmaLock);
+
+		s_InIsr = 1;
+		Start = Fake_Now_ns();
+		HCI_TL_SPI_RxCpltCallback(BSP_ERROR_NONE);
+		g_FakeSpi.IsrTime_ns += Fake_Now_ns() - Start;
+		g_FakeSpi.DmaInterrupts++;
+		s_InIsr = 0;
+		pthread_mutex_unlock(&s_Cpu);
+	}
+
+	return NULL;
+}
+#endif
+
+
+/**
+ * @brief	Starts the interrupt threads, the FIFO and the statistics start empty
+ */
+void FakeBlueNRG_Start(void)
+{
+	pthread_mutexattr_t Attributes;
+
+	pthread_mutexattr_init(&Attributes);
+	pthread_mutexattr_settype(&Attributes, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&s_Cpu, &Attributes);
+	pthread_mutexattr_destroy(&Attributes);
+
+	memset(&g_FakeSpi, 0, sizeof(g_FakeSpi));
+	s_FifoHead = s_FifoTail = 0;
+	s_Stop = 0;
+
+	pthread_create(&s_ExtiThread, NULL, Thread_Exti, NULL);
+#if (HCI_TL_SPI_RX_USE_DMA == 1)
+	pthread_create(&s_DmaThread, NULL, Thread_Dma, NULL);
+#endif
+}
+
+
+void FakeBlueNRG_Stop(void)
+{
+	s_Stop = 1;
+
+	pthread_mutex_lock(&s_Nvic);
+	pthread_cond_broadcast(&s_NvicCond);
+	pthread_mutex_unlock(&s_Nvic);
+	pthread_join(s_ExtiThread, NULL);
+
+#if (HCI_TL_SPI_RX_USE_DMA == 1)
+	pthread_mutex_lock(&s_DmaLock);
+	pthread_cond_broadcast(&s_DmaCond);
+	pthread_mutex_unlock(&s_DmaLock);
+	pthread_join(s_DmaThread, NULL);
+#endif
+}
+
+
+/**
+ * @brief	The controller has a packet for the host, the IRQ line goes high if it was low
+ */
+void FakeBlueNRG_Queue(const uint8_t *pPacket, uint8_t Length)
+{
+	pthread_mutex_lock(&s_Lock);
+
+	if(((s_FifoHead - s_FifoTail) >= FAKE_FIFO_PACKETS) || (Length > FAKE_PACKET_SIZE_MAX))
+	{
+		printf("FAIL: fake controller FIFO overflow\n");
+		exit(1);
+	}
+
+	s_Fifo[s_FifoHead % FAKE_FIFO_PACKETS].Length = Length;
+	memcpy(s_Fifo[s_FifoHead % FAKE_FIFO_PACKETS].Data, pPacket, Length);
+	s_FifoHead++;
+
+	if((s_FifoHead - s_FifoTail) > g_FakeSpi.FifoPeak)
+		g_FakeSpi.FifoPeak = s_FifoHead - s_FifoTail;
+
+	Line_Update();
+
+	pthread_mutex_unlock(&s_Lock);
+}
+
+
+uint32_t FakeBlueNRG_Pending(void)
+{
+	uint32_t Pending;
+
+	pthread_mutex_lock(&s_Lock);
+	Pending = s_FifoHead - s_FifoTail;
+	pthread_mutex_unlock(&s_Lock);
+
+	return Pending;
+}
+
+
+/*--- BSP SPI1 ---*/
+int32_t BSP_SPI1_Init(void)
+{
+	return BSP_ERROR_NONE;
+}
+
+
+int32_t BSP_SPI1_SendRecv(uint8_t *pTxData, uint8_t *pRxData, uint16_t Length)
+{
+	Spi_Spin(Length);
+	Spi_Transfer(pTxData, pRxData, Length, s_InIsr ? &g_FakeSpi.IsrBytes : &g_FakeSpi.TaskBytes);
+
+	return BSP_ERROR_NONE;
+}
+
+
+int32_t BSP_SPI1_SendRecv_DMA(uint8_t *pTxData, uint8_t *pRxData, uint16_t Length)
+{
+	int32_t Status = BSP_ERROR_UNKNOWN_FAILURE;
+
+	pthread_mutex_lock(&s_DmaLock);
+	if((s_DmaJob.Length == 0) && (Length != 0))
+	{
+		s_DmaJob.pTx = pTxData;
+		s_DmaJob.pRx = pRxData;
+		s_DmaJob.Length = Length;
+		pthread_cond_signal(&s_DmaCond);
+		Status = BSP_ERROR_NONE;
+	}
+	pthread_mutex_unlock(&s_DmaLock);
+
+	return Status;
+}
+
+
+int32_t BSP_GetTick(void)
+{
+	return (int32_t)HAL_GetTick();
+}
+
+
+/*--- HAL GPIO, NVIC and EXTI ---*/
+void HAL_Delay(uint32_t Delay)
+{
+	usleep(Delay * 1000);
+}
+
+
+void HAL_GPIO_Init(void *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+}
+
+
+void HAL_GPIO_DeInit(void *GPIOx, uint32_t GPIO_Pin)
+{
+}
+
+
+GPIO_PinState HAL_GPIO_ReadPin(void *GPIOx, uint16_t GPIO_Pin)
+{
+	uint8_t Level = 0;
+
+	if((GPIOx == HCI_TL_SPI_IRQ_PORT) && (GPIO_Pin == HCI_TL_SPI_IRQ_PIN))
+	{
+		pthread_mutex_lock(&s_Lock);
+		Level = s_LineLevel;
+		pthread_mutex_unlock(&s_Lock);
+	}
+
+	return Level ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+
+/**
+ * @brief	CS edges frame the transactions, a write is handed to the command handler as CS rises
+ */
+void HAL_GPIO_WritePin(void *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	uint8_t Command[sizeof(s_Command)];
+	uint16_t CommandLength = 0;
+
+	if((GPIOx != HCI_TL_SPI_CS_PORT) || (GPIO_Pin != HCI_TL_SPI_CS_PIN))
+		return;
+
+	pthread_mutex_lock(&s_Lock);
+
+	if((PinState == GPIO_PIN_RESET) && !s_CsLow)
+	{
+		s_CsLow = 1;
+		s_Phase = SPI_PHASE_HEADER;
+		s_HeaderIdx = 0;
+	}
+	else if((PinState == GPIO_PIN_SET) && s_CsLow)
+	{
+		/* A packet read only in part is dropped all the same */
+		if((s_Phase == SPI_PHASE_READ) && (s_ReadIdx != 0) && (s_ReadIdx < s_ReadLength))
+			Fifo_Pop();
+
+		if((s_Phase == SPI_PHASE_WRITE) && (s_CommandLength != 0))
+		{
+			CommandLength = s_CommandLength;
+			memcpy(Command, s_Command, CommandLength);
+			g_FakeSpi.Writes++;
+		}
+
+		s_CsLow = 0;
+		s_Phase = SPI_PHASE_IDLE;
+	}
+
+	Line_Update();
+
+	pthread_mutex_unlock(&s_Lock);
+
+	if((CommandLength != 0) && (g_FakeCommandHandler != NULL))
+		g_FakeCommandHandler(Command, CommandLength);
+}
+
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+}
+
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+	if(IRQn != HCI_TL_SPI_EXTI_IRQn)
+		return;
+
+	pthread_mutex_lock(&s_Nvic);
+	s_ExtiEnabled = 1;
+	pthread_cond_signal(&s_NvicCond);
+	pthread_mutex_unlock(&s_Nvic);
+}
+
+
+/**
+ * @brief	Returns with the EXTI0 interrupt masked and not running, as it cannot preempt the caller
+ */
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+	if(IRQn != HCI_TL_SPI_EXTI_IRQn)
+		return;
+
+	pthread_mutex_lock(&s_Cpu);
+	pthread_mutex_lock(&s_Nvic);
+	s_ExtiEnabled = 0;
+	pthread_mutex_unlock(&s_Nvic);
+	pthread_mutex_unlock(&s_Cpu);
+}
+
+
+HAL_StatusTypeDef HAL_EXTI_GetHandle(EXTI_HandleTypeDef *hexti, uint32_t ExtiLine)
+{
+	hexti->Line = ExtiLine;
+	s_pExti = hexti;
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_EXTI_RegisterCallback(EXTI_HandleTypeDef *hexti, EXTI_CallbackIDTypeDef CallbackID, void (*pPendingCbfn)(void))
+{
+	hexti->PendingCallback = pPendingCbfn;
+	return HAL_OK;
+}
+
+
+void HAL_EXTI_GenerateSWI(EXTI_HandleTypeDef *hexti)
+{
+	Exti_Pend();
+}
+
+
+/******************************************* END OF FILE *******************************************/
@@ -0,0 +1,66 @@
+/**
+  **************************************************************************************************
+  * @file           : fake_bluenrg2_spi.h
+  * @brief          : Header for fake_bluenrg2_spi.c file, the host fake of the BlueNRG-2 on SPI1.
+  * @author         : Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Define to prevent recursive inclusion ---------------------------------------------------------*/
+#ifndef __FAKE_BLUENRG2_SPI_H
+#define __FAKE_BLUENRG2_SPI_H
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdint.h>
+
+
+/* Exported defines ------------------------------------------------------------------------------*/
+	/*--- SPI1 clock of the target, 100MHz APB2 / 128, 8 bits per byte ---*/
+	#define FAKE_SPI_BYTE_NS					10240
+
+	/*--- Packets the controller buffers for the host ---*/
+	#define FAKE_FIFO_PACKETS					256
+	#define FAKE_PACKET_SIZE_MAX				128		/* HCI_READ_PACKET_SIZE */
+
+	/*--- Bytes of the SPI header, either way ---*/
+	#define FAKE_SPI_HEADER_SIZE				5
+
+
+/* Exported types --------------------------------------------------------------------------------*/
+	typedef struct
+	{
+		uint32_t Interrupts;			/* EXTI interrupts run, software ones included */
+		uint32_t DmaInterrupts;			/* SPI1 DMA transfer completions */
+		uint32_t Reads;					/* Read transactions that carried a packet */
+		uint32_t EmptyReads;			/* Read transactions with nothing to read */
+		uint32_t Writes;				/* Write transactions that carried a command */
+		uint64_t IsrBytes;				/* Bytes clocked by the CPU in interrupt context */
+		uint64_t TaskBytes;				/* Bytes clocked by the CPU in task context */
+		uint64_t DmaBytes;				/* Bytes moved by the DMA */
+		uint64_t IsrTime_ns;			/* Host time spent in the EXTI and DMA interrupts */
+		uint32_t FifoPeak;
+
+	} FakeSpiStats;
+
+	/*--- Called on the task thread when CS rises at the end of a write, the command whole ---*/
+	typedef void (*FakeCommandHandler)(const uint8_t *pCommand, uint16_t Length);
+
+
+/* Exported variables ----------------------------------------------------------------------------*/
+extern FakeSpiStats g_FakeSpi;
+extern FakeCommandHandler g_FakeCommandHandler;
+
+
+/* Exported Functions Prototypes -----------------------------------------------------------------*/
+void FakeBlueNRG_Start(void);
+void FakeBlueNRG_Stop(void);
+void FakeBlueNRG_Queue(const uint8_t *pPacket, uint8_t Length);
+uint32_t FakeBlueNRG_Pending(void);
+
+
+#endif  /* __FAKE_BLUENRG2_SPI_H */
+
+
+/******************************************* END OF FILE *******************************************/
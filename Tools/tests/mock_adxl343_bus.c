@@ -0,0 +1,260 @@
+/**
+  **************************************************************************************************
+  * @file           : mock_adxl343_bus.c
+  * @brief          : Host mock of I2C1 with an ADXL343 on it. The HAL transfer calls update a register
+  *  				  file, and a thread plays the I2C1 event/DMA interrupt that completes each
+  *  				  _IT/_DMA transfer through __io_accelerometer_i2cCpltCallback(), some time later.
+  *  				  Every transfer is logged, and NACKs, hangs and INT1 edges can be injected.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "i2c.h"
+#include "adxl343_io.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "mock_adxl343_bus.h"
+
+
+/* Private define --------------------------------------------------------------------------------*/
+#define MOCK_XFER_TIME_US						100		/* Start to completion interrupt */
+
+
+/* Private typedef -------------------------------------------------------------------------------*/
+typedef struct
+{
+	uint8_t Read;
+	uint8_t Register;
+	uint8_t *pData;
+	uint16_t Length;
+	uint8_t Nack;
+	uint8_t Int1;
+
+} MockJob;
+
+
+/* Exported/Global variables ---------------------------------------------------------------------*/
+I2C_HandleTypeDef hi2c1;
+DMA_HandleTypeDef hdma_i2c1_rx;
+
+uint8_t g_MockRegisters[0x40];
+MockBusStats g_MockBus;
+
+volatile uint32_t g_MockNacks;
+volatile uint32_t g_MockHangs;
+volatile uint32_t g_MockInt1;
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+static void MockBus_Log(MockTransferType Type, uint8_t Register, uint16_t Length)
+{
+	MockTransfer *pEntry = &g_MockBus.Log[g_MockBus.Transfers % MOCK_BUS_LOG_SIZE];
+
+	pEntry->Type = Type;
+	pEntry->Register = Register;
+	pEntry->Length = Length;
+	g_MockBus.Transfers++;
+}
+
+
+/**
+ * @brief	The I2C1 interrupt: moves the data, raises INT1 if asked, then reports the completion
+ */
+static void *MockBus_Irq(void *pArg)
+{
+	MockJob *pJob = pArg;
+
+	usleep(MOCK_XFER_TIME_US);
+
+	if(pJob->Int1)
+	{
+		BaseType_t xWoken;
+		xTaskNotifyFromISR(g_HostTask, MOCK_INT1_NOTIFICATION, eSetBits, &xWoken);
+	}
+
+	if(pJob->Nack)
+	{
+		hi2c1.ErrorCode = HAL_I2C_ERROR_AF;
+		hi2c1.State = HAL_I2C_STATE_READY;
+		__io_accelerometer_i2cCpltCallback(ERROR);
+	}
+	else
+	{
+		if(pJob->Read)
+			memcpy(pJob->pData, &g_MockRegisters[pJob->Register], pJob->Length);
+		else
+			memcpy(&g_MockRegisters[pJob->Register], pJob->pData, pJob->Length);
+
+		hi2c1.State = HAL_I2C_STATE_READY;
+		__io_accelerometer_i2cCpltCallback(SUCCESS);
+	}
+
+	free(pJob);
+	return NULL;
+}
+
+
+static HAL_StatusTypeDef MockBus_Start(MockTransferType Type, uint8_t Register, uint8_t *pData, uint16_t Length)
+{
+	MockJob *pJob;
+	pthread_t Irq;
+
+	if(hi2c1.State != HAL_I2C_STATE_READY)
+	{
+		g_MockBus.Busy++;
+		return HAL_BUSY;
+	}
+
+	if(((uint32_t)Register + Length) > sizeof(g_MockRegisters))
+	{
+		printf("FAIL: transfer past the last register (0x%02X + %u)\n", Register, Length);
+		exit(1);
+	}
+
+	MockBus_Log(Type, Register, Length);
+	hi2c1.State = HAL_I2C_STATE_BUSY;
+	hi2c1.ErrorCode = HAL_I2C_ERROR_NONE;
+
+	if(g_MockHangs)
+	{
+		/* No interrupt ever comes, the peripheral stays busy until de-initialized */
+		g_MockHangs--;
+		return HAL_OK;
+	}
+
+	pJob = calloc(1, sizeof(MockJob));
+	pJob->Read = (Type == MOCK_XFER_MEM_READ_IT) || (Type == MOCK_XFER_MEM_READ_DMA);
+	pJob->Register = Register;
+	pJob->pData = pData;
+	pJob->Length = Length;
+
+	if(g_MockNacks)
+	{
+		g_MockNacks--;
+		pJob->Nack = 1;
+		g_MockBus.Nacks++;
+	}
+
+	if(g_MockInt1)
+	{
+		g_MockInt1--;
+		pJob->Int1 = 1;
+	}
+
+	pthread_create(&Irq, NULL, MockBus_Irq, pJob);
+	pthread_detach(Irq);
+
+	return HAL_OK;
+}
+
+
+/**
+ * @brief	Clears the registers, the statistics and the faults
+ */
+void MockBus_Reset(void)
+{
+	memset(g_MockRegisters, 0, sizeof(g_MockRegisters));
+	memset(&g_MockBus, 0, sizeof(g_MockBus));
+	g_MockNacks = 0;
+	g_MockHangs = 0;
+	g_MockInt1 = 0;
+	hi2c1.State = HAL_I2C_STATE_READY;
+}
+
+
+/**
+ * @brief	Transfer number Index since the last reset, NULL if it left the log
+ */
+const MockTransfer *MockBus_Transfer(uint32_t Index)
+{
+	if((Index >= g_MockBus.Transfers) || ((g_MockBus.Transfers - Index) > MOCK_BUS_LOG_SIZE))
+		return NULL;
+
+	return &g_MockBus.Log[Index % MOCK_BUS_LOG_SIZE];
+}
+
+
+/*--- HAL I2C ---*/
+void MX_I2C1_Init(void)
+{
+	HAL_I2C_Init(&hi2c1);
+}
+
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c)
+{
+	hi2c->State = HAL_I2C_STATE_READY;
+	hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c)
+{
+	g_MockBus.Recoveries++;
+	hi2c->State = HAL_I2C_STATE_RESET;
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	MockBus_Log(MOCK_XFER_MASTER_TX_POLLED, 0, Size);
+	hi2c->ErrorCode = (DevAddress == 0xA6) ? HAL_I2C_ERROR_NONE : HAL_I2C_ERROR_AF;
+	return (hi2c->ErrorCode == HAL_I2C_ERROR_NONE) ? HAL_OK : HAL_ERROR;
+}
+
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size)
+{
+	/* First byte is the register address */
+	return MockBus_Start(MOCK_XFER_MASTER_TX_IT, pData[0], pData + 1, Size - 1);
+}
+
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	return MockBus_Start(MOCK_XFER_MEM_WRITE_IT, (uint8_t)MemAddress, pData, Size);
+}
+
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	return MockBus_Start(MOCK_XFER_MEM_READ_IT, (uint8_t)MemAddress, pData, Size);
+}
+
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	return MockBus_Start(MOCK_XFER_MEM_READ_DMA, (uint8_t)MemAddress, pData, Size);
+}
+
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c)
+{
+	return hi2c->State;
+}
+
+
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef *hi2c)
+{
+	return hi2c->ErrorCode;
+}
+
+
+void Error_Handler(void)
+{
+	printf("FAIL: Error_Handler() called\n");
+	exit(1);
+}
+
+
+/******************************************* END OF FILE *******************************************/
@@ -0,0 +1,76 @@
+/**
+  **************************************************************************************************
+  * @file           : mock_adxl343_bus.h
+  * @brief          : Header for mock_adxl343_bus.c file, the host mock of I2C1 and the ADXL343.
+  * @author         : Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Define to prevent recursive inclusion ---------------------------------------------------------*/
+#ifndef __MOCK_ADXL343_BUS_H
+#define __MOCK_ADXL343_BUS_H
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdint.h>
+
+
+/* Exported defines ------------------------------------------------------------------------------*/
+	/*--- Transfers kept in the log, the older ones are overwritten ---*/
+	#define MOCK_BUS_LOG_SIZE					256
+
+	/*--- Notification bit set by the mock INT1 line, as FRTOS_TASK_NOTIF_ADXL343_INT1 ---*/
+	#define MOCK_INT1_NOTIFICATION				((uint32_t)0x0001)
+
+
+/* Exported types --------------------------------------------------------------------------------*/
+	/*--- Kind of transfer seen on the bus ---*/
+	typedef enum
+	{
+		MOCK_XFER_MEM_READ_IT = 0,
+		MOCK_XFER_MEM_READ_DMA,
+		MOCK_XFER_MEM_WRITE_IT,
+		MOCK_XFER_MASTER_TX_IT,
+		MOCK_XFER_MASTER_TX_POLLED
+
+	} MockTransferType;
+
+	typedef struct
+	{
+		MockTransferType Type;
+		uint8_t Register;				/* First register, auto-incremented by the device */
+		uint16_t Length;				/* Data bytes, register address excluded */
+
+	} MockTransfer;
+
+	typedef struct
+	{
+		uint32_t Transfers;				/* Transfers started, NACKed ones included */
+		uint32_t Nacks;					/* Transfers ended by an acknowledge failure */
+		uint32_t Recoveries;			/* HAL_I2C_DeInit() calls, one per bus recovery */
+		uint32_t Busy;					/* Transfers refused because one was still running */
+		MockTransfer Log[MOCK_BUS_LOG_SIZE];
+
+	} MockBusStats;
+
+
+/* Exported variables ----------------------------------------------------------------------------*/
+extern uint8_t g_MockRegisters[0x40];	/* ADXL343 register file, indexed by address */
+extern MockBusStats g_MockBus;
+
+/*--- Faults injected into the next transfers ---*/
+extern volatile uint32_t g_MockNacks;	/* Transfers to NACK */
+extern volatile uint32_t g_MockHangs;	/* Transfers that never complete */
+extern volatile uint32_t g_MockInt1;	/* Transfers during which INT1 notifies the task */
+
+
+/* Exported Functions Prototypes -----------------------------------------------------------------*/
+void MockBus_Reset(void);
+const MockTransfer *MockBus_Transfer(uint32_t Index);
+
+
+#endif  /* __MOCK_ADXL343_BUS_H */
+
+
+/******************************************* END OF FILE *******************************************/
@@ -0,0 +1,48 @@
+/**
+  **************************************************************************************************
+  * @file           : FreeRTOS.h
+  * @brief          : Host stand-in for the FreeRTOS kernel API used by the firmware modules built
+  *  				  into the host tests, see host_freertos.c. A tick is one millisecond.
+  * @author         : Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Define to prevent recursive inclusion ---------------------------------------------------------*/
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stddef.h>
+
+
+/* Exported types --------------------------------------------------------------------------------*/
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+
+/* Exported defines ------------------------------------------------------------------------------*/
+#define pdFALSE							((BaseType_t)0)
+#define pdTRUE							((BaseType_t)1)
+#define pdPASS							pdTRUE
+#define pdFAIL							pdFALSE
+#define portMAX_DELAY					((TickType_t)0xFFFFFFFFUL)
+#define configTICK_RATE_HZ				((TickType_t)1000)
+#define portTICK_PERIOD_MS				((TickType_t)1)
+#define pdMS_TO_TICKS(xTimeInMs)		((TickType_t)(xTimeInMs))
+
+#define configASSERT(x)					((void)0)
+#define portYIELD_FROM_ISR(x)			((void)(x))
+
+
+/* Exported functions ----------------------------------------------------------------------------*/
+BaseType_t xPortIsInsideInterrupt(void);
+
+
+#endif  /* INC_FREERTOS_H */
+
+
+/******************************************* END OF FILE *******************************************/
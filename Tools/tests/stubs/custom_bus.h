@@ -0,0 +1,35 @@
+/**
+  **************************************************************************************************
+  * @file           : custom_bus.h
+  * @brief          : Host stand-in for the BSP bus header. SPI1 is implemented by the BlueNRG-2 fake
+  *  				  of the tests that need it.
+  * @author         : Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Define to prevent recursive inclusion ---------------------------------------------------------*/
+#ifndef __CUSTOM_BUS_H
+#define __CUSTOM_BUS_H
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include "stm32f4xx_hal.h"
+
+
+/* Exported defines ------------------------------------------------------------------------------*/
+#define BSP_ERROR_NONE					0
+#define BSP_ERROR_UNKNOWN_FAILURE		-6
+
+
+/* Exported functions ----------------------------------------------------------------------------*/
+int32_t BSP_SPI1_Init(void);
+int32_t BSP_SPI1_SendRecv(uint8_t *pTxData, uint8_t *pRxData, uint16_t Length);
+int32_t BSP_SPI1_SendRecv_DMA(uint8_t *pTxData, uint8_t *pRxData, uint16_t Length);
+int32_t BSP_GetTick(void);
+
+
+#endif  /* __CUSTOM_BUS_H */
+
+
+/******************************************* END OF FILE *******************************************/
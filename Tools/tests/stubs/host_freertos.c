@@ -0,0 +1,227 @@
+/**
+  **************************************************************************************************
+  * @file           : host_freertos.c
+  * @brief          : Host implementation of the FreeRTOS calls made by the modules under test.
+  *  				  Semaphores are pthread condition variables. The notification of the single task
+  *  				  keeps the kernel semantics the firmware relies on: a wait returns on any
+  *  				  notification and consumes its pending state, whatever the bits cleared on exit.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "stm32f4xx_hal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+
+/* Private typedef -------------------------------------------------------------------------------*/
+typedef struct
+{
+	pthread_mutex_t Lock;
+	pthread_cond_t Cond;
+	uint32_t Count;
+
+} HostSemaphore;
+
+_Static_assert(sizeof(HostSemaphore) <= sizeof(StaticSemaphore_t), "StaticSemaphore_t too small on this host");
+
+
+/* Exported/Global variables ---------------------------------------------------------------------*/
+TaskHandle_t const g_HostTask = (TaskHandle_t)&g_HostTask;
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+static HostSemaphore s_Notification = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0};
+static uint32_t s_NotificationValue;
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+/**
+ * @brief	Absolute deadline of a wait, portMAX_DELAY waits for ever
+ */
+static void Host_Deadline(struct timespec *pDeadline, TickType_t xTicks)
+{
+	clock_gettime(CLOCK_REALTIME, pDeadline);
+	pDeadline->tv_sec += xTicks / 1000;
+	pDeadline->tv_nsec += (long)(xTicks % 1000) * 1000000;
+	pDeadline->tv_sec += pDeadline->tv_nsec / 1000000000;
+	pDeadline->tv_nsec %= 1000000000;
+}
+
+
+/**
+ * @retval	pdTRUE once Count was non zero and decremented, pdFALSE on timeout
+ */
+static BaseType_t Host_Wait(HostSemaphore *pSem, TickType_t xTicks)
+{
+	struct timespec Deadline;
+	int Result = 0;
+	BaseType_t Taken;
+
+	Host_Deadline(&Deadline, xTicks);
+
+	pthread_mutex_lock(&pSem->Lock);
+	while((pSem->Count == 0) && (Result != ETIMEDOUT))
+	{
+		if(xTicks == portMAX_DELAY)
+			pthread_cond_wait(&pSem->Cond, &pSem->Lock);
+		else
+			Result = pthread_cond_timedwait(&pSem->Cond, &pSem->Lock, &Deadline);
+	}
+
+	Taken = (pSem->Count != 0) ? pdTRUE : pdFALSE;
+	if(Taken)
+		pSem->Count--;
+	pthread_mutex_unlock(&pSem->Lock);
+
+	return Taken;
+}
+
+
+static BaseType_t Host_Post(HostSemaphore *pSem)
+{
+	BaseType_t Given;
+
+	pthread_mutex_lock(&pSem->Lock);
+	Given = (pSem->Count == 0) ? pdTRUE : pdFALSE;
+	pSem->Count = 1;
+	pthread_cond_signal(&pSem->Cond);
+	pthread_mutex_unlock(&pSem->Lock);
+
+	return Given;
+}
+
+
+static SemaphoreHandle_t Host_Create(StaticSemaphore_t *pBuffer, uint32_t Count)
+{
+	HostSemaphore *pSem = (HostSemaphore *)pBuffer;
+
+	pthread_mutex_init(&pSem->Lock, NULL);
+	pthread_cond_init(&pSem->Cond, NULL);
+	pSem->Count = Count;
+
+	return pBuffer;
+}
+
+
+/*--- Kernel ---*/
+BaseType_t xPortIsInsideInterrupt(void)
+{
+	return pdFALSE;
+}
+
+
+BaseType_t xTaskGetSchedulerState(void)
+{
+	return taskSCHEDULER_RUNNING;
+}
+
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return g_HostTask;
+}
+
+
+TickType_t xTaskGetTickCount(void)
+{
+	return (TickType_t)HAL_GetTick();
+}
+
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+	usleep(xTicksToDelay * 1000);
+}
+
+
+/*--- Tickless idle, the host tick follows the host clock and is never suppressed ---*/
+eSleepModeStatus eTaskConfirmSleepModeStatus(void)
+{
+	return eAbortSleep;
+}
+
+
+void vTaskStepTick(TickType_t xTicksToJump)
+{
+}
+
+
+/*--- Semaphores, a mutex is a binary semaphore given at creation ---*/
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *pxSemaphoreBuffer)
+{
+	return Host_Create(pxSemaphoreBuffer, 0);
+}
+
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *pxMutexBuffer)
+{
+	return Host_Create(pxMutexBuffer, 1);
+}
+
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime)
+{
+	return Host_Wait((HostSemaphore *)xSemaphore, xBlockTime);
+}
+
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore)
+{
+	return Host_Post((HostSemaphore *)xSemaphore);
+}
+
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t xSemaphore, BaseType_t *pxHigherPriorityTaskWoken)
+{
+	*pxHigherPriorityTaskWoken = pdTRUE;
+	return Host_Post((HostSemaphore *)xSemaphore);
+}
+
+
+/*--- Direct to task notification of g_HostTask ---*/
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit, uint32_t *pulNotificationValue, TickType_t xTicksToWait)
+{
+	BaseType_t Received;
+
+	pthread_mutex_lock(&s_Notification.Lock);
+	if(s_Notification.Count == 0)
+		s_NotificationValue &= ~ulBitsToClearOnEntry;
+	pthread_mutex_unlock(&s_Notification.Lock);
+
+	Received = Host_Wait(&s_Notification, xTicksToWait);
+
+	pthread_mutex_lock(&s_Notification.Lock);
+	if(pulNotificationValue != NULL)
+		*pulNotificationValue = s_NotificationValue;
+	if(Received)
+		s_NotificationValue &= ~ulBitsToClearOnExit;
+	pthread_mutex_unlock(&s_Notification.Lock);
+
+	return Received;
+}
+
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction, BaseType_t *pxHigherPriorityTaskWoken)
+{
+	pthread_mutex_lock(&s_Notification.Lock);
+	if(eAction == eSetBits)
+		s_NotificationValue |= ulValue;
+	pthread_mutex_unlock(&s_Notification.Lock);
+
+	*pxHigherPriorityTaskWoken = pdTRUE;
+	Host_Post(&s_Notification);
+
+	return pdPASS;
+}
+
+
+/******************************************* END OF FILE *******************************************/
@@ -0,0 +1,53 @@
+/**
+  **************************************************************************************************
+  * @file           : host_hal.c
+  * @brief          : Host implementation of the few HAL services used by the modules under test.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <time.h>
+#include "stm32f4xx_hal.h"
+
+
+/* Exported/Global variables ---------------------------------------------------------------------*/
+__thread uint8_t g_HostExclusiveValue;
+DWT_Type g_HostDwt;
+CoreDebug_Type g_HostCoreDebug;
+GPIO_TypeDef g_HostGpio[3];
+TIM_TypeDef g_HostTim[4];
+SysTick_Type g_HostSysTick;
+SCB_Type g_HostScb;
+uint32_t SystemCoreClock = 100000000;
+volatile uint32_t uwTick;
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+/**
+ * @brief	Milliseconds since an arbitrary origin, like the 1kHz HAL tick
+ */
+uint32_t HAL_GetTick(void)
+{
+	struct timespec Now;
+
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (uint32_t)((Now.tv_sec * 1000) + (Now.tv_nsec / 1000000));
+}
+
+
+/**
+ * @brief	The host tick follows the host clock, it is not stopped
+ */
+void HAL_SuspendTick(void)
+{
+}
+
+void HAL_ResumeTick(void)
+{
+}
+
+
+/******************************************* END OF FILE *******************************************/
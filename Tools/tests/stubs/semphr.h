@@ -0,0 +1,40 @@
+/**
+  **************************************************************************************************
+  * @file           : semphr.h
+  * @brief          : Host stand-in for the FreeRTOS semaphore API, see host_freertos.c.
+  * @author         : Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Define to prevent recursive inclusion ---------------------------------------------------------*/
+#ifndef SEMAPHORE_H
+#define SEMAPHORE_H
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include "FreeRTOS.h"
+
+
+/* Exported types --------------------------------------------------------------------------------*/
+typedef struct
+{
+	uint8_t Storage[128];
+
+} StaticSemaphore_t;
+
+typedef StaticSemaphore_t * SemaphoreHandle_t;
+
+
+/* Exported functions ----------------------------------------------------------------------------*/
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *pxSemaphoreBuffer);
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *pxMutexBuffer);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t xSemaphore, BaseType_t *pxHigherPriorityTaskWoken);
+
+
+#endif  /* SEMAPHORE_H */
+
+
+/******************************************* END OF FILE *******************************************/
@@ -0,0 +1,356 @@
+/**
+  **************************************************************************************************
+  * @file           : stm32f4xx_hal.h
+  * @brief          : Host stand-in for the HAL and CMSIS definitions used by the firmware modules
+  *  				  built into the host tests. Barriers map to full fences, LDREX/STREX to a
+  *  				  compare and swap, so the modules run unchanged on threads.
+  * @author         : Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Define to prevent recursive inclusion ---------------------------------------------------------*/
+#ifndef __STM32F4xx_HAL_H
+#define __STM32F4xx_HAL_H
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stddef.h>
+
+
+/* Exported defines ------------------------------------------------------------------------------*/
+#define __weak							__attribute__((weak))
+#define __IO							volatile
+
+#define __DMB()							__sync_synchronize()
+#define __DSB()							__sync_synchronize()
+#define __ISB()							__sync_synchronize()
+
+#define assert_param(expr)				((void)0)
+#define UNUSED(x)						((void)(x))
+
+#define GPIOA							(&g_HostGpio[0])
+#define GPIOB							(&g_HostGpio[1])
+#define GPIOC							(&g_HostGpio[2])
+#define GPIO_PIN_0						((uint16_t)0x0001)
+#define GPIO_PIN_1						((uint16_t)0x0002)
+#define GPIO_PIN_3						((uint16_t)0x0008)
+#define GPIO_PIN_4						((uint16_t)0x0010)
+#define GPIO_PIN_5						((uint16_t)0x0020)
+#define GPIO_PIN_6						((uint16_t)0x0040)
+#define GPIO_PIN_7						((uint16_t)0x0080)
+#define GPIO_PIN_8						((uint16_t)0x0100)
+#define GPIO_PIN_9						((uint16_t)0x0200)
+#define GPIO_PIN_10						((uint16_t)0x0400)
+#define GPIO_PIN_13						((uint16_t)0x2000)
+#define EXTI0_IRQn						6
+#define EXTI15_10_IRQn					40
+
+#define GPIO_MODE_OUTPUT_PP				((uint32_t)0x00000001)
+#define GPIO_MODE_IT_RISING				((uint32_t)0x10110000)
+#define GPIO_NOPULL						((uint32_t)0x00000000)
+#define GPIO_SPEED_FREQ_LOW				((uint32_t)0x00000000)
+#define __HAL_RCC_GPIOA_CLK_ENABLE()	((void)0)
+
+#define EXTI_LINE_0						((uint32_t)0x06000000)
+
+#define TIM1							(&g_HostTim[0])
+#define TIM3							(&g_HostTim[1])
+#define TIM2							(&g_HostTim[2])
+#define TIM5							(&g_HostTim[3])
+#define TIM5_IRQn						50
+#define TIM_CR1_CEN						((uint32_t)0x00000001)
+#define TIM_SR_UIF						((uint32_t)0x00000001)
+#define TIM_SR_CC3IF					((uint32_t)0x00000008)
+#define TIM_DIER_CC3IE					((uint32_t)0x00000008)
+#define TIM_IT_UPDATE					((uint32_t)0x00000001)
+#define TIM_DMA_UPDATE					((uint32_t)0x00000100)
+#define TIM_DMA_CC1						((uint32_t)0x00000200)
+#define TIM_CHANNEL_1					((uint32_t)0x00000000)
+#define TIM_CHANNEL_2					((uint32_t)0x00000004)
+#define TIM_CHANNEL_3					((uint32_t)0x00000008)
+
+#define __HAL_TIM_ENABLE(h)				((h)->Instance->CR1 |= TIM_CR1_CEN)
+#define __HAL_TIM_DISABLE(h)			((h)->Instance->CR1 &= ~TIM_CR1_CEN)
+#define __HAL_TIM_ENABLE_IT(h, it)		((h)->Instance->DIER |= (it))
+#define __HAL_TIM_DISABLE_IT(h, it)		((h)->Instance->DIER &= ~(it))
+#define __HAL_TIM_CLEAR_IT(h, it)		((h)->Instance->SR = ~(it))
+#define __HAL_TIM_ENABLE_DMA(h, dma)	((h)->Instance->DIER |= (dma))
+#define __HAL_TIM_DISABLE_DMA(h, dma)	((h)->Instance->DIER &= ~(dma))
+#define __HAL_TIM_SET_COUNTER(h, cnt)	((h)->Instance->CNT = (cnt))
+#define __HAL_TIM_SET_AUTORELOAD(h, arr)	((h)->Instance->ARR = (arr))
+
+#define DMA_SxCR_EN						((uint32_t)0x00000001)
+#define DMA_SxCR_TCIE					((uint32_t)0x00000010)
+
+#define I2C1							((void *)0x40005400)
+#define I2C_MEMADD_SIZE_8BIT			((uint16_t)0x0001)
+#define I2C_ADDRESSINGMODE_7BIT			((uint32_t)0x00004000)
+#define I2C_DUALADDRESS_DISABLE			((uint32_t)0x00000000)
+#define I2C_GENERALCALL_DISABLE			((uint32_t)0x00000000)
+#define I2C_NOSTRETCH_DISABLE			((uint32_t)0x00000000)
+#define HAL_I2C_ERROR_NONE				((uint32_t)0x00000000)
+#define HAL_I2C_ERROR_AF				((uint32_t)0x00000004)
+
+
+/* Exported types --------------------------------------------------------------------------------*/
+typedef enum
+{
+	SUCCESS = 0,
+	ERROR = !SUCCESS
+
+} ErrorStatus;
+
+typedef enum
+{
+	HAL_OK = 0x00,
+	HAL_ERROR = 0x01,
+	HAL_BUSY = 0x02,
+	HAL_TIMEOUT = 0x03
+
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+	HAL_I2C_STATE_RESET = 0x00,
+	HAL_I2C_STATE_READY = 0x20,
+	HAL_I2C_STATE_BUSY = 0x24
+
+} HAL_I2C_StateTypeDef;
+
+typedef enum
+{
+	RESET = 0,
+	SET = !RESET
+
+} FlagStatus;
+
+typedef int32_t IRQn_Type;
+
+typedef enum
+{
+	GPIO_PIN_RESET = 0,
+	GPIO_PIN_SET
+
+} GPIO_PinState;
+
+typedef struct
+{
+	uint32_t Pin;
+	uint32_t Mode;
+	uint32_t Pull;
+	uint32_t Speed;
+	uint32_t Alternate;
+
+} GPIO_InitTypeDef;
+
+typedef enum
+{
+	HAL_EXTI_COMMON_CB_ID = 0x00
+
+} EXTI_CallbackIDTypeDef;
+
+typedef struct
+{
+	uint32_t Line;
+	void (*PendingCallback)(void);
+
+} EXTI_HandleTypeDef;
+
+typedef struct
+{
+	volatile uint32_t IDR;
+	volatile uint32_t ODR;
+	volatile uint32_t BSRR;
+
+} GPIO_TypeDef;
+
+typedef struct
+{
+	volatile uint32_t CR1;
+	volatile uint32_t DIER;
+	volatile uint32_t SR;
+	volatile uint32_t CNT;
+	volatile uint32_t ARR;
+	volatile uint32_t CCR1;
+	volatile uint32_t CCR2;
+	volatile uint32_t CCR3;
+
+} TIM_TypeDef;
+
+typedef struct
+{
+	TIM_TypeDef *Instance;
+
+} TIM_HandleTypeDef;
+
+typedef struct
+{
+	volatile uint32_t CR;
+	volatile uint32_t NDTR;
+	volatile uint32_t PAR;
+	volatile uint32_t M0AR;
+
+} DMA_Stream_TypeDef;
+
+typedef enum
+{
+	HAL_DMA_FULL_TRANSFER = 0x00,
+	HAL_DMA_HALF_TRANSFER = 0x01
+
+} HAL_DMA_LevelCompleteTypeDef;
+
+typedef struct __DMA_HandleTypeDef
+{
+	void *Instance;
+	void (*XferCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+	void (*XferErrorCallback)(struct __DMA_HandleTypeDef *hdma);
+
+} DMA_HandleTypeDef;
+
+typedef struct
+{
+	uint32_t ClockSpeed;
+	uint32_t DutyCycle;
+	uint32_t OwnAddress1;
+	uint32_t AddressingMode;
+	uint32_t DualAddressMode;
+	uint32_t OwnAddress2;
+	uint32_t GeneralCallMode;
+	uint32_t NoStretchMode;
+
+} I2C_InitTypeDef;
+
+typedef struct
+{
+	void *Instance;
+	I2C_InitTypeDef Init;
+	volatile HAL_I2C_StateTypeDef State;
+	volatile uint32_t ErrorCode;
+
+} I2C_HandleTypeDef;
+
+
+/*--- Cycle counter, it does not count on the host: tests time the calls with the host clock ---*/
+typedef struct
+{
+	volatile uint32_t CTRL;
+	volatile uint32_t CYCCNT;
+
+} DWT_Type;
+
+typedef struct
+{
+	volatile uint32_t DEMCR;
+
+} CoreDebug_Type;
+
+/*--- SysTick and interrupt control, for the tickless idle ---*/
+typedef struct
+{
+	volatile uint32_t CTRL;
+	volatile uint32_t LOAD;
+	volatile uint32_t VAL;
+
+} SysTick_Type;
+
+typedef struct
+{
+	volatile uint32_t ICSR;
+
+} SCB_Type;
+
+#define SysTick_CTRL_ENABLE_Msk			((uint32_t)0x00000001)
+#define SCB_ICSR_PENDSTSET_Msk			((uint32_t)0x04000000)
+#define SysTick							(&g_HostSysTick)
+#define SCB								(&g_HostScb)
+
+#define __disable_irq()					((void)0)
+#define __enable_irq()					((void)0)
+#define __WFI()							((void)0)
+
+#define LSI_VALUE						((uint32_t)32000)
+
+extern SysTick_Type g_HostSysTick;
+extern SCB_Type g_HostScb;
+extern uint32_t SystemCoreClock;
+extern volatile uint32_t uwTick;
+
+#define DWT_CTRL_CYCCNTENA_Msk			((uint32_t)0x00000001)
+#define CoreDebug_DEMCR_TRCENA_Msk		((uint32_t)0x01000000)
+#define DWT								(&g_HostDwt)
+#define CoreDebug						(&g_HostCoreDebug)
+
+extern DWT_Type g_HostDwt;
+extern CoreDebug_Type g_HostCoreDebug;
+
+/*--- Registers of the peripherals written directly, see host_hal.c ---*/
+extern GPIO_TypeDef g_HostGpio[3];
+extern TIM_TypeDef g_HostTim[4];
+
+
+/* Exported functions ----------------------------------------------------------------------------*/
+uint32_t HAL_GetTick(void);
+void HAL_SuspendTick(void);
+void HAL_ResumeTick(void);
+
+/*--- GPIO, NVIC and EXTI, implemented by the BlueNRG-2 fake of the test ---*/
+void HAL_Delay(uint32_t Delay);
+void HAL_GPIO_Init(void *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+void HAL_GPIO_DeInit(void *GPIOx, uint32_t GPIO_Pin);
+GPIO_PinState HAL_GPIO_ReadPin(void *GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_WritePin(void *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+static inline void NVIC_ClearPendingIRQ(IRQn_Type IRQn)
+{
+}
+HAL_StatusTypeDef HAL_EXTI_GetHandle(EXTI_HandleTypeDef *hexti, uint32_t ExtiLine);
+HAL_StatusTypeDef HAL_EXTI_RegisterCallback(EXTI_HandleTypeDef *hexti, EXTI_CallbackIDTypeDef CallbackID, void (*pPendingCbfn)(void));
+void HAL_EXTI_GenerateSWI(EXTI_HandleTypeDef *hexti);
+
+/*--- TIM and DMA, implemented by the timer model of the test ---*/
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength);
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength);
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma);
+HAL_StatusTypeDef HAL_DMA_PollForTransfer(DMA_HandleTypeDef *hdma, HAL_DMA_LevelCompleteTypeDef CompleteLevel, uint32_t Timeout);
+
+/*--- I2C, implemented by the bus mock of the test ---*/
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c);
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef *hi2c);
+
+/*--- Exclusive monitor of the calling thread ---*/
+extern __thread uint8_t g_HostExclusiveValue;
+
+static inline uint8_t __LDREXB(volatile uint8_t *addr)
+{
+	g_HostExclusiveValue = *addr;
+	return g_HostExclusiveValue;
+}
+
+static inline uint32_t __STREXB(uint8_t value, volatile uint8_t *addr)
+{
+	uint8_t Expected = g_HostExclusiveValue;
+
+	return __atomic_compare_exchange_n(addr, &Expected, value, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) ? 0 : 1;
+}
+
+static inline void __CLREX(void)
+{
+}
+
+
+#endif  /* __STM32F4xx_HAL_H */
+
+
+/******************************************* END OF FILE *******************************************/
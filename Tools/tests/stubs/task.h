@@ -0,0 +1,71 @@
+/**
+  **************************************************************************************************
+  * @file           : task.h
+  * @brief          : Host stand-in for the FreeRTOS task API, see host_freertos.c. The tests run a
+  *  				  single task: the main thread. Other threads play the interrupts.
+  * @author         : Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Define to prevent recursive inclusion ---------------------------------------------------------*/
+#ifndef INC_TASK_H
+#define INC_TASK_H
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include "FreeRTOS.h"
+
+
+/* Exported types --------------------------------------------------------------------------------*/
+typedef void * TaskHandle_t;
+
+typedef enum
+{
+	eNoAction = 0,
+	eSetBits,
+	eIncrement,
+	eSetValueWithOverwrite,
+	eSetValueWithoutOverwrite
+
+} eNotifyAction;
+
+typedef enum
+{
+	eAbortSleep = 0,
+	eStandardSleep,
+	eNoTasksWaitingTimeout
+
+} eSleepModeStatus;
+
+
+/* Exported defines ------------------------------------------------------------------------------*/
+#define taskSCHEDULER_SUSPENDED			((BaseType_t)0)
+#define taskSCHEDULER_NOT_STARTED		((BaseType_t)1)
+#define taskSCHEDULER_RUNNING			((BaseType_t)2)
+
+/*--- Critical sections are only entered from the task thread of the tests that use them ---*/
+#define taskENTER_CRITICAL()			((void)0)
+#define taskEXIT_CRITICAL()				((void)0)
+
+
+/* Exported variables ----------------------------------------------------------------------------*/
+/*--- Handle of the task played by the main thread ---*/
+extern TaskHandle_t const g_HostTask;
+
+
+/* Exported functions ----------------------------------------------------------------------------*/
+BaseType_t xTaskGetSchedulerState(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t xTicksToDelay);
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit, uint32_t *pulNotificationValue, TickType_t xTicksToWait);
+BaseType_t xTaskNotifyFromISR(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction, BaseType_t *pxHigherPriorityTaskWoken);
+eSleepModeStatus eTaskConfirmSleepModeStatus(void);
+void vTaskStepTick(TickType_t xTicksToJump);
+
+
+#endif  /* INC_TASK_H */
+
+
+/******************************************* END OF FILE *******************************************/
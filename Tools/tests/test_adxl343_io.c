@@ -0,0 +1,321 @@
+/**
+  **************************************************************************************************
+  * @file           : test_adxl343_io.c
+  * @brief          : Host test of the ADXL343 I2C1 transaction engine (adxl343_io.c) on the bus mock.
+  *  				  Transfers must go through the _IT/_DMA calls and block the task until the
+  *  				  completion interrupt, NACKs must be retried, a hung bus recovered, and the task
+  *  				  notifications of the caller (INT1) must survive the transfers. Configuration
+  *  				  registers come from the shadow, staged changes go out in merged bursts.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "adxl343_io.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "mock_adxl343_bus.h"
+#include "test_check.h"
+
+
+/* Private define --------------------------------------------------------------------------------*/
+#define REG_THRESH_TAP							((uint8_t)0x1D)
+#define REG_OFSX								((uint8_t)0x1E)
+#define REG_OFSY								((uint8_t)0x1F)
+#define REG_OFSZ								((uint8_t)0x20)
+#define REG_DUR									((uint8_t)0x21)
+#define REG_TAP_AXES							((uint8_t)0x2A)
+#define REG_ACT_TAP_STATUS						((uint8_t)0x2B)
+#define REG_BW_RATE								((uint8_t)0x2C)
+#define REG_POWER_CTL							((uint8_t)0x2D)
+#define REG_INT_ENABLE							((uint8_t)0x2E)
+#define REG_INT_MAP								((uint8_t)0x2F)
+#define REG_INT_SOURCE							((uint8_t)0x30)
+#define REG_DATA_FORMAT							((uint8_t)0x31)
+#define REG_DATAX0								((uint8_t)0x32)
+#define REG_FIFO_CTL							((uint8_t)0x38)
+
+
+/* Private typedef -------------------------------------------------------------------------------*/
+typedef struct
+{
+	uint8_t Register;
+	uint8_t Clear;
+	uint8_t Set;
+
+} RegisterChange;
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+/*--- Read-modify-writes of a stream configuration: rate, measure, watermark on INT1, format, FIFO ---*/
+static const RegisterChange s_StreamConfig[] = {
+	{ REG_BW_RATE,		0x0F, 0x0C },		/* 400Hz */
+	{ REG_POWER_CTL,	0x08, 0x08 },		/* Measure */
+	{ REG_INT_ENABLE,	0x02, 0x02 },		/* Watermark */
+	{ REG_INT_MAP,		0x02, 0x00 },		/* Watermark on INT1 */
+	{ REG_DATA_FORMAT,	0x0B, 0x08 },		/* Full resolution, 2g */
+	{ REG_FIFO_CTL,		0xDF, 0x90 },		/* Stream, 16 samples */
+};
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+static void Test_WriteThenRead(void)
+{
+	MockBus_Reset();
+
+	__io_accelerometer_i2cWriteRegister(REG_BW_RATE, 0x0D, 1);
+	CHECK(g_MockRegisters[REG_BW_RATE] == 0x0D);
+	CHECK(__io_accelerometer_i2cReadRegister(REG_BW_RATE, 1) == 0x0D);
+
+	CHECK(g_MockBus.Transfers == 2);
+	CHECK(MockBus_Transfer(0)->Type == MOCK_XFER_MEM_WRITE_IT);
+	CHECK(MockBus_Transfer(1)->Type == MOCK_XFER_MEM_READ_IT);
+}
+
+
+static void Test_FifoReadUsesDma(void)
+{
+	uint16_t X, Y, Z;
+
+	MockBus_Reset();
+	g_MockRegisters[REG_DATAX0 + 0] = 0x34;
+	g_MockRegisters[REG_DATAX0 + 1] = 0x12;
+	g_MockRegisters[REG_DATAX0 + 2] = 0xFF;
+	g_MockRegisters[REG_DATAX0 + 3] = 0xFF;
+	g_MockRegisters[REG_DATAX0 + 4] = 0x00;
+	g_MockRegisters[REG_DATAX0 + 5] = 0x01;
+
+	__ADXL_READMULTIBYTE_FIFO(&X, &Y, &Z);
+
+	CHECK((X == 0x1234) && (Y == 0xFFFF) && (Z == 0x0100));
+	CHECK(g_MockBus.Transfers == 1);
+	CHECK((MockBus_Transfer(0)->Type == MOCK_XFER_MEM_READ_DMA) && (MockBus_Transfer(0)->Length == 6));
+}
+
+
+/**
+ * @brief	INT1 raised while the task waits for a transfer must still wake the stream wait
+ */
+static void Test_Int1SurvivesTransfer(void)
+{
+	uint32_t Notification = 0;
+
+	MockBus_Reset();
+	g_MockInt1 = 1;
+
+	__io_accelerometer_i2cReadRegister(REG_BW_RATE, 1);
+
+	CHECK(xTaskNotifyWait(0, MOCK_INT1_NOTIFICATION, &Notification, 0) == pdTRUE);
+	CHECK(Notification & MOCK_INT1_NOTIFICATION);
+}
+
+
+static void Test_NackRetried(void)
+{
+	MockBus_Reset();
+	g_MockNacks = 1;
+
+	__io_accelerometer_i2cWriteRegister(REG_BW_RATE, 0x0A, 1);
+
+	CHECK(g_MockBus.Nacks == 1);
+	CHECK(g_MockBus.Transfers == 2);
+	CHECK(g_MockRegisters[REG_BW_RATE] == 0x0A);
+}
+
+
+static void Test_HungBusRecovered(void)
+{
+	uint32_t Start;
+
+	MockBus_Reset();
+	g_MockRegisters[REG_BW_RATE] = 0x0C;
+	g_MockHangs = 1;
+
+	Start = HAL_GetTick();
+	CHECK(__io_accelerometer_i2cReadRegister(REG_BW_RATE, 1) == 0x0C);
+
+	/* Timed out once (50ms), recovered, then retried */
+	CHECK((HAL_GetTick() - Start) >= 50);
+	CHECK(g_MockBus.Recoveries == 1);
+	CHECK(g_MockBus.Transfers == 2);
+}
+
+
+/**
+ * @brief	Clean bus and registers at their reset values, the shadow seeded from them
+ * @retval	Transfers made so far, the reset write
+ */
+static uint32_t Shadow_Reset(void)
+{
+	MockBus_Reset();
+	__RESET_ADXL343_REGISTERS();
+
+	return g_MockBus.Transfers;
+}
+
+
+static uint8_t Transfer_Is(uint32_t Index, uint8_t Register, uint16_t Length)
+{
+	const MockTransfer *pTransfer = MockBus_Transfer(Index);
+
+	return (pTransfer != NULL) && (pTransfer->Type == MOCK_XFER_MEM_WRITE_IT) && (pTransfer->Register == Register) &&
+		   (pTransfer->Length == Length);
+}
+
+
+static void Test_ShadowSeeded(void)
+{
+	uint32_t Transfers = Shadow_Reset();
+	uint32_t ShadowReads = xAccelBusStats.ShadowReads;
+
+	CHECK((Transfers == 1) && (MockBus_Transfer(0)->Type == MOCK_XFER_MASTER_TX_IT) && (MockBus_Transfer(0)->Length == 29));
+	CHECK(g_MockRegisters[REG_BW_RATE] == RST_REG_BW_RATE);
+
+	/* Configuration from the shadow, status from the device */
+	CHECK(__io_accelerometer_ShadowRead(REG_BW_RATE, 1) == RST_REG_BW_RATE);
+	CHECK(g_MockBus.Transfers == Transfers);
+	CHECK(xAccelBusStats.ShadowReads == (ShadowReads + 1));
+
+	g_MockRegisters[REG_INT_SOURCE] = 0x83;
+	CHECK(__io_accelerometer_ShadowRead(REG_INT_SOURCE, 1) == 0x83);
+	CHECK(g_MockBus.Transfers == (Transfers + 1));
+	CHECK(MockBus_Transfer(Transfers)->Type == MOCK_XFER_MEM_READ_IT);
+}
+
+
+/**
+ * @brief	Adjacent staged registers in one burst, runs merged over up to two clean registers but
+ * 			never over a status register, unchanged values not staged at all
+ */
+static void Test_ShadowBurstMerging(void)
+{
+	uint32_t Transfers = Shadow_Reset();
+
+	/* Adjacent */
+	__io_accelerometer_ShadowStage(REG_BW_RATE, 0x0D, 1);
+	__io_accelerometer_ShadowStage(REG_POWER_CTL, 0x08, 1);
+	CHECK(g_MockBus.Transfers == Transfers);
+	CHECK(__io_accelerometer_ShadowFlush(1) == SUCCESS);
+	CHECK((g_MockBus.Transfers == (Transfers + 1)) && Transfer_Is(Transfers, REG_BW_RATE, 2));
+	CHECK((g_MockRegisters[REG_BW_RATE] == 0x0D) && (g_MockRegisters[REG_POWER_CTL] == 0x08));
+	Transfers = g_MockBus.Transfers;
+
+	/* Two clean registers in between, rewritten with their shadow value */
+	__io_accelerometer_ShadowStage(REG_OFSX, 0x01, 1);
+	__io_accelerometer_ShadowStage(REG_DUR, 0x02, 1);
+	CHECK(__io_accelerometer_ShadowFlush(1) == SUCCESS);
+	CHECK((g_MockBus.Transfers == (Transfers + 1)) && Transfer_Is(Transfers, REG_OFSX, 4));
+	CHECK((g_MockRegisters[REG_OFSX] == 0x01) && (g_MockRegisters[REG_OFSY] == RST_REG_OFSY) &&
+		  (g_MockRegisters[REG_OFSZ] == RST_REG_OFSZ) && (g_MockRegisters[REG_DUR] == 0x02));
+	Transfers = g_MockBus.Transfers;
+
+	/* Three clean registers in between, two bursts */
+	__io_accelerometer_ShadowStage(REG_THRESH_TAP, 0x03, 1);
+	__io_accelerometer_ShadowStage(REG_DUR, 0x04, 1);
+	CHECK(__io_accelerometer_ShadowFlush(1) == SUCCESS);
+	CHECK((g_MockBus.Transfers == (Transfers + 2)) && Transfer_Is(Transfers, REG_THRESH_TAP, 1) &&
+		  Transfer_Is(Transfers + 1, REG_DUR, 1));
+	Transfers = g_MockBus.Transfers;
+
+	/* ACT_TAP_STATUS in between, never written */
+	g_MockRegisters[REG_ACT_TAP_STATUS] = 0x55;
+	__io_accelerometer_ShadowStage(REG_TAP_AXES, 0x01, 1);
+	__io_accelerometer_ShadowStage(REG_BW_RATE, 0x0C, 1);
+	CHECK(__io_accelerometer_ShadowFlush(1) == SUCCESS);
+	CHECK((g_MockBus.Transfers == (Transfers + 2)) && Transfer_Is(Transfers, REG_TAP_AXES, 1) &&
+		  Transfer_Is(Transfers + 1, REG_BW_RATE, 1));
+	CHECK(g_MockRegisters[REG_ACT_TAP_STATUS] == 0x55);
+	Transfers = g_MockBus.Transfers;
+
+	/* Nothing changed, nothing to write */
+	__io_accelerometer_ShadowStage(REG_BW_RATE, 0x0C, 1);
+	CHECK(__io_accelerometer_ShadowFlush(1) == SUCCESS);
+	CHECK(g_MockBus.Transfers == Transfers);
+}
+
+
+/**
+ * @brief	A burst NACKed past its retries stays staged for the next flush
+ */
+static void Test_ShadowFlushNack(void)
+{
+	uint32_t Transfers = Shadow_Reset();
+
+	__io_accelerometer_ShadowStage(REG_INT_ENABLE, 0x80, 1);
+	g_MockNacks = 2;
+
+	CHECK(__io_accelerometer_ShadowFlush(1) == ERROR);
+	CHECK(g_MockBus.Transfers == (Transfers + 2));
+	CHECK(g_MockRegisters[REG_INT_ENABLE] == RST_REG_INT_ENABLE);
+
+	CHECK(__io_accelerometer_ShadowFlush(1) == SUCCESS);
+	CHECK((g_MockBus.Transfers == (Transfers + 3)) && Transfer_Is(Transfers + 2, REG_INT_ENABLE, 1));
+	CHECK(g_MockRegisters[REG_INT_ENABLE] == 0x80);
+}
+
+
+/**
+ * @brief	Same register changes, read-modify-written on the bus then through the shadow
+ */
+static void Test_ShadowTraffic(void)
+{
+	const uint32_t Changes = sizeof(s_StreamConfig) / sizeof(s_StreamConfig[0]);
+	uint8_t Expected[sizeof(g_MockRegisters)];
+	uint32_t Transfers, RmwTransfers, ShadowTransfers;
+
+	Transfers = Shadow_Reset();
+	for(uint32_t idx = 0; idx < Changes; idx++)
+	{
+		const RegisterChange *pChange = &s_StreamConfig[idx];
+		uint8_t Value = __io_accelerometer_i2cReadRegister(pChange->Register, 1);
+
+		__io_accelerometer_i2cWriteRegister(pChange->Register, (uint8_t)((Value & ~pChange->Clear) | pChange->Set), 1);
+	}
+	RmwTransfers = g_MockBus.Transfers - Transfers;
+	memcpy(Expected, g_MockRegisters, sizeof(Expected));
+
+	Transfers = Shadow_Reset();
+	for(uint32_t idx = 0; idx < Changes; idx++)
+	{
+		const RegisterChange *pChange = &s_StreamConfig[idx];
+		uint8_t Value = __io_accelerometer_ShadowRead(pChange->Register, 1);
+
+		__io_accelerometer_ShadowStage(pChange->Register, (uint8_t)((Value & ~pChange->Clear) | pChange->Set), 1);
+	}
+	CHECK(__io_accelerometer_ShadowFlush(1) == SUCCESS);
+	ShadowTransfers = g_MockBus.Transfers - Transfers;
+
+	printf("stream configuration, %u register changes: %u transactions read-modify-written, %u through the shadow\n",
+		   Changes, RmwTransfers, ShadowTransfers);
+
+	CHECK(memcmp(Expected, g_MockRegisters, sizeof(Expected)) == 0);
+	CHECK(RmwTransfers == (2 * Changes));
+	CHECK(ShadowTransfers == 3);	/* BW_RATE to INT_MAP, DATA_FORMAT, FIFO_CTL */
+}
+
+
+int main(void)
+{
+	__io_accelerometer_i2cEngineInit();
+	MockBus_Reset();
+
+	Test_WriteThenRead();
+	Test_FifoReadUsesDma();
+	Test_Int1SurvivesTransfer();
+	Test_NackRetried();
+	Test_HungBusRecovered();
+	Test_ShadowSeeded();
+	Test_ShadowBurstMerging();
+	Test_ShadowFlushNack();
+	Test_ShadowTraffic();
+
+	printf("adxl343 i2c engine: %u transactions\n", xAccelBusStats.Transactions);
+	return Test_Result();
+}
+
+
+/******************************************* END OF FILE *******************************************/
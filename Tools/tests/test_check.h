@@ -0,0 +1,56 @@
+/**
+  **************************************************************************************************
+  * @file           : test_check.h
+  * @brief          : Checks shared by the host tests. Every failed check is printed and counted,
+  *  				  Test_Result() then ends main() with PASS or FAIL and the exit status.
+  *  				  Included once, by the test file holding main().
+  * @author         : Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Define to prevent recursive inclusion ---------------------------------------------------------*/
+#ifndef __TEST_CHECK_H
+#define __TEST_CHECK_H
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdio.h>
+
+
+/* Exported macros -------------------------------------------------------------------------------*/
+	/*--- Prints a failure, from a format string literal and its arguments, and counts it ---*/
+	#define TEST_FAIL(...)						do { printf("FAIL: " __VA_ARGS__); s_Failures++; } while(0)
+
+	/*--- Fails when the condition is false, naming the test function and the line ---*/
+	#define CHECK(cond)							do { if(!(cond)) { TEST_FAIL("%s, line %d: %s\n", __func__, __LINE__, #cond); } } while(0)
+
+
+/* Exported variables ----------------------------------------------------------------------------*/
+	/*--- Failed checks, from any thread of the test ---*/
+	static volatile uint32_t s_Failures;
+
+
+/* Exported functions ----------------------------------------------------------------------------*/
+/**
+ * @brief	Result of the test, printed last
+ * @retval	Exit status of main(): 0 when every check passed
+ */
+static int Test_Result(void)
+{
+	if(s_Failures != 0)
+	{
+		printf("FAIL: %u checks\n", s_Failures);
+		return 1;
+	}
+
+	printf("PASS\n");
+	return 0;
+}
+
+
+#endif  /* __TEST_CHECK_H */
+
+
+/******************************************* END OF FILE *******************************************/
@@ -0,0 +1,290 @@
+/**
+  **************************************************************************************************
+  * @file           : test_event_lut.c
+  * @brief          : Host test of the direct-indexed HCI event tables (bluenrg1_events_lut.c) against
+  *  				  the generated tables of bluenrg1_events.c. Every event code, vendor ones
+  *  				  included, must give the callback the linear search of the old APP_UserEvtRx()
+  *  				  finds, with the same parameters. A recorded session then goes through both
+  *  				  dispatchers to compare their cost per event.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "hci_const.h"
+#include "bluenrg1_events.h"
+#include "test_check.h"
+
+
+/* Private define --------------------------------------------------------------------------------*/
+#define TABLE_SIZE(table)						(sizeof(table) / sizeof((table)[0]))
+
+#define TRACE_WRITES							30		/* Control writes between connection and disconnection */
+#define TRACE_EVENTS							(TRACE_WRITES + 4)
+#define BENCH_ROUNDS							20000
+
+#define EVT_TX_POOL_AVAILABLE					0x0C16
+#define EVT_ATTRIBUTE_MODIFIED					0x0C01
+
+
+/* Private typedef -------------------------------------------------------------------------------*/
+typedef hci_event_process (*EventDispatcher)(uint8_t *pEvent, uint8_t **ppParams);
+
+typedef struct
+{
+	uint8_t Length;
+	uint8_t Data[HCI_READ_PACKET_SIZE];
+
+} TraceEvent;
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+static TraceEvent s_Trace[TRACE_EVENTS];
+static volatile uint32_t s_AttributeWrites;
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+/*--- Callback of the trace counted, the others are the weak ones of bluenrg1_events_cb.c ---*/
+void aci_gatt_attribute_modified_event(uint16_t Connection_Handle, uint16_t Attr_Handle, uint16_t Offset,
+									   uint16_t Attr_Data_Length, uint8_t Attr_Data[])
+{
+	s_AttributeWrites++;
+}
+
+
+/**
+ * @brief	The dispatcher APP_UserEvtRx() had before the lookup tables, first match kept
+ */
+static hci_event_process Linear_Lookup(uint8_t *pEvent, uint8_t **ppParams)
+{
+	hci_event_pckt *pEventPckt = (hci_event_pckt *)pEvent;
+	hci_event_process Process = NULL;
+
+	if(pEventPckt->evt == EVT_LE_META_EVENT)
+	{
+		evt_le_meta_event *pEvt = (void *)pEventPckt->data;
+
+		for(uint32_t idx = 0; idx < TABLE_SIZE(hci_le_meta_events_table); idx++)
+		{
+			if((pEvt->subevent == hci_le_meta_events_table[idx].evt_code) && (Process == NULL))
+			{
+				Process = hci_le_meta_events_table[idx].process;
+				*ppParams = pEvt->data;
+			}
+		}
+	}
+	else if(pEventPckt->evt == EVT_VENDOR)
+	{
+		evt_blue_aci *pBlueEvt = (void *)pEventPckt->data;
+
+		for(uint32_t idx = 0; idx < TABLE_SIZE(hci_vendor_specific_events_table); idx++)
+		{
+			if((pBlueEvt->ecode == hci_vendor_specific_events_table[idx].evt_code) && (Process == NULL))
+			{
+				Process = hci_vendor_specific_events_table[idx].process;
+				*ppParams = pBlueEvt->data;
+			}
+		}
+	}
+	else
+	{
+		for(uint32_t idx = 0; idx < TABLE_SIZE(hci_events_table); idx++)
+		{
+			if((pEventPckt->evt == hci_events_table[idx].evt_code) && (Process == NULL))
+			{
+				Process = hci_events_table[idx].process;
+				*ppParams = pEventPckt->data;
+			}
+		}
+	}
+
+	return Process;
+}
+
+
+/**
+ * @brief	Both dispatchers must agree on the callback and on its parameters
+ */
+static void Lookup_Compare(uint8_t *pEvent, uint16_t Code)
+{
+	uint8_t *pLinearParams = NULL, *pLutParams = NULL;
+	hci_event_process Linear = Linear_Lookup(pEvent, &pLinearParams);
+	hci_event_process Lut = hci_events_lut_lookup(pEvent, &pLutParams);
+
+	if((Linear != Lut) || ((Linear != NULL) && (pLinearParams != pLutParams)))
+	{
+		TEST_FAIL("event 0x%02X code 0x%04X: lookup table and generated table disagree\n", pEvent[0], Code);
+	}
+}
+
+
+static void Test_EveryEventCode(void)
+{
+	uint8_t Event[8] = {0};
+
+	for(uint16_t Code = 0; Code <= 0xFF; Code++)
+	{
+		if((Code == EVT_LE_META_EVENT) || (Code == EVT_VENDOR))
+			continue;
+
+		Event[0] = (uint8_t)Code;
+		Lookup_Compare(Event, Code);
+	}
+}
+
+
+static void Test_EveryLeMetaSubevent(void)
+{
+	uint8_t Event[8] = {EVT_LE_META_EVENT, 1};
+
+	for(uint16_t Code = 0; Code <= 0xFF; Code++)
+	{
+		Event[2] = (uint8_t)Code;
+		Lookup_Compare(Event, Code);
+	}
+}
+
+
+static void Test_EveryVendorCode(void)
+{
+	uint8_t Event[8] = {EVT_VENDOR, 2};
+
+	for(uint32_t Code = 0; Code <= 0xFFFF; Code++)
+	{
+		Event[2] = (uint8_t)Code;
+		Event[3] = (uint8_t)(Code >> 8);
+		Lookup_Compare(Event, (uint16_t)Code);
+	}
+}
+
+
+/**
+ * @brief	No entry the generated tables do not have, so no stale one after a regeneration
+ */
+static void Test_NoExtraEntries(void)
+{
+	uint32_t Events = 0, LeMeta = 0, Vendor = 0;
+
+	for(uint32_t idx = 0; idx < HCI_EVENTS_LUT_SIZE; idx++)
+		Events += (hci_events_lut[idx] != NULL);
+
+	for(uint32_t idx = 0; idx < HCI_LE_META_EVENTS_LUT_SIZE; idx++)
+		LeMeta += (hci_le_meta_events_lut[idx] != NULL);
+
+	for(uint32_t Group = 0; Group < HCI_VENDOR_EVENTS_LUT_GROUPS; Group++)
+	{
+		for(uint32_t idx = 0; idx < HCI_VENDOR_EVENTS_LUT_SIZE; idx++)
+			Vendor += (hci_vendor_specific_events_lut[Group][idx] != NULL);
+	}
+
+	CHECK(Events == TABLE_SIZE(hci_events_table));
+	CHECK(LeMeta == TABLE_SIZE(hci_le_meta_events_table));
+	CHECK(Vendor == TABLE_SIZE(hci_vendor_specific_events_table));
+}
+
+
+static uint8_t Trace_Add(uint8_t Index, uint8_t Event, const uint8_t *pParams, uint8_t Length)
+{
+	s_Trace[Index].Data[0] = Event;
+	s_Trace[Index].Data[1] = Length;
+	memcpy(&s_Trace[Index].Data[2], pParams, Length);
+	s_Trace[Index].Length = (uint8_t)(Length + 2);
+
+	return (uint8_t)(Index + 1);
+}
+
+
+/**
+ * @brief	Events of a session as recorded on the car: connection, MTU exchange, control writes
+ * 			each followed by a TX pool available, disconnection
+ */
+static void Trace_Build(void)
+{
+	static const uint8_t Connection[19] = {EVT_LE_CONN_COMPLETE, 0x00, 0x01, 0x08, 0x01, 0x00};
+	static const uint8_t Disconnection[4] = {0x00, 0x01, 0x08, 0x13};
+	static const uint8_t Mtu[6] = {0x0C, 0x0C, 0x01, 0x08, 0x9E, 0x00};
+	uint8_t Write[12] = {(uint8_t)EVT_ATTRIBUTE_MODIFIED, (uint8_t)(EVT_ATTRIBUTE_MODIFIED >> 8), 0x01, 0x08, 0x0E, 0x00,
+						 0x00, 0x00, 0x02, 0x00, 0x00, 0x00};
+	uint8_t Index = 0;
+
+	Index = Trace_Add(Index, EVT_LE_META_EVENT, Connection, sizeof(Connection));
+	Index = Trace_Add(Index, EVT_VENDOR, Mtu, sizeof(Mtu));
+
+	for(uint8_t idx = 0; idx < TRACE_WRITES; idx++)
+	{
+		Write[10] = idx;
+		Index = Trace_Add(Index, EVT_VENDOR, Write, sizeof(Write));
+	}
+
+	Index = Trace_Add(Index, EVT_DISCONN_COMPLETE, Disconnection, sizeof(Disconnection));
+	Trace_Add(Index, EVT_VENDOR, (const uint8_t[]){(uint8_t)EVT_TX_POOL_AVAILABLE, (uint8_t)(EVT_TX_POOL_AVAILABLE >> 8), 0x00, 0x00}, 4);
+}
+
+
+/**
+ * @brief	APP_UserEvtRx() on the recorded trace with either dispatcher
+ * @retval	Host time per event, ns
+ */
+static double Trace_Dispatch(EventDispatcher Dispatcher)
+{
+	struct timespec Start, End;
+	hci_event_process Process;
+	uint8_t *pParams;
+
+	clock_gettime(CLOCK_MONOTONIC, &Start);
+
+	for(uint32_t Round = 0; Round < BENCH_ROUNDS; Round++)
+	{
+		for(uint32_t idx = 0; idx < TRACE_EVENTS; idx++)
+		{
+			Process = Dispatcher(s_Trace[idx].Data, &pParams);
+			if(Process != NULL)
+				Process(pParams);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &End);
+
+	return (((End.tv_sec - Start.tv_sec) * 1e9) + (End.tv_nsec - Start.tv_nsec)) / ((double)BENCH_ROUNDS * TRACE_EVENTS);
+}
+
+
+static void Test_TraceBenchmark(void)
+{
+	double Linear_ns, Lut_ns;
+
+	Trace_Build();
+
+	s_AttributeWrites = 0;
+	Linear_ns = Trace_Dispatch(Linear_Lookup);
+	CHECK(s_AttributeWrites == (BENCH_ROUNDS * TRACE_WRITES));
+
+	s_AttributeWrites = 0;
+	Lut_ns = Trace_Dispatch(hci_events_lut_lookup);
+	CHECK(s_AttributeWrites == (BENCH_ROUNDS * TRACE_WRITES));
+
+	printf("event dispatch, recorded session of %u events: linear search %.1fns, lookup table %.1fns per event on the host\n",
+		   TRACE_EVENTS, Linear_ns, Lut_ns);
+
+	CHECK(Lut_ns < Linear_ns);
+}
+
+
+int main(void)
+{
+	Test_EveryEventCode();
+	Test_EveryLeMetaSubevent();
+	Test_EveryVendorCode();
+	Test_NoExtraEntries();
+	Test_TraceBenchmark();
+
+	return Test_Result();
+}
+
+
+/******************************************* END OF FILE *******************************************/
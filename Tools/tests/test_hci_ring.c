@@ -0,0 +1,458 @@
+/**
+  **************************************************************************************************
+  * @file           : test_hci_ring.c
+  * @brief          : Host stress test of the HCI received packet ring (hci_tl.c). A fake BlueNRG-2
+  *  				  runs on its own thread as the interrupt (producer), the event task drains the
+  *  				  ring (consumer) with random stalls, and two command tasks run hci_send_req()
+  *  				  until the last event, their responses queued behind the events. Every user event must come out
+  *  				  once and in order, and every command must get its own response.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hci_const.h"
+#include "hci.h"
+#include "hci_tl.h"
+#include "test_check.h"
+
+
+/* Private define --------------------------------------------------------------------------------*/
+#define TEST_EVENTS								200000
+#define TEST_COMMAND_TASKS						2
+#define TEST_TIMEOUT_S							60		/* A lost event or wake up hangs the test */
+#define TEST_FIFO_PACKETS						4096
+#define TEST_CONTROLLER_BACKLOG					64		/* Events the fake controller buffers before it waits */
+
+#define TEST_VENDOR_EVENT						0xFF
+#define TEST_OGF								0x3F
+
+
+/* Private typedef -------------------------------------------------------------------------------*/
+/*--- Packet waiting in the fake BlueNRG-2 for the host to read it ---*/
+typedef struct
+{
+	uint8_t Length;
+	uint8_t Data[HCI_READ_PACKET_SIZE];
+
+} FakePacket;
+
+/*--- Binary semaphore, a give on a given semaphore is lost like in FreeRTOS ---*/
+typedef struct
+{
+	pthread_mutex_t Lock;
+	pthread_cond_t Cond;
+	uint8_t Given;
+
+} BinarySem;
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+static pthread_mutex_t s_FifoLock = PTHREAD_MUTEX_INITIALIZER;
+static FakePacket s_Fifo[TEST_FIFO_PACKETS];
+static uint32_t s_FifoHead, s_FifoTail;
+static uint32_t s_FifoPeak;
+
+static volatile uint16_t s_DmaLength;
+static unsigned int s_IsrSeed = 1;
+
+static BinarySem s_SemIrq = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0};
+static BinarySem s_SemEvents = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0};
+static BinarySem s_SemHciCmd[HCI_CMD_WAIT_FLAG_NUM];
+static pthread_t s_EventsThread;
+
+static volatile uint32_t s_EventsReceived;
+static volatile uint32_t s_CommandsDone;
+static volatile uint32_t s_CommandTasks = TEST_COMMAND_TASKS;
+static volatile uint32_t s_Resumes;
+static volatile uint32_t s_IrqPolls;
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+static void Sem_Give(BinarySem *pSem)
+{
+	pthread_mutex_lock(&pSem->Lock);
+	pSem->Given = 1;
+	pthread_cond_signal(&pSem->Cond);
+	pthread_mutex_unlock(&pSem->Lock);
+}
+
+
+/**
+ * @retval	1: taken, 0: timed out
+ */
+static uint8_t Sem_Take(BinarySem *pSem, uint32_t Timeout_us)
+{
+	struct timespec Deadline;
+	uint8_t Taken;
+
+	clock_gettime(CLOCK_REALTIME, &Deadline);
+	Deadline.tv_nsec += (long)Timeout_us * 1000;
+	Deadline.tv_sec += Deadline.tv_nsec / 1000000000;
+	Deadline.tv_nsec %= 1000000000;
+
+	pthread_mutex_lock(&pSem->Lock);
+	while(!pSem->Given && (pthread_cond_timedwait(&pSem->Cond, &pSem->Lock, &Deadline) == 0));
+	Taken = pSem->Given;
+	pSem->Given = 0;
+	pthread_mutex_unlock(&pSem->Lock);
+
+	return Taken;
+}
+
+
+static void Fifo_Push(const uint8_t *pData, uint8_t Length)
+{
+	uint8_t Edge;
+
+	pthread_mutex_lock(&s_FifoLock);
+
+	if((s_FifoHead - s_FifoTail) >= TEST_FIFO_PACKETS)
+	{
+		printf("FAIL: fake controller FIFO overflow\n");
+		exit(1);
+	}
+
+	Edge = (s_FifoHead == s_FifoTail);
+	s_Fifo[s_FifoHead % TEST_FIFO_PACKETS].Length = Length;
+	memcpy(s_Fifo[s_FifoHead % TEST_FIFO_PACKETS].Data, pData, Length);
+	s_FifoHead++;
+
+	if((s_FifoHead - s_FifoTail) > s_FifoPeak)
+		s_FifoPeak = s_FifoHead - s_FifoTail;
+
+	pthread_mutex_unlock(&s_FifoLock);
+
+	/* IRQ line goes high, no edge if it already was */
+	if(Edge)
+		Sem_Give(&s_SemIrq);
+}
+
+
+static uint32_t Fifo_Pending(void)
+{
+	uint32_t Pending;
+
+	pthread_mutex_lock(&s_FifoLock);
+	Pending = s_FifoHead - s_FifoTail;
+	pthread_mutex_unlock(&s_FifoLock);
+
+	return Pending;
+}
+
+
+/**
+ * @brief	Receive callback of the fake bus. Half of the reads end later, like the SPI DMA ones.
+ */
+static int32_t FakeBus_Receive(uint8_t *pBuffer, uint16_t Size)
+{
+	FakePacket Packet;
+
+	pthread_mutex_lock(&s_FifoLock);
+
+	if(s_FifoHead == s_FifoTail)
+	{
+		pthread_mutex_unlock(&s_FifoLock);
+		return 0;
+	}
+
+	Packet = s_Fifo[s_FifoTail % TEST_FIFO_PACKETS];
+	s_FifoTail++;
+
+	pthread_mutex_unlock(&s_FifoLock);
+
+	memcpy(pBuffer, Packet.Data, (Packet.Length < Size) ? Packet.Length : Size);
+
+	if(rand_r(&s_IsrSeed) & 1)
+	{
+		s_DmaLength = Packet.Length;
+		return HCI_TL_RX_PENDING;
+	}
+
+	return Packet.Length;
+}
+
+
+/**
+ * @brief	Send callback of the fake bus, the controller answers with EVT_CMD_COMPLETE echoing the
+ * 			first parameter byte. The response is queued behind the events already pending.
+ */
+static int32_t FakeBus_Send(uint8_t *pBuffer, uint16_t Size)
+{
+	uint8_t Response[8];
+
+	Response[0] = HCI_EVENT_PKT;
+	Response[1] = EVT_CMD_COMPLETE;
+	Response[2] = 5;
+	Response[3] = 1;
+	Response[4] = pBuffer[1];
+	Response[5] = pBuffer[2];
+	Response[6] = 0;
+	Response[7] = pBuffer[4];
+
+	Fifo_Push(Response, sizeof(Response));
+
+	return Size;
+}
+
+
+static int32_t FakeBus_Init(void *pConf)
+{
+	return 0;
+}
+
+
+static int32_t FakeBus_Reset(void)
+{
+	return 0;
+}
+
+
+/**
+ * @brief	hci_tl_lowlevel_isr() and HCI_TL_SPI_RxCpltCallback() of the fake bus
+ */
+static void FakeIsr(void)
+{
+	uint16_t Length;
+
+	while(Fifo_Pending())
+	{
+		if(hci_notify_asynch_evt(NULL))
+			return;
+
+		if(s_DmaLength != 0)
+		{
+			sched_yield();
+			Length = s_DmaLength;
+			s_DmaLength = 0;
+			hci_notify_asynch_evt_cplt(Length);
+		}
+	}
+}
+
+
+/**
+ * @brief	Fake BlueNRG-2 and its interrupt. Queues the user events in bursts and reads them.
+ * 			While the host holds the reads off, the IRQ line stays high and no edge comes: only
+ * 			hci_tl_lowlevel_resume() restarts the reads. The wait is bounded because two host cores
+ * 			race where the interrupt and the task of the target cannot, each expiry is counted.
+ */
+static void *Thread_Controller(void *pArg)
+{
+	uint8_t Packet[8] = {HCI_EVENT_PKT, TEST_VENDOR_EVENT, 5, 0x04, 0, 0, 0, 0};
+	uint32_t Sequence = 0;
+	uint32_t Burst;
+
+	while((s_EventsReceived < TEST_EVENTS) || (s_CommandTasks != 0))
+	{
+		for(Burst = 1 + (rand_r(&s_IsrSeed) % 12);
+			(Burst > 0) && (Sequence < TEST_EVENTS) && (Fifo_Pending() < TEST_CONTROLLER_BACKLOG); Burst--)
+		{
+			memcpy(&Packet[4], &Sequence, sizeof(Sequence));
+			Fifo_Push(Packet, sizeof(Packet));
+			Sequence++;
+		}
+
+		FakeIsr();
+
+		if(!Sem_Take(&s_SemIrq, 1000) && Fifo_Pending())
+			s_IrqPolls++;
+	}
+
+	return NULL;
+}
+
+
+/**
+ * @brief	UserEvtRx callback, checks the events sequence
+ */
+static void UserEvtRx(void *pData)
+{
+	static uint32_t Expected = 0;
+	static unsigned int Seed = 2;
+	uint8_t *pPacket = pData;
+	uint32_t Sequence;
+
+	if(pPacket[1] != TEST_VENDOR_EVENT)
+	{
+		TEST_FAIL("event 0x%02X reached the user callback\n", pPacket[1]);
+		return;
+	}
+
+	memcpy(&Sequence, &pPacket[4], sizeof(Sequence));
+	if(Sequence != Expected)
+	{
+		TEST_FAIL("event %u received, %u expected\n", Sequence, Expected);
+	}
+	Expected = Sequence + 1;
+	s_EventsReceived++;
+
+	/* A slow callback now and then, so the ring fills up */
+	if((rand_r(&Seed) % 512) == 0)
+		usleep(300);
+}
+
+
+static void *Thread_Events(void *pArg)
+{
+	s_EventsThread = pthread_self();
+
+	while(s_EventsReceived < TEST_EVENTS)
+	{
+		Sem_Take(&s_SemEvents, 5000);
+		hci_user_evt_proc();
+	}
+
+	return NULL;
+}
+
+
+static void *Thread_Commands(void *pArg)
+{
+	uint16_t Ocf = (uint16_t)(uintptr_t)pArg;
+	unsigned int Seed = Ocf;
+	uint8_t Param, Response[2];
+	struct hci_request Request;
+
+	/* Commands keep coming while the ring fills up and drains */
+	for(uint32_t idx = 0; s_EventsReceived < TEST_EVENTS; idx++)
+	{
+		Param = (uint8_t)idx;
+
+		memset(&Request, 0, sizeof(Request));
+		Request.ogf = TEST_OGF;
+		Request.ocf = Ocf;
+		Request.event = EVT_CMD_COMPLETE;
+		Request.cparam = &Param;
+		Request.clen = sizeof(Param);
+		Request.rparam = Response;
+		Request.rlen = sizeof(Response);
+
+		if((hci_send_req(&Request, FALSE) < 0) || (Response[0] != 0) || (Response[1] != Param))
+		{
+			TEST_FAIL("command 0x%03X #%u got no or a wrong response\n", Ocf, idx);
+		}
+
+		__atomic_add_fetch(&s_CommandsDone, 1, __ATOMIC_SEQ_CST);
+		usleep(rand_r(&Seed) % 100);
+	}
+
+	__atomic_sub_fetch(&s_CommandTasks, 1, __ATOMIC_SEQ_CST);
+
+	return NULL;
+}
+
+
+/*--- Callbacks of the HCI transport layer ---*/
+void hci_tl_lowlevel_init(void)
+{
+	tHciIO Fops = {0};
+
+	Fops.Init = FakeBus_Init;
+	Fops.Reset = FakeBus_Reset;
+	Fops.Receive = FakeBus_Receive;
+	Fops.Send = FakeBus_Send;
+
+	hci_register_io_bus(&Fops);
+}
+
+
+void hci_tl_lowlevel_resume(void)
+{
+	__atomic_add_fetch(&s_Resumes, 1, __ATOMIC_SEQ_CST);
+	Sem_Give(&s_SemIrq);
+}
+
+
+void hci_user_evt_notify(void)
+{
+	Sem_Give(&s_SemEvents);
+}
+
+
+void hci_cmd_resp_wait(uint32_t flag, uint32_t timeout)
+{
+	Sem_Take(&s_SemHciCmd[flag], timeout * 1000);
+}
+
+
+void hci_cmd_resp_release(uint32_t flag)
+{
+	Sem_Give(&s_SemHciCmd[flag]);
+}
+
+
+uint8_t hci_user_evt_proc_caller(void)
+{
+	return pthread_equal(pthread_self(), s_EventsThread) ? 1 : 0;
+}
+
+
+static void Test_Timeout(int Signal)
+{
+	static const char Message[] = "FAIL: test timed out, an event or a wake up was lost\n";
+
+	write(STDOUT_FILENO, Message, sizeof(Message) - 1);
+	_exit(1);
+}
+
+
+int main(void)
+{
+	pthread_t Controller, Events, Commands[TEST_COMMAND_TASKS];
+	tHciReadPoolStats Stats;
+
+	for(uint8_t idx = 0; idx < HCI_CMD_WAIT_FLAG_NUM; idx++)
+	{
+		pthread_mutex_init(&s_SemHciCmd[idx].Lock, NULL);
+		pthread_cond_init(&s_SemHciCmd[idx].Cond, NULL);
+	}
+
+	hci_init(UserEvtRx, NULL);
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	signal(SIGALRM, Test_Timeout);
+	alarm(TEST_TIMEOUT_S);
+
+	pthread_create(&Events, NULL, Thread_Events, NULL);
+	for(uintptr_t idx = 0; idx < TEST_COMMAND_TASKS; idx++)
+		pthread_create(&Commands[idx], NULL, Thread_Commands, (void *)(0x10 + idx));
+	pthread_create(&Controller, NULL, Thread_Controller, NULL);
+
+	pthread_join(Events, NULL);
+	for(uint8_t idx = 0; idx < TEST_COMMAND_TASKS; idx++)
+		pthread_join(Commands[idx], NULL);
+	pthread_join(Controller, NULL);
+
+	hci_read_pool_stats(&Stats);
+
+	printf("hci ring: %u events, %u commands, ring peak %u/%u, %u reads held off, %u resumes, "
+		   "%u bounded IRQ waits, controller FIFO peak %u\n",
+		   s_EventsReceived, s_CommandsDone, Stats.peak, Stats.size, Stats.stalls, s_Resumes,
+		   s_IrqPolls, s_FifoPeak);
+
+	CHECK(Stats.pending == 0);
+
+	/* The command tasks never wait in the callback, no event may be dropped for their responses */
+	if(Stats.dropped != 0)
+		TEST_FAIL("%u events dropped\n", Stats.dropped);
+
+	/* Reads held off must be resumed by the consumer, not by the bounded wait */
+	if(s_IrqPolls > (Stats.stalls / 100))
+		TEST_FAIL("held off reads not resumed\n");
+
+	return Test_Result();
+}
+
+
+/******************************************* END OF FILE *******************************************/
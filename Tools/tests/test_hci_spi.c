@@ -0,0 +1,797 @@
+/**
+  **************************************************************************************************
+  * @file           : test_hci_spi.c
+  * @brief          : Host test of the BlueNRG-2 SPI transport (hci_tl_interface.c) and the HCI layer
+  *  				  above it (hci_tl.c), on the fake controller of fake_bluenrg2_spi.c. Built twice,
+  *  				  with the payload read by the SPI1 DMA and polled in the EXTI interrupt.
+  *  				  Replays the events of BLE sessions in bursts: every packet must come out whole
+  *  				  and in order, and the bytes the CPU clocks in interrupt context give the
+  *  				  interrupt time per packet at the SPI1 rate of the target. Single events then
+  *  				  give the latency from the EXTI edge to UserEvtRx, with the event task woken
+  *  				  by hci_user_evt_notify() and, for reference, polling every 15ms as it used to.
+  *  				  Last, command tasks race more hci_send_req() calls than there are command slots
+  *  				  while events stream in, the controller answering out of order: each must get
+  *  				  its own response. A command never answered must time out without spinning and
+  *  				  free its slot, and EVT_HARDWARE_ERROR must fail the commands waiting.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hci_const.h"
+#include "hci.h"
+#include "hci_tl.h"
+#include "hci_tl_interface.h"
+#include "fake_bluenrg2_spi.h"
+#include "test_check.h"
+
+
+/* Private define --------------------------------------------------------------------------------*/
+#define TEST_SESSIONS							100
+#define TEST_WRITES_PER_SESSION					30		/* Control writes between connection and disconnection */
+#define TEST_PACKETS_PER_SESSION				(TEST_WRITES_PER_SESSION + 3)
+#define TEST_PACKETS							(TEST_SESSIONS * TEST_PACKETS_PER_SESSION)
+#define TEST_BURST_MAX							8
+#define TEST_TIMEOUT_S							60		/* A lost packet or wake up hangs the test */
+
+#define LATENCY_EVENTS							200
+#define LATENCY_GAP_US							3000	/* Plus up to 1ms, events never queue up */
+#define LATENCY_POLL_PERIOD_MS					15		/* The vTaskDelayUntil() period of the old event task */
+#define LATENCY_MEDIAN_MAX_US					1000
+#define LATENCY_MAX_US							50000	/* Below the fallback wait of the event task */
+#define IDLE_TIME_US							100000
+#define EVENT_TASK_WAIT_US						100000
+
+#define COMMAND_TASKS							(HCI_CMD_INFLIGHT_MAX + 1)
+#define COMMANDS_PER_TASK						200
+#define COMMAND_EVENTS							1000	/* User events streamed meanwhile */
+#define COMMAND_RESPONSE_DELAY_US				2000	/* Up to, random per command */
+#define COMMAND_PENDING_MAX						8
+#define COMMAND_OGF								0x3F
+#define COMMAND_OCF_SILENT						0x3FF	/* The controller never answers it */
+#define COMMAND_WAIT_CPU_MAX_MS					50		/* CPU used by a caller through a whole timeout */
+#define HARDWARE_ERROR_AFTER_US					50000
+#define CALLBACK_COMMAND_MAX_MS					(HCI_DEFAULT_TIMEOUT_MS / 4)
+
+#define EVT_BLUE_GATT_ATTRIBUTE_MODIFIED		0x0C01
+#define EVT_BLUE_TEST_LONG						0x0C0F	/* Fills a whole HCI_READ_PACKET_SIZE buffer */
+
+#if (HCI_TL_SPI_RX_USE_DMA == 1)
+#define TEST_RX_MODE							"SPI1 DMA"
+#else
+#define TEST_RX_MODE							"polled in EXTI"
+#endif
+
+
+/* Private typedef -------------------------------------------------------------------------------*/
+typedef struct
+{
+	uint8_t Length;
+	uint8_t Data[HCI_READ_PACKET_SIZE];
+
+} TestPacket;
+
+/*--- Binary semaphore, a give on a given semaphore is lost like in FreeRTOS ---*/
+typedef struct
+{
+	pthread_mutex_t Lock;
+	pthread_cond_t Cond;
+	uint8_t Given;
+
+} BinarySem;
+
+/*--- Command response held by the fake controller until it is due ---*/
+typedef struct
+{
+	uint64_t Due_ns;
+	uint8_t Packet[8];
+
+} PendingResponse;
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+static TestPacket s_Packets[TEST_PACKETS];
+static uint64_t s_PayloadBytes;
+static volatile uint32_t s_Received;
+static volatile uint32_t s_Mismatches;
+static volatile uint8_t s_Done;
+
+static uint64_t s_QueuedAt_ns[TEST_PACKETS];
+static uint32_t s_Latency_us[TEST_PACKETS];
+static volatile uint32_t s_PollPeriod_ms;			/* 0: the event task waits for hci_user_evt_notify() */
+static volatile uint32_t s_Wakeups;
+static volatile uint32_t s_Notifications;
+
+static pthread_mutex_t s_ResponseLock = PTHREAD_MUTEX_INITIALIZER;
+static PendingResponse s_Responses[COMMAND_PENDING_MAX];
+static uint32_t s_ResponseCount;
+static unsigned int s_ResponseSeed = 9;
+static volatile uint8_t s_ResponderStop;
+static volatile uint32_t s_HardwareErrors;
+static volatile uint32_t s_CommandErrors;
+static volatile uint8_t s_CallbackCommand;			/* UserEvtRx() sends a command behind a full ring */
+static int s_CallbackResult;
+static uint8_t s_CallbackEcho;
+static double s_Callback_ms;
+
+static BinarySem s_SemEvents = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0};
+static BinarySem s_SemHciCmd[HCI_CMD_WAIT_FLAG_NUM];
+static pthread_t s_EventsThread;
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+static void Sem_Give(BinarySem *pSem)
+{
+	pthread_mutex_lock(&pSem->Lock);
+	pSem->Given = 1;
+	pthread_cond_signal(&pSem->Cond);
+	pthread_mutex_unlock(&pSem->Lock);
+}
+
+
+/**
+ * @retval	1: taken, 0: timed out
+ */
+static uint8_t Sem_Take(BinarySem *pSem, uint32_t Timeout_us)
+{
+	struct timespec Deadline;
+	uint8_t Taken;
+
+	clock_gettime(CLOCK_REALTIME, &Deadline);
+	Deadline.tv_nsec += (long)Timeout_us * 1000;
+	Deadline.tv_sec += Deadline.tv_nsec / 1000000000;
+	Deadline.tv_nsec %= 1000000000;
+
+	pthread_mutex_lock(&pSem->Lock);
+	while(!pSem->Given && (pthread_cond_timedwait(&pSem->Cond, &pSem->Lock, &Deadline) == 0));
+	Taken = pSem->Given;
+	pSem->Given = 0;
+	pthread_mutex_unlock(&pSem->Lock);
+
+	return Taken;
+}
+
+
+static uint64_t Test_Now_ns(void)
+{
+	struct timespec Now;
+
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return ((uint64_t)Now.tv_sec * 1000000000ull) + (uint64_t)Now.tv_nsec;
+}
+
+
+static int Latency_Compare(const void *pA, const void *pB)
+{
+	uint32_t A = *(const uint32_t *)pA, B = *(const uint32_t *)pB;
+
+	return (A > B) - (A < B);
+}
+
+
+/**
+ * @brief	Event packet of Length parameter bytes, the ones past Fixed are filled from the seed
+ */
+static void Packet_Build(TestPacket *pPacket, uint8_t Event, const uint8_t *pFixed, uint8_t Fixed, uint8_t Length, unsigned int *pSeed)
+{
+	pPacket->Data[0] = HCI_EVENT_PKT;
+	pPacket->Data[1] = Event;
+	pPacket->Data[2] = Length;
+	memcpy(&pPacket->Data[3], pFixed, Fixed);
+
+	for(uint8_t idx = Fixed; idx < Length; idx++)
+		pPacket->Data[3 + idx] = (uint8_t)rand_r(pSeed);
+
+	pPacket->Length = (uint8_t)(Length + 3);
+	s_PayloadBytes += pPacket->Length;
+}
+
+
+/**
+ * @brief	Events of a session as the car sees them: connection, control writes of 1 to 20 bytes,
+ * 			one long vendor event, disconnection
+ */
+static void Session_Build(void)
+{
+	static const uint8_t Connection[] = {EVT_LE_CONN_COMPLETE, 0x00, 0x01, 0x08};
+	static const uint8_t Disconnection[] = {0x00, 0x01, 0x08, 0x13};
+	uint8_t Modified[] = {(uint8_t)EVT_BLUE_GATT_ATTRIBUTE_MODIFIED, (uint8_t)(EVT_BLUE_GATT_ATTRIBUTE_MODIFIED >> 8), 0x01, 0x08};
+	uint8_t Long[] = {(uint8_t)EVT_BLUE_TEST_LONG, (uint8_t)(EVT_BLUE_TEST_LONG >> 8)};
+	unsigned int Seed = 7;
+	uint32_t Index = 0;
+
+	for(uint32_t Session = 0; Session < TEST_SESSIONS; Session++)
+	{
+		Packet_Build(&s_Packets[Index++], EVT_LE_META_EVENT, Connection, sizeof(Connection), 19, &Seed);
+
+		for(uint32_t Write = 0; Write < TEST_WRITES_PER_SESSION; Write++)
+		{
+			/* Connection and attribute handles, offset, length, value */
+			uint8_t Value = (uint8_t)(1 + ((Session + Write * 7) % 20));
+			Packet_Build(&s_Packets[Index++], EVT_VENDOR, Modified, sizeof(Modified), (uint8_t)(10 + Value), &Seed);
+		}
+
+		Packet_Build(&s_Packets[Index++], EVT_VENDOR, Long, sizeof(Long), HCI_READ_PACKET_SIZE - 3, &Seed);
+		Packet_Build(&s_Packets[Index++], EVT_DISCONN_COMPLETE, Disconnection, sizeof(Disconnection), 4, &Seed);
+	}
+}
+
+
+static void Callback_Command(void);
+
+
+/**
+ * @brief	UserEvtRx callback, every packet must be the next one replayed, byte for byte
+ */
+static void UserEvtRx(void *pData)
+{
+	uint8_t *pPacket = pData;
+	const TestPacket *pExpected = &s_Packets[s_Received % TEST_PACKETS];
+
+	if(pPacket[1] == EVT_HARDWARE_ERROR)
+	{
+		s_HardwareErrors++;
+		return;
+	}
+
+	if(s_CallbackCommand)
+	{
+		s_CallbackCommand = 0;
+		Callback_Command();
+	}
+
+	if((s_Received >= TEST_PACKETS) || ((uint8_t)(pPacket[2] + 3) != pExpected->Length) ||
+	   (memcmp(pPacket, pExpected->Data, pExpected->Length) != 0))
+	{
+		if(s_Mismatches++ < 5)
+			printf("FAIL: packet %u (event 0x%02X, %u bytes) is not the one replayed\n", s_Received, pPacket[1], pPacket[2] + 3);
+	}
+
+	s_Latency_us[s_Received % TEST_PACKETS] = (uint32_t)((Test_Now_ns() - s_QueuedAt_ns[s_Received % TEST_PACKETS]) / 1000);
+	s_Received++;
+}
+
+
+/**
+ * @brief	The BLE event task, blocked until notified, or polling like the old vTaskDelayUntil() loop
+ */
+static void *Thread_Events(void *pArg)
+{
+	struct timespec Next;
+
+	s_EventsThread = pthread_self();
+	clock_gettime(CLOCK_MONOTONIC, &Next);
+
+	while(!s_Done)
+	{
+		if(s_PollPeriod_ms != 0)
+		{
+			Next.tv_nsec += (long)s_PollPeriod_ms * 1000000;
+			Next.tv_sec += Next.tv_nsec / 1000000000;
+			Next.tv_nsec %= 1000000000;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &Next, NULL);
+		}
+		else
+		{
+			if(!Sem_Take(&s_SemEvents, EVENT_TASK_WAIT_US))
+			{
+				clock_gettime(CLOCK_MONOTONIC, &Next);
+				continue;
+			}
+			s_Wakeups++;
+		}
+
+		hci_user_evt_proc();
+	}
+
+	return NULL;
+}
+
+
+/*--- Callbacks of the HCI transport layer ---*/
+void hci_user_evt_notify(void)
+{
+	__atomic_add_fetch(&s_Notifications, 1, __ATOMIC_SEQ_CST);
+	Sem_Give(&s_SemEvents);
+}
+
+
+void hci_cmd_resp_wait(uint32_t flag, uint32_t timeout)
+{
+	Sem_Take(&s_SemHciCmd[flag], timeout * 1000);
+}
+
+
+void hci_cmd_resp_release(uint32_t flag)
+{
+	Sem_Give(&s_SemHciCmd[flag]);
+}
+
+
+uint8_t hci_user_evt_proc_caller(void)
+{
+	return pthread_equal(pthread_self(), s_EventsThread) ? 1 : 0;
+}
+
+
+/**
+ * @brief	The sessions go out in bursts of 1 to TEST_BURST_MAX packets with random gaps, so that
+ * 			reads start from an edge, from the IRQ line still high, and from a full ring
+ */
+static void Test_ReplaySessions(void)
+{
+	unsigned int Seed = 3;
+	uint32_t Sent = 0;
+	uint32_t Burst;
+	uint64_t HeaderBytes;
+
+	while(Sent < TEST_PACKETS)
+	{
+		for(Burst = 1 + (rand_r(&Seed) % TEST_BURST_MAX); (Burst > 0) && (Sent < TEST_PACKETS); Burst--, Sent++)
+		{
+			while(FakeBlueNRG_Pending() >= (FAKE_FIFO_PACKETS - 1))
+				usleep(100);
+
+			s_QueuedAt_ns[Sent] = Test_Now_ns();
+			FakeBlueNRG_Queue(s_Packets[Sent].Data, s_Packets[Sent].Length);
+		}
+
+		usleep(rand_r(&Seed) % 2000);
+	}
+
+	while(s_Received < TEST_PACKETS)
+		usleep(1000);
+
+	HeaderBytes = (uint64_t)FAKE_SPI_HEADER_SIZE * (g_FakeSpi.Reads + g_FakeSpi.EmptyReads);
+
+	printf("hci spi (%s): %u packets, %llu payload bytes, %u interrupts, %u empty reads, FIFO peak %u\n",
+		   TEST_RX_MODE, s_Received, (unsigned long long)s_PayloadBytes, g_FakeSpi.Interrupts + g_FakeSpi.DmaInterrupts,
+		   g_FakeSpi.EmptyReads, g_FakeSpi.FifoPeak);
+	printf("  CPU clocked %llu bytes in interrupt context, %.1fus per packet on the SPI1 bus, host interrupt time %.1fus per packet\n",
+		   (unsigned long long)g_FakeSpi.IsrBytes, ((double)g_FakeSpi.IsrBytes * FAKE_SPI_BYTE_NS / 1000.0) / s_Received,
+		   ((double)g_FakeSpi.IsrTime_ns / 1000.0) / s_Received);
+
+	CHECK(s_Received == TEST_PACKETS);
+	CHECK(s_Mismatches == 0);
+	CHECK(g_FakeSpi.Reads == TEST_PACKETS);
+
+#if (HCI_TL_SPI_RX_USE_DMA == 1)
+	/* Only the headers are clocked by the CPU, the payloads all go through the DMA */
+	CHECK(g_FakeSpi.IsrBytes == HeaderBytes);
+	CHECK(g_FakeSpi.DmaBytes == s_PayloadBytes);
+#else
+	CHECK(g_FakeSpi.IsrBytes == (HeaderBytes + s_PayloadBytes));
+	CHECK(g_FakeSpi.DmaBytes == 0);
+#endif
+}
+
+
+/**
+ * @brief	One event at a time, from the rising edge of the IRQ line to the UserEvtRx callback
+ * @retval	Median latency, us
+ */
+static uint32_t Latency_Run(uint32_t PollPeriod_ms)
+{
+	static uint32_t Sorted[LATENCY_EVENTS];
+	unsigned int Seed = 5;
+
+	s_PollPeriod_ms = PollPeriod_ms;
+	s_Received = 0;
+
+	for(uint32_t idx = 0; idx < LATENCY_EVENTS; idx++)
+	{
+		s_QueuedAt_ns[idx] = Test_Now_ns();
+		FakeBlueNRG_Queue(s_Packets[idx].Data, s_Packets[idx].Length);
+
+		usleep(LATENCY_GAP_US + (rand_r(&Seed) % 1000));
+	}
+
+	while(s_Received < LATENCY_EVENTS)
+		usleep(1000);
+
+	memcpy(Sorted, s_Latency_us, sizeof(Sorted));
+	qsort(Sorted, LATENCY_EVENTS, sizeof(Sorted[0]), Latency_Compare);
+
+	printf("  %s: EXTI edge to UserEvtRx median %uus, 99th percentile %uus, max %uus\n",
+		   (PollPeriod_ms != 0) ? "event task polling every 15ms" : "event task notified          ",
+		   Sorted[LATENCY_EVENTS / 2], Sorted[(LATENCY_EVENTS * 99) / 100], Sorted[LATENCY_EVENTS - 1]);
+
+	CHECK(s_Mismatches == 0);
+
+	if(PollPeriod_ms == 0)
+		CHECK(Sorted[LATENCY_EVENTS - 1] < LATENCY_MAX_US);
+
+	return Sorted[LATENCY_EVENTS / 2];
+}
+
+
+static void Test_EventLatency(void)
+{
+	uint32_t Notified_us, Polled_us;
+	uint32_t Notifications = s_Notifications;
+	uint32_t Wakeups = s_Wakeups;
+
+	printf("hci event latency (%s), %u single events:\n", TEST_RX_MODE, LATENCY_EVENTS);
+
+	Notified_us = Latency_Run(0);
+
+	/* One notification, and one wake up of the event task at most, per event */
+	CHECK((s_Notifications - Notifications) == LATENCY_EVENTS);
+	CHECK((s_Wakeups - Wakeups) <= LATENCY_EVENTS);
+
+	Polled_us = Latency_Run(LATENCY_POLL_PERIOD_MS);
+	s_PollPeriod_ms = 0;
+
+	CHECK(Notified_us < LATENCY_MEDIAN_MAX_US);
+	CHECK(Notified_us < (Polled_us / 4));
+}
+
+
+/**
+ * @brief	Nothing on the bus, nothing wakes the event task
+ */
+static void Test_IdleNoWakeup(void)
+{
+	uint32_t Notifications, Wakeups;
+
+	/* Let the event task go back to waiting after the polled run */
+	usleep(2 * LATENCY_POLL_PERIOD_MS * 1000);
+
+	Notifications = s_Notifications;
+	Wakeups = s_Wakeups;
+	usleep(IDLE_TIME_US);
+
+	printf("idle %ums: %u notifications, %u event task wake ups\n", IDLE_TIME_US / 1000,
+		   s_Notifications - Notifications, s_Wakeups - Wakeups);
+
+	CHECK(s_Notifications == Notifications);
+	CHECK(s_Wakeups == Wakeups);
+}
+
+
+/**
+ * @brief	Command handler of the fake controller: EVT_CMD_COMPLETE echoing the first parameter
+ * 			byte, due after a random delay so that the responses of the tasks cross
+ */
+static void Controller_Command(const uint8_t *pCommand, uint16_t Length)
+{
+	uint16_t Opcode = (uint16_t)(pCommand[1] | (pCommand[2] << 8));
+	PendingResponse *pResponse;
+
+	if((Length < 5) || (Opcode == cmd_opcode_pack(COMMAND_OGF, COMMAND_OCF_SILENT)))
+		return;
+
+	pthread_mutex_lock(&s_ResponseLock);
+
+	if(s_ResponseCount >= COMMAND_PENDING_MAX)
+	{
+		printf("FAIL: more commands waiting for their response than tasks\n");
+		exit(1);
+	}
+
+	pResponse = &s_Responses[s_ResponseCount++];
+	pResponse->Due_ns = Test_Now_ns() + ((uint64_t)(rand_r(&s_ResponseSeed) % COMMAND_RESPONSE_DELAY_US) * 1000);
+	pResponse->Packet[0] = HCI_EVENT_PKT;
+	pResponse->Packet[1] = EVT_CMD_COMPLETE;
+	pResponse->Packet[2] = 5;
+	pResponse->Packet[3] = 1;
+	pResponse->Packet[4] = pCommand[1];
+	pResponse->Packet[5] = pCommand[2];
+	pResponse->Packet[6] = 0;
+	pResponse->Packet[7] = pCommand[4];
+
+	pthread_mutex_unlock(&s_ResponseLock);
+}
+
+
+/**
+ * @brief	Queues the command responses that are due
+ */
+static void *Thread_Responder(void *pArg)
+{
+	while(!s_ResponderStop)
+	{
+		uint64_t Now = Test_Now_ns();
+
+		pthread_mutex_lock(&s_ResponseLock);
+		for(uint32_t idx = 0; idx < s_ResponseCount; )
+		{
+			if(s_Responses[idx].Due_ns <= Now)
+			{
+				FakeBlueNRG_Queue(s_Responses[idx].Packet, sizeof(s_Responses[idx].Packet));
+				s_Responses[idx] = s_Responses[--s_ResponseCount];
+			}
+			else
+				idx++;
+		}
+		pthread_mutex_unlock(&s_ResponseLock);
+
+		usleep(100);
+	}
+
+	return NULL;
+}
+
+
+/**
+ * @retval	hci_send_req() result, 0 with the echoed parameter in *pEcho on success
+ */
+static int Command_Send(uint16_t Ocf, uint8_t Param, uint8_t *pEcho)
+{
+	uint8_t Response[2] = {0xFF, 0};
+	struct hci_request Request;
+	int Result;
+
+	memset(&Request, 0, sizeof(Request));
+	Request.ogf = COMMAND_OGF;
+	Request.ocf = Ocf;
+	Request.event = EVT_CMD_COMPLETE;
+	Request.cparam = &Param;
+	Request.clen = sizeof(Param);
+	Request.rparam = Response;
+	Request.rlen = sizeof(Response);
+
+	Result = hci_send_req(&Request, FALSE);
+
+	if((Result == 0) && (Response[0] != 0))
+		Result = -1;
+
+	*pEcho = Response[1];
+	return Result;
+}
+
+
+static void *Thread_Commands(void *pArg)
+{
+	uint16_t Ocf = (uint16_t)(uintptr_t)pArg;
+	uint8_t Echo;
+
+	for(uint32_t idx = 0; idx < COMMANDS_PER_TASK; idx++)
+	{
+		uint8_t Param = (uint8_t)(idx ^ Ocf);
+
+		if((Command_Send(Ocf, Param, &Echo) != 0) || (Echo != Param))
+		{
+			if(__atomic_add_fetch(&s_CommandErrors, 1, __ATOMIC_SEQ_CST) <= 5)
+				printf("FAIL: command 0x%03X #%u got no or a wrong response\n", Ocf, idx);
+		}
+	}
+
+	return NULL;
+}
+
+
+static void *Thread_SilentCommand(void *pArg)
+{
+	uint8_t Echo;
+
+	return (void *)(intptr_t)Command_Send(COMMAND_OCF_SILENT, 0, &Echo);
+}
+
+
+/**
+ * @brief	More command tasks than slots, while user events keep coming
+ */
+static void Test_ConcurrentCommands(void)
+{
+	pthread_t Commands[COMMAND_TASKS];
+	uint32_t Writes = g_FakeSpi.Writes;
+	unsigned int Seed = 11;
+	uint64_t Start = Test_Now_ns();
+
+	s_Received = 0;
+
+	for(uintptr_t idx = 0; idx < COMMAND_TASKS; idx++)
+		pthread_create(&Commands[idx], NULL, Thread_Commands, (void *)(0x20 + idx));
+
+	for(uint32_t idx = 0; idx < COMMAND_EVENTS; idx++)
+	{
+		/* The responses must fit too, on a loaded host the event task can fall behind */
+		while(FakeBlueNRG_Pending() >= (FAKE_FIFO_PACKETS - COMMAND_PENDING_MAX))
+			usleep(100);
+
+		FakeBlueNRG_Queue(s_Packets[idx].Data, s_Packets[idx].Length);
+		usleep(rand_r(&Seed) % 500);
+	}
+
+	for(uint8_t idx = 0; idx < COMMAND_TASKS; idx++)
+		pthread_join(Commands[idx], NULL);
+
+	while(s_Received < COMMAND_EVENTS)
+		usleep(1000);
+
+	printf("hci commands (%s): %u tasks on %u slots, %u commands in %.0fms, %u events meanwhile\n",
+		   TEST_RX_MODE, COMMAND_TASKS, HCI_CMD_INFLIGHT_MAX, g_FakeSpi.Writes - Writes,
+		   (double)(Test_Now_ns() - Start) / 1e6, s_Received);
+
+	CHECK(s_CommandErrors == 0);
+	CHECK((g_FakeSpi.Writes - Writes) == (COMMAND_TASKS * COMMANDS_PER_TASK));
+	CHECK(s_Received == COMMAND_EVENTS);
+	CHECK(s_Mismatches == 0);
+}
+
+
+/**
+ * @brief	Runs in the event task: the next HCI_READ_PACKET_NUM_MAX events fill the ring, the last
+ * 			one stays in the controller, then a command goes out. Its send resumes the read, so
+ * 			the last event is parked and the response must still be read behind it.
+ */
+static void Callback_Command(void)
+{
+	tHciReadPoolStats Stats;
+	uint64_t Start;
+
+	for(uint32_t idx = 1; idx <= HCI_READ_PACKET_NUM_MAX; idx++)
+		FakeBlueNRG_Queue(s_Packets[s_Received + idx].Data, s_Packets[s_Received + idx].Length);
+
+	do
+	{
+		usleep(100);
+		hci_read_pool_stats(&Stats);
+	}
+	while((Stats.pending < HCI_READ_PACKET_NUM_MAX) || (FakeBlueNRG_Pending() != 1));
+
+	Start = Test_Now_ns();
+	s_CallbackResult = Command_Send(0x32, 0xC3, &s_CallbackEcho);
+	s_Callback_ms = (double)(Test_Now_ns() - Start) / 1e6;
+}
+
+
+/**
+ * @brief	A command sent from an event callback while the ring is full and an event is parked
+ */
+static void Test_CommandFromCallback(void)
+{
+	tHciReadPoolStats Stats;
+	uint32_t Dropped;
+
+	hci_read_pool_stats(&Stats);
+	Dropped = Stats.dropped;
+
+	s_Received = 0;
+	s_CallbackCommand = 1;
+	FakeBlueNRG_Queue(s_Packets[0].Data, s_Packets[0].Length);
+
+	while(s_Received < (HCI_READ_PACKET_NUM_MAX + 1))
+		usleep(1000);
+
+	hci_read_pool_stats(&Stats);
+
+	printf("command from callback (%s): returned %d after %.1fms, %u events behind it\n",
+		   TEST_RX_MODE, s_CallbackResult, s_Callback_ms, s_Received - 1);
+
+	CHECK((s_CallbackResult == 0) && (s_CallbackEcho == 0xC3));
+	CHECK(s_Callback_ms < CALLBACK_COMMAND_MAX_MS);
+	CHECK(s_Received == (HCI_READ_PACKET_NUM_MAX + 1));
+	CHECK(s_Mismatches == 0);
+	CHECK(Stats.dropped == Dropped);
+}
+
+
+/**
+ * @brief	A command never answered times out after HCI_DEFAULT_TIMEOUT_MS, blocked and not
+ * 			spinning, and its slot serves the next commands
+ */
+static void Test_CommandTimeout(void)
+{
+	struct timespec CpuStart, CpuEnd;
+	uint64_t Start = Test_Now_ns();
+	double Elapsed_ms, Cpu_ms;
+	uint8_t Echo;
+	int Result;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &CpuStart);
+	Result = Command_Send(COMMAND_OCF_SILENT, 0, &Echo);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &CpuEnd);
+
+	Elapsed_ms = (double)(Test_Now_ns() - Start) / 1e6;
+	Cpu_ms = ((CpuEnd.tv_sec - CpuStart.tv_sec) * 1e3) + ((CpuEnd.tv_nsec - CpuStart.tv_nsec) / 1e6);
+
+	printf("command timeout: returned %d after %.0fms, %.2fms of CPU\n", Result, Elapsed_ms, Cpu_ms);
+
+	CHECK(Result < 0);
+	CHECK(Elapsed_ms >= HCI_DEFAULT_TIMEOUT_MS);
+	CHECK(Cpu_ms < COMMAND_WAIT_CPU_MAX_MS);
+
+	/* Every slot is free again */
+	for(uint8_t idx = 0; idx < HCI_CMD_INFLIGHT_MAX; idx++)
+		CHECK((Command_Send(0x30, (uint8_t)(0xA0 + idx), &Echo) == 0) && (Echo == (uint8_t)(0xA0 + idx)));
+}
+
+
+/**
+ * @brief	EVT_HARDWARE_ERROR fails every command waiting, and still reaches the application
+ */
+static void Test_HardwareError(void)
+{
+	static const uint8_t HardwareError[] = {HCI_EVENT_PKT, EVT_HARDWARE_ERROR, 1, 0x01};
+	pthread_t Silent[HCI_CMD_INFLIGHT_MAX];
+	uint32_t HardwareErrors = s_HardwareErrors;
+	uint64_t Start = Test_Now_ns();
+	void *pResult;
+	uint8_t Echo;
+
+	for(uint8_t idx = 0; idx < HCI_CMD_INFLIGHT_MAX; idx++)
+		pthread_create(&Silent[idx], NULL, Thread_SilentCommand, NULL);
+
+	usleep(HARDWARE_ERROR_AFTER_US);
+	FakeBlueNRG_Queue(HardwareError, sizeof(HardwareError));
+
+	for(uint8_t idx = 0; idx < HCI_CMD_INFLIGHT_MAX; idx++)
+	{
+		pthread_join(Silent[idx], &pResult);
+		CHECK((intptr_t)pResult < 0);
+	}
+
+	printf("hardware error: %u waiting commands failed after %.0fms\n", HCI_CMD_INFLIGHT_MAX,
+		   (double)(Test_Now_ns() - Start) / 1e6);
+
+	CHECK((Test_Now_ns() - Start) < ((uint64_t)HCI_DEFAULT_TIMEOUT_MS * 1000000 / 2));
+
+	while(s_HardwareErrors == HardwareErrors)
+		usleep(1000);
+
+	/* The slots are usable again */
+	CHECK((Command_Send(0x31, 0x5A, &Echo) == 0) && (Echo == 0x5A));
+}
+
+
+static void Test_Timeout(int Signal)
+{
+	static const char Message[] = "FAIL: test timed out, a packet or a wake up was lost\n";
+
+	write(STDOUT_FILENO, Message, sizeof(Message) - 1);
+	_exit(1);
+}
+
+
+int main(void)
+{
+	pthread_t Events, Responder;
+
+	for(uint8_t idx = 0; idx < HCI_CMD_WAIT_FLAG_NUM; idx++)
+	{
+		pthread_mutex_init(&s_SemHciCmd[idx].Lock, NULL);
+		pthread_cond_init(&s_SemHciCmd[idx].Cond, NULL);
+	}
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	signal(SIGALRM, Test_Timeout);
+	alarm(TEST_TIMEOUT_S);
+
+	Session_Build();
+
+	g_FakeCommandHandler = Controller_Command;
+	FakeBlueNRG_Start();
+	hci_init(UserEvtRx, NULL);
+	pthread_create(&Events, NULL, Thread_Events, NULL);
+	pthread_create(&Responder, NULL, Thread_Responder, NULL);
+
+	Test_ReplaySessions();
+	Test_EventLatency();
+	Test_IdleNoWakeup();
+	Test_ConcurrentCommands();
+	Test_CommandFromCallback();
+	Test_CommandTimeout();
+	Test_HardwareError();
+
+	s_ResponderStop = 1;
+	pthread_join(Responder, NULL);
+	s_Done = 1;
+	pthread_join(Events, NULL);
+	FakeBlueNRG_Stop();
+
+	return Test_Result();
+}
+
+
+/******************************************* END OF FILE *******************************************/
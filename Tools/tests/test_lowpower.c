@@ -0,0 +1,278 @@
+/**
+  **************************************************************************************************
+  * @file           : test_lowpower.c
+  * @brief          : Host test of the tick compensation of the tickless idle (car_app_lowpower.c).
+  *  				  SysTick and TIM5 are modelled on a core cycle time line at 100MHz: the tick
+  *  				  count stepped after a sleep must be the ticks elapsed, and SysTick must take
+  *  				  the next tick on the boundary it had before the sleep. Hours of idle periods,
+  *  				  woken up by the timer or by an interrupt at random, must not move the tick by
+  *  				  a single cycle. The STOP mode conversion of the RTC time is not built here,
+  *  				  LOWPOWER_USE_STOP_MODE is 0 on the host.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "FreeRTOS.h"
+#include "car_app_lowpower.h"
+#include "tim.h"
+#include "test_check.h"
+
+
+/* Private define --------------------------------------------------------------------------------*/
+#define CORE_CLOCK_HZ							100000000
+#define CYCLES_PER_TICK							(CORE_CLOCK_HZ / configTICK_RATE_HZ)
+#define CYCLES_PER_COUNT						((CORE_CLOCK_HZ / 1000000) * TIMEBASE_US_PER_COUNT)
+#define MIN_RELOAD_CYCLES						100		/* SYSTICK_MIN_RELOAD_CYCLES */
+#define MAX_IDLE_TICKS							20000	/* LOWPOWER_MAX_IDLE_TICKS */
+
+#define RANDOM_CASES							200000
+#define RUN_DURATION_S							7200
+#define RUN_TIMER_WAKEUP_PERCENT				60
+
+
+/* Private typedef -------------------------------------------------------------------------------*/
+/*--- Tick side of the time line: kernel tick count and time of the next SysTick interrupt ---*/
+typedef struct
+{
+	uint64_t Now;					/* Core cycles */
+	uint64_t NextTick;				/* Core cycles */
+	uint64_t Origin;				/* Tick boundary of tick 0, core cycles */
+	uint32_t TickCount;
+
+} TickModel;
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+static unsigned int s_Seed = 24;
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+static uint32_t Random_Range(uint32_t Min, uint32_t Max)
+{
+	return Min + (uint32_t)(((uint64_t)rand_r(&s_Seed) * (Max - Min + 1)) / ((uint64_t)RAND_MAX + 1));
+}
+
+
+/**
+ * @brief	Core cycles from the SysTick stop to the tick boundary of the task timeout
+ */
+static uint64_t Timeout_Cycles(uint32_t ToBoundary, uint32_t ExpectedIdle)
+{
+	return ToBoundary + ((uint64_t)(ExpectedIdle - 1) * CYCLES_PER_TICK);
+}
+
+
+/**
+ * @brief	Any wake up up to the one of TIM5: the counts slept and SysTick must end on a boundary
+ */
+static void Test_PhaseKept(void)
+{
+	uint32_t ToBoundary, ExpectedIdle, WakeCounts, Slept, Ticks, Remaining;
+	uint32_t LostTicks = xLowPowerStats.LostTicks;
+	uint64_t Elapsed;
+
+	for(uint32_t idx = 0; idx < RANDOM_CASES; idx++)
+	{
+		ToBoundary = Random_Range(1, CYCLES_PER_TICK);
+		ExpectedIdle = (idx & 1) ? Random_Range(2, 20) : Random_Range(2, MAX_IDLE_TICKS);
+		WakeCounts = LowPower_WakeCounts(ToBoundary, ExpectedIdle);
+		Slept = Random_Range(0, WakeCounts + 1);
+
+		Ticks = LowPower_CompensateTicks(Slept, ToBoundary, ExpectedIdle, &Remaining);
+		Elapsed = (uint64_t)Slept * CYCLES_PER_COUNT;
+
+		if((Ticks >= ExpectedIdle) || (Remaining < MIN_RELOAD_CYCLES) || (Remaining >= (CYCLES_PER_TICK + MIN_RELOAD_CYCLES)) ||
+		   ((Elapsed + Remaining) != (ToBoundary + ((uint64_t)Ticks * CYCLES_PER_TICK))))
+		{
+			TEST_FAIL("%s, boundary %u, idle %u, slept %u: %u ticks, %u cycles left\n", __func__, ToBoundary, ExpectedIdle, Slept, Ticks, Remaining);
+			return;
+		}
+	}
+
+	CHECK(xLowPowerStats.LostTicks == LostTicks);
+}
+
+
+/**
+ * @brief	Woken up by TIM5: every tick but the last one is stepped, SysTick takes the last one on
+ * 			the boundary of the task timeout
+ */
+static void Test_TimerWakeup(void)
+{
+	uint32_t ToBoundary, ExpectedIdle, Slept, Ticks, Remaining;
+
+	for(uint32_t idx = 0; idx < RANDOM_CASES; idx++)
+	{
+		ExpectedIdle = Random_Range(1, MAX_IDLE_TICKS);
+		ToBoundary = Random_Range((ExpectedIdle == 1) ? (MIN_RELOAD_CYCLES + CYCLES_PER_COUNT) : 1, CYCLES_PER_TICK);
+
+		/* Timebase_SyncEdge() returns on the count after the compare match */
+		Slept = LowPower_WakeCounts(ToBoundary, ExpectedIdle) + 1;
+		Ticks = LowPower_CompensateTicks(Slept, ToBoundary, ExpectedIdle, &Remaining);
+
+		if((Ticks != (ExpectedIdle - 1)) || ((((uint64_t)Slept * CYCLES_PER_COUNT) + Remaining) != Timeout_Cycles(ToBoundary, ExpectedIdle)))
+		{
+			TEST_FAIL("%s, boundary %u, idle %u: %u ticks, %u cycles left\n", __func__, ToBoundary, ExpectedIdle, Ticks, Remaining);
+			return;
+		}
+	}
+}
+
+
+/**
+ * @brief	Woken up past the task timeout: the ticks beyond it are counted as lost, the one of the
+ * 			timeout is taken right away
+ */
+static void Test_LateWakeup(void)
+{
+	uint32_t ToBoundary, ExpectedIdle, Slept, Ticks, Remaining, LostTicks, Late;
+
+	for(uint32_t idx = 0; idx < 1000; idx++)
+	{
+		ToBoundary = Random_Range(1, CYCLES_PER_TICK);
+		ExpectedIdle = Random_Range(2, 100);
+		Late = Random_Range(0, 5);
+
+		/* Late ticks past the boundary of the timeout, part of a tick more */
+		Slept = (uint32_t)((Timeout_Cycles(ToBoundary, ExpectedIdle) + ((uint64_t)Late * CYCLES_PER_TICK)) / CYCLES_PER_COUNT) +
+				Random_Range(1, (CYCLES_PER_TICK / CYCLES_PER_COUNT) - 1);
+
+		LostTicks = xLowPowerStats.LostTicks;
+		Ticks = LowPower_CompensateTicks(Slept, ToBoundary, ExpectedIdle, &Remaining);
+
+		CHECK(Ticks == (ExpectedIdle - 1));
+		CHECK(Remaining == MIN_RELOAD_CYCLES);
+		CHECK((xLowPowerStats.LostTicks - LostTicks) == (((((uint64_t)Slept * CYCLES_PER_COUNT) - ToBoundary) / CYCLES_PER_TICK) + 1 - ExpectedIdle));
+	}
+}
+
+
+/**
+ * @brief	Runs the time line until Cycle, the kernel counts every SysTick interrupt
+ */
+static void Model_RunUntil(TickModel *pModel, uint64_t Cycle)
+{
+	while(pModel->NextTick <= Cycle)
+	{
+		pModel->TickCount++;
+		pModel->NextTick += CYCLES_PER_TICK;
+	}
+
+	pModel->Now = Cycle;
+}
+
+
+/**
+ * @brief	LowPower_SuppressTicksAndSleep() on the model, TIM5 counts on multiples of CYCLES_PER_COUNT
+ * @retval	1 if the sleep was not aborted
+ */
+static uint8_t Model_Sleep(TickModel *pModel, uint32_t ExpectedIdle, uint8_t TimerWakeup)
+{
+	uint32_t Start, End, ToBoundary, WakeCounts, Ticks, Remaining;
+	uint32_t TickCount = pModel->TickCount;
+	uint64_t Wake;
+
+	/* Timebase_SyncEdge(), a tick pending by then aborts the sleep and is taken right after */
+	Start = (uint32_t)(pModel->Now / CYCLES_PER_COUNT) + 1;
+	Model_RunUntil(pModel, (uint64_t)Start * CYCLES_PER_COUNT);
+
+	if(pModel->TickCount != TickCount)
+		return 0;
+
+	ToBoundary = (uint32_t)(pModel->NextTick - pModel->Now);
+	WakeCounts = LowPower_WakeCounts(ToBoundary, ExpectedIdle);
+
+	/* TIM5 compare, or an interrupt anywhere before it. The core leaves WFI within a count */
+	if(TimerWakeup || (WakeCounts == 0))
+		Wake = ((uint64_t)(Start + WakeCounts) * CYCLES_PER_COUNT) + Random_Range(0, CYCLES_PER_COUNT - 1);
+	else
+		Wake = ((uint64_t)Start * CYCLES_PER_COUNT) + Random_Range(0, (WakeCounts * CYCLES_PER_COUNT) - 1);
+
+	End = (uint32_t)(Wake / CYCLES_PER_COUNT) + 1;
+
+	Ticks = LowPower_CompensateTicks(End - Start, ToBoundary, ExpectedIdle, &Remaining);
+
+	pModel->Now = (uint64_t)End * CYCLES_PER_COUNT;
+	pModel->TickCount += Ticks;
+	pModel->NextTick = pModel->Now + Remaining;
+
+	return 1;
+}
+
+
+static void Test_HoursOfIdle(void)
+{
+	TickModel Model = {0};
+	uint32_t Sleeps = 0, TimerWakeups = 0, Aborted = 0, OutOfPhase = 0, LateTimeouts = 0;
+	uint32_t LostTicks = xLowPowerStats.LostTicks;
+	uint32_t ExpectedIdle, Timeout;
+	uint8_t TimerWakeup;
+
+	/* SysTick started anywhere within a TIM5 count */
+	Model.Origin = Random_Range(1, CYCLES_PER_COUNT - 1);
+	Model.NextTick = Model.Origin + CYCLES_PER_TICK;
+
+	while(Model.Now < ((uint64_t)RUN_DURATION_S * CORE_CLOCK_HZ))
+	{
+		/* Tasks run for a while, then block for a few ticks or for long */
+		Model_RunUntil(&Model, Model.Now + Random_Range(0, 3 * CYCLES_PER_TICK));
+
+		ExpectedIdle = (Random_Range(0, 4) != 0) ? Random_Range(2, 50) : Random_Range(2, 5000);
+		TimerWakeup = (Random_Range(1, 100) <= RUN_TIMER_WAKEUP_PERCENT);
+		Timeout = Model.TickCount + ExpectedIdle;
+
+		if(!Model_Sleep(&Model, ExpectedIdle, TimerWakeup))
+		{
+			Aborted++;
+			continue;
+		}
+
+		Sleeps++;
+
+		if(Model.NextTick != (Model.Origin + ((uint64_t)(Model.TickCount + 1) * CYCLES_PER_TICK)))
+		{
+			OutOfPhase++;
+			Model.Origin = Model.NextTick - ((uint64_t)(Model.TickCount + 1) * CYCLES_PER_TICK);
+		}
+
+		/* The task timeout is the next tick */
+		if(TimerWakeup)
+		{
+			TimerWakeups++;
+			LateTimeouts += ((Model.TickCount + 1) != Timeout);
+		}
+	}
+
+	/* Up to the next tick, which may have been stepped a little early */
+	Model_RunUntil(&Model, Model.NextTick);
+
+	printf("tick compensation, %u s of idle: %u sleeps (%u timer wakeups), %u aborted, %u ticks counted for %u elapsed, %u out of phase\n",
+		   RUN_DURATION_S, Sleeps, TimerWakeups, Aborted, Model.TickCount, (uint32_t)((Model.Now - Model.Origin) / CYCLES_PER_TICK), OutOfPhase);
+
+	CHECK(OutOfPhase == 0);
+	CHECK(LateTimeouts == 0);
+	CHECK(Model.TickCount == (uint32_t)((Model.Now - Model.Origin) / CYCLES_PER_TICK));
+	CHECK(xLowPowerStats.LostTicks == LostTicks);
+}
+
+
+int main(void)
+{
+	/* SystemCoreClock as set by SystemClock_Config() */
+	SystemCoreClock = CORE_CLOCK_HZ;
+	LowPower_Init();
+
+	Test_PhaseKept();
+	Test_TimerWakeup();
+	Test_LateWakeup();
+	Test_HoursOfIdle();
+
+	return Test_Result();
+}
+
+
+/******************************************* END OF FILE *******************************************/
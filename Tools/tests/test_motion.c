@@ -0,0 +1,525 @@
+/**
+  **************************************************************************************************
+  * @file           : test_motion.c
+  * @brief          : Host test of the fixed point dead reckoning (car_app_motion.c). Drive traces are
+  *  				  synthesized the way the ADXL343 records them: 13-bit counts at 3.9mg/LSB with
+  *  				  gravity on z, a bias per axis and 2 LSB rms of noise, seeded so that every run
+  *  				  sees the same trace. The Q16.16 integrator must follow a double precision
+  *  				  mirror of the same algorithm, and the fast magnitude the exact one. The periodic
+  *  				  path of Task_CarMovementCalculations() is replayed with read latency to measure
+  *  				  the distance error of each way of getting dt. Two hours of driving with a drifting
+  *  				  bias must keep the distance error bounded through the zero velocity updates.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "car_app_motion.h"
+#include "test_check.h"
+
+
+/* Private define --------------------------------------------------------------------------------*/
+#define TRACE_PERIOD_US							2500	/* ADXL_STREAM_OUTPUT_DATA_RATE, 400Hz */
+#define TRACE_NOISE_RMS							2.0		/* Counts */
+#define TRACE_GRAVITY_COUNTS					256.0	/* 1g at 3.90625mg/LSB */
+#define TRACE_COUNTS_MAX						4095	/* 13-bit two's complement */
+
+/*--- Drive cycle: accelerate, cruise, brake, stand still; the heading turns every cycle ---*/
+#define CYCLE_ACCEL_CM_S2						50.0
+#define CYCLE_ACCEL_S							1.0
+#define CYCLE_CRUISE_S							4.0
+#define CYCLE_STOP_S							5.0
+#define CYCLE_S									((2 * CYCLE_ACCEL_S) + CYCLE_CRUISE_S + CYCLE_STOP_S)
+#define CYCLE_DRIVEN_S							((2 * CYCLE_ACCEL_S) + CYCLE_CRUISE_S)
+#define CYCLE_HEADING_STEP_RAD					0.7
+
+#define ACCURACY_TRACE_S						60
+#define ACCURACY_VELOCITY_MAX_CM_S				0.01
+#define ACCURACY_DISTANCE_MAX_PERCENT			0.1		/* The fast magnitude errs high by 0.08% at most */
+#define MAGNITUDE_ERROR_MAX_PERCENT				0.25
+#define BENCH_SAMPLES							2000000
+
+/*--- Periodic measurements: vTaskDelayUntil() from the tick of the previous read, then the I2C read ---*/
+#define JITTER_PERIOD_US						25000	/* FREQUENCY_MS_CALCULATION */
+#define JITTER_TICK_US							1000	/* configTICK_RATE_HZ 1000 */
+#define JITTER_CYCLES							10
+#define JITTER_SEEDS							16		/* Traces averaged per cell, noise alone moves one by 2% */
+#define JITTER_EXACT_ERROR_MAX_PERCENT			2.0		/* Noise leaves +1.4% with no latency at all */
+
+/*--- Hours of stream mode, the bias of x and y drifting with temperature ---*/
+#define REPLAY_S								(2 * 3600)
+#define REPLAY_DRIFT_COUNTS						3.0		/* Peak, about 12mg */
+#define REPLAY_DRIFT_PERIOD_S					1800.0
+#define REPLAY_NO_ZUPT_S						120		/* Q16.16 velocity wraps soon after, without ZUPT */
+#define REPLAY_ERROR_MAX_PERCENT				3.0
+#define REPLAY_ERROR_GROWTH_MAX_PERCENT			0.5		/* Second hour against first */
+
+#define LSB_CM_S2								((double)MOTION_LSB_CM_S2_Q16 / Q16_ONE)
+
+
+/* Private typedef -------------------------------------------------------------------------------*/
+/*--- Accelerometer as the car carries it ---*/
+typedef struct
+{
+	double Bias[3];						/* Counts */
+	double Heading;						/* Rad, of the cycle in progress */
+	unsigned int Seed;
+
+} TraceSensor;
+
+/*--- Where the periodic path takes the dt of each sample from ---*/
+typedef enum
+{
+	DT_EXACT = 0,						/* Timebase_GetMicros() after the read */
+	DT_CONSTANT,						/* FREQUENCY_S_CALCULATION, as before the timebase */
+	DT_TICKS,							/* xTaskGetTickCount() after the read */
+	DT_SOURCES
+
+} DtSource;
+
+/*--- Double precision mirror of Motion_Integrate(), same bias, gate and trapezoids ---*/
+typedef struct
+{
+	double AccelNetPrev[3];
+	double Bias[3];
+	double Velocity[3];
+	double VelocityResultant;
+	double Distance;
+	uint8_t Primed;
+
+} ReferenceState;
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+static volatile double s_Sink;					/* Keeps the benchmark loops */
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+static double Noise_Gaussian(unsigned int *pSeed)
+{
+	double U1 = (rand_r(pSeed) + 1.0) / ((double)RAND_MAX + 2.0);
+	double U2 = (rand_r(pSeed) + 1.0) / ((double)RAND_MAX + 2.0);
+
+	return sqrt(-2.0 * log(U1)) * cos(2.0 * M_PI * U2);
+}
+
+
+/**
+ * @brief	True acceleration along the heading at time Time_s of the drive cycle, cm/(s^2)
+ * @retval	1 while the wheels are driven (accelerating, cruising or braking)
+ */
+static uint8_t Cycle_Acceleration(double Time_s, double *pAccel)
+{
+	double Phase = fmod(Time_s, CYCLE_S);
+
+	if(Phase < CYCLE_ACCEL_S)
+		*pAccel = CYCLE_ACCEL_CM_S2;
+	else if(Phase < (CYCLE_ACCEL_S + CYCLE_CRUISE_S))
+		*pAccel = 0;
+	else if(Phase < CYCLE_DRIVEN_S)
+		*pAccel = -CYCLE_ACCEL_CM_S2;
+	else
+		*pAccel = 0;
+
+	return Phase < CYCLE_DRIVEN_S;
+}
+
+
+/**
+ * @brief	Distance covered by the drive cycle from 0 to Time_s, cm
+ */
+static double Cycle_Distance(double Time_s)
+{
+	double Cruise = CYCLE_ACCEL_CM_S2 * CYCLE_ACCEL_S;
+	double PerCycle = (Cruise * CYCLE_ACCEL_S) + (Cruise * CYCLE_CRUISE_S);
+	double Phase = fmod(Time_s, CYCLE_S);
+	double Distance = floor(Time_s / CYCLE_S) * PerCycle;
+
+	if(Phase < CYCLE_ACCEL_S)
+		return Distance + (0.5 * CYCLE_ACCEL_CM_S2 * Phase * Phase);
+
+	Distance += 0.5 * Cruise * CYCLE_ACCEL_S;
+	Phase -= CYCLE_ACCEL_S;
+
+	if(Phase < CYCLE_CRUISE_S)
+		return Distance + (Cruise * Phase);
+
+	Distance += Cruise * CYCLE_CRUISE_S;
+	Phase -= CYCLE_CRUISE_S;
+
+	if(Phase < CYCLE_ACCEL_S)
+		return Distance + (Cruise * Phase) - (0.5 * CYCLE_ACCEL_CM_S2 * Phase * Phase);
+
+	return Distance + (0.5 * Cruise * CYCLE_ACCEL_S);
+}
+
+
+/**
+ * @brief	Sample of the accelerometer at Time_s, as ADXL_TwosComplement_13bits() returns it
+ * @retval	1 while the wheels are driven
+ */
+static uint8_t Trace_Sample(TraceSensor *pSensor, double Time_s, int32_t Counts[3])
+{
+	double Accel, Axis[3];
+	uint8_t Driven = Cycle_Acceleration(Time_s, &Accel);
+
+	pSensor->Heading = floor(Time_s / CYCLE_S) * CYCLE_HEADING_STEP_RAD;
+
+	Axis[0] = Accel * cos(pSensor->Heading) / LSB_CM_S2;
+	Axis[1] = Accel * sin(pSensor->Heading) / LSB_CM_S2;
+	Axis[2] = TRACE_GRAVITY_COUNTS;
+
+	for(uint8_t idx = 0; idx < 3; idx++)
+	{
+		double Value = round(Axis[idx] + pSensor->Bias[idx] + (TRACE_NOISE_RMS * Noise_Gaussian(&pSensor->Seed)));
+
+		if(Value > TRACE_COUNTS_MAX)
+			Value = TRACE_COUNTS_MAX;
+		else if(Value < -TRACE_COUNTS_MAX - 1)
+			Value = -TRACE_COUNTS_MAX - 1;
+
+		Counts[idx] = (int32_t)Value;
+	}
+
+	return Driven;
+}
+
+
+/**
+ * @brief	Stationary as Car_IsStationary() tells it: wheels off for MOTION_ZUPT_SETTLE_US
+ */
+static uint8_t Cycle_Stationary(double Time_s)
+{
+	return fmod(Time_s, CYCLE_S) >= (CYCLE_DRIVEN_S + (MOTION_ZUPT_SETTLE_US / 1e6));
+}
+
+
+static void Reference_Integrate(ReferenceState *pRef, uint8_t Stationary, const int32_t Counts[3], uint32_t Dt_us)
+{
+	const double Gate = (double)MOTION_NOISE_GATE_Q16 / Q16_ONE;
+	double VelocityResultantPrev = pRef->VelocityResultant;
+	double Dt_s;
+
+	if(!pRef->Primed)
+	{
+		for(uint8_t idx = 0; idx < 3; idx++)
+			pRef->Bias[idx] = Counts[idx];
+		pRef->Primed = 1;
+	}
+
+	if(Stationary)
+	{
+		for(uint8_t idx = 0; idx < 3; idx++)
+		{
+			pRef->Bias[idx] += (Counts[idx] - pRef->Bias[idx]) / (1 << MOTION_BIAS_SHIFT);
+			pRef->AccelNetPrev[idx] = 0;
+			pRef->Velocity[idx] = 0;
+		}
+
+		pRef->VelocityResultant = 0;
+		return;
+	}
+
+	Dt_s = ((Dt_us > MOTION_DT_MAX_US) ? MOTION_DT_MAX_US : Dt_us) / 1e6;
+
+	for(uint8_t idx = 0; idx < 3; idx++)
+	{
+		double AccelNet = Counts[idx] - pRef->Bias[idx];
+
+		if(fabs(AccelNet) < Gate)
+			AccelNet = 0;
+
+		pRef->Velocity[idx] += (pRef->AccelNetPrev[idx] + AccelNet) * LSB_CM_S2 * Dt_s / 2;
+		pRef->AccelNetPrev[idx] = AccelNet;
+	}
+
+	pRef->VelocityResultant = hypot(pRef->Velocity[0], pRef->Velocity[1]);
+	pRef->Distance += (VelocityResultantPrev + pRef->VelocityResultant) * Dt_s / 2;
+}
+
+
+static double Q16_ToDouble(int64_t Value)
+{
+	return (double)Value / Q16_ONE;
+}
+
+
+/**
+ * @brief	Same trace through both integrators, stationary once the wheels are off
+ */
+static void Test_AccuracyAgainstReference(void)
+{
+	TraceSensor Sensor = { {3.0, -2.0, 5.0}, 0, 1 };
+	ReferenceState Ref = {0};
+	MotionState Motion;
+	int32_t Counts[3];
+	double VelocityError = 0, Distance;
+
+	Motion_Init(&Motion);
+
+	for(uint32_t Sample = 0; Sample < (ACCURACY_TRACE_S * 1000000u / TRACE_PERIOD_US); Sample++)
+	{
+		uint8_t Stationary = !Trace_Sample(&Sensor, Sample * (TRACE_PERIOD_US / 1e6), Counts);
+
+		Motion_SetStationary(&Motion, Stationary);
+		Motion_Integrate(&Motion, Counts[0], Counts[1], Counts[2], TRACE_PERIOD_US);
+		Reference_Integrate(&Ref, Stationary, Counts, TRACE_PERIOD_US);
+
+		for(uint8_t idx = 0; idx < 3; idx++)
+		{
+			double Error = fabs(Q16_ToDouble(Motion.Velocity[idx]) - Ref.Velocity[idx]);
+			if(Error > VelocityError)
+				VelocityError = Error;
+		}
+	}
+
+	Distance = Q16_ToDouble(Motion.Distance);
+
+	printf("Q16.16 against double, %us trace: velocity off by %.5fcm/s at most, distance %.2fcm against %.2fcm "
+		   "(%.4f%%), true distance %.0fcm\n", ACCURACY_TRACE_S, VelocityError, Distance, Ref.Distance,
+		   100.0 * fabs(Distance - Ref.Distance) / Ref.Distance, Cycle_Distance(ACCURACY_TRACE_S));
+
+	CHECK(VelocityError < ACCURACY_VELOCITY_MAX_CM_S);
+	CHECK(fabs(Distance - Ref.Distance) < (Ref.Distance * ACCURACY_DISTANCE_MAX_PERCENT / 100));
+}
+
+
+static void Test_FastMagnitude(void)
+{
+	static const double Magnitudes[] = {0.5, 1.0, 37.0, 1000.0, 30000.0};
+	double ErrorMax = 0;
+
+	for(uint32_t Mag = 0; Mag < (sizeof(Magnitudes) / sizeof(Magnitudes[0])); Mag++)
+	{
+		for(uint32_t Step = 0; Step <= 3600; Step++)
+		{
+			double Angle = Step * (2.0 * M_PI / 3600);
+			q16_t x = (q16_t)lround(Magnitudes[Mag] * cos(Angle) * Q16_ONE);
+			q16_t y = (q16_t)lround(Magnitudes[Mag] * sin(Angle) * Q16_ONE);
+			double Exact = hypot((double)x, (double)y);
+			double Error = fabs(Motion_FastMagnitude(x, y) - Exact) / Exact;
+
+			if(Error > ErrorMax)
+				ErrorMax = Error;
+		}
+	}
+
+	printf("fast magnitude: %.4f%% off at most over every 0.1 degree\n", 100.0 * ErrorMax);
+
+	CHECK(ErrorMax < (MAGNITUDE_ERROR_MAX_PERCENT / 100));
+	CHECK(Motion_FastMagnitude(0, -Q16_ONE) == Q16_ONE);
+	CHECK(Motion_FastMagnitude(INT32_MIN, INT32_MIN) == INT32_MAX);
+}
+
+
+/**
+ * @brief	Host cost of one sample, the Cortex-M4 runs the double one in soft float (configENABLE_FPU 0)
+ */
+static void Test_Benchmark(void)
+{
+	static int32_t Counts[1024][3];
+	TraceSensor Sensor = { {3.0, -2.0, 5.0}, 0, 1 };
+	struct timespec Start, End;
+	ReferenceState Ref = {0};
+	MotionState Motion;
+	double Fixed_ns, Double_ns;
+
+	for(uint32_t idx = 0; idx < 1024; idx++)
+		Trace_Sample(&Sensor, idx * (TRACE_PERIOD_US / 1e6), Counts[idx]);
+
+	Motion_Init(&Motion);
+	clock_gettime(CLOCK_MONOTONIC, &Start);
+	for(uint32_t idx = 0; idx < BENCH_SAMPLES; idx++)
+		Motion_Integrate(&Motion, Counts[idx & 1023][0], Counts[idx & 1023][1], Counts[idx & 1023][2], TRACE_PERIOD_US);
+	clock_gettime(CLOCK_MONOTONIC, &End);
+	Fixed_ns = (((End.tv_sec - Start.tv_sec) * 1e9) + (End.tv_nsec - Start.tv_nsec)) / BENCH_SAMPLES;
+
+	clock_gettime(CLOCK_MONOTONIC, &Start);
+	for(uint32_t idx = 0; idx < BENCH_SAMPLES; idx++)
+		Reference_Integrate(&Ref, 0, Counts[idx & 1023], TRACE_PERIOD_US);
+	clock_gettime(CLOCK_MONOTONIC, &End);
+	Double_ns = (((End.tv_sec - Start.tv_sec) * 1e9) + (End.tv_nsec - Start.tv_nsec)) / BENCH_SAMPLES;
+
+	s_Sink = Q16_ToDouble(Motion.Distance) + Ref.Distance;
+
+	printf("sample integration on the host (hardware FPU): Q16.16 %.1fns, double %.1fns\n", Fixed_ns, Double_ns);
+}
+
+
+/**
+ * @brief	Replays the periodic path with a read latency drawn in [0, Latency_us]
+ * @note	The next wake up is one period after the tick the read ended on, so latency of a tick
+ * 			or more stretches the period, and the trace starts and ends with the car standing still
+ * @retval	Distance covered, cm
+ */
+static double Jitter_Distance(uint32_t Latency_us, DtSource Source, unsigned int Seed)
+{
+	const uint64_t Start_us = (uint64_t)((CYCLE_DRIVEN_S * 1e6) + MOTION_ZUPT_SETTLE_US);
+	const uint64_t End_us = Start_us + (uint64_t)(JITTER_CYCLES * CYCLE_S * 1e6);
+	TraceSensor Sensor = { {3.0, -2.0, 5.0}, 0, Seed };
+	unsigned int LatencySeed = Seed + JITTER_SEEDS;
+	uint64_t Wake_us = Start_us, Sample_us, LastSample_us = 0;
+	MotionState Motion;
+	int32_t Counts[3];
+	uint32_t Dt_us;
+
+	Motion_Init(&Motion);
+
+	while(Wake_us < End_us)
+	{
+		Sample_us = Wake_us + ((Latency_us != 0) ? ((uint32_t)rand_r(&LatencySeed) % (Latency_us + 1)) : 0);
+		Trace_Sample(&Sensor, Sample_us / 1e6, Counts);
+
+		if(LastSample_us == 0)
+			Dt_us = JITTER_PERIOD_US;
+		else if(Source == DT_EXACT)
+			Dt_us = (uint32_t)(Sample_us - LastSample_us);
+		else if(Source == DT_TICKS)
+			Dt_us = (uint32_t)(((Sample_us / JITTER_TICK_US) - (LastSample_us / JITTER_TICK_US)) * JITTER_TICK_US);
+		else
+			Dt_us = JITTER_PERIOD_US;
+
+		Motion_SetStationary(&Motion, Cycle_Stationary(Sample_us / 1e6));
+		Motion_Integrate(&Motion, Counts[0], Counts[1], Counts[2], Dt_us);
+
+		LastSample_us = Sample_us;
+		Wake_us = ((Sample_us / JITTER_TICK_US) * JITTER_TICK_US) + JITTER_PERIOD_US;
+	}
+
+	return Q16_ToDouble(Motion.Distance);
+}
+
+
+/**
+ * @brief	Distance error against read latency, one row per latency bound and one column per dt source,
+ * 			each cell the mean error over JITTER_SEEDS traces
+ */
+static void Test_JitterBenchmark(void)
+{
+	static const uint32_t Latencies_us[] = {0, 250, 1000, 2500, 5000};
+	static const char *const Sources[DT_SOURCES] = {"exact", "constant", "ticks"};
+	const double Truth = Cycle_Distance(JITTER_CYCLES * CYCLE_S);
+	double Error[DT_SOURCES];
+
+	printf("periodic path, %u cycles of %.0fcm, mean distance error of %u traces per read latency and dt source:\n",
+		   JITTER_CYCLES, Cycle_Distance(CYCLE_S), JITTER_SEEDS);
+
+	for(uint32_t Row = 0; Row < (sizeof(Latencies_us) / sizeof(Latencies_us[0])); Row++)
+	{
+		printf("  latency up to %4uus:", Latencies_us[Row]);
+
+		for(uint8_t Source = 0; Source < DT_SOURCES; Source++)
+		{
+			Error[Source] = 0;
+			for(unsigned int Seed = 1; Seed <= JITTER_SEEDS; Seed++)
+				Error[Source] += Jitter_Distance(Latencies_us[Row], (DtSource)Source, Seed);
+
+			Error[Source] = 100.0 * ((Error[Source] / JITTER_SEEDS) - Truth) / Truth;
+			printf(" %s %+6.2f%%", Sources[Source], Error[Source]);
+		}
+
+		printf("\n");
+
+		CHECK(fabs(Error[DT_EXACT]) < JITTER_EXACT_ERROR_MAX_PERCENT);
+		if(Latencies_us[Row] > JITTER_TICK_US)
+			CHECK(fabs(Error[DT_EXACT]) < fabs(Error[DT_CONSTANT]));
+	}
+}
+
+
+/**
+ * @brief	Stream mode replay from a standstill, stationary as the actuators tell it or never
+ * @param	Duration_s: length of the replay, whole drive cycles
+ * 			Zupt: 0 to integrate every sample, as before the zero velocity updates
+ * 			pErrorMax: largest distance error at the end of a stop phase, percent, from the 10th cycle
+ * 			pErrorFirstHour: distance error at the end of the first hour, percent
+ * @retval	Distance error at the end of the replay, percent
+ */
+static double Replay_Run(uint32_t Duration_s, uint8_t Zupt, double *pErrorMax, double *pErrorFirstHour)
+{
+	const double Start_s = CYCLE_S - 1.0;	/* Each cycle replayed ends 1s before the next drive */
+	const uint32_t Samples = (uint32_t)((uint64_t)Duration_s * 1000000u / TRACE_PERIOD_US);
+	const uint32_t CycleSamples = (uint32_t)(CYCLE_S * 1000000u / TRACE_PERIOD_US);
+	TraceSensor Sensor = { {3.0, -2.0, 5.0}, 0, 5 };
+	MotionState Motion;
+	int32_t Counts[3];
+	double Error = 0;
+
+	Motion_Init(&Motion);
+	*pErrorMax = 0;
+
+	for(uint32_t Sample = 0; Sample < Samples; Sample++)
+	{
+		double Time_s = Sample * (TRACE_PERIOD_US / 1e6);
+		double Drift = REPLAY_DRIFT_COUNTS * sin(2.0 * M_PI * Time_s / REPLAY_DRIFT_PERIOD_S);
+
+		Sensor.Bias[0] = 3.0 + Drift;
+		Sensor.Bias[1] = -2.0 - Drift;
+		Trace_Sample(&Sensor, Start_s + Time_s, Counts);
+
+		Motion_SetStationary(&Motion, Zupt && Cycle_Stationary(Start_s + Time_s));
+		Motion_Integrate(&Motion, Counts[0], Counts[1], Counts[2], TRACE_PERIOD_US);
+
+		/* Last sample of each cycle, the car stands still */
+		if(((Sample + 1) % CycleSamples) == 0)
+		{
+			double Truth = Cycle_Distance(Start_s + Time_s) - Cycle_Distance(Start_s);
+
+			Error = 100.0 * (Q16_ToDouble(Motion.Distance) - Truth) / Truth;
+
+			if(Zupt)
+				CHECK(Motion.VelocityResultant == 0);
+
+			if(((Sample + 1) >= (10 * CycleSamples)) && (fabs(Error) > *pErrorMax))
+				*pErrorMax = fabs(Error);
+
+			if((Time_s < 3600) && ((Time_s + CYCLE_S) >= 3600))
+				*pErrorFirstHour = Error;
+		}
+	}
+
+	return Error;
+}
+
+
+/**
+ * @brief	Hours of driving: with the zero velocity updates the relative distance error holds, without
+ * 			them the bias integrates into velocity and distance runs away within minutes
+ */
+static void Test_HoursReplay(void)
+{
+	double ErrorMax, ErrorFirstHour = 0, Error, ErrorNoZupt, ErrorMaxNoZupt, Unused;
+
+	Error = Replay_Run(REPLAY_S, 1, &ErrorMax, &ErrorFirstHour);
+	ErrorNoZupt = Replay_Run(REPLAY_NO_ZUPT_S, 0, &ErrorMaxNoZupt, &Unused);
+
+	printf("%uh replay, bias drifting by %.0f counts: distance error %+.2f%% after 1h, %+.2f%% after %uh, "
+		   "%.2f%% at most; without ZUPT %+.0f%% after %us\n", REPLAY_S / 3600, REPLAY_DRIFT_COUNTS,
+		   ErrorFirstHour, Error, REPLAY_S / 3600, ErrorMax, ErrorNoZupt, REPLAY_NO_ZUPT_S);
+
+	CHECK(ErrorMax < REPLAY_ERROR_MAX_PERCENT);
+	CHECK(fabs(Error - ErrorFirstHour) < REPLAY_ERROR_GROWTH_MAX_PERCENT);
+	CHECK(fabs(ErrorNoZupt) > (10 * REPLAY_ERROR_MAX_PERCENT));
+}
+
+
+int main(void)
+{
+	Test_AccuracyAgainstReference();
+	Test_FastMagnitude();
+	Test_Benchmark();
+	Test_JitterBenchmark();
+	Test_HoursReplay();
+
+	return Test_Result();
+}
+
+
+/******************************************* END OF FILE *******************************************/
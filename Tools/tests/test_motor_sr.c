@@ -0,0 +1,418 @@
+/**
+  **************************************************************************************************
+  * @file           : test_motor_sr.c
+  * @brief          : Host test of the 74HC595 direction byte transfer of motordriver_io.c, built
+  *  				  once per back end. Every pin write lands in a waveform record: BSRR words the
+  *  				  modelled TIM1 update and CH1 requests move with the DMA, or the HAL_GPIO_WritePin()
+  *  				  calls of the bit-banged transfer. A 74HC595 model then clocks the record in and
+  *  				  must latch the byte, with the set-up and hold times of the timer back end.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "motordriver_io.h"
+#include "test_check.h"
+
+
+/* Private define --------------------------------------------------------------------------------*/
+/*--- TIM1 as MX_TIM1_Init() sets it: 100MHz / (9 + 1), update every 1000 counts, CH1 compare at 500 ---*/
+#define TIM1_TICK_NS							100
+#define TIM1_PERIOD_COUNTS						(TIM_PWM_PERIOD_VALUE + 1)
+#define TIM1_CC1_COUNT							500
+
+/*--- Timing of the waveform, in TIM1 counts ---*/
+#define WAVE_SETUP_MIN							500		/* DIR_SER steady before DIR_CLK rises */
+#define WAVE_HOLD_MIN							500		/* DIR_SER steady after DIR_CLK rises */
+#define WAVE_LATCH_WIDTH_MIN					1000
+#define WAVE_DURATION_MAX						20000	/* 19 update requests, 1.9ms */
+#define WAVE_TIMEOUT_MS							10		/* SR_WAVE_TIMEOUT_MS */
+
+#define WAVE_SAMPLES_MAX						256
+#define TIM1_RUN_COUNTS_MAX						(4 * WAVE_DURATION_MAX)
+
+
+/* Private typedef -------------------------------------------------------------------------------*/
+/*--- Levels of the shift register inputs from a given time on ---*/
+typedef struct
+{
+	uint32_t Time;						/* TIM1 counts, or pin writes for the bit-banged transfer */
+	uint8_t Ser;
+	uint8_t Clk;
+	uint8_t Latch;
+
+} WaveSample;
+
+
+/* Exported/Global variables ---------------------------------------------------------------------*/
+/*--- Instances of tim.c ---*/
+TIM_HandleTypeDef htim1 = { TIM1 };
+TIM_HandleTypeDef htim3 = { TIM3 };
+TIM_HandleTypeDef htim9;
+DMA_HandleTypeDef hdma_tim1_up;
+DMA_HandleTypeDef hdma_tim1_ch1;
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+static DMA_Stream_TypeDef s_Dma2Stream5;		/* TIM1_UP, DIR_SER and DIR_LATCH */
+static DMA_Stream_TypeDef s_Dma2Stream1;		/* TIM1_CH1, DIR_CLK */
+static uint32_t s_DmaAborts;
+static uint32_t s_DmaBusy;
+
+static WaveSample s_Wave[WAVE_SAMPLES_MAX];
+static uint32_t s_WaveLength;
+static uint32_t s_Time;
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+static uint8_t Pin_Level(GPIO_TypeDef *pPort, uint16_t Pin)
+{
+	return (pPort->ODR & Pin) ? 1 : 0;
+}
+
+
+/**
+ * @brief	Appends the shift register inputs to the record if any of them moved
+ */
+static void Wave_Record(void)
+{
+	WaveSample Sample = { s_Time, Pin_Level(DIR_SER_GPIO_Port, DIR_SER_Pin), Pin_Level(DIR_CLK_GPIO_Port, DIR_CLK_Pin),
+						  Pin_Level(DIR_LATCH_GPIO_Port, DIR_LATCH_Pin) };
+	const WaveSample *pLast = (s_WaveLength != 0) ? &s_Wave[s_WaveLength - 1] : NULL;
+
+	if((pLast != NULL) && (pLast->Ser == Sample.Ser) && (pLast->Clk == Sample.Clk) && (pLast->Latch == Sample.Latch))
+		return;
+
+	if(s_WaveLength < WAVE_SAMPLES_MAX)
+		s_Wave[s_WaveLength++] = Sample;
+}
+
+
+static void Wave_Reset(void)
+{
+	s_WaveLength = 0;
+	s_Time = 0;
+	Wave_Record();
+}
+
+
+/**
+ * @brief	Plays the record into a 74HC595: DIR_SER shifts into QA on each DIR_CLK rising edge, the
+ * 			storage register takes the shift register on the DIR_LATCH rising edge
+ * @param	Timed: 1 to check the set-up, hold and latch timings as well
+ * @retval	Storage register, QA in bit 0
+ */
+static uint8_t Wave_Check(uint8_t Byte, uint8_t Timed)
+{
+	uint32_t SerChange = 0, ClkRise = 0, LatchRise = 0, ClkEdges = 0, LatchEdges = 0;
+	uint8_t Shift = 0, Storage = 0;
+
+	for(uint32_t idx = 1; idx < s_WaveLength; idx++)
+	{
+		const WaveSample *pPrev = &s_Wave[idx - 1], *pNow = &s_Wave[idx];
+
+		if(pNow->Ser != pPrev->Ser)
+		{
+			if(Timed && (ClkEdges != 0) && (LatchEdges == 0) && ((pNow->Time - ClkRise) < WAVE_HOLD_MIN))
+			{
+				TEST_FAIL("byte 0x%02X: DIR_SER held %.1fus after clock edge %u\n", Byte,
+						  (pNow->Time - ClkRise) * TIM1_TICK_NS / 1000.0, ClkEdges);
+			}
+
+			SerChange = pNow->Time;
+		}
+
+		if(pNow->Clk && !pPrev->Clk)
+		{
+			if(Timed && ((pNow->Time - SerChange) < WAVE_SETUP_MIN))
+			{
+				TEST_FAIL("byte 0x%02X: DIR_SER set up %.1fus before clock edge %u\n", Byte,
+						  (pNow->Time - SerChange) * TIM1_TICK_NS / 1000.0, ClkEdges + 1);
+			}
+
+			Shift = (uint8_t)((Shift << 1) | pNow->Ser);
+			ClkRise = pNow->Time;
+			ClkEdges++;
+		}
+
+		if(pNow->Latch && !pPrev->Latch)
+		{
+			Storage = Shift;
+			LatchRise = pNow->Time;
+			LatchEdges++;
+			CHECK(ClkEdges == 8);
+		}
+
+		if(!pNow->Latch && pPrev->Latch && Timed)
+			CHECK((pNow->Time - LatchRise) >= WAVE_LATCH_WIDTH_MIN);
+	}
+
+	CHECK(ClkEdges == 8);
+	CHECK(LatchEdges == 1);
+	CHECK(s_Wave[s_WaveLength - 1].Latch == 0);
+	if(Timed)
+		CHECK((s_Wave[s_WaveLength - 1].Time - s_Wave[1].Time) <= WAVE_DURATION_MAX);
+
+	return Storage;
+}
+
+
+/**
+ * @brief	QH back to QA: the byte goes out from bit 0, so bit 0 ends up in QH
+ */
+static uint8_t Byte_Reverse(uint8_t Byte)
+{
+	uint8_t Reversed = 0;
+
+	for(uint8_t idx = 0; idx < 8; idx++)
+		Reversed |= (uint8_t)(((Byte >> idx) & 0x1) << (7 - idx));
+
+	return Reversed;
+}
+
+
+/*--- GPIO, pins of the bit-banged transfer ---*/
+void HAL_GPIO_WritePin(void *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	GPIO_TypeDef *pPort = GPIOx;
+
+	if(PinState == GPIO_PIN_SET)
+		pPort->ODR |= GPIO_Pin;
+	else
+		pPort->ODR &= ~(uint32_t)GPIO_Pin;
+
+	s_Time++;
+	Wave_Record();
+}
+
+
+/*--- GPIO BSRR written by the DMA, set wins over reset ---*/
+static void Gpio_WriteBsrr(uint32_t Address, uint32_t Word)
+{
+	for(uint8_t Port = 0; Port < 3; Port++)
+	{
+		if(Address == (uint32_t)(uintptr_t)&g_HostGpio[Port].BSRR)
+		{
+			g_HostGpio[Port].ODR = (g_HostGpio[Port].ODR & ~(Word >> 16)) | (Word & 0xFFFF);
+			Wave_Record();
+			return;
+		}
+	}
+
+	TEST_FAIL("DMA write to 0x%08X, not a GPIO BSRR\n", Address);
+}
+
+
+/*--- TIM and DMA, streams in normal mode from memory to a peripheral register ---*/
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+	__HAL_TIM_ENABLE(htim);
+	return HAL_OK;
+}
+
+
+static HAL_StatusTypeDef Dma_Start(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength,
+								   uint32_t Interrupts)
+{
+	DMA_Stream_TypeDef *pStream = hdma->Instance;
+
+	if(pStream->CR & DMA_SxCR_EN)
+	{
+		s_DmaBusy++;
+		return HAL_BUSY;
+	}
+
+	pStream->M0AR = SrcAddress;
+	pStream->PAR = DstAddress;
+	pStream->NDTR = DataLength;
+	pStream->CR = DMA_SxCR_EN | Interrupts;
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+	return Dma_Start(hdma, SrcAddress, DstAddress, DataLength, 0);
+}
+
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+	return Dma_Start(hdma, SrcAddress, DstAddress, DataLength, DMA_SxCR_TCIE);
+}
+
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma)
+{
+	((DMA_Stream_TypeDef *)hdma->Instance)->CR = 0;
+	s_DmaAborts++;
+
+	return HAL_OK;
+}
+
+
+HAL_StatusTypeDef HAL_DMA_PollForTransfer(DMA_HandleTypeDef *hdma, HAL_DMA_LevelCompleteTypeDef CompleteLevel, uint32_t Timeout)
+{
+	DMA_Stream_TypeDef *pStream = hdma->Instance;
+
+	return ((pStream->NDTR == 0) && !(pStream->CR & DMA_SxCR_EN)) ? HAL_OK : HAL_TIMEOUT;
+}
+
+
+/**
+ * @brief	One TIM1 request: the stream moves its next word, then interrupts if that was the last
+ */
+static void Dma_Request(DMA_HandleTypeDef *hdma, uint32_t Request)
+{
+	DMA_Stream_TypeDef *pStream = hdma->Instance;
+
+	if(!(TIM1->DIER & Request) || !(pStream->CR & DMA_SxCR_EN) || (pStream->NDTR == 0))
+		return;
+
+	Gpio_WriteBsrr(pStream->PAR, *(const uint32_t *)(uintptr_t)pStream->M0AR);
+	pStream->M0AR += sizeof(uint32_t);
+
+	if(--pStream->NDTR == 0)
+	{
+		pStream->CR &= ~DMA_SxCR_EN;
+
+		if((pStream->CR & DMA_SxCR_TCIE) && (hdma->XferCpltCallback != NULL))
+			hdma->XferCpltCallback(hdma);
+	}
+}
+
+
+/**
+ * @brief	Counts TIM1 from Count while any of its DMA requests is enabled
+ * @param	Count: counter value when the transfer was started, it decides which request comes first
+ */
+static void Tim1_Run(uint32_t Count)
+{
+	for(uint32_t Counts = 0; (TIM1->DIER & (TIM_DMA_UPDATE | TIM_DMA_CC1)) && (Counts < TIM1_RUN_COUNTS_MAX); Counts++)
+	{
+		s_Time++;
+
+		if(++Count == TIM1_PERIOD_COUNTS)
+		{
+			Count = 0;
+			Dma_Request(&hdma_tim1_up, TIM_DMA_UPDATE);
+		}
+
+		if(Count == TIM1_CC1_COUNT)
+			Dma_Request(&hdma_tim1_ch1, TIM_DMA_CC1);
+	}
+}
+
+
+#if (MOTOR_SR_BACKEND == MOTOR_SR_BACKEND_TIM_DMA)
+/**
+ * @brief	Every byte, the timer caught at a different count each time so that either request may
+ * 			come first; no pin moves before the timer does
+ */
+static void Test_EveryByte(void)
+{
+	for(uint32_t Byte = 0; Byte <= 0xFF; Byte++)
+	{
+		uint32_t Count = (Byte * 37) % TIM1_PERIOD_COUNTS;
+
+		Wave_Reset();
+		__MOTOR_SetShiftRegister((uint8_t)Byte);
+		CHECK(s_WaveLength == 1);
+		CHECK(g_RecentShiftRegisterByte == Byte);
+
+		Tim1_Run(Count);
+
+		if(Wave_Check((uint8_t)Byte, 1) != Byte_Reverse((uint8_t)Byte))
+		{
+			TEST_FAIL("byte 0x%02X latched as 0x%02X (QA in bit 0)\n", Byte, Wave_Check((uint8_t)Byte, 0));
+		}
+
+		CHECK((TIM1->DIER & (TIM_DMA_UPDATE | TIM_DMA_CC1)) == 0);
+	}
+
+	CHECK(s_DmaAborts == 0);
+	CHECK(s_DmaBusy == 0);
+}
+
+
+/**
+ * @brief	With TIM1 stopped the next byte waits SR_WAVE_TIMEOUT_MS, aborts both streams and goes out
+ */
+static void Test_StalledTimer(void)
+{
+	TickType_t Start;
+
+	Wave_Reset();
+	__MOTOR_SetShiftRegister(0xA5);
+
+	Start = xTaskGetTickCount();
+	__MOTOR_SetShiftRegister(0x5A);
+	CHECK((xTaskGetTickCount() - Start) >= WAVE_TIMEOUT_MS);
+	CHECK(s_DmaAborts == 2);
+	CHECK(s_DmaBusy == 0);
+	CHECK(s_WaveLength == 1);
+
+	Tim1_Run(0);
+	CHECK(Wave_Check(0x5A, 1) == Byte_Reverse(0x5A));
+
+	s_DmaAborts = 0;
+}
+#else
+/**
+ * @brief	Every byte through the bit-banged transfer, pin writes in order only: the delay loops
+ * 			are calibrated for the target
+ */
+static void Test_EveryByte(void)
+{
+	for(uint32_t Byte = 0; Byte <= 0xFF; Byte++)
+	{
+		Wave_Reset();
+		__MOTOR_SetShiftRegister((uint8_t)Byte);
+
+		if(Wave_Check((uint8_t)Byte, 0) != Byte_Reverse((uint8_t)Byte))
+		{
+			TEST_FAIL("byte 0x%02X latched as 0x%02X (QA in bit 0)\n", Byte, Wave_Check((uint8_t)Byte, 0));
+		}
+	}
+}
+
+#endif
+
+
+/**
+ * @brief	The example of the __MOTOR_SetShiftRegister() description: 0x30 sets QC and QD only
+ */
+static void Test_DocumentedExample(void)
+{
+	Wave_Reset();
+	__MOTOR_SetShiftRegister(0x30);
+	Tim1_Run(0);
+
+	CHECK(Wave_Check(0x30, MOTOR_SR_BACKEND == MOTOR_SR_BACKEND_TIM_DMA) == ((1 << 2) | (1 << 3)));
+}
+
+
+int main(void)
+{
+	hdma_tim1_up.Instance = &s_Dma2Stream5;
+	hdma_tim1_ch1.Instance = &s_Dma2Stream1;
+	__MOTOR_HWInit();
+
+	Test_EveryByte();
+#if (MOTOR_SR_BACKEND == MOTOR_SR_BACKEND_TIM_DMA)
+	Test_StalledTimer();
+#endif
+	Test_DocumentedExample();
+
+	return Test_Result();
+}
+
+
+/******************************************* END OF FILE *******************************************/
@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""
+Host test of the post-link RAM budget report of Tools/ram_budget.py.
+
+Compiles objects holding xFrtosRamBudget and kernel objects named as in
+car_app_freertos.c with the host compiler, and checks the figures read back
+and the verdict for both layouts.
+"""
+
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+
+sys.dont_write_bytecode = True
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+
+import ram_budget  # noqa: E402
+
+BUDGET = """
+typedef struct { unsigned int StaticBytes, HeapBytes, HeapSize; } FRTOS_RamBudget_t;
+const FRTOS_RamBudget_t xFrtosRamBudget = { %d, %d, %d };
+unsigned char ucHeap[%d];
+"""
+
+STATIC_OBJECTS = """
+static unsigned int s_TaskStack_PB[256];
+static unsigned char s_TaskTCB_PB[96];
+static unsigned char s_TimConnIdleBuffer[48];
+void *Objects[] = { s_TaskStack_PB, s_TaskTCB_PB, s_TimConnIdleBuffer };
+"""
+
+STATIC_BYTES = 256 * 4 + 96 + 48
+
+
+def build(source):
+    """ram_budget.Elf of the source compiled by the host compiler."""
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, "budget.c")
+        with open(path, "w") as handle:
+            handle.write(source)
+        subprocess.check_call([os.environ.get("CC", "gcc"), "-c", "-O0", path, "-o", path + ".o"])
+        with open(path + ".o", "rb") as handle:
+            return ram_budget.Elf(handle.read())
+
+
+class ReportTest(unittest.TestCase):
+
+    def test_static_layout(self):
+        elf = build(BUDGET % (STATIC_BYTES, 2000, 512, 512) + STATIC_OBJECTS)
+        lines, fits = ram_budget.report(elf, 4096)
+        self.assertTrue(fits)
+        self.assertIn("Static layout:   %4d bytes in .bss" % STATIC_BYTES, lines[0])
+        self.assertIn("static layout", lines[2])
+        self.assertFalse([line for line in lines if line.startswith("warning")])
+        self.assertIn("%d of 4096 bytes" % (STATIC_BYTES + 512), lines[-1])
+
+    def test_static_out_of_date(self):
+        elf = build(BUDGET % (STATIC_BYTES - 4, 2000, 512, 512) + STATIC_OBJECTS)
+        lines, _ = ram_budget.report(elf, 4096)
+        self.assertTrue([line for line in lines if line.startswith("warning")])
+
+    def test_static_over_budget(self):
+        elf = build(BUDGET % (STATIC_BYTES, 2000, 512, 512) + STATIC_OBJECTS)
+        _, fits = ram_budget.report(elf, STATIC_BYTES + 511)
+        self.assertFalse(fits)
+
+    def test_heap_layout(self):
+        elf = build(BUDGET % (STATIC_BYTES, 2000, 4096, 4096))
+        lines, fits = ram_budget.report(elf, 4096)
+        self.assertTrue(fits)
+        self.assertIn("heap layout", lines[2])
+
+        elf = build(BUDGET % (STATIC_BYTES, 5000, 4096, 4096))
+        _, fits = ram_budget.report(elf, 8192)
+        self.assertFalse(fits)
+
+    def test_not_firmware(self):
+        with self.assertRaises(ValueError):
+            ram_budget.report(build("int x;\n"), 4096)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,248 @@
+/**
+  **************************************************************************************************
+  * @file           : test_speed_loop.c
+  * @brief          : Host plant simulation of the wheel speed loop (car_app_speed.c). Each wheel is a
+  *  				  first order DC motor with a dead band, stepped at 1kHz between the loop
+  *  				  iterations. Reports the settling time of a speed step on a nominal and on a
+  *  				  mismatched motor, the feedforward only drive of wheels without an encoder, and
+  *  				  the CPU cost of one loop iteration.
+  * @author			: Reggie W
+  **************************************************************************************************
+  */
+
+
+/* Includes --------------------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "car_app_speed.h"
+#include "test_check.h"
+
+
+/* Private define --------------------------------------------------------------------------------*/
+#define PLANT_STEPS_PER_ITERATION				(1000 / SPEED_CONTROL_LOOP_HZ)	/* 1ms plant steps */
+#define SETTLING_BAND_PERCENT					5
+#define OVERSHOOT_MAX_PERCENT					10
+#define FINAL_ERROR_MAX_CM_S					1.0		/* Duty cycles are whole percents, 1.5cm/s apart */
+#define SIM_TIME_MS								10000
+#define COST_ITERATIONS							1000000
+
+
+/* Private typedef -------------------------------------------------------------------------------*/
+typedef struct
+{
+	double Gain;						/* Steady speed per duty % past the dead band, cm/s */
+	double DeadBand;					/* Duty % needed to overcome static friction */
+	double Tau_ms;						/* Time constant */
+
+} PlantModel;
+
+typedef struct
+{
+	uint32_t Settling_ms;				/* Last entry into the settling band, SIM_TIME_MS if never */
+	double Overshoot;					/* Peak above the target, cm/s */
+	double FinalError;					/* Target minus speed at the end, cm/s */
+
+} StepResponse;
+
+
+/* Private variables -----------------------------------------------------------------------------*/
+static const PlantModel s_Nominal = { 1.5, 0.0, 150.0 };		/* The one the default gains are set for */
+static const PlantModel s_Mismatched = { 1.2, 8.0, 250.0 };		/* Weaker, stickier and slower */
+
+static double s_WheelSpeed[MOTWHEEL_COUNT];						/* cm/s */
+static uint8_t s_WheelDuty[MOTWHEEL_COUNT];						/* % */
+static uint8_t s_ShiftRegister;
+static uint8_t s_EncodersFitted;
+
+
+/* Private user code -----------------------------------------------------------------------------*/
+
+/*--- Motor layer and encoders seen by the speed loop ---*/
+void Motor_GetOutputs(MotorOutputs *pOutputs)
+{
+	pOutputs->ShiftRegister = s_ShiftRegister;
+}
+
+
+void Motor_ApplyWheelSpeeds(const uint8_t pPercentage[MOTWHEEL_COUNT])
+{
+	memcpy(s_WheelDuty, pPercentage, sizeof(s_WheelDuty));
+}
+
+
+uint8_t Speed_ReadWheelEncoder(E_MotorWheel_Idx Wheel, q16_t *pSpeed)
+{
+	if(!s_EncodersFitted)
+		return 0;
+
+	*pSpeed = (q16_t)(s_WheelSpeed[Wheel] * Q16_ONE);
+	return 1;
+}
+
+
+/*--- Plant ---*/
+static void Plant_Step(const PlantModel *pPlant, uint8_t Wheel)
+{
+	double Drive = (double)s_WheelDuty[Wheel] - pPlant->DeadBand;
+	double Steady = (Drive > 0) ? (Drive * pPlant->Gain) : 0;
+
+	s_WheelSpeed[Wheel] += (Steady - s_WheelSpeed[Wheel]) / pPlant->Tau_ms;
+}
+
+
+/**
+ * @brief	Starts every wheel from rest and tracks the speed of the rear left one after a step to Target
+ */
+static StepResponse Sim_Step(const PlantModel *pPlant, int32_t Target)
+{
+	StepResponse Response = { SIM_TIME_MS, 0, 0 };
+	double Band = (double)Target * SETTLING_BAND_PERCENT / 100;
+	uint8_t InBand = 0;
+
+	for(uint8_t idx = 0; idx < MOTWHEEL_COUNT; idx++)
+	{
+		s_WheelSpeed[idx] = 0;
+		s_WheelDuty[idx] = 0;
+	}
+
+	/* Wheels off first, so that every PID starts from a reset */
+	s_ShiftRegister = 0;
+	Speed_ControlStep();
+
+	Speed_SetTarget(MOTWHEEL_FRONTTIRES, Target);
+	Speed_SetTarget(MOTWHEEL_REARTIRES, Target);
+	s_ShiftRegister = MOT1_SELECTION_BITMASK | MOT2_SELECTION_BITMASK | MOT3_SELECTION_BITMASK | MOT4_SELECTION_BITMASK;
+
+	for(uint32_t Time_ms = 0; Time_ms < SIM_TIME_MS; Time_ms += PLANT_STEPS_PER_ITERATION)
+	{
+		double Error;
+
+		Speed_ControlStep();
+
+		for(uint32_t Step = 0; Step < PLANT_STEPS_PER_ITERATION; Step++)
+		{
+			for(uint8_t idx = 0; idx < MOTWHEEL_COUNT; idx++)
+				Plant_Step(pPlant, idx);
+		}
+
+		Error = (double)Target - s_WheelSpeed[MOTWHEEL_IDX_REARLEFT];
+
+		if(-Error > Response.Overshoot)
+			Response.Overshoot = -Error;
+
+		if((Error <= Band) && (Error >= -Band))
+		{
+			if(!InBand)
+				Response.Settling_ms = Time_ms + PLANT_STEPS_PER_ITERATION;
+			InBand = 1;
+		}
+		else
+		{
+			InBand = 0;
+			Response.Settling_ms = SIM_TIME_MS;
+		}
+
+		Response.FinalError = Error;
+	}
+
+	return Response;
+}
+
+
+static void Test_NominalStep(void)
+{
+	StepResponse Response;
+
+	s_EncodersFitted = 1;
+	Response = Sim_Step(&s_Nominal, SPEED_TARGET_DEFAULT_CM_S);
+
+	printf("nominal motor: settles in %ums, overshoot %.2fcm/s, final error %.3fcm/s\n",
+		   Response.Settling_ms, Response.Overshoot, Response.FinalError);
+
+	CHECK(Response.Settling_ms <= 1500);
+	CHECK(Response.Overshoot <= (SPEED_TARGET_DEFAULT_CM_S * OVERSHOOT_MAX_PERCENT / 100.0));
+	CHECK((Response.FinalError < FINAL_ERROR_MAX_CM_S) && (Response.FinalError > -FINAL_ERROR_MAX_CM_S));
+}
+
+
+/**
+ * @brief	The integral must make up for a motor the feedforward gain is wrong for
+ */
+static void Test_MismatchedStep(void)
+{
+	StepResponse Response;
+
+	s_EncodersFitted = 1;
+	Response = Sim_Step(&s_Mismatched, SPEED_TARGET_DEFAULT_CM_S);
+
+	printf("mismatched motor: settles in %ums, overshoot %.2fcm/s, final error %.3fcm/s\n",
+		   Response.Settling_ms, Response.Overshoot, Response.FinalError);
+
+	CHECK(Response.Settling_ms <= 3000);
+	CHECK(Response.Overshoot <= (SPEED_TARGET_DEFAULT_CM_S * OVERSHOOT_MAX_PERCENT / 100.0));
+	CHECK((Response.FinalError < FINAL_ERROR_MAX_CM_S) && (Response.FinalError > -FINAL_ERROR_MAX_CM_S));
+}
+
+
+/**
+ * @brief	Without encoders the duty cycle is the feedforward term, and no integral builds up
+ */
+static void Test_FeedforwardWithoutEncoder(void)
+{
+	uint32_t EncoderSamples = xSpeedStats.EncoderSamples;
+	StepResponse Response;
+	uint8_t Expected = (uint8_t)Q16_TO_INT(((int64_t)SPEED_PID_KFF_Q16 * SPEED_TARGET_DEFAULT_CM_S) + (Q16_ONE / 2));
+
+	s_EncodersFitted = 0;
+	Response = Sim_Step(&s_Mismatched, SPEED_TARGET_DEFAULT_CM_S);
+
+	printf("feedforward only, mismatched motor: %u%% duty, final error %.2fcm/s\n",
+		   s_WheelDuty[MOTWHEEL_IDX_REARLEFT], Response.FinalError);
+
+	CHECK(xSpeedStats.EncoderSamples == EncoderSamples);
+	CHECK(xSpeedStats.FeedforwardSamples != 0);
+
+	for(uint8_t idx = 0; idx < MOTWHEEL_COUNT; idx++)
+		CHECK(s_WheelDuty[idx] == Expected);
+}
+
+
+/**
+ * @brief	Host time of one loop iteration (4 wheels), the target figure is xSpeedStats.MaxCycles
+ */
+static void Test_IterationCost(void)
+{
+	struct timespec Start, End;
+	double Elapsed_ns;
+
+	s_EncodersFitted = 1;
+	s_ShiftRegister = MOT1_SELECTION_BITMASK | MOT2_SELECTION_BITMASK | MOT3_SELECTION_BITMASK | MOT4_SELECTION_BITMASK;
+
+	clock_gettime(CLOCK_MONOTONIC, &Start);
+	for(uint32_t idx = 0; idx < COST_ITERATIONS; idx++)
+	{
+		s_WheelSpeed[idx & 3] = (double)(idx & 63);
+		Speed_ControlStep();
+	}
+	clock_gettime(CLOCK_MONOTONIC, &End);
+
+	Elapsed_ns = ((End.tv_sec - Start.tv_sec) * 1e9) + (End.tv_nsec - Start.tv_nsec);
+	printf("loop iteration: %.1fns on the host, %u iterations\n", Elapsed_ns / COST_ITERATIONS, COST_ITERATIONS);
+}
+
+
+int main(void)
+{
+	Speed_Init(SPEED_CONTROL_LOOP_HZ);
+
+	Test_NominalStep();
+	Test_MismatchedStep();
+	Test_FeedforwardWithoutEncoder();
+	Test_IterationCost();
+
+	return Test_Result();
+}
+
+
+/******************************************* END OF FILE *******************************************/
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""
+Host test of the SWO demultiplexer and record loader of Tools/trace_decode.py.
+
+Builds ITM captures the way the TPIU emits them, with synchronisation
+packets, overflows, local timestamps and other stimulus ports mixed in, and
+checks that the trace port records come out whole and in order.
+"""
+
+import os
+import struct
+import sys
+import unittest
+
+sys.dont_write_bytecode = True
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+
+import trace_decode  # noqa: E402
+
+SYNC = bytes(5) + b"\x80"           # 47 zero bits then a one
+OVERFLOW = b"\x70"
+
+
+def software_packet(port, payload):
+    """ITM software source packet, 1, 2 or 4 payload bytes."""
+    size = {1: 1, 2: 2, 4: 3}[len(payload)]
+    return bytes(((port << 3) | size,)) + payload
+
+
+def record(timestamp, ev, ident, arg):
+    return struct.pack(trace_decode.RECORD_FORMAT, timestamp, ev, ident, arg)
+
+
+def drained(rec, port=trace_decode.TRACE_ITM_PORT):
+    """A record as Trace_Drain() writes it, two words on the stimulus port."""
+    return software_packet(port, rec[:4]) + software_packet(port, rec[4:])
+
+
+RECORDS = [
+    record(0x00000100, trace_decode.EV_TASK_IN, 3, 40),
+    record(0x00000180, trace_decode.EV_NOTIFY_FROM_ISR, 3, 22),
+    record(0x00000200, trace_decode.EV_ISR_ENTER, 0, 22),
+]
+
+
+class DemuxSwoTest(unittest.TestCase):
+
+    def test_sync_prefix(self):
+        # The 0x80 ending the sync must not swallow the first header
+        capture = SYNC + b"".join(drained(rec) for rec in RECORDS)
+        self.assertEqual(trace_decode.demux_swo(capture, trace_decode.TRACE_ITM_PORT), b"".join(RECORDS))
+
+    def test_repeated_syncs_and_overflow(self):
+        capture = SYNC + SYNC + drained(RECORDS[0]) + OVERFLOW + SYNC + drained(RECORDS[1]) + bytes(7) + b"\x80" \
+                  + drained(RECORDS[2])
+        self.assertEqual(trace_decode.demux_swo(capture, trace_decode.TRACE_ITM_PORT), b"".join(RECORDS))
+
+    def test_other_ports_and_timestamps(self):
+        # Local timestamp with continuation bytes, then a printf on port 0
+        capture = SYNC + b"\xc0\x85\x01" + software_packet(0, b"ok\r\n") + drained(RECORDS[0]) \
+                  + b"\x30" + software_packet(0, b"!") + drained(RECORDS[1])
+        self.assertEqual(trace_decode.demux_swo(capture, trace_decode.TRACE_ITM_PORT), RECORDS[0] + RECORDS[1])
+
+    def test_records_loaded_from_capture(self):
+        capture = SYNC + b"".join(drained(rec) for rec in RECORDS)
+        records = trace_decode.load_records(capture, True, trace_decode.TRACE_ITM_PORT)
+        self.assertEqual(records, [struct.unpack(trace_decode.RECORD_FORMAT, rec) for rec in RECORDS])
+
+
+if __name__ == "__main__":
+    unittest.main()
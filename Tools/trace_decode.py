@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+"""
+Decoder of the FreeRTOS_BLE_Car scheduler trace (Core/Src/car_app_trace.c).
+
+Input is one of:
+  - a dump of xTraceBuffer taken by a debugger, e.g. in gdb:
+        dump binary value trace.bin xTraceBuffer
+  - the records drained on ITM stimulus port TRACE_ITM_PORT, either already
+    demultiplexed (8 bytes per record) or as a raw SWO capture (--swo).
+
+Output is a Chrome/Perfetto trace JSON (open in ui.perfetto.dev or
+chrome://tracing), and a histogram per task of the latency between a task
+notification and the task being switched in.
+
+Usage: trace_decode.py [--swo] [--port N] [--name N=Label ...] [-o out.json] dump.bin
+"""
+
+import argparse
+import json
+import struct
+import sys
+from collections import defaultdict
+
+# Keep in line with car_app_trace.h
+TRACE_MAGIC = 0x45435254
+TRACE_ITM_PORT = 1
+US_PER_COUNT = 2                    # TIM5 at 500kHz, TIMEBASE_US_PER_COUNT
+HEADER_FORMAT = "<6I"               # Magic, Records, Head, Tail, Overwritten, Drained
+RECORD_FORMAT = "<IBBH"             # Timestamp, Type, Id, Arg
+
+EV_TASK_IN = 1
+EV_ISR_ENTER = 2
+EV_ISR_EXIT = 3
+EV_NOTIFY = 4
+EV_NOTIFY_FROM_ISR = 5
+EV_IDLE_SLEEP = 6
+EV_IDLE_WAKE = 7
+EV_TASK_NAME = 8
+
+HISTOGRAM_EDGES_US = [10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000]
+
+
+def demux_swo(data, port):
+    """Keeps the payload of the ITM software packets of one stimulus port."""
+    out = bytearray()
+    idx = 0
+    zeros = 0
+    while idx < len(data):
+        header = data[idx]
+        idx += 1
+        if header == 0x00:
+            # Synchronisation, at least 47 zero bits then a one
+            zeros += 1
+            continue
+        if header == 0x80 and zeros:
+            # Last byte of the synchronisation, not a timestamp header
+            zeros = 0
+            continue
+        zeros = 0
+        if header == 0x70:
+            # Overflow
+            continue
+        size = header & 0x03
+        if size == 0:
+            # Timestamp or extension packet, continuation bit on every byte
+            if header & 0x80:
+                while idx < len(data) and data[idx] & 0x80:
+                    idx += 1
+                idx += 1
+            continue
+        length = 4 if size == 3 else size
+        if not (header & 0x04) and (header >> 3) == port:
+            out += data[idx:idx + length]
+        idx += length
+    return bytes(out)
+
+
+def load_records(data, swo, port):
+    if swo:
+        data = demux_swo(data, port)
+
+    if len(data) >= struct.calcsize(HEADER_FORMAT) and struct.unpack_from("<I", data)[0] == TRACE_MAGIC:
+        magic, count, head, tail, overwritten, drained = struct.unpack_from(HEADER_FORMAT, data)
+        base = struct.calcsize(HEADER_FORMAT)
+        ring = [struct.unpack_from(RECORD_FORMAT, data, base + 8 * n) for n in range(count)]
+        print("RAM dump: %d records pending, %d overwritten, %d drained" % (head - tail, overwritten, drained))
+        return [ring[n % count] for n in range(tail, head)]
+
+    usable = len(data) - (len(data) % 8)
+    return [struct.unpack_from(RECORD_FORMAT, data, off) for off in range(0, usable, 8)]
+
+
+def unwrap(records):
+    """Turns the 32-bit TIM5 counts into microseconds from the first record."""
+    out = []
+    last = None
+    offset = 0
+    for ts, ev, ident, arg in records:
+        if last is not None and ts < last and last - ts > 0x80000000:
+            offset += 1 << 32
+        last = ts
+        out.append(((ts + offset) * US_PER_COUNT, ev, ident, arg))
+    if out:
+        start = out[0][0]
+        out = [(ts - start, ev, ident, arg) for ts, ev, ident, arg in out]
+    return out
+
+
+def build(records, names):
+    events = []
+    latencies = defaultdict(list)
+    pending_notify = {}
+    name_chars = defaultdict(bytearray)
+    running = None
+    isr_stack = []
+    sleep_start = None
+
+    def task_name(number):
+        if number in names:
+            return names[number]
+        if name_chars[number]:
+            return name_chars[number].split(b"\0")[0].decode("ascii", "replace")
+        return "task %d" % number
+
+    for ts, ev, ident, arg in records:
+        if ev == EV_TASK_NAME:
+            name_chars[ident] += bytes((arg & 0xFF, arg >> 8))
+        elif ev == EV_TASK_IN:
+            if running is not None:
+                events.append({"ph": "X", "pid": 1, "tid": running[0], "ts": running[1],
+                               "dur": ts - running[1], "name": task_name(running[0])})
+            running = (ident, ts)
+            if ident in pending_notify:
+                latencies[ident].append(ts - pending_notify.pop(ident))
+        elif ev == EV_ISR_ENTER:
+            isr_stack.append((arg, ts))
+        elif ev == EV_ISR_EXIT:
+            if isr_stack and isr_stack[-1][0] == arg:
+                number, start = isr_stack.pop()
+                events.append({"ph": "X", "pid": 2, "tid": number, "ts": start, "dur": ts - start,
+                               "name": "IRQ %d" % (number - 16)})
+        elif ev in (EV_NOTIFY, EV_NOTIFY_FROM_ISR):
+            # Only the first notification counts, until the task runs
+            pending_notify.setdefault(ident, ts)
+            source = ("IRQ %d" % (arg - 16)) if ev == EV_NOTIFY_FROM_ISR else task_name(arg)
+            events.append({"ph": "i", "s": "t", "pid": 1, "tid": ident, "ts": ts,
+                           "name": "notified by " + source})
+        elif ev == EV_IDLE_SLEEP:
+            sleep_start = ts
+        elif ev == EV_IDLE_WAKE and sleep_start is not None:
+            events.append({"ph": "X", "pid": 3, "tid": 0, "ts": sleep_start, "dur": ts - sleep_start,
+                           "name": "tickless idle"})
+            sleep_start = None
+
+    # Track names
+    for number in set(e["tid"] for e in events if e["pid"] == 1):
+        events.append({"ph": "M", "pid": 1, "tid": number, "name": "thread_name",
+                       "args": {"name": task_name(number)}})
+    for pid, label in ((1, "Tasks"), (2, "Interrupts"), (3, "Low power")):
+        events.append({"ph": "M", "pid": pid, "name": "process_name", "args": {"name": label}})
+
+    return events, latencies, task_name
+
+
+def print_histograms(latencies, task_name):
+    for number in sorted(latencies):
+        values = sorted(latencies[number])
+        p99 = values[min(len(values) - 1, (len(values) * 99) // 100)]
+        print("\n%s: %d wake ups, min %d us, avg %d us, p99 %d us, max %d us"
+              % (task_name(number), len(values), values[0], sum(values) // len(values), p99, values[-1]))
+
+        counts = [0] * (len(HISTOGRAM_EDGES_US) + 1)
+        for value in values:
+            slot = next((n for n, edge in enumerate(HISTOGRAM_EDGES_US) if value < edge), len(HISTOGRAM_EDGES_US))
+            counts[slot] += 1
+
+        widest = max(counts)
+        for n, count in enumerate(counts):
+            label = ("< %d" % HISTOGRAM_EDGES_US[n]) if n < len(HISTOGRAM_EDGES_US) else (">= %d" % HISTOGRAM_EDGES_US[-1])
+            bar = "#" * ((count * 40 + widest - 1) // widest) if count else ""
+            print("  %9s us %7d %s" % (label, count, bar))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", help="xTraceBuffer dump or ITM capture")
+    parser.add_argument("--swo", action="store_true", help="input is a raw SWO capture, keep the trace port only")
+    parser.add_argument("--port", type=int, default=TRACE_ITM_PORT, help="ITM stimulus port of the trace")
+    parser.add_argument("--name", action="append", default=[], metavar="N=Label", help="name of task number N")
+    parser.add_argument("-o", "--output", default="trace.json", help="Chrome/Perfetto trace JSON to write")
+    args = parser.parse_args()
+
+    names = {}
+    for item in args.name:
+        number, _, label = item.partition("=")
+        names[int(number)] = label
+
+    with open(args.dump, "rb") as handle:
+        records = unwrap(load_records(handle.read(), args.swo, args.port))
+
+    if not records:
+        sys.exit("No trace record found")
+
+    events, latencies, task_name = build(records, names)
+
+    with open(args.output, "w") as handle:
+        json.dump({"traceEvents": events, "displayTimeUnit": "ms"}, handle)
+
+    print("%d records over %.3f s written to %s" % (len(records), records[-1][0] / 1e6, args.output))
+    print_histograms(latencies, task_name)
+
+
+if __name__ == "__main__":
+    main()